@@ -0,0 +1,98 @@
+#include "AvahiDiscoveryBackend.hpp"
+#include "AvahiServicePublisher.hpp"
+#include "DistributedServiceDirectory.hpp"
+
+namespace fipa {
+namespace services {
+
+AvahiDiscoveryBackend::AvahiDiscoveryBackend()
+    : mServiceDiscovery(new servicediscovery::avahi::ServiceDiscovery())
+{
+    mServiceDiscovery->serviceAdded.connect(sigc::mem_fun(*this, &AvahiDiscoveryBackend::serviceAdded));
+    mServiceDiscovery->serviceRemoved.connect(sigc::mem_fun(*this, &AvahiDiscoveryBackend::serviceRemoved));
+}
+
+AvahiDiscoveryBackend::~AvahiDiscoveryBackend()
+{
+    stop();
+    delete mServiceDiscovery;
+}
+
+void AvahiDiscoveryBackend::listen(const std::vector<std::string>& scopes, const DiscoveryObserver& observer)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        mObserver = observer;
+    }
+    mServiceDiscovery->listenOn(scopes);
+}
+
+void AvahiDiscoveryBackend::publish(const std::string& scope, const ServiceDirectoryList& entries)
+{
+    std::vector<servicediscovery::avahi::ServiceDescription> descriptions;
+    descriptions.reserve(entries.size());
+    ServiceDirectoryList::const_iterator cit = entries.begin();
+    for(; cit != entries.end(); ++cit)
+    {
+        descriptions.push_back(DistributedServiceDirectory::convert(*cit));
+    }
+
+    boost::unique_lock<boost::mutex> lock(mPublisherMutex);
+    if(!mPublisher)
+    {
+        mPublisher.reset(new AvahiServicePublisher());
+    }
+    // A single modification of the publisher, so that the services are
+    // announced together
+    mPublisher->publish(scope, descriptions);
+}
+
+void AvahiDiscoveryBackend::unpublish(const std::string& scope, const std::vector<Name>& names)
+{
+    boost::unique_lock<boost::mutex> lock(mPublisherMutex);
+    if(mPublisher)
+    {
+        mPublisher->unpublish(scope, names);
+    }
+}
+
+void AvahiDiscoveryBackend::stop()
+{
+    {
+        // Withdraws all services
+        boost::unique_lock<boost::mutex> lock(mPublisherMutex);
+        mPublisher.reset();
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        if(!mObserver)
+        {
+            return;
+        }
+        mObserver = DiscoveryObserver();
+    }
+    mServiceDiscovery->stop();
+}
+
+void AvahiDiscoveryBackend::serviceAdded(servicediscovery::avahi::ServiceEvent event)
+{
+    // Services are announced again when their description changes, so that
+    // the observer is expected to replace an existing entry
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    if(mObserver)
+    {
+        mObserver(ServiceDirectoryChange::ADDED, DistributedServiceDirectory::convert(event.getServiceConfiguration()));
+    }
+}
+
+void AvahiDiscoveryBackend::serviceRemoved(servicediscovery::avahi::ServiceEvent event)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    if(mObserver)
+    {
+        mObserver(ServiceDirectoryChange::REMOVED, DistributedServiceDirectory::convert(event.getServiceConfiguration()));
+    }
+}
+
+} // end namespace services
+} // end namespace fipa
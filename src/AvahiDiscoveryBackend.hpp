@@ -0,0 +1,53 @@
+#ifndef FIPA_SERVICES_AVAHI_DISCOVERY_BACKEND_HPP
+#define FIPA_SERVICES_AVAHI_DISCOVERY_BACKEND_HPP
+
+#include <memory>
+#include <boost/thread.hpp>
+#include <fipa_services/DiscoveryBackend.hpp>
+#include <service_discovery/ServiceDiscovery.hpp>
+
+namespace fipa {
+namespace services {
+
+class AvahiServicePublisher;
+
+/**
+ * \class AvahiDiscoveryBackend
+ * \brief Discovery backend which browses the avahi service types given as
+ * scopes and publishes all services with a single AvahiServicePublisher
+ */
+class AvahiDiscoveryBackend : public DiscoveryBackend
+{
+public:
+    AvahiDiscoveryBackend();
+
+    virtual ~AvahiDiscoveryBackend();
+
+    void listen(const std::vector<std::string>& scopes, const DiscoveryObserver& observer);
+
+    void publish(const std::string& scope, const ServiceDirectoryList& entries);
+
+    void unpublish(const std::string& scope, const std::vector<Name>& names);
+
+    void stop();
+
+private:
+    void serviceAdded(servicediscovery::avahi::ServiceEvent event);
+
+    void serviceRemoved(servicediscovery::avahi::ServiceEvent event);
+
+    servicediscovery::avahi::ServiceDiscovery* mServiceDiscovery;
+    // Guards the observer, so that it is not called after stop
+    boost::mutex mMutex;
+    DiscoveryObserver mObserver;
+
+    // Guards the publisher separately, since the observer is called while
+    // mMutex is held
+    boost::mutex mPublisherMutex;
+    // Created with the first publication
+    std::unique_ptr<AvahiServicePublisher> mPublisher;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_AVAHI_DISCOVERY_BACKEND_HPP
@@ -0,0 +1,434 @@
+#include "AvahiServicePublisher.hpp"
+#include <avahi-common/error.h>
+#include <avahi-common/timeval.h>
+#include <base-logging/Logging.hpp>
+#include <stdexcept>
+
+namespace fipa {
+namespace services {
+
+namespace {
+    /**
+     * Scoped lock of the threaded poll
+     * Must not be used within avahi callbacks, which hold the lock already
+     */
+    class PollLock
+    {
+    public:
+        explicit PollLock(AvahiThreadedPoll* poll)
+            : mPoll(poll)
+        {
+            avahi_threaded_poll_lock(mPoll);
+        }
+
+        ~PollLock()
+        {
+            avahi_threaded_poll_unlock(mPoll);
+        }
+
+    private:
+        PollLock(const PollLock&);
+        PollLock& operator=(const PollLock&);
+
+        AvahiThreadedPoll* mPoll;
+    };
+}
+
+AvahiServicePublisher::AvahiServicePublisher(const base::Time& commitDelay)
+    : mPoll(avahi_threaded_poll_new())
+    , mClient(NULL)
+    , mCommitTimeout(NULL)
+    , mCommitDelayInMS(commitDelay.toMilliseconds())
+    , mCommitScheduled(false)
+{
+    if(!mPoll)
+    {
+        throw std::runtime_error("fipa::services::AvahiServicePublisher: could not create poll");
+    }
+
+    int error;
+    // The client callback is called from within avahi_client_new already
+    AvahiClient* client = avahi_client_new(avahi_threaded_poll_get(mPoll), (AvahiClientFlags) 0, clientCallback, this, &error);
+    if(!client)
+    {
+        avahi_threaded_poll_free(mPoll);
+        throw std::runtime_error("fipa::services::AvahiServicePublisher: could not create client -- " + std::string(avahi_strerror(error)));
+    }
+    mClient = client;
+
+    const AvahiPoll* api = avahi_threaded_poll_get(mPoll);
+    mCommitTimeout = api->timeout_new(api, NULL, commitCallback, this);
+    avahi_threaded_poll_start(mPoll);
+}
+
+AvahiServicePublisher::~AvahiServicePublisher()
+{
+    avahi_threaded_poll_stop(mPoll);
+    const AvahiPoll* api = avahi_threaded_poll_get(mPoll);
+    api->timeout_free(mCommitTimeout);
+    // Frees the entry groups as well, which withdraws all services
+    if(mClient)
+    {
+        avahi_client_free(mClient);
+    }
+    avahi_threaded_poll_free(mPoll);
+}
+
+void AvahiServicePublisher::publish(const std::string& scope, const servicediscovery::avahi::ServiceDescription& description)
+{
+    PollLock lock(mPoll);
+    Scope& services = mScopes[scope];
+    services.services[description.getName()] = description;
+    services.modified.insert(description.getName());
+    mModifiedScopes.insert(scope);
+    scheduleCommit();
+}
+
+void AvahiServicePublisher::publish(const std::string& scope, const std::vector<servicediscovery::avahi::ServiceDescription>& descriptions)
+{
+    PollLock lock(mPoll);
+    Scope& services = mScopes[scope];
+    std::vector<servicediscovery::avahi::ServiceDescription>::const_iterator cit = descriptions.begin();
+    for(; cit != descriptions.end(); ++cit)
+    {
+        services.services[cit->getName()] = *cit;
+        services.modified.insert(cit->getName());
+    }
+    mModifiedScopes.insert(scope);
+    scheduleCommit();
+}
+
+bool AvahiServicePublisher::unpublish(const std::string& scope, const std::string& name)
+{
+    return unpublish(scope, std::vector<std::string>(1, name)) == 1;
+}
+
+size_t AvahiServicePublisher::unpublish(const std::string& scope, const std::vector<std::string>& names)
+{
+    size_t withdrawn = 0;
+    PollLock lock(mPoll);
+    Scopes::iterator it = mScopes.find(scope);
+    if(it != mScopes.end())
+    {
+        std::vector<std::string>::const_iterator cit = names.begin();
+        for(; cit != names.end(); ++cit)
+        {
+            if(it->second.services.erase(*cit))
+            {
+                it->second.modified.insert(*cit);
+                ++withdrawn;
+            }
+        }
+    }
+    if(withdrawn)
+    {
+        mModifiedScopes.insert(scope);
+        scheduleCommit();
+    }
+    return withdrawn;
+}
+
+size_t AvahiServicePublisher::getNumberOfServices() const
+{
+    size_t numberOfServices = 0;
+    PollLock lock(mPoll);
+    Scopes::const_iterator cit = mScopes.begin();
+    for(; cit != mScopes.end(); ++cit)
+    {
+        numberOfServices += cit->second.services.size();
+    }
+    return numberOfServices;
+}
+
+void AvahiServicePublisher::scheduleCommit()
+{
+    // Modifications within the delay are committed together, later
+    // modifications do not postpone the commit further
+    if(mCommitScheduled)
+    {
+        return;
+    }
+    struct timeval tv;
+    const AvahiPoll* api = avahi_threaded_poll_get(mPoll);
+    api->timeout_update(mCommitTimeout, avahi_elapse_time(&tv, mCommitDelayInMS, 0));
+    mCommitScheduled = true;
+}
+
+void AvahiServicePublisher::commit()
+{
+    if(!mClient || avahi_client_get_state(mClient) != AVAHI_CLIENT_S_RUNNING)
+    {
+        // Committed once the client is running
+        return;
+    }
+
+    std::set<std::string>::const_iterator sit = mModifiedScopes.begin();
+    for(; sit != mModifiedScopes.end(); ++sit)
+    {
+        Scope& scope = mScopes[*sit];
+        if(scope.isolated)
+        {
+            commitServiceGroups(*sit, scope);
+        } else {
+            commitGroup(*sit, scope);
+        }
+        scope.modified.clear();
+    }
+    mModifiedScopes.clear();
+}
+
+void AvahiServicePublisher::commitGroup(const std::string& type, Scope& scope)
+{
+    if(!scope.group)
+    {
+        scope.group = avahi_entry_group_new(mClient, groupCallback, this);
+        if(!scope.group)
+        {
+            LOG_ERROR_S << "AvahiServicePublisher: could not create entry group for '" << type << "' -- " << avahi_strerror(avahi_client_errno(mClient));
+            return;
+        }
+    }
+    avahi_entry_group_reset(scope.group);
+
+    std::map<std::string, servicediscovery::avahi::ServiceDescription>::const_iterator cit = scope.services.begin();
+    for(; cit != scope.services.end(); ++cit)
+    {
+        addService(scope.group, type, cit->second);
+    }
+
+    if(!avahi_entry_group_is_empty(scope.group))
+    {
+        int error = avahi_entry_group_commit(scope.group);
+        if(error < 0)
+        {
+            LOG_ERROR_S << "AvahiServicePublisher: could not commit services of '" << type << "' -- " << avahi_strerror(error);
+        }
+    }
+}
+
+void AvahiServicePublisher::commitServiceGroups(const std::string& type, Scope& scope)
+{
+    if(scope.group)
+    {
+        avahi_entry_group_free(scope.group);
+        scope.group = NULL;
+    }
+
+    // The service of the other host keeps its name, so the local service
+    // is withdrawn
+    std::set<std::string>::const_iterator cit = scope.collisions.begin();
+    for(; cit != scope.collisions.end(); ++cit)
+    {
+        LOG_WARN_S << "AvahiServicePublisher: service name collision, withdrawing '" << *cit << "' of '" << type << "'";
+        scope.services.erase(*cit);
+        scope.modified.insert(*cit);
+    }
+    scope.collisions.clear();
+
+    for(cit = scope.modified.begin(); cit != scope.modified.end(); ++cit)
+    {
+        std::map<std::string, AvahiEntryGroup*>::iterator git = scope.serviceGroups.find(*cit);
+        std::map<std::string, servicediscovery::avahi::ServiceDescription>::const_iterator sit = scope.services.find(*cit);
+        if(sit == scope.services.end())
+        {
+            if(git != scope.serviceGroups.end())
+            {
+                avahi_entry_group_free(git->second);
+                scope.serviceGroups.erase(git);
+            }
+            continue;
+        }
+
+        AvahiEntryGroup* group = NULL;
+        if(git != scope.serviceGroups.end())
+        {
+            group = git->second;
+            avahi_entry_group_reset(group);
+        } else {
+            group = avahi_entry_group_new(mClient, groupCallback, this);
+            if(!group)
+            {
+                LOG_ERROR_S << "AvahiServicePublisher: could not create entry group for '" << *cit << "' of '" << type << "' -- " << avahi_strerror(avahi_client_errno(mClient));
+                continue;
+            }
+            scope.serviceGroups[*cit] = group;
+        }
+
+        if(addService(group, type, sit->second))
+        {
+            int error = avahi_entry_group_commit(group);
+            if(error < 0)
+            {
+                LOG_ERROR_S << "AvahiServicePublisher: could not commit service '" << *cit << "' of '" << type << "' -- " << avahi_strerror(error);
+            }
+        }
+    }
+}
+
+bool AvahiServicePublisher::addService(AvahiEntryGroup* group, const std::string& type, const servicediscovery::avahi::ServiceDescription& description)
+{
+    AvahiStringList* txt = NULL;
+    std::list<std::string> rawDescriptions = description.getRawDescriptions();
+    std::list<std::string>::const_iterator rit = rawDescriptions.begin();
+    for(; rit != rawDescriptions.end(); ++rit)
+    {
+        txt = avahi_string_list_add(txt, rit->c_str());
+    }
+
+    servicediscovery::avahi::ServiceConfiguration configuration(description);
+    int error = avahi_entry_group_add_service_strlst(group, AVAHI_IF_UNSPEC, AVAHI_PROTO_UNSPEC, (AvahiPublishFlags) 0,
+            description.getName().c_str(), type.c_str(), NULL, NULL, configuration.getPort(), txt);
+    avahi_string_list_free(txt);
+    if(error < 0)
+    {
+        LOG_WARN_S << "AvahiServicePublisher: could not add service '" << description.getName() << "' to '" << type << "' -- " << avahi_strerror(error);
+        return false;
+    }
+    return true;
+}
+
+void AvahiServicePublisher::markAllModified()
+{
+    Scopes::iterator it = mScopes.begin();
+    for(; it != mScopes.end(); ++it)
+    {
+        Scope& scope = it->second;
+        std::map<std::string, servicediscovery::avahi::ServiceDescription>::const_iterator sit = scope.services.begin();
+        for(; sit != scope.services.end(); ++sit)
+        {
+            scope.modified.insert(sit->first);
+        }
+        mModifiedScopes.insert(it->first);
+    }
+}
+
+void AvahiServicePublisher::handleCollision(AvahiEntryGroup* group)
+{
+    // Entry groups are modified by the next commit only, since this might
+    // be called from within an avahi call on the group
+    Scopes::iterator it = mScopes.begin();
+    for(; it != mScopes.end(); ++it)
+    {
+        Scope& scope = it->second;
+        if(scope.group == group)
+        {
+            // The colliding service is unknown, so each service gets its own
+            // entry group to find it
+            LOG_WARN_S << "AvahiServicePublisher: service name collision in '" << it->first << "', publishing its services individually";
+            scope.isolated = true;
+            std::map<std::string, servicediscovery::avahi::ServiceDescription>::const_iterator sit = scope.services.begin();
+            for(; sit != scope.services.end(); ++sit)
+            {
+                scope.modified.insert(sit->first);
+            }
+            mModifiedScopes.insert(it->first);
+            scheduleCommit();
+            return;
+        }
+
+        std::map<std::string, AvahiEntryGroup*>::const_iterator git = scope.serviceGroups.begin();
+        for(; git != scope.serviceGroups.end(); ++git)
+        {
+            if(git->second == group)
+            {
+                scope.collisions.insert(git->first);
+                mModifiedScopes.insert(it->first);
+                scheduleCommit();
+                return;
+            }
+        }
+    }
+}
+
+void AvahiServicePublisher::recreateClient()
+{
+    // Freeing the client frees all its entry groups
+    Scopes::iterator it = mScopes.begin();
+    for(; it != mScopes.end(); ++it)
+    {
+        it->second.group = NULL;
+        it->second.serviceGroups.clear();
+    }
+    avahi_client_free(mClient);
+    mClient = NULL;
+
+    int error;
+    // Wait for the daemon to become available again instead of failing,
+    // services are republished once the client is running
+    AvahiClient* client = avahi_client_new(avahi_threaded_poll_get(mPoll), AVAHI_CLIENT_NO_FAIL, clientCallback, this, &error);
+    if(!client)
+    {
+        LOG_ERROR_S << "AvahiServicePublisher: could not recreate client, services are not published -- " << avahi_strerror(error);
+    }
+    mClient = client;
+}
+
+void AvahiServicePublisher::clientCallback(AvahiClient* client, AvahiClientState state, void* userdata)
+{
+    AvahiServicePublisher* publisher = static_cast<AvahiServicePublisher*>(userdata);
+    publisher->mClient = client;
+
+    switch(state)
+    {
+        case AVAHI_CLIENT_S_RUNNING:
+        {
+            // (Re)publish all scopes, e.g. after the host name has changed
+            publisher->markAllModified();
+            publisher->commit();
+            break;
+        }
+        case AVAHI_CLIENT_S_COLLISION:
+        case AVAHI_CLIENT_S_REGISTERING:
+        {
+            // The host name changes, services are republished once running
+            Scopes::iterator it = publisher->mScopes.begin();
+            for(; it != publisher->mScopes.end(); ++it)
+            {
+                if(it->second.group)
+                {
+                    avahi_entry_group_reset(it->second.group);
+                }
+                std::map<std::string, AvahiEntryGroup*>::iterator git = it->second.serviceGroups.begin();
+                for(; git != it->second.serviceGroups.end(); ++git)
+                {
+                    avahi_entry_group_reset(git->second);
+                }
+            }
+            break;
+        }
+        case AVAHI_CLIENT_FAILURE:
+            LOG_ERROR_S << "AvahiServicePublisher: client failure, reconnecting -- " << avahi_strerror(avahi_client_errno(client));
+            publisher->recreateClient();
+            break;
+        default:
+            break;
+    }
+}
+
+void AvahiServicePublisher::groupCallback(AvahiEntryGroup* group, AvahiEntryGroupState state, void* userdata)
+{
+    AvahiServicePublisher* publisher = static_cast<AvahiServicePublisher*>(userdata);
+    switch(state)
+    {
+        case AVAHI_ENTRY_GROUP_COLLISION:
+            publisher->handleCollision(group);
+            break;
+        case AVAHI_ENTRY_GROUP_FAILURE:
+            LOG_ERROR_S << "AvahiServicePublisher: entry group failure -- " << avahi_strerror(avahi_client_errno(avahi_entry_group_get_client(group)));
+            break;
+        default:
+            break;
+    }
+}
+
+void AvahiServicePublisher::commitCallback(AvahiTimeout* timeout, void* userdata)
+{
+    AvahiServicePublisher* publisher = static_cast<AvahiServicePublisher*>(userdata);
+    const AvahiPoll* api = avahi_threaded_poll_get(publisher->mPoll);
+    api->timeout_update(timeout, NULL);
+    publisher->mCommitScheduled = false;
+    publisher->commit();
+}
+
+} // end namespace services
+} // end namespace fipa
@@ -0,0 +1,170 @@
+#ifndef FIPA_SERVICES_AVAHI_SERVICE_PUBLISHER_HPP
+#define FIPA_SERVICES_AVAHI_SERVICE_PUBLISHER_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <avahi-client/client.h>
+#include <avahi-client/publish.h>
+#include <avahi-common/thread-watch.h>
+#include <base/Time.hpp>
+#include <service_discovery/ServiceDiscovery.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class AvahiServicePublisher
+ * \brief Publishes any number of services with a single avahi client
+ * \details All services of a scope, i.e. an avahi service type, are records
+ * of a single entry group, so that the number of clients, threads and D-Bus
+ * connections does not grow with the number of services.
+ *
+ * Since avahi does not allow to modify a committed entry group, each
+ * modification recommits the entry group of the scope. Modifications are
+ * therefore collected and committed together after the commit delay, so
+ * that registering many services at once results in a single announcement.
+ * Services are republished after the host name has changed, e.g. due to a
+ * collision, and after the connection to the avahi daemon has been rebuilt.
+ *
+ * If the entry group of a scope collides with a service of another host,
+ * the scope falls back to one entry group per service, so that only the
+ * colliding service is withdrawn while the others remain published.
+ *
+ * The publisher is thread-safe.
+ */
+class AvahiServicePublisher
+{
+public:
+    /**
+     * Connect to the avahi daemon
+     * \param commitDelay Time modifications are collected before they are
+     * committed
+     * \throws std::runtime_error if the avahi client cannot be created
+     */
+    AvahiServicePublisher(const base::Time& commitDelay = base::Time::fromMilliseconds(10));
+
+    ~AvahiServicePublisher();
+
+    /**
+     * Publish a service, or update the service of the same name
+     * \param scope Service type to publish the service with
+     * \param description Description of the service
+     */
+    void publish(const std::string& scope, const servicediscovery::avahi::ServiceDescription& description);
+
+    /**
+     * Publish or update several services, which are committed together
+     * \param scope Service type to publish the services with
+     * \param descriptions Descriptions of the services
+     */
+    void publish(const std::string& scope, const std::vector<servicediscovery::avahi::ServiceDescription>& descriptions);
+
+    /**
+     * Withdraw a service
+     * \return false if the service is not published in the scope
+     */
+    bool unpublish(const std::string& scope, const std::string& name);
+
+    /**
+     * Withdraw several services, which is committed together
+     * \return Number of services that have been withdrawn
+     */
+    size_t unpublish(const std::string& scope, const std::vector<std::string>& names);
+
+    /**
+     * Get the number of published services of all scopes
+     */
+    size_t getNumberOfServices() const;
+
+private:
+    struct Scope
+    {
+        /// Entry group of all services, unless the scope is isolated
+        AvahiEntryGroup* group;
+        /// Entry groups of the individual services, once a collision
+        /// occurred in the scope
+        std::map<std::string, AvahiEntryGroup*> serviceGroups;
+        bool isolated;
+        std::map<std::string, servicediscovery::avahi::ServiceDescription> services;
+        /// Services modified since the last commit
+        std::set<std::string> modified;
+        /// Services whose entry group reported a collision
+        std::set<std::string> collisions;
+
+        Scope() : group(NULL), isolated(false) {}
+    };
+    typedef std::map<std::string, Scope> Scopes;
+
+    /**
+     * Commit the modified scopes after the commit delay
+     * Requires the poll lock
+     */
+    void scheduleCommit();
+
+    /**
+     * Commit the modified scopes, if the client is running
+     * Requires the poll lock
+     */
+    void commit();
+
+    /**
+     * Commit the services of a scope in a single entry group
+     * Requires the poll lock
+     */
+    void commitGroup(const std::string& type, Scope& scope);
+
+    /**
+     * Commit the modified services of an isolated scope, each in its own
+     * entry group, and withdraw the colliding services
+     * Requires the poll lock
+     */
+    void commitServiceGroups(const std::string& type, Scope& scope);
+
+    /**
+     * Add a service to an entry group
+     * \return false if the service could not be added
+     */
+    static bool addService(AvahiEntryGroup* group, const std::string& type, const servicediscovery::avahi::ServiceDescription& description);
+
+    /**
+     * Mark all services as modified, so that they are republished with the
+     * next commit
+     * Requires the poll lock
+     */
+    void markAllModified();
+
+    /**
+     * Handle a collision of an entry group
+     * Requires the poll lock
+     */
+    void handleCollision(AvahiEntryGroup* group);
+
+    /**
+     * Replace the failed client, which frees all entry groups, and republish
+     * once the new client is running
+     * Requires the poll lock
+     */
+    void recreateClient();
+
+    static void clientCallback(AvahiClient* client, AvahiClientState state, void* userdata);
+
+    static void groupCallback(AvahiEntryGroup* group, AvahiEntryGroupState state, void* userdata);
+
+    static void commitCallback(AvahiTimeout* timeout, void* userdata);
+
+    AvahiThreadedPoll* mPoll;
+    AvahiClient* mClient;
+    AvahiTimeout* mCommitTimeout;
+    unsigned mCommitDelayInMS;
+    bool mCommitScheduled;
+
+    // The following members are guarded by the poll lock
+    Scopes mScopes;
+    std::set<std::string> mModifiedScopes;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_AVAHI_SERVICE_PUBLISHER_HPP
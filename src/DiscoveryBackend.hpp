@@ -0,0 +1,64 @@
+#ifndef FIPA_SERVICES_DISCOVERY_BACKEND_HPP
+#define FIPA_SERVICES_DISCOVERY_BACKEND_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <fipa_services/ServiceDirectoryChangeFeed.hpp>
+
+namespace fipa {
+namespace services {
+
+/// Called for services which appear (ADDED), change (MODIFIED) or disappear
+/// (REMOVED), for removals only the name of the entry is set
+typedef std::function<void (ServiceDirectoryChange::Type, const ServiceDirectoryEntry&)> DiscoveryObserver;
+
+/**
+ * \class DiscoveryBackend
+ * \brief Discovery mechanism a DistributedServiceDirectory is built on
+ * \details A backend publishes the services registered with the directory
+ * and reports the services of the given scopes as events, so that the
+ * directory can answer searches from a local cache. Services which are
+ * already visible when listening starts are reported as ADDED. Services
+ * published by the backend itself are reported as well, once they are
+ * visible.
+ */
+class DiscoveryBackend
+{
+public:
+    typedef std::shared_ptr<DiscoveryBackend> Ptr;
+
+    virtual ~DiscoveryBackend() {}
+
+    /**
+     * Start listening for services
+     * \param scopes Scopes, e.g. avahi service types, to listen on
+     * \param observer Observer that is called from any thread, until stop
+     * returns
+     */
+    virtual void listen(const std::vector<std::string>& scopes, const DiscoveryObserver& observer) = 0;
+
+    /**
+     * Publish services, or update the services of the same names
+     * \details The services of one call should be announced together
+     * \param scope Scope to publish the services in
+     * \param entries Entries of the services
+     */
+    virtual void publish(const std::string& scope, const ServiceDirectoryList& entries) = 0;
+
+    /**
+     * Withdraw services that have been published by this backend
+     * \param scope Scope the services have been published in
+     * \param names Names of the services
+     */
+    virtual void unpublish(const std::string& scope, const std::vector<Name>& names) = 0;
+
+    /**
+     * Stop listening and withdraw all published services
+     */
+    virtual void stop() = 0;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_DISCOVERY_BACKEND_HPP
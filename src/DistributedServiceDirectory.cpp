@@ -1,4 +1,6 @@
 #include "DistributedServiceDirectory.hpp"
+#include "AvahiDiscoveryBackend.hpp"
+#include "RegexCache.hpp"
 #include <boost/algorithm/string.hpp>
 #include <base-logging/Logging.hpp>
 
@@ -6,24 +8,41 @@ namespace fipa {
 namespace services {
 
 DistributedServiceDirectory::DistributedServiceDirectory(const std::string& scope)
-    : mServiceDiscovery(new servicediscovery::avahi::ServiceDiscovery())
+    : mDiscoveryBackend(new AvahiDiscoveryBackend())
+    , mStopWorker(false)
 {
     std::vector<std::string> scopes;
     scopes.push_back(scope);
 
-    mServiceDiscovery->listenOn(scopes);
+    mDiscoveryBackend->listen(scopes, std::bind(&DistributedServiceDirectory::handleDiscoveryEvent, this, std::placeholders::_1, std::placeholders::_2));
 }
 
 DistributedServiceDirectory::DistributedServiceDirectory(const std::vector<std::string>& scopes)
-    : mServiceDiscovery(new servicediscovery::avahi::ServiceDiscovery())
+    : mDiscoveryBackend(new AvahiDiscoveryBackend())
+    , mStopWorker(false)
 {
-    mServiceDiscovery->listenOn(scopes);
+    mDiscoveryBackend->listen(scopes, std::bind(&DistributedServiceDirectory::handleDiscoveryEvent, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+DistributedServiceDirectory::DistributedServiceDirectory(const std::vector<std::string>& scopes, const DiscoveryBackend::Ptr& backend)
+    : mDiscoveryBackend(backend)
+    , mStopWorker(false)
+{
+    mDiscoveryBackend->listen(scopes, std::bind(&DistributedServiceDirectory::handleDiscoveryEvent, this, std::placeholders::_1, std::placeholders::_2));
 }
 
 DistributedServiceDirectory::~DistributedServiceDirectory()
 {
-    mServiceDiscovery->stop();
-    delete mServiceDiscovery;
+    {
+        boost::unique_lock<boost::mutex> lock(mPendingMutex);
+        mStopWorker = true;
+    }
+    mPendingCondition.notify_all();
+    if(mWorker.joinable())
+    {
+        mWorker.join();
+    }
+    mDiscoveryBackend->stop();
 }
 
 std::string DistributedServiceDirectory::canonizeName(const std::string& name)
@@ -83,72 +102,358 @@ ServiceDirectoryList DistributedServiceDirectory::convert(const std::map<std::st
     return serviceDirectoryList;
 }
 
-void DistributedServiceDirectory::registerService(const ServiceDirectoryEntry& entry, const std::string& publishDomain, uint32_t ttlInMS)
+void DistributedServiceDirectory::registerService(const ServiceDirectoryEntry& entry, const std::string& publishDomain)
 {
-    using namespace servicediscovery::avahi;
-
-    LOG_DEBUG_S << "DistributedServiceDirectory: register: " << entry.toString();
+    registerServices(ServiceDirectoryList(1, entry), publishDomain);
+}
 
+void DistributedServiceDirectory::registerServices(const ServiceDirectoryList& entries, const std::string& publishDomain)
+{
     boost::unique_lock<boost::mutex> lock(mMutex);
-    ServiceDescription serviceDescription = convert(entry); 
+    withdrawExpired(base::Time::now());
+    publish(entries, publishDomain);
+}
 
-    ServiceConfiguration serviceConfiguration(serviceDescription);
-    serviceConfiguration.setType(publishDomain);
+void DistributedServiceDirectory::publish(const ServiceDirectoryList& entries, const std::string& publishDomain)
+{
+    ServiceDirectoryList published;
+    published.reserve(entries.size());
+    ServiceDirectoryList::const_iterator cit = entries.begin();
+    for(; cit != entries.end(); ++cit)
+    {
+        LOG_DEBUG_S << "DistributedServiceDirectory: register: " << cit->toString();
+        PublishedServices::iterator it = mPublishedServices.find(*cit);
+        if(it != mPublishedServices.end())
+        {
+            if(it->second != publishDomain)
+            {
+                mDiscoveryBackend->unpublish(it->second, std::vector<Name>(1, canonizeName(cit->getName())));
+            }
+            mPublishedServices.erase(it);
+        }
+        mRegistrationLeases.cancel(cit->getName());
+        ServiceDirectoryEntry entry = *cit;
+        entry.setFieldContent(ServiceDirectoryEntry::NAME, canonizeName(cit->getName()));
+        published.push_back(entry);
+        mPublishedServices[*cit] = publishDomain;
+    }
+    // A single publication, so that the services are announced together
+    mDiscoveryBackend->publish(publishDomain, published);
+}
 
-    ServiceDiscovery* serviceDiscovery = new ServiceDiscovery();
-    serviceDiscovery->start(serviceConfiguration);
+void DistributedServiceDirectory::registerService(const ServiceDirectoryEntry& entry, const base::Time& leaseDuration)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    base::Time now = base::Time::now();
+    withdrawExpired(now);
+    publish(ServiceDirectoryList(1, entry), DEFAULT_SERVICE_SCOPE);
+    mRegistrationLeases.schedule(entry.getName(), now + leaseDuration);
+}
 
-    mServiceDiscoveries[entry] = serviceDiscovery;
+void DistributedServiceDirectory::renewLease(const Name& name, const base::Time& leaseDuration)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    base::Time now = base::Time::now();
+    withdrawExpired(now);
+    if(!mRegistrationLeases.contains(name))
+    {
+        throw NotFound("Lease of " + name);
+    }
+    mRegistrationLeases.schedule(name, now + leaseDuration);
 }
 
-void DistributedServiceDirectory::deregisterService(const std::string& regex, ServiceDirectoryEntry::Field field)
+size_t DistributedServiceDirectory::expireLeases(const base::Time& now)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return withdrawExpired(now);
+}
 
+size_t DistributedServiceDirectory::withdrawExpired(const base::Time& now)
 {
-    using namespace servicediscovery::avahi;
+    std::vector<std::string> expired = mRegistrationLeases.advance(now);
+    std::vector<std::string>::const_iterator cit = expired.begin();
+    for(; cit != expired.end(); ++cit)
+    {
+        LOG_INFO_S << "DistributedServiceDirectory: lease expired: " << *cit;
+        withdraw(*cit);
+    }
+    // Leases are cancelled when a service is withdrawn, so that all expired
+    // services are still registered
+    return expired.size();
+}
 
+void DistributedServiceDirectory::deregisterService(const std::string& regex, ServiceDirectoryEntry::Field field)
+{
     boost::unique_lock<boost::mutex> lock(mMutex);
-    ServiceDiscoveryMap::iterator it = mServiceDiscoveries.begin();
+    withdrawExpired(base::Time::now());
+    PublishedServices::iterator it = mPublishedServices.begin();
 
-    boost::regex r(regex);
+    RegexCache::RegexPtr r = RegexCache::getInstance().get(regex);
     boost::smatch what;
-    for(; it != mServiceDiscoveries.end(); ++it)
+    for(; it != mPublishedServices.end(); ++it)
     {
-        ServiceDirectoryEntry entry = it->first;
-        ServiceDiscovery* serviceDiscovery = it->second;
-
-        if(boost::regex_match( entry.getFieldContent(field) ,what,r))
+        const ServiceDirectoryEntry& entry = it->first;
+        if(boost::regex_match( entry.getFieldContent(field) ,what,*r))
         {
-            serviceDiscovery->stop();
-            delete serviceDiscovery;
-            mServiceDiscoveries.erase(it);
+            withdraw(entry.getName());
             return;
         }
     }
     throw NotFound("DistributedServiceDirectory: deregistration failed. No known ServiceDirectoryEntry matching '" + regex + "'");
 }
 
-ServiceDirectoryList DistributedServiceDirectory::search(const std::string& regex, ServiceDirectoryEntry::Field field, bool doThrow) const
+void DistributedServiceDirectory::modify(const ServiceDirectoryEntry& entry)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    withdrawExpired(base::Time::now());
+    PublishedServices::iterator it = mPublishedServices.find(entry);
+    if(it == mPublishedServices.end())
+    {
+        throw NotFound("DistributedServiceDirectory: modification failed. No known ServiceDirectoryEntry named '" + entry.getName() + "'");
+    }
+
+    // The key holds the registered content, so it is replaced as well
+    std::string scope = it->second;
+    mPublishedServices.erase(it);
+    mPublishedServices[entry] = scope;
+
+    ServiceDirectoryEntry published = entry;
+    published.setFieldContent(ServiceDirectoryEntry::NAME, canonizeName(entry.getName()));
+    mDiscoveryBackend->publish(scope, ServiceDirectoryList(1, published));
+}
+
+size_t DistributedServiceDirectory::restoreSnapshot(const std::string& filename, const base::Time& leaseDuration)
+{
+    throw NotSupported("DistributedServiceDirectory::restoreSnapshot");
+}
+
+size_t DistributedServiceDirectory::restore(const ServiceDirectoryList& entries, const base::Time& leaseDuration)
 {
-    using namespace servicediscovery::avahi;
+    throw NotSupported("DistributedServiceDirectory::restore");
+}
 
-    SearchPattern pattern;
-    if(field == ServiceDirectoryEntry::NAME)
+void DistributedServiceDirectory::deregisterServices(const std::vector<Name>& names)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    withdrawExpired(base::Time::now());
+    std::vector<Name>::const_iterator cit = names.begin();
+    for(; cit != names.end(); ++cit)
     {
-        pattern = SearchPattern(regex);
-    } else {
-        pattern = SearchPattern(".*", ServiceDirectoryEntry::FieldTxt[field], regex);
+        if(!mPublishedServices.count(ServiceDirectoryEntry(*cit, "", ServiceLocator(), "")))
+        {
+            throw NotFound("DistributedServiceDirectory: deregistration failed. No known ServiceDirectoryEntry named '" + *cit + "'");
+        }
+    }
+
+    // Names to withdraw per scope
+    std::map<std::string, std::vector<Name> > withdrawals;
+    for(cit = names.begin(); cit != names.end(); ++cit)
+    {
+        PublishedServices::iterator it = mPublishedServices.find(ServiceDirectoryEntry(*cit, "", ServiceLocator(), ""));
+        if(it != mPublishedServices.end())
+        {
+            withdrawals[it->second].push_back(canonizeName(*cit));
+            mPublishedServices.erase(it);
+            mRegistrationLeases.cancel(*cit);
+        }
+    }
+
+    std::map<std::string, std::vector<Name> >::const_iterator wit = withdrawals.begin();
+    for(; wit != withdrawals.end(); ++wit)
+    {
+        mDiscoveryBackend->unpublish(wit->first, wit->second);
     }
+}
 
-    // Search for services
-    LOG_DEBUG_S << "Searching for services: " << regex;
-    std::map<std::string, ServiceDescription> results = ServiceDiscovery::getVisibleServices(pattern);
-    LOG_DEBUG_S << "Search completed";
-    if(results.empty() && doThrow)
+void DistributedServiceDirectory::withdraw(const Name& name)
+{
+    PublishedServices::iterator it = mPublishedServices.find(ServiceDirectoryEntry(name, "", ServiceLocator(), ""));
+    if(it == mPublishedServices.end())
     {
-        throw NotFound("DistributedServiceDirectory::search failed: No ServiceDirectoryEntry matching '" + regex + "' on field type '" + ServiceDirectoryEntry::FieldTxt[field] + "'");
+        throw NotFound("DistributedServiceDirectory: deregistration failed. No known ServiceDirectoryEntry named '" + name + "'");
     }
+    mDiscoveryBackend->unpublish(it->second, std::vector<Name>(1, canonizeName(name)));
+    // The name might refer to the erased entry
+    mRegistrationLeases.cancel(name);
+    mPublishedServices.erase(it);
+}
+
+std::future<void> DistributedServiceDirectory::registerServiceAsync(const ServiceDirectoryEntry& entry, const std::string& publishDomain)
+{
+    return enqueue(entry.getName(), true, entry, publishDomain);
+}
 
-    return convert(results);
+std::future<void> DistributedServiceDirectory::deregisterServiceAsync(const Name& name)
+{
+    return enqueue(name, false, ServiceDirectoryEntry(), "");
+}
+
+std::future<void> DistributedServiceDirectory::enqueue(const Name& name, bool publish, const ServiceDirectoryEntry& entry, const std::string& scope)
+{
+    std::promise<void> promise;
+    std::future<void> future = promise.get_future();
+    {
+        boost::unique_lock<boost::mutex> lock(mPendingMutex);
+        if(!mWorker.joinable())
+        {
+            mWorker = boost::thread(&DistributedServiceDirectory::processPendingOperations, this);
+        }
+
+        std::map<Name, PendingOperation>::iterator it = mPendingOperations.find(name);
+        if(it == mPendingOperations.end())
+        {
+            it = mPendingOperations.insert(std::make_pair(name, PendingOperation())).first;
+            it->second.replacesRegistration = false;
+            mPendingOrder.push_back(name);
+        } else if(it->second.publish && !publish)
+        {
+            it->second.replacesRegistration = true;
+        }
+        // The latest request determines what is applied
+        PendingOperation& operation = it->second;
+        operation.publish = publish;
+        operation.entry = entry;
+        operation.scope = scope;
+        operation.promises.push_back(std::move(promise));
+    }
+    mPendingCondition.notify_one();
+    return future;
+}
+
+void DistributedServiceDirectory::processPendingOperations()
+{
+    while(true)
+    {
+        Name name;
+        PendingOperation operation;
+        {
+            boost::unique_lock<boost::mutex> lock(mPendingMutex);
+            // Pending operations are applied before the worker stops
+            while(mPendingOrder.empty() && !mStopWorker)
+            {
+                mPendingCondition.wait(lock);
+            }
+            if(mPendingOrder.empty())
+            {
+                return;
+            }
+            name = mPendingOrder.front();
+            mPendingOrder.pop_front();
+            std::map<Name, PendingOperation>::iterator it = mPendingOperations.find(name);
+            operation = std::move(it->second);
+            mPendingOperations.erase(it);
+        }
+
+        std::exception_ptr error;
+        try {
+            if(operation.publish)
+            {
+                registerService(operation.entry, operation.scope);
+            } else {
+                boost::unique_lock<boost::mutex> lock(mMutex);
+                if(!operation.replacesRegistration || mPublishedServices.count(ServiceDirectoryEntry(name, "", ServiceLocator(), "")))
+                {
+                    withdraw(name);
+                }
+            }
+        } catch(...)
+        {
+            error = std::current_exception();
+        }
+
+        std::vector<std::promise<void> >::iterator pit = operation.promises.begin();
+        for(; pit != operation.promises.end(); ++pit)
+        {
+            if(error)
+            {
+                pit->set_exception(error);
+            } else {
+                pit->set_value();
+            }
+        }
+    }
+}
+
+ServiceDirectoryList DistributedServiceDirectory::getRegisteredServices() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    ServiceDirectoryList services;
+    PublishedServices::const_iterator cit = mPublishedServices.begin();
+    for(; cit != mPublishedServices.end(); ++cit)
+    {
+        services.push_back(cit->first);
+    }
+    return services;
+}
+
+void DistributedServiceDirectory::mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field selectiveMerge)
+{
+    std::set<std::string> fieldValues;
+    std::set<Name> names;
+    ServiceDirectoryList::const_iterator cit = updateList.begin();
+    for(; cit != updateList.end(); ++cit)
+    {
+        fieldValues.insert(cit->getFieldContent(selectiveMerge));
+        names.insert(cit->getName());
+    }
+
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    withdrawExpired(base::Time::now());
+
+    // Services of the update list are published again rather than withdrawn
+    std::vector<Name> removals;
+    PublishedServices::const_iterator it = mPublishedServices.begin();
+    for(; it != mPublishedServices.end(); ++it)
+    {
+        const ServiceDirectoryEntry& entry = it->first;
+        if(fieldValues.count(entry.getFieldContent(selectiveMerge)) && !names.count(entry.getName()))
+        {
+            removals.push_back(entry.getName());
+        }
+    }
+
+    // Registered services keep the domain they have been published in, only
+    // new services are published in the default domain
+    std::map<std::string, ServiceDirectoryList> updatesByDomain;
+    for(cit = updateList.begin(); cit != updateList.end(); ++cit)
+    {
+        PublishedServices::const_iterator pit = mPublishedServices.find(*cit);
+        if(pit != mPublishedServices.end())
+        {
+            updatesByDomain[pit->second].push_back(*cit);
+        } else {
+            updatesByDomain[DEFAULT_SERVICE_SCOPE].push_back(*cit);
+        }
+    }
+
+    std::vector<Name>::const_iterator rit = removals.begin();
+    for(; rit != removals.end(); ++rit)
+    {
+        withdraw(*rit);
+    }
+
+    std::map<std::string, ServiceDirectoryList>::const_iterator uit = updatesByDomain.begin();
+    for(; uit != updatesByDomain.end(); ++uit)
+    {
+        publish(uit->second, uit->first);
+    }
+}
+
+void DistributedServiceDirectory::handleDiscoveryEvent(ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry)
+{
+    LOG_DEBUG_S << "DistributedServiceDirectory: discovery event " << type << " for '" << entry.getName() << "'";
+
+    // Names are cached as they are published, whatever the backend reports
+    ServiceDirectoryEntry canonized = entry;
+    canonized.setFieldContent(ServiceDirectoryEntry::NAME, canonizeName(entry.getName()));
+
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    if(type == ServiceDirectoryChange::REMOVED)
+    {
+        apply(ServiceDirectoryList(), std::vector<Name>(1, canonized.getName()));
+    } else {
+        apply(ServiceDirectoryList(1, canonized), std::vector<Name>());
+    }
 }
 
 } // end namespace services
@@ -1,19 +1,29 @@
 #ifndef FIPA_SERVICES_DISTRIBUTED_SERVICE_DIRECTORY_HPP
 #define FIPA_SERVICES_DISTRIBUTED_SERVICE_DIRECTORY_HPP
 
+#include <deque>
+#include <future>
+#include <memory>
 #include <fipa_services/ServiceDirectory.hpp>
+#include <fipa_services/DiscoveryBackend.hpp>
 #include <service_discovery/ServiceDiscovery.hpp>
 
 #define DEFAULT_SERVICE_SCOPE "_fipa_service_directory._udp"
 
 namespace fipa {
 namespace services {
+
 /**
  * \class DistributedServiceDirectory
  * \brief Implementation of a distributed service directory using the functionality of Avahi
  * \details The distributed service directory allows to register services which are then published
- * in a given avahi domain (default is _fipa_service_directory._udp). Each service can be associated
+ * in a given avahi domain (default is _fipa_service_directory._udp). Avahi is the default
+ * DiscoveryBackend, which can be replaced, e.g. by an InProcessDiscoveryBackend. Each service can be associated
  * with information on how to access the service. This is done constructing a ServiceLocator object and specifying a service locator. 
+ *
+ * Searches are answered from a local cache of the visible services, which is
+ * kept up to date by the events of the discovery backend. Changes of the cache
+ * are published like the changes of a ServiceDirectory.
  * \see http://www.fipa.org/specs/fipa00001/SC00001L.html#_Toc26668707
  * \verbatim
  #include <fipa_services/DistributedServiceDirectory.hpp>
@@ -32,14 +42,15 @@ namespace services {
  */
 class DistributedServiceDirectory : public ServiceDirectory
 {
-    typedef std::map<ServiceDirectoryEntry, servicediscovery::avahi::ServiceDiscovery*> ServiceDiscoveryMap;
-    ServiceDiscoveryMap mServiceDiscoveries;
+    // Registered services and the scope they are published in
+    typedef std::map<ServiceDirectoryEntry, std::string> PublishedServices;
+    PublishedServices mPublishedServices;
 
     static std::string canonizeName(const std::string& name);
 
-    // Default listing object (to make sure service discovery is working when
-    // no other service is registered)
-    servicediscovery::avahi::ServiceDiscovery* mServiceDiscovery;
+    // Publishes the registered services and reports the visible services,
+    // which are cached in the entries of the base class
+    DiscoveryBackend::Ptr mDiscoveryBackend;
 
 public:
 
@@ -54,6 +65,15 @@ public:
      */
     DistributedServiceDirectory(const std::vector<std::string>& scopes);
 
+    /**
+     * Constructor to use another discovery backend than avahi, e.g. an
+     * InProcessDiscoveryBackend for testing
+     * \param scopes Listening scopes
+     * \param backend Discovery backend that publishes the registered
+     * services and reports the visible services
+     */
+    DistributedServiceDirectory(const std::vector<std::string>& scopes, const DiscoveryBackend::Ptr& backend);
+
     /**
      * Virtual Destructor
      */
@@ -89,9 +109,90 @@ public:
      * Register a service
      * \param entry The ServiceDirectoryEntry which describes the service that shall be registered
      * \param publishDomain Default domain under which services will be published
-     * \param ttlInMS TimeToLive in Milliseconds
      */
-    void registerService(const ServiceDirectoryEntry& entry, const std::string& publishDomain, uint32_t ttlInMS = 30000);
+    void registerService(const ServiceDirectoryEntry& entry, const std::string& publishDomain);
+
+    /**
+     * Register a service
+     * \deprecated The time to live has never had an effect, the service
+     * remains registered until it is deregistered. Use
+     * registerService(entry, publishDomain) or register the service with a
+     * lease instead
+     * \param entry The ServiceDirectoryEntry which describes the service that shall be registered
+     * \param publishDomain Default domain under which services will be published
+     * \param ttlInMS Ignored
+     */
+    void registerService(const ServiceDirectoryEntry& entry, const std::string& publishDomain, uint32_t ttlInMS) { registerService(entry, publishDomain); }
+
+    /**
+     * Register several services, which are announced together
+     */
+    void registerServices(const ServiceDirectoryList& entries) { registerServices(entries, DEFAULT_SERVICE_SCOPE); }
+
+    /**
+     * Register several services, which are announced together
+     * \param entries The ServiceDirectoryEntries which describe the services
+     * \param publishDomain Domain under which the services will be published
+     */
+    void registerServices(const ServiceDirectoryList& entries, const std::string& publishDomain);
+
+    /**
+     * Deregister several services that have been registered with this
+     * instance, which are withdrawn together
+     * \param names Names of the services
+     * \throws NotFound if a service has not been registered with this
+     * instance, in which case no service is deregistered
+     */
+    void deregisterServices(const std::vector<Name>& names);
+
+    /**
+     * Register a service with a lease, which is published in the default
+     * domain and withdrawn unless the lease is renewed
+     * \details Expired services are withdrawn by the next registration or
+     * deregistration, or the next call to expireLeases, e.g. by
+     * MessageTransport::trigger. They disappear from the searches once the
+     * discovery backend reports their removal.
+     * \param entry The ServiceDirectoryEntry which describes the service that shall be registered
+     * \param leaseDuration Duration after which the service is withdrawn
+     * unless the lease is renewed
+     */
+    void registerService(const ServiceDirectoryEntry& entry, const base::Time& leaseDuration);
+
+    /**
+     * Renew the lease of a service that has been registered with this
+     * instance
+     * \throws NotFound if the service has not been registered with a lease
+     */
+    void renewLease(const Name& name, const base::Time& leaseDuration);
+
+    /**
+     * Withdraw all registered services with an expired lease
+     * \param now Current time
+     * \return Number of withdrawn services
+     */
+    size_t expireLeases(const base::Time& now = base::Time::now());
+
+    /**
+     * Modify a service that has been registered with this instance, which is
+     * published again in its domain, keeping its lease
+     * \param entry Entry that replaces the registered one of the same name
+     * \throws NotFound if the service has not been registered with this
+     * instance
+     */
+    void modify(const ServiceDirectoryEntry& entry);
+
+    /**
+     * Not supported, since the cache only mirrors the services visible in the
+     * network, which are restored by their owners
+     * \throws NotSupported
+     */
+    size_t restoreSnapshot(const std::string& filename, const base::Time& leaseDuration = base::Time());
+
+    /**
+     * Not supported, see restoreSnapshot
+     * \throws NotSupported
+     */
+    size_t restore(const ServiceDirectoryList& entries, const base::Time& leaseDuration = base::Time());
 
     /**
      * Looks up services that have been registered with this instance and deregisters them
@@ -100,12 +201,116 @@ public:
     virtual void deregisterService(const std::string& regex, ServiceDirectoryEntry::Field field);
 
     /**
-     * Search for a given service based on the field information
-     * \param regex Regular expression which will be applied to the selected field
-     * \param field Field selection which the regex shall be applied on
-     * \param doThrow If set to true, the function will throw an exception if no entry could be found
+     * Register a service in the background, so that the caller does not wait
+     * for the publisher
+     * \details Asynchronous operations are applied by a worker thread. Pending
+     * operations on the same service are coalesced, so that only the latest
+     * one is applied, e.g. a registration that is followed by a
+     * deregistration before it has been applied is not published at all.
+     * Synchronous operations are not ordered with respect to pending
+     * asynchronous operations.
+     * \param entry The ServiceDirectoryEntry which describes the service that shall be registered
+     * \param publishDomain Domain under which the service will be published
+     * \return Future which is ready once the service has been handed to the
+     * publisher, or which holds the exception of the registration
+     */
+    std::future<void> registerServiceAsync(const ServiceDirectoryEntry& entry, const std::string& publishDomain = DEFAULT_SERVICE_SCOPE);
+
+    /**
+     * Deregister a service in the background, see registerServiceAsync
+     * \param name Name of the service
+     * \return Future which is ready once the service has been withdrawn, or
+     * which holds NotFound if the service has not been registered
+     */
+    std::future<void> deregisterServiceAsync(const Name& name);
+
+    /**
+     * Get the services that have been registered with this instance
+     */
+    ServiceDirectoryList getRegisteredServices() const;
+
+    /**
+     * Register all services of the update list and withdraw the services
+     * registered with this instance where the field has a value of the update
+     * list
+     * \details Only services registered with this instance can be withdrawn,
+     * services of other nodes remain visible. Services which are already
+     * registered are published again in their domain, new services in the
+     * default domain
+     * \param updateList list of services to register
+     * \param selectiveMerge Field by which entries are identified for removal
+     */
+    void mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field selectiveMerge);
+
+    /**
+     * Lookup a service by its exact name
+     * \details Names are canonized like for publishing, i.e. dots are
+     * replaced
+     * \param name Name of the service
+     */
+    ServiceDirectoryList lookupByName(const Name& name) const { return ServiceDirectory::lookupByName(canonizeName(name)); }
+
+private:
+    /**
+     * Update the cache with an event of the discovery backend
      */
-    ServiceDirectoryList search(const std::string& regex, ServiceDirectoryEntry::Field field, bool doThrow) const;
+    void handleDiscoveryEvent(ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry);
+
+    /**
+     * Publish services, replacing their registration and lease
+     * Requires mMutex to be held
+     */
+    void publish(const ServiceDirectoryList& entries, const std::string& publishDomain);
+
+    /**
+     * Withdraw a registered service
+     * Requires mMutex to be held
+     * \throws NotFound
+     */
+    void withdraw(const Name& name);
+
+    /**
+     * Withdraw the registered services with an expired lease
+     * Requires mMutex to be held
+     * \return Number of withdrawn services
+     */
+    size_t withdrawExpired(const base::Time& now);
+
+    // Leases of registered services, guarded by mMutex
+    TimerWheel mRegistrationLeases;
+
+    /// Pending asynchronous operation on a service, which combines all
+    /// coalesced requests
+    struct PendingOperation
+    {
+        bool publish;
+        ServiceDirectoryEntry entry;
+        std::string scope;
+        /// A deregistration that replaces a registration does not fail if
+        /// the service has not been registered
+        bool replacesRegistration;
+        std::vector<std::promise<void> > promises;
+    };
+
+    /**
+     * Queue an operation or coalesce it with the pending one of the service
+     */
+    std::future<void> enqueue(const Name& name, bool publish, const ServiceDirectoryEntry& entry, const std::string& scope);
+
+    /**
+     * Worker loop, which applies the pending operations
+     */
+    void processPendingOperations();
+
+    // Guards the pending operations, it is never held while an operation is
+    // applied
+    boost::mutex mPendingMutex;
+    boost::condition_variable mPendingCondition;
+    std::map<Name, PendingOperation> mPendingOperations;
+    std::deque<Name> mPendingOrder;
+    bool mStopWorker;
+    // Started with the first asynchronous operation
+    boost::thread mWorker;
 };
 
 } // end namespace services
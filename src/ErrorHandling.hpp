@@ -19,7 +19,10 @@ namespace services {
 FIPA_SERVICE_EXCEPTION(DuplicateEntry, "Entry already exists: ")
 FIPA_SERVICE_EXCEPTION(NotFound, "Entry could not be found: ")
 FIPA_SERVICE_EXCEPTION(NotImplemented, "Function has not been implemeted yet: ")
+FIPA_SERVICE_EXCEPTION(NotSupported, "Operation is not supported: ")
 FIPA_SERVICE_EXCEPTION(ArgumentError, "Invalid argument provided: ")
+FIPA_SERVICE_EXCEPTION(InvalidSnapshot, "Invalid service directory snapshot: ")
+FIPA_SERVICE_EXCEPTION(InvalidEncoding, "Invalid service directory encoding: ")
 
 } // end namespace services
 } // end namespace fipa
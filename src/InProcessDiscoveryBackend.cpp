@@ -0,0 +1,266 @@
+#include "InProcessDiscoveryBackend.hpp"
+
+namespace fipa {
+namespace services {
+
+InProcessDiscoveryNetwork::InProcessDiscoveryNetwork(const base::Time& propagationDelay, double lossProbability, uint32_t seed)
+    : mPropagationDelay(propagationDelay)
+    , mLossProbability(lossProbability)
+    , mRandom(seed)
+    , mNumberOfDeliveredEvents(0)
+    , mNumberOfLostEvents(0)
+{
+}
+
+base::Time InProcessDiscoveryNetwork::getTime() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mTime;
+}
+
+void InProcessDiscoveryNetwork::advance(const base::Time& duration)
+{
+    deliver(getTime() + duration);
+}
+
+void InProcessDiscoveryNetwork::flush()
+{
+    while(true)
+    {
+        base::Time until;
+        {
+            boost::unique_lock<boost::mutex> lock(mMutex);
+            if(mEvents.empty())
+            {
+                return;
+            }
+            until = mEvents.back().deliveryTime;
+        }
+        deliver(until);
+    }
+}
+
+void InProcessDiscoveryNetwork::reannounce()
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    Listeners::const_iterator lit = mListeners.begin();
+    for(; lit != mListeners.end(); ++lit)
+    {
+        std::set<std::string>::const_iterator sit = lit->second.scopes.begin();
+        for(; sit != lit->second.scopes.end(); ++sit)
+        {
+            const Publications& publications = mScopes[*sit];
+            Publications::const_iterator pit = publications.begin();
+            for(; pit != publications.end(); ++pit)
+            {
+                queue(pit->second.publisher, *lit, ServiceDirectoryChange::ADDED, pit->second.entry);
+            }
+        }
+    }
+}
+
+size_t InProcessDiscoveryNetwork::getNumberOfPendingEvents() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mEvents.size();
+}
+
+uint64_t InProcessDiscoveryNetwork::getNumberOfDeliveredEvents() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mNumberOfDeliveredEvents;
+}
+
+uint64_t InProcessDiscoveryNetwork::getNumberOfLostEvents() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mNumberOfLostEvents;
+}
+
+void InProcessDiscoveryNetwork::listen(const std::shared_ptr<InProcessDiscoveryBackend>& backend, const std::vector<std::string>& scopes)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    Listener& listener = mListeners[backend.get()];
+    listener.backend = backend;
+    listener.scopes = std::set<std::string>(scopes.begin(), scopes.end());
+
+    // Services which are visible already
+    Listeners::const_iterator lit = mListeners.find(backend.get());
+    std::set<std::string>::const_iterator sit = listener.scopes.begin();
+    for(; sit != listener.scopes.end(); ++sit)
+    {
+        const Publications& publications = mScopes[*sit];
+        Publications::const_iterator pit = publications.begin();
+        for(; pit != publications.end(); ++pit)
+        {
+            queue(pit->second.publisher, *lit, ServiceDirectoryChange::ADDED, pit->second.entry);
+        }
+    }
+}
+
+void InProcessDiscoveryNetwork::publish(const InProcessDiscoveryBackend* publisher, const std::string& scope, const ServiceDirectoryList& entries)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    Publications& publications = mScopes[scope];
+    ServiceDirectoryList::const_iterator cit = entries.begin();
+    for(; cit != entries.end(); ++cit)
+    {
+        Publication& publication = publications[cit->getName()];
+        publication.publisher = publisher;
+        publication.entry = *cit;
+        announce(publisher, scope, ServiceDirectoryChange::ADDED, *cit);
+    }
+}
+
+void InProcessDiscoveryNetwork::unpublish(const InProcessDiscoveryBackend* publisher, const std::string& scope, const std::vector<Name>& names)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    Publications& publications = mScopes[scope];
+    std::vector<Name>::const_iterator cit = names.begin();
+    for(; cit != names.end(); ++cit)
+    {
+        Publications::iterator it = publications.find(*cit);
+        // Services of the same name published by another backend remain
+        if(it != publications.end() && it->second.publisher == publisher)
+        {
+            announce(publisher, scope, ServiceDirectoryChange::REMOVED, it->second.entry);
+            publications.erase(it);
+        }
+    }
+}
+
+void InProcessDiscoveryNetwork::detach(const InProcessDiscoveryBackend* backend)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mListeners.erase(backend);
+
+    std::map<std::string, Publications>::iterator sit = mScopes.begin();
+    for(; sit != mScopes.end(); ++sit)
+    {
+        Publications::iterator it = sit->second.begin();
+        while(it != sit->second.end())
+        {
+            if(it->second.publisher == backend)
+            {
+                announce(backend, sit->first, ServiceDirectoryChange::REMOVED, it->second.entry);
+                sit->second.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void InProcessDiscoveryNetwork::announce(const InProcessDiscoveryBackend* publisher, const std::string& scope, ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry)
+{
+    Listeners::const_iterator lit = mListeners.begin();
+    for(; lit != mListeners.end(); ++lit)
+    {
+        if(lit->second.scopes.count(scope))
+        {
+            queue(publisher, *lit, type, entry);
+        }
+    }
+}
+
+void InProcessDiscoveryNetwork::queue(const InProcessDiscoveryBackend* publisher, const Listeners::value_type& listener, ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry)
+{
+    // The publisher sees its own services reliably
+    if(listener.first != publisher && mLossProbability > 0)
+    {
+        double sample = static_cast<double>(mRandom()) / (static_cast<double>(std::mt19937::max()) + 1.0);
+        if(sample < mLossProbability)
+        {
+            ++mNumberOfLostEvents;
+            return;
+        }
+    }
+
+    Event event;
+    event.deliveryTime = mTime + mPropagationDelay;
+    event.receiver = listener.second.backend;
+    event.type = type;
+    event.entry = entry;
+    mEvents.push_back(event);
+}
+
+void InProcessDiscoveryNetwork::deliver(const base::Time& until)
+{
+    while(true)
+    {
+        Event event;
+        {
+            boost::unique_lock<boost::mutex> lock(mMutex);
+            if(mEvents.empty() || mEvents.front().deliveryTime > until)
+            {
+                if(mTime < until)
+                {
+                    mTime = until;
+                }
+                return;
+            }
+            event = mEvents.front();
+            mEvents.pop_front();
+            mTime = event.deliveryTime;
+            ++mNumberOfDeliveredEvents;
+        }
+
+        // The observer is called without holding the lock, since it may
+        // publish itself
+        std::shared_ptr<InProcessDiscoveryBackend> receiver = event.receiver.lock();
+        if(receiver)
+        {
+            receiver->notify(event.type, event.entry);
+        }
+    }
+}
+
+InProcessDiscoveryBackend::InProcessDiscoveryBackend(const InProcessDiscoveryNetwork::Ptr& network)
+    : mNetwork(network)
+{
+}
+
+InProcessDiscoveryBackend::~InProcessDiscoveryBackend()
+{
+    mNetwork->detach(this);
+}
+
+void InProcessDiscoveryBackend::listen(const std::vector<std::string>& scopes, const DiscoveryObserver& observer)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        mObserver = observer;
+    }
+    mNetwork->listen(shared_from_this(), scopes);
+}
+
+void InProcessDiscoveryBackend::publish(const std::string& scope, const ServiceDirectoryList& entries)
+{
+    mNetwork->publish(this, scope, entries);
+}
+
+void InProcessDiscoveryBackend::unpublish(const std::string& scope, const std::vector<Name>& names)
+{
+    mNetwork->unpublish(this, scope, names);
+}
+
+void InProcessDiscoveryBackend::stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        mObserver = DiscoveryObserver();
+    }
+    mNetwork->detach(this);
+}
+
+void InProcessDiscoveryBackend::notify(ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    if(mObserver)
+    {
+        mObserver(type, entry);
+    }
+}
+
+} // end namespace services
+} // end namespace fipa
@@ -0,0 +1,201 @@
+#ifndef FIPA_SERVICES_IN_PROCESS_DISCOVERY_BACKEND_HPP
+#define FIPA_SERVICES_IN_PROCESS_DISCOVERY_BACKEND_HPP
+
+#include <deque>
+#include <map>
+#include <random>
+#include <set>
+#include <boost/thread.hpp>
+#include <base/Time.hpp>
+#include <fipa_services/DiscoveryBackend.hpp>
+
+namespace fipa {
+namespace services {
+
+class InProcessDiscoveryBackend;
+
+/**
+ * \class InProcessDiscoveryNetwork
+ * \brief Simulated network that connects InProcessDiscoveryBackends of the
+ * same process
+ * \details The network has its own clock, so that it behaves
+ * deterministically: publications and withdrawals are delivered to all
+ * backends which listen on the scope, including the publishing one, once
+ * the clock has been advanced by the propagation delay. Each delivery to
+ * another backend than the publishing one is lost with the loss
+ * probability, which is drawn from a random generator of the given seed.
+ * Lost events are only recovered by reannounce, which resembles the
+ * periodic announcements of mDNS.
+ *
+ * Observers are called by the thread which advances the clock.
+ *
+ * \verbatim
+ #include <fipa_services/InProcessDiscoveryBackend.hpp>
+
+ using namespace fipa::services;
+ InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork(base::Time::fromMilliseconds(5), 0.01));
+ DistributedServiceDirectory a(scopes, DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+ DistributedServiceDirectory b(scopes, DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+
+ a.registerService(entry);
+ network->advance(base::Time::fromMilliseconds(5));
+ b.lookupByName(entry.getName());
+ \endverbatim
+ */
+class InProcessDiscoveryNetwork
+{
+public:
+    typedef std::shared_ptr<InProcessDiscoveryNetwork> Ptr;
+
+    /**
+     * Constructor
+     * \param propagationDelay Time until an event is delivered
+     * \param lossProbability Probability that the delivery of an event to
+     * another backend is lost
+     * \param seed Seed of the random generator which decides about losses
+     */
+    InProcessDiscoveryNetwork(const base::Time& propagationDelay = base::Time(), double lossProbability = 0.0, uint32_t seed = 0);
+
+    /**
+     * Get the time of the simulated clock, which starts at zero
+     */
+    base::Time getTime() const;
+
+    /**
+     * Advance the clock and deliver all events which are due
+     * \param duration Time to advance the clock by
+     */
+    void advance(const base::Time& duration);
+
+    /**
+     * Advance the clock until all pending events have been delivered
+     */
+    void flush();
+
+    /**
+     * Announce all published services again to all backends listening on
+     * their scope, so that events which have been lost are recovered
+     */
+    void reannounce();
+
+    /**
+     * Get the number of events which have not been delivered yet
+     */
+    size_t getNumberOfPendingEvents() const;
+
+    /**
+     * Get the number of events which have been delivered
+     */
+    uint64_t getNumberOfDeliveredEvents() const;
+
+    /**
+     * Get the number of events which have been lost
+     */
+    uint64_t getNumberOfLostEvents() const;
+
+private:
+    friend class InProcessDiscoveryBackend;
+
+    typedef std::weak_ptr<InProcessDiscoveryBackend> BackendReference;
+
+    /// Published service and the backend which published it
+    struct Publication
+    {
+        const InProcessDiscoveryBackend* publisher;
+        ServiceDirectoryEntry entry;
+    };
+    typedef std::map<Name, Publication> Publications;
+
+    struct Listener
+    {
+        BackendReference backend;
+        std::set<std::string> scopes;
+    };
+    typedef std::map<const InProcessDiscoveryBackend*, Listener> Listeners;
+
+    struct Event
+    {
+        base::Time deliveryTime;
+        BackendReference receiver;
+        ServiceDirectoryChange::Type type;
+        ServiceDirectoryEntry entry;
+    };
+
+    void listen(const std::shared_ptr<InProcessDiscoveryBackend>& backend, const std::vector<std::string>& scopes);
+
+    void publish(const InProcessDiscoveryBackend* publisher, const std::string& scope, const ServiceDirectoryList& entries);
+
+    void unpublish(const InProcessDiscoveryBackend* publisher, const std::string& scope, const std::vector<Name>& names);
+
+    /**
+     * Stop delivering to a backend and withdraw its services
+     */
+    void detach(const InProcessDiscoveryBackend* backend);
+
+    /**
+     * Queue an event for all backends listening on the scope
+     * Requires mMutex to be held
+     */
+    void announce(const InProcessDiscoveryBackend* publisher, const std::string& scope, ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry);
+
+    /**
+     * Queue an event for a single backend, unless it is lost
+     * Requires mMutex to be held
+     */
+    void queue(const InProcessDiscoveryBackend* publisher, const Listeners::value_type& listener, ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry);
+
+    /**
+     * Deliver all events which are due until the given time
+     */
+    void deliver(const base::Time& until);
+
+    mutable boost::mutex mMutex;
+    base::Time mTime;
+    base::Time mPropagationDelay;
+    double mLossProbability;
+    std::mt19937 mRandom;
+    std::map<std::string, Publications> mScopes;
+    Listeners mListeners;
+    /// Events ordered by their delivery time, since the delay is constant
+    std::deque<Event> mEvents;
+    uint64_t mNumberOfDeliveredEvents;
+    uint64_t mNumberOfLostEvents;
+};
+
+/**
+ * \class InProcessDiscoveryBackend
+ * \brief Discovery backend which publishes to and listens on an
+ * InProcessDiscoveryNetwork, e.g. to test and benchmark
+ * DistributedServiceDirectory without avahi
+ * \details The backend has to be owned by a shared pointer before it
+ * listens.
+ */
+class InProcessDiscoveryBackend : public DiscoveryBackend, public std::enable_shared_from_this<InProcessDiscoveryBackend>
+{
+public:
+    InProcessDiscoveryBackend(const InProcessDiscoveryNetwork::Ptr& network);
+
+    virtual ~InProcessDiscoveryBackend();
+
+    void listen(const std::vector<std::string>& scopes, const DiscoveryObserver& observer);
+
+    void publish(const std::string& scope, const ServiceDirectoryList& entries);
+
+    void unpublish(const std::string& scope, const std::vector<Name>& names);
+
+    void stop();
+
+private:
+    friend class InProcessDiscoveryNetwork;
+
+    void notify(ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry);
+
+    InProcessDiscoveryNetwork::Ptr mNetwork;
+    // Guards the observer, so that it is not called after stop
+    boost::mutex mMutex;
+    DiscoveryObserver mObserver;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_IN_PROCESS_DISCOVERY_BACKEND_HPP
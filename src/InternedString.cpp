@@ -0,0 +1,122 @@
+#include "InternedString.hpp"
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+
+namespace fipa {
+namespace services {
+
+namespace {
+    /// Minimum size of a stripe before unreferenced content is purged
+    const size_t MINIMUM_PURGE_THRESHOLD = 64;
+
+    const std::shared_ptr<const std::string>& getEmpty()
+    {
+        static std::shared_ptr<const std::string> empty(new std::string());
+        return empty;
+    }
+}
+
+InternedString::InternedString()
+    : mValue(getEmpty())
+{
+}
+
+InternedString::InternedString(const std::string& value)
+    : mValue(value.empty() ? getEmpty() : StringPool::getInstance().intern(value).mValue)
+{
+}
+
+InternedString::InternedString(const char* value)
+    : mValue(*value == '\0' ? getEmpty() : StringPool::getInstance().intern(value).mValue)
+{
+}
+
+InternedString::InternedString(const char* value, size_t length)
+    : mValue(length == 0 ? getEmpty() : StringPool::getInstance().intern(value, length).mValue)
+{
+}
+
+StringPool::Stripe::Stripe()
+    : purgeThreshold(MINIMUM_PURGE_THRESHOLD)
+{
+}
+
+StringPool::StringPool()
+{
+}
+
+StringPool& StringPool::getInstance()
+{
+    static StringPool pool;
+    return pool;
+}
+
+InternedString StringPool::intern(const std::string& value)
+{
+    return intern(value.data(), value.size());
+}
+
+InternedString StringPool::intern(const char* value, size_t length)
+{
+    Stripe& stripe = mStripes[boost::hash_range(value, value + length) % NUMBER_OF_STRIPES];
+    boost::unique_lock<boost::mutex> lock(stripe.mutex);
+    stripe.lookup.assign(value, length);
+    Pool::const_iterator cit = stripe.pool.find(stripe.lookup);
+    if(cit != stripe.pool.end())
+    {
+        return InternedString(cit->second);
+    }
+
+    if(stripe.pool.size() >= stripe.purgeThreshold)
+    {
+        purgeUnlocked(stripe);
+        stripe.purgeThreshold = std::max(MINIMUM_PURGE_THRESHOLD, 2*stripe.pool.size());
+    }
+
+    std::shared_ptr<const std::string> content(new std::string(stripe.lookup));
+    stripe.pool[stripe.lookup] = content;
+    return InternedString(content);
+}
+
+size_t StringPool::purge()
+{
+    size_t purged = 0;
+    for(size_t i = 0; i < NUMBER_OF_STRIPES; ++i)
+    {
+        boost::unique_lock<boost::mutex> lock(mStripes[i].mutex);
+        purged += purgeUnlocked(mStripes[i]);
+    }
+    return purged;
+}
+
+size_t StringPool::purgeUnlocked(Stripe& stripe)
+{
+    size_t purged = 0;
+    Pool::iterator it = stripe.pool.begin();
+    while(it != stripe.pool.end())
+    {
+        // Only referenced by the pool itself
+        if(it->second.use_count() == 1)
+        {
+            it = stripe.pool.erase(it);
+            ++purged;
+        } else {
+            ++it;
+        }
+    }
+    return purged;
+}
+
+size_t StringPool::size() const
+{
+    size_t size = 0;
+    for(size_t i = 0; i < NUMBER_OF_STRIPES; ++i)
+    {
+        boost::unique_lock<boost::mutex> lock(mStripes[i].mutex);
+        size += mStripes[i].pool.size();
+    }
+    return size;
+}
+
+} // end namespace services
+} // end namespace fipa
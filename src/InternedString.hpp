@@ -0,0 +1,130 @@
+#ifndef FIPA_SERVICES_INTERNED_STRING_HPP
+#define FIPA_SERVICES_INTERNED_STRING_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <boost/thread.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class InternedString
+ * \brief Immutable string whose content is shared with all equal interned
+ * strings
+ * \details Service directory entries repeat the same types, descriptions
+ * and signatures many times. An interned string only holds a reference to
+ * the single copy of its content in the StringPool, so that copying and
+ * storing it does not allocate.
+ */
+class InternedString
+{
+public:
+    /**
+     * Create an empty string
+     */
+    InternedString();
+
+    /**
+     * Create an interned string, using the pool of StringPool::getInstance()
+     */
+    InternedString(const std::string& value);
+
+    InternedString(const char* value);
+
+    /**
+     * Create an interned string from a character range, without a temporary
+     * copy of the range
+     */
+    InternedString(const char* value, size_t length);
+
+    /**
+     * Get the content
+     */
+    const std::string& str() const { return *mValue; }
+
+    operator const std::string&() const { return *mValue; }
+
+    bool operator==(const InternedString& other) const { return mValue == other.mValue || *mValue == *other.mValue; }
+
+    bool operator!=(const InternedString& other) const { return !(*this == other); }
+
+private:
+    friend class StringPool;
+
+    explicit InternedString(const std::shared_ptr<const std::string>& value) : mValue(value) {}
+
+    std::shared_ptr<const std::string> mValue;
+};
+
+/**
+ * \class StringPool
+ * \brief Thread-safe pool of the content of interned strings
+ * \details The pool is split into stripes by the hash of the content, each
+ * with its own lock, so that threads interning different strings, e.g. when
+ * registering in different shards, rarely wait for each other. Content
+ * which is no longer referenced by any interned string is dropped from a
+ * stripe when the stripe has doubled in size since its last purge.
+ */
+class StringPool
+{
+public:
+    StringPool();
+
+    /**
+     * Get the process wide instance
+     */
+    static StringPool& getInstance();
+
+    /**
+     * Get the interned string for the given content
+     */
+    InternedString intern(const std::string& value);
+
+    /**
+     * Get the interned string for the given character range
+     */
+    InternedString intern(const char* value, size_t length);
+
+    /**
+     * Drop all content which is not referenced by an interned string
+     * \return Number of dropped strings
+     */
+    size_t purge();
+
+    /**
+     * Get the number of distinct strings in the pool
+     */
+    size_t size() const;
+
+private:
+    typedef std::unordered_map<std::string, std::shared_ptr<const std::string> > Pool;
+
+    struct Stripe
+    {
+        Stripe();
+
+        boost::mutex mutex;
+        Pool pool;
+        /// Key buffer for lookups of character ranges, reused to avoid
+        /// allocations
+        std::string lookup;
+        size_t purgeThreshold;
+    };
+
+    static const size_t NUMBER_OF_STRIPES = 16;
+
+    /**
+     * Drop all content of the stripe which is not referenced by an interned
+     * string
+     * Requires the mutex of the stripe to be held
+     */
+    static size_t purgeUnlocked(Stripe& stripe);
+
+    mutable Stripe mStripes[NUMBER_OF_STRIPES];
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_INTERNED_STRING_HPP
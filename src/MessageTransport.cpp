@@ -29,6 +29,21 @@ MessageTransport::MessageTransport(const fipa::acl::AgentID& id, ServiceDirector
     {
         throw std::invalid_argument("MessageTransport: a service directory is required for instanciation");
     }
+    mSubscription = mpServiceDirectory->subscribe(std::bind(&MessageTransport::handleDirectoryChange, this, std::placeholders::_1));
+}
+
+MessageTransport::~MessageTransport()
+{
+    mpServiceDirectory->unsubscribe(mSubscription);
+}
+
+void MessageTransport::handleDirectoryChange(const ServiceDirectoryChange& change)
+{
+    // Removals and modifications do not make an unknown receiver resolvable
+    if(change.type == ServiceDirectoryChange::ADDED)
+    {
+        mUnknownReceivers.invalidate(change.entry.getName());
+    }
 }
 
 void MessageTransport::activateTransports(transports::Transport::Type flags)
@@ -193,6 +208,8 @@ void MessageTransport::registerMessageTransport(const std::string& type, Message
     }
 
     mMessageTransportHandlerMap[type] = handle;
+    // The handler might deliver to receivers which are cached as unknown
+    mUnknownReceivers.clear();
 }
 
 void MessageTransport::deregisterMessageTransport(const std::string& type)
@@ -220,6 +237,7 @@ void MessageTransport::modifyMessageTransport(const std::string& type, MessageTr
     }
 
     mMessageTransportHandlerMap[type] = handler;
+    mUnknownReceivers.clear();
 }
 
 void MessageTransport::stamp(fipa::acl::Letter& letter) const
@@ -299,11 +317,28 @@ fipa::acl::AgentIDList MessageTransport::forward(const fipa::acl::Letter& letter
         // The name of the next destination -- this next destination can also be an intermediate receiver
         std::string receiverName = rit->getName();
 
-        // Check for local receivers, or identify locator
-        bool doThrow = false;
+        // Fail fast for receivers which have recently been found to be
+        // unknown, the receiver remains in the list of remaining receivers
+        if(mUnknownReceivers.contains(receiverName))
+        {
+            LOG_DEBUG_S << "MessageTransport '" << mAgentId.getName() << "': receiver '" << receiverName << "' is cached as unknown";
+            continue;
+        }
+        uint64_t generation = mUnknownReceivers.getGeneration();
 
-        // Add "$" to make sure names are not interpreted as prefix
-        fipa::services::ServiceDirectoryList list = mpServiceDirectory->search(receiverName + "$", fipa::services::ServiceDirectoryEntry::NAME, doThrow);
+        // Check for local receivers, or identify locator
+        // Literal names are resolved without any regex matching involved,
+        // while other names are patterns, e.g. 'a.b' matches 'aXb' as well
+        fipa::services::ServiceDirectoryList list;
+        std::string literal;
+        if(ServiceDirectoryIndex::isLiteral(receiverName, literal))
+        {
+            list = mpServiceDirectory->lookupByName(literal);
+        } else {
+            bool doThrow = false;
+            // Add "$" to make sure names are not interpreted as prefix
+            list = mpServiceDirectory->search(receiverName + "$", fipa::services::ServiceDirectoryEntry::NAME, doThrow);
+        }
         // The list can be either empty or contain or or multiple entries, e.g.
         // regex pattern matching simplifies broadcasting/multicasting
         if(list.empty())
@@ -324,13 +359,14 @@ fipa::acl::AgentIDList MessageTransport::forward(const fipa::acl::Letter& letter
             {
                 it->second->cleanup(receiverName);
             }
+            mUnknownReceivers.insert(receiverName, generation);
             continue;
         } else {
             using namespace fipa::services;
             ServiceDirectoryList::const_iterator cit = list.begin();
             for(; cit != list.end(); ++cit)
             {
-                ServiceDirectoryEntry serviceEntry = *cit;
+                const ServiceDirectoryEntry& serviceEntry = *cit;
 
                 // Filter out sender from broadcast/multicast
                 if(serviceEntry.getName() == envelope.getFrom().getName())
@@ -339,12 +375,13 @@ fipa::acl::AgentIDList MessageTransport::forward(const fipa::acl::Letter& letter
                     continue;
                 }
 
-                ServiceLocator locator = serviceEntry.getLocator();
-                ServiceLocations locations = locator.getLocations();
+                // Locations are used in place, so that their parsed
+                // addresses are kept with the directory entry
+                const ServiceLocations& locations = serviceEntry.getLocator().getLocations();
                 for(ServiceLocations::const_iterator it = locations.begin(); it != locations.end(); it++)
                 {
                     // Retrieve address
-                    ServiceLocation location = *it;
+                    const ServiceLocation& location = *it;
 
                     try{
                         // Handle delivery
@@ -413,9 +450,9 @@ void MessageTransport::handleData(const std::string& data)
 
 void MessageTransport::forward(const std::string& receiverName, const ServiceLocation& location, const fipa::acl::Letter& letter) const
 {
-    transports::Address address;
+    const transports::Address* address;
     try {
-        address = transports::Address::fromString(location.getServiceAddress());
+        address = &location.getAddress();
     } catch(const std::invalid_argument& e)
     {
         throw std::runtime_error("MessageTransport '" + mAgentId.getName() + "' : address '" + location.getServiceAddress() + "' for receiver '" + receiverName + "'");
@@ -431,10 +468,11 @@ void MessageTransport::forward(const std::string& receiverName, const ServiceLoc
         }
     } else {
         // Check if the transport that corresponds to the protocol is allowed
-        if(!hasActiveTransport(address.protocol))
+        std::map<transports::Transport::Type, transports::Transport::Ptr>::iterator tit = mActiveTransports.find(location.getTransportType());
+        if(tit == mActiveTransports.end())
         {
             // Protocol not implemented (or not activated)
-            throw std::runtime_error("MessageTransport '" + mAgentId.getName() + "' : transport protocol '" + address.protocol + "' is not active or supported.");
+            throw std::runtime_error("MessageTransport '" + mAgentId.getName() + "' : transport protocol '" + address->protocol + "' is not active or supported.");
         }
 
         // Check if the service signature matches
@@ -443,19 +481,14 @@ void MessageTransport::forward(const std::string& receiverName, const ServiceLoc
             throw std::runtime_error("MessageTransport '" + mAgentId.getName() + "': service signature for '" + receiverName + "' is '" + location.getSignatureType() + "' and is not on the list of accepted signatures -- will not connect to: " + location.toString());
         }
 
-        transports::Transport::Type type = transports::Transport::getTypeFromTxt(address.protocol);
-        std::map<transports::Transport::Type, transports::Transport::Ptr>::iterator tit = mActiveTransports.find(type);
-        if( tit != mActiveTransports.end() )
-        {
-            transports::Transport::Ptr transport = tit->second;
-            LOG_DEBUG_S << "MessageTransport: '" << transport->getName() << "': forwarding to other MTS";
+        const transports::Transport::Ptr& transport = tit->second;
+        LOG_DEBUG_S << "MessageTransport: '" << transport->getName() << "': forwarding to other MTS";
 
-            std::string data = serializeLetter(letter, location.getSignatureType());
+        std::string data = serializeLetter(letter, location.getSignatureType());
 
-            // Try sending via given transport
-            // will throw on failure
-            transport->send(receiverName, address, data);
-        }
+        // Try sending via given transport
+        // will throw on failure
+        transport->send(receiverName, *address, data);
     } // end else
 }
 
@@ -473,6 +506,10 @@ void MessageTransport::removeFromList(const fipa::acl::AgentID& agent, fipa::acl
 
 void MessageTransport::trigger()
 {
+    // Services of crashed agents are removed once their lease expires, so
+    // that letters are no longer routed to them
+    mpServiceDirectory->expireLeases();
+
     using namespace fipa::services::transports;
     std::map<Transport::Type, Transport::Ptr>::iterator it = mActiveTransports.begin();
     for(; it != mActiveTransports.end(); ++it)
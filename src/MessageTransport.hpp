@@ -7,6 +7,7 @@
 #include <fipa_services/transports/Transport.hpp>
 #include <fipa_services/transports/Configuration.hpp>
 #include <fipa_services/ServiceDirectory.hpp>
+#include <fipa_services/UnknownReceiverCache.hpp>
 
 namespace fipa {
 namespace agent_management {
@@ -91,6 +92,15 @@ private:
     std::string mServiceSignature;
     std::set<std::string> mAcceptedServiceSignatures;
 
+    /// Receivers which could neither be resolved nor delivered locally, so
+    /// that further letters to them fail fast
+    mutable UnknownReceiverCache mUnknownReceivers;
+    ServiceDirectoryChangeFeed::SubscriptionId mSubscription;
+
+    // The subscription refers to this instance, so it cannot be copied
+    MessageTransport(const MessageTransport&);
+    MessageTransport& operator=(const MessageTransport&);
+
     /**
      * Stamp message for further delivery,
      * i.e. mark as handled by this message transport
@@ -134,6 +144,11 @@ private:
      */
     bool isLocal(const ServiceLocation& local) const;
 
+    /**
+     * Invalidate the unknown receivers that may resolve to an added service
+     */
+    void handleDirectoryChange(const ServiceDirectoryChange& change);
+
     /**
      * Handle incoming data from the transports
      */
@@ -160,6 +175,8 @@ public:
      */
     MessageTransport(const fipa::acl::AgentID& id, ServiceDirectory::Ptr serviceDirectory);
 
+    ~MessageTransport();
+
     fipa::acl::AgentID getAgentID() const { return mAgentId; }
 
     void configure(const std::vector<transports::Configuration>& configurations) { mTransportConfigurations = configurations; }
@@ -251,7 +268,8 @@ public:
 
     /**
      * Trigger the MessageTransport and all associated underlying transports to
-     * process messages and establishing connections
+     * process messages and establishing connections, and remove the
+     * services with an expired lease from the service directory
      */
     void trigger();
 
@@ -276,10 +294,22 @@ public:
      */
     ServiceDirectory::Ptr getServiceDirectory() { return mpServiceDirectory; }
 
+    /**
+     * Get the cache of receivers which could neither be resolved in the
+     * service directory nor delivered locally, e.g. to read how often
+     * letters failed fast or to change the lifetime of cached receivers
+     * \return Unknown receiver cache
+     */
+    UnknownReceiverCache& getUnknownReceiverCache() { return mUnknownReceivers; }
+
     /**
      * Allows to register a client which is added to the service directory
      * accordingly
      * Locators of this client will be set according to the activated transports
+     * Registration is synchronous, i.e. with a DistributedServiceDirectory
+     * this call waits until the service has been handed to the publisher. To
+     * avoid this, register the client via
+     * DistributedServiceDirectory::registerServiceAsync instead.
      * \param clientName Name of client to register
      * \param clientDescription Description of client to register
      */
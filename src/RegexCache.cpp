@@ -0,0 +1,107 @@
+#include "RegexCache.hpp"
+
+namespace fipa {
+namespace services {
+
+RegexCache::RegexCache(size_t capacity)
+    : mCapacity(capacity)
+    , mHits(0)
+    , mMisses(0)
+{
+}
+
+RegexCache& RegexCache::getInstance()
+{
+    static RegexCache cache;
+    return cache;
+}
+
+RegexCache::RegexPtr RegexCache::get(const std::string& pattern)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        std::unordered_map<std::string, LRUList::iterator>::iterator it = mIndex.find(pattern);
+        if(it != mIndex.end())
+        {
+            // Move to front
+            mLRUList.splice(mLRUList.begin(), mLRUList, it->second);
+            ++mHits;
+            return it->second->second;
+        }
+        ++mMisses;
+    }
+
+    // Compile outside of the lock, this might throw
+    RegexPtr regex(new boost::regex(pattern));
+
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    // Another thread might have inserted the same pattern meanwhile
+    std::unordered_map<std::string, LRUList::iterator>::iterator it = mIndex.find(pattern);
+    if(it != mIndex.end())
+    {
+        mLRUList.splice(mLRUList.begin(), mLRUList, it->second);
+        return it->second->second;
+    }
+
+    mLRUList.push_front(std::make_pair(pattern, regex));
+    mIndex[pattern] = mLRUList.begin();
+    shrink();
+    return regex;
+}
+
+uint64_t RegexCache::getHits() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mHits;
+}
+
+uint64_t RegexCache::getMisses() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mMisses;
+}
+
+void RegexCache::resetStatistics()
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mHits = 0;
+    mMisses = 0;
+}
+
+size_t RegexCache::size() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mLRUList.size();
+}
+
+size_t RegexCache::getCapacity() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mCapacity;
+}
+
+void RegexCache::setCapacity(size_t capacity)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mCapacity = capacity;
+    shrink();
+}
+
+void RegexCache::clear()
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mLRUList.clear();
+    mIndex.clear();
+}
+
+void RegexCache::shrink()
+{
+    while(mLRUList.size() > mCapacity)
+    {
+        mIndex.erase(mLRUList.back().first);
+        mLRUList.pop_back();
+    }
+}
+
+} // end namespace services
+} // end namespace fipa
@@ -0,0 +1,113 @@
+#ifndef FIPA_SERVICES_REGEX_CACHE_HPP
+#define FIPA_SERVICES_REGEX_CACHE_HPP
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+#include <boost/regex.hpp>
+#include <boost/thread.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class RegexCache
+ * \brief Bounded, thread-safe cache of compiled regular expressions
+ * \details Compiling a boost::regex is expensive compared to matching a short
+ * string, so patterns that are used repeatedly, e.g. for searching the
+ * service directory, are compiled only once. When the capacity is reached
+ * the least recently used pattern is dropped.
+ * \verbatim
+ #include <fipa_services/RegexCache.hpp>
+
+ using namespace fipa::services;
+ RegexCache::RegexPtr r = RegexCache::getInstance().get("robot_.*");
+ bool matches = boost::regex_match(std::string("robot_0"), *r);
+ \endverbatim
+ */
+class RegexCache
+{
+public:
+    typedef std::shared_ptr<const boost::regex> RegexPtr;
+
+    /**
+     * Constructor
+     * \param capacity Maximum number of compiled patterns in the cache
+     */
+    RegexCache(size_t capacity = 512);
+
+    /**
+     * Get the process wide instance that is shared by the service
+     * directories and service locators
+     */
+    static RegexCache& getInstance();
+
+    /**
+     * Get the compiled regular expression for the given pattern,
+     * compile it if it is not yet cached
+     * \param pattern Regular expression
+     * \return Compiled regular expression
+     * \throws boost::regex_error if the pattern is not a valid regular
+     * expression
+     */
+    RegexPtr get(const std::string& pattern);
+
+    /**
+     * Number of get calls that have been served from the cache
+     */
+    uint64_t getHits() const;
+
+    /**
+     * Number of get calls that required compiling the pattern
+     */
+    uint64_t getMisses() const;
+
+    /**
+     * Reset hit and miss counters
+     */
+    void resetStatistics();
+
+    /**
+     * Number of currently cached patterns
+     */
+    size_t size() const;
+
+    /**
+     * Get the maximum number of cached patterns
+     */
+    size_t getCapacity() const;
+
+    /**
+     * Set the maximum number of cached patterns, dropping the least
+     * recently used ones if required
+     */
+    void setCapacity(size_t capacity);
+
+    /**
+     * Remove all cached patterns
+     */
+    void clear();
+
+private:
+    typedef std::list< std::pair<std::string, RegexPtr> > LRUList;
+
+    /**
+     * Remove least recently used patterns until capacity is satisfied
+     */
+    void shrink();
+
+    mutable boost::mutex mMutex;
+    size_t mCapacity;
+    // Most recently used pattern is at the front
+    LRUList mLRUList;
+    std::unordered_map<std::string, LRUList::iterator> mIndex;
+
+    uint64_t mHits;
+    uint64_t mMisses;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_REGEX_CACHE_HPP
@@ -0,0 +1,498 @@
+#include "ReplicatedServiceDirectory.hpp"
+#include "ServiceDirectoryWireFormat.hpp"
+#include "transports/Transport.hpp"
+#include <base-logging/Logging.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace fipa {
+namespace services {
+
+namespace {
+    const size_t MAGIC_SIZE = 4;
+
+    typedef ServiceDirectoryWireFormat Format;
+
+    void appendVersionVector(std::string& buffer, const ReplicatedServiceDirectory::VersionVector& versionVector)
+    {
+        Format::appendVarint(buffer, versionVector.size());
+        ReplicatedServiceDirectory::VersionVector::const_iterator cit = versionVector.begin();
+        for(; cit != versionVector.end(); ++cit)
+        {
+            Format::appendString(buffer, cit->first);
+            Format::appendVarint(buffer, cit->second);
+        }
+    }
+
+    const char* readVersionVector(const char* position, const char* end, ReplicatedServiceDirectory::VersionVector& versionVector)
+    {
+        uint64_t size;
+        position = Format::readVarint(position, end, size);
+        for(uint64_t i = 0; i < size; ++i)
+        {
+            StringRange nodeId;
+            uint64_t sequence;
+            position = Format::readString(position, end, nodeId);
+            position = Format::readVarint(position, end, sequence);
+            versionVector[nodeId.str()] = sequence;
+        }
+        return position;
+    }
+}
+
+const char* const ReplicatedServiceDirectory::MAGIC = "FSDR";
+
+bool ReplicatedServiceDirectory::Record::supersedes(const Record& other) const
+{
+    if(sequence != other.sequence)
+    {
+        return sequence > other.sequence;
+    }
+    return origin > other.origin;
+}
+
+ReplicatedServiceDirectory::ReplicatedServiceDirectory(const NodeId& nodeId, transports::TransportType::Type transportType, const std::string& interfaceName, uint16_t port, ConcurrencyMode mode)
+    : ServiceDirectory(mode)
+    , mNodeId(nodeId)
+    , mTransport(transports::Transport::create(transportType))
+    , mClock(0)
+    , mSynchronize(false)
+    , mAntiEntropyPeriod(base::Time::fromSeconds(5))
+    , mTombstoneLifetime(base::Time::fromSeconds(3600))
+{
+    transports::Configuration configuration = mTransport->getConfiguration();
+    configuration.listening_port = port;
+    mTransport->setConfiguration(configuration);
+    mTransport->start();
+    mTransport->registerObserver(std::bind(&ReplicatedServiceDirectory::handleData, this, std::placeholders::_1));
+    mAddress = mTransport->getAddress(interfaceName);
+
+    mSubscription = mChangeFeed.subscribe(std::bind(&ReplicatedServiceDirectory::handleChange, this, std::placeholders::_1));
+}
+
+ReplicatedServiceDirectory::~ReplicatedServiceDirectory()
+{
+    mChangeFeed.unsubscribe(mSubscription);
+}
+
+void ReplicatedServiceDirectory::addPeer(const NodeId& nodeId, const transports::Address& address)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mPeers[nodeId] = address;
+}
+
+void ReplicatedServiceDirectory::removePeer(const NodeId& nodeId)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    if(mPeers.erase(nodeId) == 0)
+    {
+        throw NotFound("peer '" + nodeId + "'");
+    }
+}
+
+ReplicatedServiceDirectory::Peers ReplicatedServiceDirectory::getPeers() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mPeers;
+}
+
+ReplicatedServiceDirectory::VersionVector ReplicatedServiceDirectory::getVersionVector() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mVersionVector;
+}
+
+void ReplicatedServiceDirectory::setAntiEntropyPeriod(const base::Time& period)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mAntiEntropyPeriod = period;
+}
+
+void ReplicatedServiceDirectory::setTombstoneLifetime(const base::Time& lifetime)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mTombstoneLifetime = lifetime;
+}
+
+void ReplicatedServiceDirectory::synchronize()
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mSynchronize = true;
+}
+
+bool ReplicatedServiceDirectory::dominates(const VersionVector& a, const VersionVector& b)
+{
+    VersionVector::const_iterator cit = b.begin();
+    for(; cit != b.end(); ++cit)
+    {
+        if(getSequence(a, cit->first) < cit->second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t ReplicatedServiceDirectory::getSequence(const VersionVector& versionVector, const NodeId& nodeId)
+{
+    VersionVector::const_iterator cit = versionVector.find(nodeId);
+    if(cit == versionVector.end())
+    {
+        return 0;
+    }
+    return cit->second;
+}
+
+void ReplicatedServiceDirectory::trigger(const base::Time& now)
+{
+    // Receiving and sending happens without holding mMutex, so that lookups
+    // do not wait for the network
+    mTransport->update(true);
+    std::vector<std::string> incoming;
+    {
+        boost::unique_lock<boost::mutex> lock(mIncomingMutex);
+        incoming.swap(mIncoming);
+    }
+
+    Envelopes envelopes;
+    {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        std::vector<std::string>::const_iterator cit = incoming.begin();
+        for(; cit != incoming.end(); ++cit)
+        {
+            try {
+                process(decode(*cit), envelopes, now);
+            } catch(const InvalidEncoding& e)
+            {
+                LOG_WARN_S << "ReplicatedServiceDirectory: '" << mNodeId << "' dropped invalid message -- " << e.what();
+            }
+        }
+
+        // Remote modifications are forwarded as well, so that peers need
+        // not to be fully connected
+        if(!dominates(mPushedVersionVector, mVersionVector))
+        {
+            broadcast(createDelta(mPushedVersionVector), envelopes);
+            mPushedVersionVector = mVersionVector;
+        }
+
+        if(mSynchronize || now - mLastAntiEntropy >= mAntiEntropyPeriod)
+        {
+            broadcast(createMessage(DIGEST), envelopes);
+            mLastAntiEntropy = now;
+            mSynchronize = false;
+        }
+
+        Records::iterator it = mRecords.begin();
+        while(it != mRecords.end())
+        {
+            if(it->second.removed && it->second.removalTime.isNull())
+            {
+                // Local removal since the last call
+                it->second.removalTime = now;
+                ++it;
+            } else if(it->second.removed && now - it->second.removalTime > mTombstoneLifetime)
+            {
+                mRecords.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+    send(envelopes);
+}
+
+void ReplicatedServiceDirectory::handleChange(const ServiceDirectoryChange& change)
+{
+    const Name& name = change.entry.getName();
+    if(mApplying.count(name))
+    {
+        return;
+    }
+
+    Record& record = mRecords[name];
+    record.name = name;
+    record.origin = mNodeId;
+    record.sequence = ++mClock;
+    record.removed = change.type == ServiceDirectoryChange::REMOVED;
+    if(record.removed)
+    {
+        record.entry = ServiceDirectoryEntry();
+        // Stamped by the next call of trigger, which provides the time
+        record.removalTime = base::Time();
+    } else {
+        record.entry = change.entry;
+    }
+    mVersionVector[mNodeId] = mClock;
+}
+
+void ReplicatedServiceDirectory::handleData(const std::string& data)
+{
+    boost::unique_lock<boost::mutex> lock(mIncomingMutex);
+    mIncoming.push_back(data);
+}
+
+void ReplicatedServiceDirectory::process(const Message& message, Envelopes& replies, const base::Time& now)
+{
+    if(message.sender == mNodeId)
+    {
+        return;
+    }
+
+    // Learn about nodes which have been told about this node
+    Envelope reply;
+    reply.receiver = message.sender;
+    try {
+        reply.address = transports::Address::fromString(message.senderAddress);
+    } catch(const std::invalid_argument& e)
+    {
+        LOG_WARN_S << "ReplicatedServiceDirectory: '" << mNodeId << "' dropped message of '" << message.sender << "' with invalid address -- " << e.what();
+        return;
+    }
+    mPeers[message.sender] = reply.address;
+
+    if(message.type == DIGEST)
+    {
+        // Send what the sender misses, and trigger the sender to send what
+        // this node misses
+        if(message.versionVector != mVersionVector)
+        {
+            reply.data = encode(createDelta(message.versionVector));
+            replies.push_back(reply);
+        }
+    } else {
+        applyDelta(message, now);
+        if(!dominates(message.versionVector, mVersionVector))
+        {
+            reply.data = encode(createDelta(message.versionVector));
+            replies.push_back(reply);
+        }
+    }
+}
+
+void ReplicatedServiceDirectory::applyDelta(const Message& delta, const base::Time& now)
+{
+    std::set<Name> names;
+    std::vector<Record>::const_iterator cit = delta.records.begin();
+    for(; cit != delta.records.end(); ++cit)
+    {
+        mClock = std::max(mClock, cit->sequence);
+        Records::iterator it = mRecords.find(cit->name);
+        if(it != mRecords.end() && !cit->supersedes(it->second))
+        {
+            continue;
+        }
+
+        Record& record = mRecords[cit->name];
+        record = *cit;
+        if(record.removed)
+        {
+            record.removalTime = now;
+        }
+        names.insert(record.name);
+    }
+
+    ServiceDirectoryList updates;
+    std::vector<Name> removals;
+    std::set<Name>::const_iterator nit = names.begin();
+    for(; nit != names.end(); ++nit)
+    {
+        const Record& record = mRecords[*nit];
+        if(record.removed)
+        {
+            removals.push_back(record.name);
+        } else {
+            updates.push_back(record.entry);
+        }
+    }
+
+    mApplying = names;
+    try {
+        ServiceDirectory::apply(updates, removals);
+    } catch(...)
+    {
+        mApplying.clear();
+        throw;
+    }
+    mApplying.clear();
+
+    // The delta only contains all modifications up to its version vector,
+    // if this node has all modifications up to its base
+    if(dominates(mVersionVector, delta.base))
+    {
+        VersionVector::const_iterator vit = delta.versionVector.begin();
+        for(; vit != delta.versionVector.end(); ++vit)
+        {
+            uint64_t& sequence = mVersionVector[vit->first];
+            sequence = std::max(sequence, vit->second);
+        }
+    }
+}
+
+ReplicatedServiceDirectory::Message ReplicatedServiceDirectory::createMessage(MessageType type) const
+{
+    Message message;
+    message.type = type;
+    message.sender = mNodeId;
+    message.senderAddress = mAddress.toString();
+    message.versionVector = mVersionVector;
+    return message;
+}
+
+ReplicatedServiceDirectory::Message ReplicatedServiceDirectory::createDelta(const VersionVector& base) const
+{
+    Message delta = createMessage(DELTA);
+    delta.base = base;
+    Records::const_iterator cit = mRecords.begin();
+    for(; cit != mRecords.end(); ++cit)
+    {
+        if(cit->second.sequence > getSequence(base, cit->second.origin))
+        {
+            delta.records.push_back(cit->second);
+        }
+    }
+    return delta;
+}
+
+void ReplicatedServiceDirectory::broadcast(const Message& message, Envelopes& envelopes) const
+{
+    if(mPeers.empty())
+    {
+        return;
+    }
+
+    Envelope envelope;
+    envelope.data = encode(message);
+    Peers::const_iterator cit = mPeers.begin();
+    for(; cit != mPeers.end(); ++cit)
+    {
+        envelope.receiver = cit->first;
+        envelope.address = cit->second;
+        envelopes.push_back(envelope);
+    }
+}
+
+void ReplicatedServiceDirectory::send(const Envelopes& envelopes)
+{
+    Envelopes::const_iterator cit = envelopes.begin();
+    for(; cit != envelopes.end(); ++cit)
+    {
+        try {
+            mTransport->send(cit->receiver, cit->address, cit->data);
+        } catch(const std::runtime_error& e)
+        {
+            // Peers which are not reachable catch up with the next
+            // anti-entropy round
+            LOG_DEBUG_S << "ReplicatedServiceDirectory: '" << mNodeId << "' could not reach peer '" << cit->receiver << "' -- " << e.what();
+        }
+    }
+}
+
+std::string ReplicatedServiceDirectory::encode(const Message& message)
+{
+    std::string buffer;
+    buffer.append(MAGIC, MAGIC_SIZE);
+    buffer.push_back(static_cast<char>(VERSION));
+    buffer.push_back(static_cast<char>(message.type));
+    Format::appendString(buffer, message.sender);
+    Format::appendString(buffer, message.senderAddress);
+    appendVersionVector(buffer, message.base);
+    appendVersionVector(buffer, message.versionVector);
+
+    ServiceDirectoryList entries;
+    Format::appendVarint(buffer, message.records.size());
+    std::vector<Record>::const_iterator cit = message.records.begin();
+    for(; cit != message.records.end(); ++cit)
+    {
+        Format::appendString(buffer, cit->name);
+        Format::appendString(buffer, cit->origin);
+        Format::appendVarint(buffer, cit->sequence);
+        buffer.push_back(static_cast<char>(cit->removed));
+        if(!cit->removed)
+        {
+            entries.push_back(cit->entry);
+        }
+    }
+    // Entries of the records which are not removed, in the order of the
+    // records
+    Format::encode(entries, buffer);
+    return buffer;
+}
+
+ReplicatedServiceDirectory::Message ReplicatedServiceDirectory::decode(const std::string& data)
+{
+    const char* position = data.data();
+    const char* end = data.data() + data.size();
+    if(data.size() < MAGIC_SIZE + 2 || memcmp(position, MAGIC, MAGIC_SIZE) != 0)
+    {
+        throw InvalidEncoding("missing replication header");
+    }
+    uint8_t version = static_cast<uint8_t>(position[MAGIC_SIZE]);
+    if(version != VERSION)
+    {
+        throw InvalidEncoding("unsupported replication version " + std::to_string(version));
+    }
+    uint8_t type = static_cast<uint8_t>(position[MAGIC_SIZE + 1]);
+    if(type != DIGEST && type != DELTA)
+    {
+        throw InvalidEncoding("unknown replication message type " + std::to_string(type));
+    }
+    position += MAGIC_SIZE + 2;
+
+    Message message;
+    message.type = static_cast<MessageType>(type);
+    StringRange value;
+    position = Format::readString(position, end, value);
+    message.sender = value.str();
+    position = Format::readString(position, end, value);
+    message.senderAddress = value.str();
+    position = readVersionVector(position, end, message.base);
+    position = readVersionVector(position, end, message.versionVector);
+
+    uint64_t numberOfRecords;
+    position = Format::readVarint(position, end, numberOfRecords);
+    // Each record takes at least four bytes
+    if(numberOfRecords > static_cast<uint64_t>(end - position)/4)
+    {
+        throw InvalidEncoding("number of records exceeds the data");
+    }
+    message.records.resize(numberOfRecords);
+    for(size_t i = 0; i < message.records.size(); ++i)
+    {
+        Record& record = message.records[i];
+        position = Format::readString(position, end, value);
+        record.name = value.str();
+        position = Format::readString(position, end, value);
+        record.origin = value.str();
+        position = Format::readVarint(position, end, record.sequence);
+        if(position == end)
+        {
+            throw InvalidEncoding("truncated record");
+        }
+        record.removed = *position++ != 0;
+    }
+
+    ServiceDirectoryWireReader reader(position, end - position);
+    ServiceDirectoryEntryView view;
+    for(size_t i = 0; i < message.records.size(); ++i)
+    {
+        Record& record = message.records[i];
+        if(record.removed)
+        {
+            continue;
+        }
+        if(!reader.next(view) || view.name != record.name)
+        {
+            throw InvalidEncoding("entries do not match the records");
+        }
+        record.entry = view.toEntry();
+    }
+    if(reader.next(view))
+    {
+        throw InvalidEncoding("entries do not match the records");
+    }
+    return message;
+}
+
+} // end namespace services
+} // end namespace fipa
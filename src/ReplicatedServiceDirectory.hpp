@@ -0,0 +1,278 @@
+#ifndef FIPA_SERVICES_REPLICATED_SERVICE_DIRECTORY_HPP
+#define FIPA_SERVICES_REPLICATED_SERVICE_DIRECTORY_HPP
+
+#include <map>
+#include <set>
+#include <memory>
+#include <vector>
+#include <fipa_services/ServiceDirectory.hpp>
+#include <fipa_services/transports/Address.hpp>
+#include <fipa_services/transports/TransportType.hpp>
+
+namespace fipa {
+namespace services {
+
+namespace transports {
+    class Transport;
+}
+
+/**
+ * \class ReplicatedServiceDirectory
+ * \brief Service directory which replicates its entries to other nodes over
+ * the builtin transports, without any service discovery backend
+ * \details All lookups and modifications are local, replication happens in
+ * trigger, which has to be called periodically, e.g. alongside
+ * MessageTransport::trigger:
+ *  - each modification is recorded with the id of the node where it
+ *    happened and a sequence number of that node; sequence numbers are
+ *    Lamport clocks, so that concurrent modifications of the same service
+ *    are resolved identically on all nodes (the higher sequence number
+ *    wins, then the higher node id)
+ *  - the version vector of a node holds the highest sequence number of each
+ *    node whose modifications have been applied
+ *  - local modifications are pushed to all peers as delta, i.e. all records
+ *    newer than the version vector of the previous push
+ *  - periodically, each node sends its version vector to all peers (anti
+ *    entropy), which answer with the records the node is missing and
+ *    request the records they are missing themselves
+ *
+ * Removed services are kept as tombstones for the tombstone lifetime, which
+ * has to exceed the time a node may be disconnected, otherwise the removal
+ * can be undone by this node.
+ *
+ * Nodes which send messages to this node are added as peers, so that a node
+ * only needs to know one other node to join.
+ *
+ * \verbatim
+ #include <fipa_services/ReplicatedServiceDirectory.hpp>
+
+ using namespace fipa::services;
+ std::shared_ptr<ReplicatedServiceDirectory> directory(new ReplicatedServiceDirectory("mts-0"));
+ directory->addPeer("mts-1", transports::Address::fromString("tcp://192.168.0.2:40000"));
+ message_transport::MessageTransport messageTransport(fipa::acl::AgentID("mts-0"), directory);
+
+ while(true)
+ {
+     directory->trigger();
+     messageTransport.trigger();
+ }
+ \endverbatim
+ */
+class ReplicatedServiceDirectory : public ServiceDirectory
+{
+public:
+    typedef std::string NodeId;
+    /// Highest sequence number per node whose modifications have been
+    /// applied
+    typedef std::map<NodeId, uint64_t> VersionVector;
+    typedef std::map<NodeId, transports::Address> Peers;
+    typedef std::shared_ptr<ReplicatedServiceDirectory> Ptr;
+
+    /**
+     * Constructor, which starts a transport that is only used for the
+     * replication
+     * \param nodeId Unique id of this node, e.g. the name of the MTS
+     * \param transportType Type of the transport
+     * \param interfaceName Network interface whose address is announced to
+     * the peers
+     * \param port Listening port, 0 for any free port
+     * \param mode Synchronization of readers and writers
+     */
+    ReplicatedServiceDirectory(const NodeId& nodeId, transports::TransportType::Type transportType = transports::TransportType::TCP, const std::string& interfaceName = "eth0", uint16_t port = 0, ConcurrencyMode mode = LOCKING);
+
+    virtual ~ReplicatedServiceDirectory();
+
+    /**
+     * Get the id of this node
+     */
+    const NodeId& getNodeId() const { return mNodeId; }
+
+    /**
+     * Get the address peers can reach this node at
+     */
+    const transports::Address& getAddress() const { return mAddress; }
+
+    /**
+     * Add or update a peer to replicate with
+     */
+    void addPeer(const NodeId& nodeId, const transports::Address& address);
+
+    /**
+     * Stop replicating with a peer
+     * \throws NotFound if the peer is unknown
+     */
+    void removePeer(const NodeId& nodeId);
+
+    /**
+     * Get the known peers
+     */
+    Peers getPeers() const;
+
+    /**
+     * Get the version vector of this node
+     */
+    VersionVector getVersionVector() const;
+
+    /**
+     * Set the period of the anti-entropy rounds, default is 5 seconds
+     */
+    void setAntiEntropyPeriod(const base::Time& period);
+
+    /**
+     * Set the time tombstones of removed services are retained, default
+     * is one hour
+     */
+    void setTombstoneLifetime(const base::Time& lifetime);
+
+    /**
+     * Receive and apply the messages of peers, push local modifications to
+     * the peers and start an anti-entropy round when due
+     * \param now Current time
+     */
+    void trigger(const base::Time& now = base::Time::now());
+
+    /**
+     * Start an anti-entropy round with all peers, which is completed by
+     * the following calls of trigger
+     */
+    void synchronize();
+
+    /**
+     * Check whether a version vector includes all modifications of another one
+     * \return true if for all nodes the sequence number of a is greater or
+     * equal than the one of b
+     */
+    static bool dominates(const VersionVector& a, const VersionVector& b);
+
+private:
+    /// Latest modification of a service
+    struct Record
+    {
+        Name name;
+        NodeId origin;
+        uint64_t sequence;
+        bool removed;
+        /// Entry, if not removed
+        ServiceDirectoryEntry entry;
+        /// Local time the tombstone has been created at, null until the
+        /// next call of trigger for local removals
+        base::Time removalTime;
+
+        /**
+         * Check whether this modification wins against another
+         * modification of the same service
+         */
+        bool supersedes(const Record& other) const;
+    };
+    typedef std::map<Name, Record> Records;
+
+    enum MessageType { DIGEST = 0, DELTA = 1 };
+
+    /**
+     * A digest carries the version vector of the sender, a delta the
+     * records which are newer than the base version vector
+     */
+    struct Message
+    {
+        MessageType type;
+        NodeId sender;
+        std::string senderAddress;
+        VersionVector base;
+        VersionVector versionVector;
+        std::vector<Record> records;
+    };
+
+    /// Encoded message to a peer
+    struct Envelope
+    {
+        NodeId receiver;
+        transports::Address address;
+        std::string data;
+    };
+    typedef std::vector<Envelope> Envelopes;
+
+    static const char* const MAGIC;
+    static const uint8_t VERSION = 1;
+
+    static std::string encode(const Message& message);
+
+    /**
+     * \throws InvalidEncoding
+     */
+    static Message decode(const std::string& data);
+
+    /**
+     * Record local modifications, called while mMutex is held
+     */
+    void handleChange(const ServiceDirectoryChange& change);
+
+    /**
+     * Queue data received by the transport
+     */
+    void handleData(const std::string& data);
+
+    /**
+     * Process a message and create the replies
+     * Requires mMutex to be held
+     * \param now Time of the trigger call
+     */
+    void process(const Message& message, Envelopes& replies, const base::Time& now);
+
+    /**
+     * Apply the records of a delta
+     * Requires mMutex to be held
+     * \param now Time of the trigger call, which tombstones are created at
+     */
+    void applyDelta(const Message& delta, const base::Time& now);
+
+    /**
+     * Encode a message for all peers
+     * Requires mMutex to be held
+     */
+    void broadcast(const Message& message, Envelopes& envelopes) const;
+
+    /**
+     * Create a message
+     * Requires mMutex to be held
+     */
+    Message createMessage(MessageType type) const;
+
+    /**
+     * Create a delta with all records newer than the given version vector
+     * Requires mMutex to be held
+     */
+    Message createDelta(const VersionVector& base) const;
+
+    void send(const Envelopes& envelopes);
+
+    static uint64_t getSequence(const VersionVector& versionVector, const NodeId& nodeId);
+
+    NodeId mNodeId;
+    std::shared_ptr<transports::Transport> mTransport;
+    transports::Address mAddress;
+
+    // The following members are guarded by mMutex
+    Peers mPeers;
+    Records mRecords;
+    VersionVector mVersionVector;
+    /// Version vector when local modifications have been pushed last
+    VersionVector mPushedVersionVector;
+    /// Lamport clock
+    uint64_t mClock;
+    /// Services whose remote modifications are being applied, which are
+    /// therefore not recorded as local modifications
+    std::set<Name> mApplying;
+    bool mSynchronize;
+    base::Time mAntiEntropyPeriod;
+    base::Time mLastAntiEntropy;
+    base::Time mTombstoneLifetime;
+
+    boost::mutex mIncomingMutex;
+    std::vector<std::string> mIncoming;
+
+    ServiceDirectoryChangeFeed::SubscriptionId mSubscription;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_REPLICATED_SERVICE_DIRECTORY_HPP
@@ -1,56 +1,313 @@
 #include "ServiceDirectory.hpp"
 #include "ServiceDirectoryEntry.hpp"
-#include <boost/regex.hpp>
+#include "ServiceDirectorySnapshot.hpp"
 #include "ErrorHandling.hpp"
 #include <base-logging/Logging.hpp>
+#include <algorithm>
 
 namespace fipa {
 namespace services {
 
-ServiceDirectory::ServiceDirectory()
-    : mTimestamp( base::Time::now() )
+namespace {
+    /**
+     * Remove the matches whose lease has expired, but which have not been
+     * removed by a writer yet
+     */
+    void removeExpiredMatches(const ServiceDirectoryIndex& index, const base::Time& now, ServiceDirectoryIndex::Matches& matches)
+    {
+        if(!index.hasLeases())
+        {
+            return;
+        }
+        matches.erase(std::remove_if(matches.begin(), matches.end(), [&index, &now](const ServiceDirectoryEntry* entry)
+            {
+                return index.isExpired(entry->getName(), now);
+            }), matches.end());
+    }
+
+    ServiceDirectoryChange createChange(ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry, const ServiceDirectoryEntry& previous = ServiceDirectoryEntry())
+    {
+        ServiceDirectoryChange change;
+        change.type = type;
+        change.entry = entry;
+        change.previous = previous;
+        return change;
+    }
+}
+
+std::string ServiceDirectoryPage::createResumeToken(const Name& name)
+{
+    // The prefix distinguishes a token for an empty name from no token
+    return "after:" + name;
+}
+
+bool ServiceDirectoryPage::parseResumeToken(const std::string& token, Name& name)
+{
+    static const std::string prefix = "after:";
+    if(token.empty())
+    {
+        return false;
+    }
+    if(token.compare(0, prefix.size(), prefix) != 0)
+    {
+        throw ArgumentError("resume token '" + token + "'");
+    }
+    name = token.substr(prefix.size());
+    return true;
+}
+
+ServiceDirectory::ServiceDirectory(ConcurrencyMode mode)
+    : mServices(new ServiceDirectoryIndex())
+    , mConcurrencyMode(mode)
+    , mTimestamp( base::Time::now() )
+{
+}
+
+ServiceDirectoryIndex::ConstPtr ServiceDirectory::read(boost::shared_lock<boost::shared_mutex>& lock) const
+{
+    if(mConcurrencyMode == COPY_ON_WRITE)
+    {
+        return std::atomic_load(&mServices);
+    }
+
+    lock = boost::shared_lock<boost::shared_mutex>(mServicesMutex);
+    return mServices;
+}
+
+bool ServiceDirectory::update(const std::function<bool (ServiceDirectoryIndex&)>& modification)
+{
+    if(mConcurrencyMode == COPY_ON_WRITE)
+    {
+        // Readers might still use the current snapshot, so modify a copy
+        // and publish it
+        ServiceDirectoryIndex::Ptr services(new ServiceDirectoryIndex(*mServices));
+        if(!modification(*services))
+        {
+            return false;
+        }
+        std::atomic_store(&mServices, services);
+        return true;
+    }
+
+    boost::unique_lock<boost::shared_mutex> lock(mServicesMutex);
+    return modification(*mServices);
+}
+
+ServiceDirectoryIndex::ConstPtr ServiceDirectory::getSnapshot() const
 {
+    boost::shared_lock<boost::shared_mutex> lock;
+    ServiceDirectoryIndex::ConstPtr services = read(lock);
+    std::vector<Name> expired = services->getExpired(base::Time::now());
+    if(mConcurrencyMode == COPY_ON_WRITE && expired.empty())
+    {
+        return services;
+    }
+
+    // Entries with an expired lease are left out, but remain in the
+    // directory until a writer removes them
+    ServiceDirectoryIndex::Ptr snapshot(new ServiceDirectoryIndex(*services));
+    std::vector<Name>::const_iterator cit = expired.begin();
+    for(; cit != expired.end(); ++cit)
+    {
+        snapshot->erase(*cit);
+    }
+    return snapshot;
 }
 
 void ServiceDirectory::registerService(const ServiceDirectoryEntry& entry)
 {
     boost::unique_lock<boost::mutex> lock(mMutex);
+    removeExpired(base::Time::now());
+    add(entry);
+}
+
+void ServiceDirectory::registerService(const ServiceDirectoryEntry& entry, const base::Time& leaseDuration)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    base::Time now = base::Time::now();
+    removeExpired(now);
+    add(entry, now + leaseDuration);
+    scheduleLease(entry.getName(), now + leaseDuration);
+}
+
+void ServiceDirectory::registerServices(const ServiceDirectoryList& entries)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    removeExpired(base::Time::now());
+
+    std::vector<const Name*> names;
+    names.reserve(entries.size());
+    ServiceDirectoryList::const_iterator cit = entries.begin();
+    for(; cit != entries.end(); ++cit)
+    {
+        if(mServices->find(cit->getName()))
+        {
+            LOG_WARN_S << "Duplicate entry: " << cit->toString();
+            throw DuplicateEntry(cit->toString());
+        }
+        names.push_back(&cit->getName());
+    }
+    // Names given twice are adjacent once sorted
+    std::sort(names.begin(), names.end(), [](const Name* a, const Name* b) { return *a < *b; });
+    std::vector<const Name*>::const_iterator nit = std::adjacent_find(names.begin(), names.end(), [](const Name* a, const Name* b) { return *a == *b; });
+    if(nit != names.end())
+    {
+        LOG_WARN_S << "Duplicate entry: " << **nit;
+        throw DuplicateEntry("ServiceDirectoryEntry named '" + **nit + "'");
+    }
+
+    if(entries.empty())
+    {
+        return;
+    }
+    update([&entries](ServiceDirectoryIndex& index) { return index.insert(entries) > 0; });
+    updateTimestamp();
+
+    ServiceDirectoryChangeList changes;
+    changes.reserve(entries.size());
+    for(cit = entries.begin(); cit != entries.end(); ++cit)
+    {
+        changes.push_back(createChange(ServiceDirectoryChange::ADDED, *cit));
+    }
+    mChangeFeed.publish(changes);
+}
+
+void ServiceDirectory::add(const ServiceDirectoryEntry& entry, const base::Time& expiry)
+{
     LOG_DEBUG_S << "Register service: " << entry.toString();
-    ServiceDirectoryMap::const_iterator cit = mServices.find(entry.getName());
-    if(cit != mServices.end())
+    // Writers are serialized by mMutex, so the index can be checked
+    // without further locking
+    if(mServices->find(entry.getName()) || !update([&entry, &expiry](ServiceDirectoryIndex& index)
+            {
+                if(!index.insert(entry))
+                {
+                    return false;
+                }
+                if(!expiry.isNull())
+                {
+                    index.setLease(entry.getName(), expiry);
+                }
+                return true;
+            }))
     {
         LOG_WARN_S << "Duplicate entry: " << entry.toString();
         throw DuplicateEntry(entry.toString());
-    } else {
-        mServices[entry.getName()] = entry;
     }
     updateTimestamp();
+    mChangeFeed.publish(ServiceDirectoryChange::ADDED, entry);
+}
+
+void ServiceDirectory::renewLease(const Name& name, const base::Time& leaseDuration)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    base::Time now = base::Time::now();
+    removeExpired(now);
+    if(!mLeases.contains(name))
+    {
+        throw NotFound("Lease of " + name);
+    }
+    scheduleLease(name, now + leaseDuration);
+}
+
+size_t ServiceDirectory::expireLeases(const base::Time& now)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return removeExpired(now);
+}
+
+void ServiceDirectory::scheduleLease(const Name& name, const base::Time& expiry)
+{
+    mLeases.schedule(name, expiry);
+    // Readers see the renewed expiry without a copy of the index
+    mServices->renewLease(name, expiry);
+}
+
+size_t ServiceDirectory::removeExpired(const base::Time& now)
+{
+    std::vector<std::string> expired = mLeases.advance(now);
+    if(expired.empty())
+    {
+        return 0;
+    }
+
+    ServiceDirectoryList removed;
+    std::vector<std::string>::const_iterator cit = expired.begin();
+    for(; cit != expired.end(); ++cit)
+    {
+        const ServiceDirectoryEntry* entry = mServices->find(*cit);
+        if(entry)
+        {
+            LOG_INFO_S << "Lease expired: " << entry->toString();
+            removed.push_back(*entry);
+        }
+    }
+
+    update([&removed](ServiceDirectoryIndex& index)
+        {
+            ServiceDirectoryList::const_iterator cit = removed.begin();
+            for(; cit != removed.end(); ++cit)
+            {
+                index.erase(cit->getName());
+            }
+            return true;
+        });
+    updateTimestamp();
+
+    ServiceDirectoryChangeList changes;
+    changes.reserve(removed.size());
+    ServiceDirectoryList::const_iterator rit = removed.begin();
+    for(; rit != removed.end(); ++rit)
+    {
+        changes.push_back(createChange(ServiceDirectoryChange::REMOVED, *rit));
+    }
+    mChangeFeed.publish(changes);
+    return removed.size();
 }
 
 void ServiceDirectory::deregisterService(const ServiceDirectoryEntry& entry)
 {
-    ServiceDirectory::deregisterService(entry.getName(), ServiceDirectoryEntry::NAME);
+    deregisterService(entry.getName(), ServiceDirectoryEntry::NAME);
 }
 
 void ServiceDirectory::deregisterService(const std::string& regex, ServiceDirectoryEntry::Field field)
 {
     boost::unique_lock<boost::mutex> lock(mMutex);
-    ServiceDirectoryMap::iterator it = mServices.begin();
+    removeExpired(base::Time::now());
 
-    boost::regex r(regex);
-    boost::smatch what;
-    for(; it != mServices.end(); ++it)
+    ServiceDirectoryIndex::Matches matches = mServices->match(regex, field, 1);
+    if(matches.empty())
     {
-        ServiceDirectoryEntry entry = it->second;
+        throw NotFound("ServiceDirectoryEntry matching '" + regex + "'");
+    }
+
+    ServiceDirectoryEntry removed = *matches.front();
+    Name name = removed.getName();
+    update([&name](ServiceDirectoryIndex& index) { return index.erase(name); });
+    mLeases.cancel(name);
+    updateTimestamp();
+    mChangeFeed.publish(ServiceDirectoryChange::REMOVED, removed);
+}
+
+void ServiceDirectory::deregisterServices(const std::vector<Name>& names)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    removeExpired(base::Time::now());
 
-        if(boost::regex_match( entry.getFieldContent(field) ,what,r))
+    std::set<Name> unique;
+    std::vector<Name> removals;
+    std::vector<Name>::const_iterator cit = names.begin();
+    for(; cit != names.end(); ++cit)
+    {
+        if(!mServices->find(*cit))
         {
-            mServices.erase(it);
-            updateTimestamp();
-            return;
+            throw NotFound("ServiceDirectoryEntry named '" + *cit + "'");
+        }
+        if(unique.insert(*cit).second)
+        {
+            removals.push_back(*cit);
         }
     }
-    throw NotFound("ServiceDirectoryEntry matching '" + regex + "'");
+    apply(ServiceDirectoryList(), removals);
 }
 
 ServiceDirectoryList ServiceDirectory::search(const ServiceDirectoryEntry& entry) const
@@ -60,49 +317,186 @@ ServiceDirectoryList ServiceDirectory::search(const ServiceDirectoryEntry& entry
 
 ServiceDirectoryList ServiceDirectory::search(const std::string& regex, ServiceDirectoryEntry::Field field, bool doThrow) const
 {
-    ServiceDirectoryMap::const_iterator it = mServices.begin();
-    ServiceDirectoryList resultList;
-
-    boost::regex r(regex);
-    boost::smatch what;
-    for(; it != mServices.end(); ++it)
+    boost::shared_lock<boost::shared_mutex> lock;
+    ServiceDirectoryIndex::ConstPtr index = read(lock);
+    ServiceDirectoryIndex::Matches matches = index->match(regex, field);
+    removeExpiredMatches(*index, base::Time::now(), matches);
+    ServiceDirectoryList resultList = toList(matches);
+    if(resultList.empty() && doThrow)
     {
-        ServiceDirectoryEntry entry = it->second;
+        throw NotFound("ServiceDirectoryEntry matching '" + regex + "'");
+    } else {
+        return resultList;
+    }
+}
 
-        if(boost::regex_match( entry.getFieldContent(field) ,what,r))
-        {
-            resultList.push_back(entry);
-        }
+ServiceDirectoryList ServiceDirectory::searchByLocation(const std::string& regex, ServiceLocation::Field field, bool doThrow) const
+{
+    boost::shared_lock<boost::shared_mutex> lock;
+    ServiceDirectoryIndex::ConstPtr index = read(lock);
+    ServiceDirectoryIndex::Matches matches = index->matchLocation(regex, field);
+    removeExpiredMatches(*index, base::Time::now(), matches);
+    ServiceDirectoryList resultList = toList(matches);
+    if(resultList.empty() && doThrow)
+    {
+        throw NotFound("ServiceDirectoryEntry with location matching '" + regex + "'");
+    } else {
+        return resultList;
     }
+}
+
+ServiceDirectoryList ServiceDirectory::searchByQuery(const ServiceDirectoryQuery& query, bool doThrow) const
+{
+    boost::shared_lock<boost::shared_mutex> lock;
+    ServiceDirectoryIndex::ConstPtr index = read(lock);
+    ServiceDirectoryIndex::Matches matches = index->match(query);
+    removeExpiredMatches(*index, base::Time::now(), matches);
+    ServiceDirectoryList resultList = toList(matches);
     if(resultList.empty() && doThrow)
     {
-        throw NotFound("ServiceDirectoryEntry matching '" + regex + "'");
+        throw NotFound("ServiceDirectoryEntry with " + query.toString());
     } else {
         return resultList;
     }
 }
 
-void ServiceDirectory::modify(const ServiceDirectoryEntry& entry)
+ServiceDirectoryPage ServiceDirectory::searchPage(const ServiceDirectoryQuery& query, size_t limit, const std::string& resumeToken) const
 {
-    ServiceDirectoryList list = search(entry);
+    if(limit == 0)
+    {
+        throw ArgumentError("page limit of 0");
+    }
+    Name after;
+    bool resume = ServiceDirectoryPage::parseResumeToken(resumeToken, after);
 
-    if(list.empty())
+    ServiceDirectoryPage page;
+    boost::shared_lock<boost::shared_mutex> lock;
+    ServiceDirectoryIndex::ConstPtr index = read(lock);
+    base::Time now = base::Time::now();
+    // One additional match tells whether another page follows
+    ServiceDirectoryIndex::Matches matches;
+    const Name* from = resume ? &after : NULL;
+    for(;;)
     {
-        throw NotFound(entry.getName());
+        size_t missing = limit + 1 - matches.size();
+        ServiceDirectoryIndex::Matches candidates = index->match(query, missing, from);
+        if(candidates.empty())
+        {
+            break;
+        }
+        // Matches with an expired lease are skipped, so the query resumes
+        // after the last candidate until the page is filled
+        const ServiceDirectoryEntry* last = candidates.back();
+        bool exhausted = candidates.size() < missing;
+        removeExpiredMatches(*index, now, candidates);
+        matches.insert(matches.end(), candidates.begin(), candidates.end());
+        if(exhausted || matches.size() > limit)
+        {
+            break;
+        }
+        from = &last->getName();
+    }
+    if(matches.size() > limit)
+    {
+        matches.resize(limit);
+        page.resumeToken = ServiceDirectoryPage::createResumeToken(matches.back()->getName());
+    }
+    page.entries = toList(matches);
+    return page;
+}
+
+void ServiceDirectory::forEachMatch(const std::string& regex, ServiceDirectoryEntry::Field field, const ServiceDirectoryVisitor& visitor) const
+{
+    boost::shared_lock<boost::shared_mutex> lock;
+    ServiceDirectoryIndex::ConstPtr index = read(lock);
+    ServiceDirectoryIndex::Matches matches = index->match(regex, field);
+    removeExpiredMatches(*index, base::Time::now(), matches);
+    if(mConcurrencyMode == LOCKING)
+    {
+        // The visitor may call back into the directory, so it must not run
+        // while the lock is held. Copies of entries share their content
+        ServiceDirectoryList entries = toList(matches);
+        lock.unlock();
+
+        ServiceDirectoryList::const_iterator eit = entries.begin();
+        for(; eit != entries.end(); ++eit)
+        {
+            if(!visitor(*eit))
+            {
+                return;
+            }
+        }
+        return;
+    }
+
+    // The snapshot remains unchanged, so entries are visited in place
+    ServiceDirectoryIndex::Matches::const_iterator cit = matches.begin();
+    for(; cit != matches.end(); ++cit)
+    {
+        if(!visitor(**cit))
+        {
+            return;
+        }
+    }
+}
+
+ServiceDirectoryList ServiceDirectory::lookupByName(const Name& name) const
+{
+    ServiceDirectoryList resultList;
+    boost::shared_lock<boost::shared_mutex> lock;
+    ServiceDirectoryIndex::ConstPtr index = read(lock);
+    const ServiceDirectoryEntry* entry = index->find(name);
+    if(entry && !index->isExpired(name, base::Time::now()))
+    {
+        resultList.push_back(*entry);
+    }
+    return resultList;
+}
+
+ServiceDirectoryList ServiceDirectory::toList(const ServiceDirectoryIndex::Matches& matches)
+{
+    ServiceDirectoryList resultList;
+    resultList.reserve(matches.size());
+    ServiceDirectoryIndex::Matches::const_iterator cit = matches.begin();
+    for(; cit != matches.end(); ++cit)
+    {
+        resultList.push_back(**cit);
     }
+    return resultList;
+}
 
-    mServices[entry.getName()] = entry;
+void ServiceDirectory::modify(const ServiceDirectoryEntry& entry)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    removeExpired(base::Time::now());
+    const ServiceDirectoryEntry* existing = mServices->find(entry.getName());
+    if(!existing)
+    {
+        throw NotFound(entry.getName());
+    }
+    ServiceDirectoryEntry previous = *existing;
+    update([&entry](ServiceDirectoryIndex& index) { return index.replace(entry); });
     updateTimestamp();
+    mChangeFeed.publish(ServiceDirectoryChange::MODIFIED, entry, previous);
 }
 
 ServiceDirectoryList ServiceDirectory::getAll() const
 {
-    ServiceDirectoryMap::const_iterator it = mServices.begin();
+    boost::shared_lock<boost::shared_mutex> lock;
+    ServiceDirectoryIndex::ConstPtr index = read(lock);
+    const ServiceDirectoryMap& services = index->getEntries();
+    ServiceDirectoryMap::const_iterator it = services.begin();
     ServiceDirectoryList resultList;
+    resultList.reserve(services.size());
+    bool leases = index->hasLeases();
+    base::Time now = base::Time::now();
 
-    for(; it != mServices.end(); ++it)
+    for(; it != services.end(); ++it)
     {
-        resultList.push_back(it->second);
+        if(!leases || !index->isExpired(it->first, now))
+        {
+            resultList.push_back(it->second);
+        }
     }
 
     return resultList;
@@ -111,43 +505,230 @@ ServiceDirectoryList ServiceDirectory::getAll() const
 
 void ServiceDirectory::mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field field)
 {
-    std::set<std::string> uniqueValues = getUniqueFieldValues(updateList, field);
-    std::set<std::string>::const_iterator cit = uniqueValues.begin();
+    mergeSelectively(updateList, field, getUniqueFieldValues(updateList, field));
+}
+
+void ServiceDirectory::mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field field, const std::set<std::string>& fieldValues)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    removeExpired(base::Time::now());
 
-    for(; cit != uniqueValues.end(); ++cit)
+    // Entries which will be replaced by the update list
+    ServiceDirectoryIndex::Matches matches = mServices->matchValues(fieldValues, field);
+    std::map<Name, ServiceDirectoryEntry> removals;
+    ServiceDirectoryIndex::Matches::const_iterator mit = matches.begin();
+    for(; mit != matches.end(); ++mit)
     {
-        clearSelectively(*cit, field);
+        removals[(*mit)->getName()] = **mit;
     }
 
+    // Validate the update list before anything is modified
+    std::set<Name> additions;
     ServiceDirectoryList::const_iterator uit = updateList.begin();
     for(; uit != updateList.end(); ++uit)
     {
-        registerService(*uit);
+        Name name = uit->getName();
+        if(!additions.insert(name).second || (mServices->find(name) && !removals.count(name)))
+        {
+            LOG_WARN_S << "Duplicate entry: " << uit->toString();
+            throw DuplicateEntry(uit->toString());
+        }
     }
+
+    update([&removals, &updateList](ServiceDirectoryIndex& index)
+        {
+            std::map<Name, ServiceDirectoryEntry>::const_iterator rit = removals.begin();
+            for(; rit != removals.end(); ++rit)
+            {
+                index.erase(rit->first);
+            }
+
+            ServiceDirectoryList::const_iterator uit = updateList.begin();
+            for(; uit != updateList.end(); ++uit)
+            {
+                index.insert(*uit);
+            }
+            return true;
+        });
+    updateTimestamp();
+
+    // Entries which are replaced by an entry of the same name count as
+    // modified unless their content is unchanged, the replacing entries are
+    // registered without lease
+    ServiceDirectoryChangeList changes;
+    std::map<Name, ServiceDirectoryEntry>::const_iterator rit = removals.begin();
+    for(; rit != removals.end(); ++rit)
+    {
+        mLeases.cancel(rit->first);
+        if(!additions.count(rit->first))
+        {
+            changes.push_back(createChange(ServiceDirectoryChange::REMOVED, rit->second));
+        }
+    }
+    for(uit = updateList.begin(); uit != updateList.end(); ++uit)
+    {
+        rit = removals.find(uit->getName());
+        if(rit == removals.end())
+        {
+            changes.push_back(createChange(ServiceDirectoryChange::ADDED, *uit));
+        } else if(!uit->hasSameContent(rit->second))
+        {
+            changes.push_back(createChange(ServiceDirectoryChange::MODIFIED, *uit, rit->second));
+        }
+    }
+    mChangeFeed.publish(changes);
 }
 
-std::set<std::string> ServiceDirectory::getUniqueFieldValues(const ServiceDirectoryList& list, ServiceDirectoryEntry::Field field)
+void ServiceDirectory::saveSnapshot(const std::string& filename) const
 {
-    ServiceDirectoryList::const_iterator cit = list.begin();
-    std::set<std::string> uniqueFieldValues;
-    for(; cit != list.end(); ++cit)
+    ServiceDirectorySnapshot::write(*getSnapshot(), filename);
+}
+
+size_t ServiceDirectory::restoreSnapshot(const std::string& filename, const base::Time& leaseDuration)
+{
+    ServiceDirectorySnapshot snapshot(filename);
+    return restore(snapshot.getEntries(), leaseDuration);
+}
+
+size_t ServiceDirectory::restore(const ServiceDirectoryList& entries, const base::Time& leaseDuration)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    base::Time now = base::Time::now();
+    removeExpired(now);
+
+    // Services which have been registered meanwhile take precedence
+    ServiceDirectoryList restored;
+    restored.reserve(entries.size());
+    ServiceDirectoryList::const_iterator cit = entries.begin();
+    for(; cit != entries.end(); ++cit)
     {
-        ServiceDirectoryEntry entry = *cit;
-        uniqueFieldValues.insert( entry.getFieldContent( field ) );
+        if(!mServices->find(cit->getName()))
+        {
+            restored.push_back(*cit);
+        }
     }
 
-    return uniqueFieldValues;
+    base::Time expiry = leaseDuration.isNull() ? base::Time() : now + leaseDuration;
+    update([&restored, &expiry](ServiceDirectoryIndex& index)
+        {
+            if(index.insert(restored) == 0)
+            {
+                return false;
+            }
+            if(!expiry.isNull())
+            {
+                ServiceDirectoryList::const_iterator cit = restored.begin();
+                for(; cit != restored.end(); ++cit)
+                {
+                    index.setLease(cit->getName(), expiry);
+                }
+            }
+            return true;
+        });
+    updateTimestamp();
+
+    ServiceDirectoryChangeList changes;
+    changes.reserve(restored.size());
+    for(cit = restored.begin(); cit != restored.end(); ++cit)
+    {
+        if(!expiry.isNull())
+        {
+            scheduleLease(cit->getName(), expiry);
+        }
+        changes.push_back(createChange(ServiceDirectoryChange::ADDED, *cit));
+    }
+    mChangeFeed.publish(changes);
+    return restored.size();
 }
 
-void ServiceDirectory::clearSelectively(const std::string& regex, ServiceDirectoryEntry::Field field)
+void ServiceDirectory::apply(const ServiceDirectoryList& updates, const std::vector<Name>& removals)
+{
+    removeExpired(base::Time::now());
+
+    // Entries which are replaced, where the update is a modification
+    std::map<Name, ServiceDirectoryEntry> previous;
+    ServiceDirectoryList::const_iterator uit = updates.begin();
+    for(; uit != updates.end(); ++uit)
+    {
+        const ServiceDirectoryEntry* existing = mServices->find(uit->getName());
+        if(existing)
+        {
+            previous[existing->getName()] = *existing;
+        }
+    }
+
+    ServiceDirectoryList removed;
+    std::vector<Name>::const_iterator rit = removals.begin();
+    for(; rit != removals.end(); ++rit)
+    {
+        const ServiceDirectoryEntry* existing = mServices->find(*rit);
+        if(existing)
+        {
+            removed.push_back(*existing);
+        }
+    }
+
+    if(updates.empty() && removed.empty())
+    {
+        return;
+    }
+
+    update([&updates, &removed](ServiceDirectoryIndex& index)
+        {
+            ServiceDirectoryList::const_iterator cit = removed.begin();
+            for(; cit != removed.end(); ++cit)
+            {
+                index.erase(cit->getName());
+            }
+            for(cit = updates.begin(); cit != updates.end(); ++cit)
+            {
+                if(!index.insert(*cit))
+                {
+                    // Replacing entries are registered without lease
+                    index.replace(*cit);
+                    index.cancelLease(cit->getName());
+                }
+            }
+            return true;
+        });
+    updateTimestamp();
+
+    ServiceDirectoryChangeList changes;
+    changes.reserve(updates.size() + removed.size());
+    for(uit = updates.begin(); uit != updates.end(); ++uit)
+    {
+        std::map<Name, ServiceDirectoryEntry>::const_iterator pit = previous.find(uit->getName());
+        if(pit == previous.end())
+        {
+            changes.push_back(createChange(ServiceDirectoryChange::ADDED, *uit));
+        } else {
+            mLeases.cancel(uit->getName());
+            // e.g. services which are announced again
+            if(!uit->hasSameContent(pit->second))
+            {
+                changes.push_back(createChange(ServiceDirectoryChange::MODIFIED, *uit, pit->second));
+            }
+        }
+    }
+    ServiceDirectoryList::const_iterator cit = removed.begin();
+    for(; cit != removed.end(); ++cit)
+    {
+        mLeases.cancel(cit->getName());
+        changes.push_back(createChange(ServiceDirectoryChange::REMOVED, *cit));
+    }
+    mChangeFeed.publish(changes);
+}
+
+std::set<std::string> ServiceDirectory::getUniqueFieldValues(const ServiceDirectoryList& list, ServiceDirectoryEntry::Field field)
 {
-    ServiceDirectoryList list = ServiceDirectory::search(regex, field, false);
     ServiceDirectoryList::const_iterator cit = list.begin();
+    std::set<std::string> uniqueFieldValues;
     for(; cit != list.end(); ++cit)
     {
-        ServiceDirectoryEntry entry = *cit;
-        deregisterService( entry.getName(), ServiceDirectoryEntry::NAME );
+        uniqueFieldValues.insert( cit->getFieldContent( field ) );
     }
+
+    return uniqueFieldValues;
 }
 
 } // end namespace services
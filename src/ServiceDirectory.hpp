@@ -1,34 +1,111 @@
 #ifndef FIPA_SERVICES_SERVICE_DIRECTORY_HPP
 #define FIPA_SERVICES_SERVICE_DIRECTORY_HPP
 
+#include <functional>
 #include <map>
 #include <set>
 #include <stdexcept>
 #include <boost/thread.hpp>
 #include <fipa_services/ServiceDirectoryEntry.hpp>
+#include <fipa_services/ServiceDirectoryIndex.hpp>
+#include <fipa_services/ServiceDirectoryChangeFeed.hpp>
+#include <fipa_services/TimerWheel.hpp>
 #include <fipa_services/ErrorHandling.hpp>
 
 namespace fipa {
 namespace services {
 
+/**
+ * \class ServiceDirectoryPage
+ * \brief Page of the entries resulting from a paginated search
+ * \details Pages are ordered by name and the resume token refers to the
+ * name of the last entry of a page. Resuming a search is therefore stable
+ * against concurrent modifications: entries which exist during the whole
+ * walk are returned exactly once, while entries that are added or removed
+ * meanwhile may or may not be returned.
+ */
+struct ServiceDirectoryPage
+{
+    ServiceDirectoryList entries;
+    /// Token to retrieve the next page, empty if this is the last page
+    std::string resumeToken;
+
+    /**
+     * Check whether this is the last page of the search
+     */
+    bool isLast() const { return resumeToken.empty(); }
+
+    /**
+     * Create the token to resume a search after the entry of the given name
+     */
+    static std::string createResumeToken(const Name& name);
+
+    /**
+     * Get the name after which a search is resumed
+     * \param token Resume token of a previous page, empty to start a search
+     * \param name Resulting name (only set if the token is not empty)
+     * \return true if the search is resumed, false if it starts from the
+     * beginning
+     * \throws ArgumentError if the token is invalid
+     */
+    static bool parseResumeToken(const std::string& token, Name& name);
+};
+
 /**
  * \class ServiceDirectory
  * \brief Class to describe FIPA service directory
+ * \details Write operations are serialized. How they are synchronized with
+ * read operations, i.e. search, lookupByName and getAll, depends on the
+ * ConcurrencyMode:
+ *  - LOCKING: entries are modified in place, readers take a shared lock
+ *  - COPY_ON_WRITE: writers modify a copy of the entries and publish it as
+ *    a new immutable snapshot, readers do not take any lock but work on the
+ *    snapshot that is current when they start. This mode suits
+ *    read-mostly directories, e.g. when several threads route messages,
+ *    since each write copies the directory.
+ *
+ * Each modification is published as a ServiceDirectoryChange with a
+ * monotonically increasing version, which can be consumed via subscribe or
+ * getChanges instead of polling getTimestamp.
+ *
+ * Services can be registered with a lease, which has to be renewed before it
+ * ends. Otherwise the service is removed by the next modification of the
+ * directory or the next call to expireLeases. Lookups do not modify the
+ * directory, but leave out services whose lease has expired meanwhile.
  */
 class ServiceDirectory
 {
-    // Map of registered services
-    ServiceDirectoryMap mServices;
+public:
+    enum ConcurrencyMode { LOCKING = 0, COPY_ON_WRITE };
+
+private:
+    // Registered services, in mode COPY_ON_WRITE the current snapshot
+    // which is only accessed via std::atomic_load/std::atomic_store
+    ServiceDirectoryIndex::Ptr mServices;
+    // Synchronizes readers and writers in mode LOCKING
+    mutable boost::shared_mutex mServicesMutex;
+    ConcurrencyMode mConcurrencyMode;
     base::Time mTimestamp;
+    // Lease expiry of registered services, guarded by mMutex. The index
+    // holds the expiry as well, so that lookups can leave out expired
+    // services
+    TimerWheel mLeases;
 
 protected:
     // Mutex to guarantee thread-safe operation
-    boost::mutex mMutex;
+    mutable boost::mutex mMutex;
+    // Changes are published while holding mMutex, so that they appear
+    // in the order of modification
+    ServiceDirectoryChangeFeed mChangeFeed;
 
 public:
     typedef std::shared_ptr<ServiceDirectory> Ptr;
 
-    ServiceDirectory();
+    /**
+     * Constructor
+     * \param mode Synchronization of readers and writers
+     */
+    ServiceDirectory(ConcurrencyMode mode = LOCKING);
     virtual ~ServiceDirectory() {}
 
     /**
@@ -38,6 +115,41 @@ public:
      */
     virtual void registerService(const ServiceDirectoryEntry& entry);
 
+    /**
+     * Register service with a lease
+     * \param entry description object to add
+     * \param leaseDuration Duration after which the service is removed unless
+     * the lease is renewed
+     * \throws DuplicateEntry
+     */
+    virtual void registerService(const ServiceDirectoryEntry& entry, const base::Time& leaseDuration);
+
+    /**
+     * Register several services in a single modification, whose changes
+     * share one version of the change feed
+     * \param entries Entries of distinct names
+     * \throws DuplicateEntry if a service is registered already or a name
+     * is given twice, in which case no service is registered
+     */
+    virtual void registerServices(const ServiceDirectoryList& entries);
+
+    /**
+     * Renew the lease of a service
+     * \param name Name of the service
+     * \param leaseDuration Duration from now after which the service is
+     * removed unless the lease is renewed again
+     * \throws NotFound if the service does not exist or has not been
+     * registered with a lease
+     */
+    virtual void renewLease(const Name& name, const base::Time& leaseDuration);
+
+    /**
+     * Remove all services with an expired lease
+     * \param now Current time
+     * \return Number of removed services
+     */
+    virtual size_t expireLeases(const base::Time& now = base::Time::now());
+
     /**
      * Deregister service
      * \param entry (only the name is relevant for deregistration)
@@ -45,6 +157,15 @@ public:
      */
     void deregisterService(const ServiceDirectoryEntry& entry);
 
+    /**
+     * Deregister several services by name in a single modification, whose
+     * changes share one version of the change feed
+     * \param names Names of the services
+     * \throws NotFound if a service is not registered, in which case no
+     * service is deregistered
+     */
+    virtual void deregisterServices(const std::vector<Name>& names);
+
     /**
      * Remove a service by name
      * \param regex regular expression
@@ -71,12 +192,83 @@ public:
      */
     virtual ServiceDirectoryList search(const std::string& regex, ServiceDirectoryEntry::Field field = ServiceDirectoryEntry::NAME, bool doThrow = true) const;
 
+    /**
+     * Call the visitor for each service where the field matches the given
+     * regular expression. In contrast to search no result list is created
+     * \param regex Regular expression to match
+     * \param field Field name to apply the regex to
+     * \param visitor Function called for each matching entry, return false to
+     * stop the iteration. The visitor is never called while the directory
+     * is locked and may therefore access or modify the directory: in
+     * LOCKING mode it visits copies of the matches, in COPY_ON_WRITE mode a
+     * snapshot. Modifications are not reflected by the ongoing iteration.
+     */
+    virtual void forEachMatch(const std::string& regex, ServiceDirectoryEntry::Field field, const ServiceDirectoryVisitor& visitor) const;
+
+    /**
+     * Lookup a service by its exact name, i.e. without
+     * any regular expression matching being involved
+     * \param name Name of the service
+     * \return Result list, which is either empty or contains the single
+     * matching entry
+     */
+    virtual ServiceDirectoryList lookupByName(const Name& name) const;
+
+    /**
+     * Search for services with at least one service location matching
+     * the given regular expression
+     * \param regex Regular expression to match
+     * \param field Field of the service location to apply the regex to
+     * \param doThrow Flag to control the throw behaviour, i.e. to throw an exception when no result has been found
+     * \throw NotFound
+     * \return Result list
+     */
+    virtual ServiceDirectoryList searchByLocation(const std::string& regex, ServiceLocation::Field field = ServiceLocation::SERVICE_ADDRESS, bool doThrow = true) const;
+
+    /**
+     * Search for services matching all predicates of a query
+     * \details The most selective indexed predicate determines the
+     * candidates, which are checked against the remaining predicates
+     * \param query Query combining predicates on several fields
+     * \param doThrow Flag to control the throw behaviour, i.e. to throw an exception when no result has been found
+     * \throw NotFound
+     * \return Result list
+     */
+    virtual ServiceDirectoryList searchByQuery(const ServiceDirectoryQuery& query, bool doThrow = true) const;
+
+    /**
+     * Get a page of the services matching all predicates of a query
+     * \details In contrast to search only the entries of a single page are
+     * copied, so that large directories can be walked with bounded memory.
+     * An empty query walks all services.
+     * \param query Query combining predicates on several fields
+     * \param limit Maximum number of entries of the page
+     * \param resumeToken Token of the previous page, empty for the first page
+     * \return Page of entries ordered by name
+     * \throws ArgumentError if the limit is 0 or the token is invalid
+     * \see ServiceDirectoryStream
+     */
+    virtual ServiceDirectoryPage searchPage(const ServiceDirectoryQuery& query, size_t limit, const std::string& resumeToken = "") const;
+
     /**
      * Modify an existing entry -- an entry will be identified by the same name
      * \param entry Entry that updates the existing one
      * \throws NotFound if entry does not exist
      */
-    void modify(const ServiceDirectoryEntry& entry);
+    virtual void modify(const ServiceDirectoryEntry& entry);
+
+    /**
+     * Get the concurrency mode of this directory
+     */
+    ConcurrencyMode getConcurrencyMode() const { return mConcurrencyMode; }
+
+    /**
+     * Get a consistent snapshot of the registered services which will not
+     * change anymore. In mode COPY_ON_WRITE this is the current snapshot,
+     * in mode LOCKING a copy is created.
+     * \return snapshot of the registered services
+     */
+    virtual ServiceDirectoryIndex::ConstPtr getSnapshot() const;
 
     /**
      * Update modification time
@@ -87,13 +279,69 @@ public:
      * Get timestamp
      * \return Timestamp when updateTimestamp has been called the last time
      */
-    base::Time getTimestamp() const { return mTimestamp; }
+    virtual base::Time getTimestamp() const { return mTimestamp; }
+
+    /**
+     * Get the current version of the directory, which is incremented with
+     * each added, removed or modified entry
+     * \return Version of the latest change, 0 if the directory has not been changed
+     */
+    uint64_t getVersion() const { return mChangeFeed.getVersion(); }
+
+    /**
+     * Get the maximum number of changes retained for getChanges
+     */
+    size_t getHistoryCapacity() const { return mChangeFeed.getHistoryCapacity(); }
+
+    /**
+     * Set the maximum number of changes retained for getChanges, a consumer
+     * which falls further behind has to resynchronize
+     * \see ServiceDirectoryChangeFeed::setHistoryCapacity
+     */
+    void setHistoryCapacity(size_t capacity) { mChangeFeed.setHistoryCapacity(capacity); }
+
+    /**
+     * Subscribe to changes of entries where the field matches the given
+     * regular expression
+     * \details The callback is called by the modifying thread after the change
+     * has been applied and must not modify this directory
+     * \param callback Function called for each matching change
+     * \param regex Regular expression
+     * \param field Field the regular expression is applied to
+     * \return Id of the subscription
+     */
+    ServiceDirectoryChangeFeed::SubscriptionId subscribe(const ServiceDirectoryChangeCallback& callback, const std::string& regex = ".*", ServiceDirectoryEntry::Field field = ServiceDirectoryEntry::NAME) { return mChangeFeed.subscribe(callback, regex, field); }
+
+    /**
+     * Cancel a subscription, waiting for callbacks in progress in other
+     * threads
+     * \throws NotFound if the subscription does not exist
+     */
+    void unsubscribe(ServiceDirectoryChangeFeed::SubscriptionId id) { mChangeFeed.unsubscribe(id); }
+
+    /**
+     * Get the changes after the given version where the field matches the
+     * given regular expression
+     * \details Only a limited number of changes is retained. If the changes
+     * are no longer available, the consumer has to resynchronize, i.e. get
+     * the current version and then retrieve all entries. Since the
+     * entries might already contain changes after that version, changes
+     * should be applied idempotently.
+     * \param version Version of the last change that has been seen
+     * \param changes Resulting changes in version order
+     * \param regex Regular expression
+     * \param field Field the regular expression is applied to
+     * \return false if the consumer needs to resynchronize, true otherwise
+     */
+    bool getChanges(uint64_t version, ServiceDirectoryChangeList& changes, const std::string& regex = ".*", ServiceDirectoryEntry::Field field = ServiceDirectoryEntry::NAME) const { return mChangeFeed.getChanges(version, changes, regex, field); }
 
     /**
      * Retrieve all registered services
+     * \details Entries share their content with the directory, so that the
+     * list is a shallow copy
      * \return List of all registered services
      */
-    ServiceDirectoryList getAll() const;
+    virtual ServiceDirectoryList getAll() const;
 
     /**
      * Merge the existing service directory list with the existing.
@@ -101,12 +349,62 @@ public:
      * Uses each unique value to update corresponding field, e.g.,
      * when locator is set as field for the selective merge then all instances with the same locator
      * are removed from the service directory and are thus overriden by the updatelist
+     *
+     * The merge is applied as a single transaction, i.e. either all changes
+     * are applied at once or none.
      * \param updateList list of services selected to update the existing one
      * \param selectiveMerge Field by which entries are identified for removal
+     * \throws DuplicateEntry if the update list contains an entry twice or an
+     * entry of the update list exists but is not identified for removal
      */
     virtual void mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field selectiveMerge);
 
-private:
+    /**
+     * Write all registered services into a snapshot file, which allows to
+     * restore the directory after a restart. The snapshot should be saved
+     * periodically and on shutdown
+     * \param filename Path of the snapshot file
+     * \throws InvalidSnapshot if the file cannot be written
+     * \see ServiceDirectorySnapshot
+     */
+    void saveSnapshot(const std::string& filename) const;
+
+    /**
+     * Register the services of a snapshot file which are not registered yet
+     * \param filename Path of the snapshot file
+     * \param leaseDuration If not null, the restored services are registered
+     * with a lease of this duration, so that they are removed unless
+     * renewed by their owner
+     * \return Number of restored services
+     * \throws InvalidSnapshot if the file is not a valid snapshot
+     */
+    virtual size_t restoreSnapshot(const std::string& filename, const base::Time& leaseDuration = base::Time());
+
+    /**
+     * Register the given services which are not registered yet in a single
+     * modification
+     * \param entries Services to restore
+     * \param leaseDuration If not null, the restored services are registered
+     * with a lease of this duration
+     * \return Number of restored services
+     */
+    virtual size_t restore(const ServiceDirectoryList& entries, const base::Time& leaseDuration = base::Time());
+
+    /**
+     * Merge the update list into the service directory and remove all
+     * existing entries where the field has one of the given values
+     *
+     * The merge is applied as a single transaction, i.e. either all changes
+     * are applied at once or none.
+     * \param updateList list of services selected to update the existing one
+     * \param selectiveMerge Field by which entries are identified for removal
+     * \param fieldValues Values of the field which identify the entries for removal
+     * \throws DuplicateEntry if the update list contains an entry twice or an
+     * entry of the update list exists but is not identified for removal
+     */
+    virtual void mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field selectiveMerge, const std::set<std::string>& fieldValues);
+
+protected:
     /**
      * Extract the unique fields
      * \param list List of entries
@@ -116,12 +414,65 @@ private:
     static std::set<std::string> getUniqueFieldValues(const ServiceDirectoryList& list, ServiceDirectoryEntry::Field field);
 
     /**
-     * Clear the service directory selectively, i.e. for field that match the given
-     * regex
-     * \param regex Regular expression to match
-     * \param field Field that the regex should be applied on
+     * Register or replace the given entries and remove the entries of the
+     * given names in a single modification, e.g. to apply the state of
+     * another directory
+     * Requires mMutex to be held
+     * \details The changes are published with a single version. Replaced and
+     * removed entries lose their lease, names which are not registered are
+     * ignored for removal
+     * \param updates Entries of distinct names to register, or to replace the
+     * entry of the same name
+     * \param removals Names of the entries to remove
+     */
+    void apply(const ServiceDirectoryList& updates, const std::vector<Name>& removals);
+
+private:
+    /**
+     * Get the index for reading, in mode LOCKING the given lock will be
+     * acquired
+     * \param lock Lock that needs to remain in scope while the index is
+     * accessed
      */
-    void clearSelectively(const std::string& regex, ServiceDirectoryEntry::Field field);
+    ServiceDirectoryIndex::ConstPtr read(boost::shared_lock<boost::shared_mutex>& lock) const;
+
+    /**
+     * Apply a modification to the index according to the concurrency mode
+     * Requires mMutex to be held
+     * \param modification Function that modifies the index and returns
+     * false if nothing has been modified
+     * \return result of the modification function
+     */
+    bool update(const std::function<bool (ServiceDirectoryIndex&)>& modification);
+
+    /**
+     * Add an entry to the index
+     * Requires mMutex to be held
+     * \param expiry If not null, the lease expiry of the entry in the index,
+     * which has to be scheduled via scheduleLease as well
+     * \throws DuplicateEntry
+     */
+    void add(const ServiceDirectoryEntry& entry, const base::Time& expiry = base::Time());
+
+    /**
+     * Remove the services with an expired lease
+     * Requires mMutex to be held
+     * \return Number of removed services
+     */
+    size_t removeExpired(const base::Time& now);
+
+    /**
+     * Schedule the lease expiry of a service and update the expiry in the
+     * index, which has to hold a lease for the service already
+     * Requires mMutex to be held
+     */
+    void scheduleLease(const Name& name, const base::Time& expiry);
+
+    /**
+     * Copy the matching entries into a result list
+     */
+    static ServiceDirectoryList toList(const ServiceDirectoryIndex::Matches& matches);
+
 };
 
 } // end namespace services
@@ -0,0 +1,176 @@
+#include "ServiceDirectoryChangeFeed.hpp"
+#include "ErrorHandling.hpp"
+#include "RegexCache.hpp"
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+
+namespace fipa {
+namespace services {
+
+bool ServiceDirectoryChange::matches(const std::string& regex, ServiceDirectoryEntry::Field field) const
+{
+    RegexCache::RegexPtr r = RegexCache::getInstance().get(regex);
+    if(boost::regex_match(entry.getFieldContent(field), *r))
+    {
+        return true;
+    }
+    return type == MODIFIED && boost::regex_match(previous.getFieldContent(field), *r);
+}
+
+ServiceDirectoryChangeFeed::ServiceDirectoryChangeFeed(size_t historyCapacity)
+    : mVersion(0)
+    , mHistoryCapacity(historyCapacity)
+    , mNextSubscriptionId(0)
+{
+}
+
+uint64_t ServiceDirectoryChangeFeed::getVersion() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mVersion;
+}
+
+uint64_t ServiceDirectoryChangeFeed::publish(ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry, const ServiceDirectoryEntry& previous)
+{
+    ServiceDirectoryChange change;
+    change.type = type;
+    change.entry = entry;
+    if(type == ServiceDirectoryChange::MODIFIED)
+    {
+        change.previous = previous;
+    }
+    return publish(ServiceDirectoryChangeList(1, change));
+}
+
+uint64_t ServiceDirectoryChangeFeed::publish(ServiceDirectoryChangeList changes)
+{
+    boost::unique_lock<boost::recursive_mutex> notificationLock(mNotificationMutex);
+
+    // Matching subscriptions per change, in the order of the changes
+    std::vector< std::pair<size_t, ServiceDirectoryChangeCallback> > notifications;
+    uint64_t version;
+    {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        if(changes.empty())
+        {
+            return mVersion;
+        }
+
+        version = ++mVersion;
+        for(size_t i = 0; i < changes.size(); ++i)
+        {
+            ServiceDirectoryChange& change = changes[i];
+            change.version = version;
+            if(change.type != ServiceDirectoryChange::MODIFIED)
+            {
+                change.previous = ServiceDirectoryEntry();
+            }
+            mHistory.push_back(change);
+
+            Subscriptions::const_iterator cit = mSubscriptions.begin();
+            for(; cit != mSubscriptions.end(); ++cit)
+            {
+                if(change.matches(cit->second.regex, cit->second.field))
+                {
+                    notifications.push_back(std::make_pair(i, cit->second.callback));
+                }
+            }
+        }
+        shrink();
+    }
+
+    // Callbacks are called without holding mMutex, so that they can
+    // (un)subscribe
+    std::vector< std::pair<size_t, ServiceDirectoryChangeCallback> >::const_iterator cit = notifications.begin();
+    for(; cit != notifications.end(); ++cit)
+    {
+        cit->second(changes[cit->first]);
+    }
+    return version;
+}
+
+ServiceDirectoryChangeFeed::SubscriptionId ServiceDirectoryChangeFeed::subscribe(const ServiceDirectoryChangeCallback& callback, const std::string& regex, ServiceDirectoryEntry::Field field)
+{
+    // Validate the regular expression upfront
+    RegexCache::getInstance().get(regex);
+
+    Subscription subscription;
+    subscription.callback = callback;
+    subscription.regex = regex;
+    subscription.field = field;
+
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    SubscriptionId id = mNextSubscriptionId++;
+    mSubscriptions[id] = subscription;
+    return id;
+}
+
+void ServiceDirectoryChangeFeed::unsubscribe(SubscriptionId id)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        if(!mSubscriptions.erase(id))
+        {
+            throw NotFound("Subscription " + boost::lexical_cast<std::string>(id));
+        }
+    }
+    // A publication in progress might still call the callback, wait for it
+    // unless it is the calling thread
+    boost::unique_lock<boost::recursive_mutex> notificationLock(mNotificationMutex);
+}
+
+bool ServiceDirectoryChangeFeed::getChanges(uint64_t version, ServiceDirectoryChangeList& changes, const std::string& regex, ServiceDirectoryEntry::Field field) const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    if(version >= mVersion)
+    {
+        return true;
+    }
+
+    // Versions in the history are consecutive, check whether the changes
+    // following the given version are still available
+    if(mHistory.empty() || version + 1 < mHistory.front().version)
+    {
+        return false;
+    }
+
+    std::deque<ServiceDirectoryChange>::const_iterator cit = std::upper_bound(mHistory.begin(), mHistory.end(), version,
+            [](uint64_t v, const ServiceDirectoryChange& change) { return v < change.version; });
+    for(; cit != mHistory.end(); ++cit)
+    {
+        if(cit->matches(regex, field))
+        {
+            changes.push_back(*cit);
+        }
+    }
+    return true;
+}
+
+size_t ServiceDirectoryChangeFeed::getHistoryCapacity() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mHistoryCapacity;
+}
+
+void ServiceDirectoryChangeFeed::setHistoryCapacity(size_t capacity)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mHistoryCapacity = capacity;
+    shrink();
+}
+
+void ServiceDirectoryChangeFeed::shrink()
+{
+    // The changes of a batch are dropped together
+    while(mHistory.size() > mHistoryCapacity && mHistory.front().version != mHistory.back().version)
+    {
+        uint64_t oldestVersion = mHistory.front().version;
+        while(!mHistory.empty() && mHistory.front().version == oldestVersion)
+        {
+            mHistory.pop_front();
+        }
+    }
+}
+
+} // end namespace services
+} // end namespace fipa
@@ -0,0 +1,169 @@
+#ifndef FIPA_SERVICES_SERVICE_DIRECTORY_CHANGE_FEED_HPP
+#define FIPA_SERVICES_SERVICE_DIRECTORY_CHANGE_FEED_HPP
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <stdint.h>
+#include <boost/thread.hpp>
+#include <fipa_services/ServiceDirectoryEntry.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class ServiceDirectoryChange
+ * \brief Single modification of a service directory
+ */
+struct ServiceDirectoryChange
+{
+    enum Type { ADDED = 0, REMOVED, MODIFIED };
+
+    /// Version of the directory after this change has been applied, the
+    /// changes of a single modification of several entries share the version
+    uint64_t version;
+    Type type;
+    /// Added or modified entry, or the entry that has been removed
+    ServiceDirectoryEntry entry;
+    /// Entry before the modification, only set for MODIFIED
+    ServiceDirectoryEntry previous;
+
+    /**
+     * Check whether the change affects an entry where the field matches the
+     * given regular expression, for modifications the previous entry is
+     * considered as well
+     */
+    bool matches(const std::string& regex, ServiceDirectoryEntry::Field field) const;
+};
+
+typedef std::vector<ServiceDirectoryChange> ServiceDirectoryChangeList;
+typedef std::function<void (const ServiceDirectoryChange&)> ServiceDirectoryChangeCallback;
+
+/**
+ * \class ServiceDirectoryChangeFeed
+ * \brief Versioned log of the changes of a service directory
+ * \details Each published change increments the version of the feed, while
+ * the changes of a batch, i.e. a single modification of several entries,
+ * share one version. Changes can either be pushed to subscribed callbacks or
+ * pulled with getChanges, where the version of the last change that has
+ * been seen acts as cursor. Only the changes of the latest versions are
+ * retained, a consumer which falls behind is told to resynchronize with the
+ * full directory content.
+ *
+ * Subscribers are called in version order by the thread that publishes the
+ * change. Callbacks may subscribe and unsubscribe, but must not modify the
+ * service directory they are subscribed to.
+ *
+ * The feed is thread-safe.
+ */
+class ServiceDirectoryChangeFeed
+{
+public:
+    typedef uint64_t SubscriptionId;
+
+    /**
+     * Constructor
+     * \param historyCapacity Maximum number of retained changes, see
+     * setHistoryCapacity
+     */
+    ServiceDirectoryChangeFeed(size_t historyCapacity = 1024);
+
+    /**
+     * Get the current version, i.e. the version of the latest change, 0 if
+     * nothing has been published yet
+     */
+    uint64_t getVersion() const;
+
+    /**
+     * Publish a change
+     * \param type Type of change
+     * \param entry Added or modified entry, or the removed entry
+     * \param previous Entry before a modification
+     * \return Version of the change
+     */
+    uint64_t publish(ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry, const ServiceDirectoryEntry& previous = ServiceDirectoryEntry());
+
+    /**
+     * Publish the changes of a single modification with one version
+     * \param changes Changes, where the versions are set by the feed
+     * \return Version of the changes, the current version if the batch is
+     * empty
+     */
+    uint64_t publish(ServiceDirectoryChangeList changes);
+
+    /**
+     * Subscribe to all changes where the field matches the given regular
+     * expression
+     * \param callback Function called for each matching change
+     * \param regex Regular expression
+     * \param field Field the regular expression is applied to
+     * \return Id of the subscription
+     */
+    SubscriptionId subscribe(const ServiceDirectoryChangeCallback& callback, const std::string& regex = ".*", ServiceDirectoryEntry::Field field = ServiceDirectoryEntry::NAME);
+
+    /**
+     * Cancel a subscription
+     * \details Waits until callbacks which are being called by other threads
+     * have returned, so that the callback can be destroyed afterwards. Must
+     * therefore not be called while holding a lock the callback acquires.
+     * \throws NotFound if the subscription does not exist
+     */
+    void unsubscribe(SubscriptionId id);
+
+    /**
+     * Get all changes after the given version where the field matches the
+     * given regular expression
+     * \param version Version of the last change that has been seen
+     * \param changes Resulting changes in version order
+     * \param regex Regular expression
+     * \param field Field the regular expression is applied to
+     * \return false if changes after the given version are no longer
+     * retained, so that the consumer needs to resynchronize, true otherwise
+     */
+    bool getChanges(uint64_t version, ServiceDirectoryChangeList& changes, const std::string& regex = ".*", ServiceDirectoryEntry::Field field = ServiceDirectoryEntry::NAME) const;
+
+    /**
+     * Get the maximum number of retained changes
+     */
+    size_t getHistoryCapacity() const;
+
+    /**
+     * Set the maximum number of retained changes
+     * \details The changes of the oldest versions are dropped as a whole,
+     * the changes of the latest version are always retained even if they
+     * exceed the capacity
+     */
+    void setHistoryCapacity(size_t capacity);
+
+private:
+    struct Subscription
+    {
+        ServiceDirectoryChangeCallback callback;
+        std::string regex;
+        ServiceDirectoryEntry::Field field;
+    };
+
+    typedef std::map<SubscriptionId, Subscription> Subscriptions;
+
+    /**
+     * Drop the oldest versions until the history capacity is met
+     * Requires mMutex to be held
+     */
+    void shrink();
+
+    mutable boost::mutex mMutex;
+    // Serializes the notification of subscribers, so that they receive
+    // changes in version order. Recursive, since callbacks may unsubscribe
+    boost::recursive_mutex mNotificationMutex;
+
+    uint64_t mVersion;
+    size_t mHistoryCapacity;
+    std::deque<ServiceDirectoryChange> mHistory;
+
+    SubscriptionId mNextSubscriptionId;
+    Subscriptions mSubscriptions;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_SERVICE_DIRECTORY_CHANGE_FEED_HPP
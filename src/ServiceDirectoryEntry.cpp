@@ -14,16 +14,51 @@ std::map<ServiceDirectoryEntry::Field, std::string> ServiceDirectoryEntry::Field
 };
 
 ServiceDirectoryEntry::ServiceDirectoryEntry()
+    : mData(new Data())
 {}
 
 ServiceDirectoryEntry::ServiceDirectoryEntry(const Name& name, const Type& type, const ServiceLocator& locator, const Description& description)
-    : mName(name)
-    , mType(type)
-    , mLocator(locator)
-    , mDescription(description)
-    , mTimestamp( base::Time::now() )
+    : mData(new Data())
+{
+    mData->name = name;
+    mData->type = type;
+    mData->locator = locator;
+    mData->description = description;
+    mData->timestamp = base::Time::now();
+}
+
+ServiceDirectoryEntry::ServiceDirectoryEntry(const ServiceDirectoryEntry& other)
+    : mData(other.mData)
 {}
 
+ServiceDirectoryEntry& ServiceDirectoryEntry::operator=(const ServiceDirectoryEntry& other)
+{
+    mData = other.mData;
+    return *this;
+}
+
+ServiceDirectoryEntry::Data& ServiceDirectoryEntry::modifiable()
+{
+    if(mData.use_count() > 1)
+    {
+        mData.reset(new Data(*mData));
+    }
+    return *mData;
+}
+
+bool ServiceDirectoryEntry::hasSameContent(const ServiceDirectoryEntry& other) const
+{
+    if(mData == other.mData)
+    {
+        return true;
+    }
+    return mData->name == other.mData->name
+        && mData->type == other.mData->type
+        && mData->description == other.mData->description
+        && mData->timestamp == other.mData->timestamp
+        && mData->locator.getLocations() == other.mData->locator.getLocations();
+}
+
 std::string ServiceDirectoryEntry::getFieldContent(ServiceDirectoryEntry::Field field) const
 {
     switch(field)
@@ -45,19 +80,19 @@ void ServiceDirectoryEntry::setFieldContent(ServiceDirectoryEntry::Field field,
         switch(field)
         {
             case NAME:
-                mName = content;
+                modifiable().name = content;
                 break;
             case TYPE:
-                mType = content;
+                modifiable().type = content;
                 break;
             case LOCATOR:
-                mLocator = ServiceLocator::fromString(content);
+                modifiable().locator = ServiceLocator::fromString(content);
                 break;
             case DESCRIPTION:
-                mDescription = content;
+                modifiable().description = content;
                 break;
             case TIMESTAMP:
-                mTimestamp = base::Time::fromString(content);
+                modifiable().timestamp = base::Time::fromString(content);
                 break;
             default:
                 assert(-1);
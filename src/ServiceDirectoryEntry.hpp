@@ -3,9 +3,12 @@
 
 #include <vector>
 #include <map>
+#include <memory>
+#include <functional>
 #include <string>
 #include <base/Time.hpp>
 #include <fipa_services/ServiceLocator.hpp>
+#include <fipa_services/InternedString.hpp>
 
 namespace fipa {
 namespace services {
@@ -19,14 +22,33 @@ typedef std::string Description;
 /**
  * \class ServiceDirectoryEntry
  * \brief The entry definition for a service directory, containing name, type, locator and description
+ * \details The content of an entry is shared between copies and is only
+ * duplicated when a copy is modified. Hence, copying entries, e.g. into
+ * search results, is cheap. Type and description are interned, since they
+ * usually repeat across many entries.
  */
 class ServiceDirectoryEntry
 {
-    Name mName;
-    Type mType;
-    ServiceLocator mLocator;
-    Description mDescription;
-    base::Time mTimestamp;
+    struct Data
+    {
+        Name name;
+        InternedString type;
+        ServiceLocator locator;
+        InternedString description;
+        base::Time timestamp;
+    };
+
+    // Shared content, which must not be modified while shared with other
+    // entries, see modifiable()
+    std::shared_ptr<Data> mData;
+
+    /**
+     * Get the content for modification, i.e. detach from
+     * other entries that share the content
+     */
+    Data& modifiable();
+
+    friend class ServiceDirectoryEntryView;
 
 public:
 
@@ -37,36 +59,43 @@ public:
 
     ServiceDirectoryEntry(const Name& name, const Type& type, const ServiceLocator& locator, const Description& description);
 
+    // Entries are copy-only: copying just shares the content, while an
+    // implicit move would leave the moved-from entry without content
+    ServiceDirectoryEntry(const ServiceDirectoryEntry& other);
+    ServiceDirectoryEntry& operator=(const ServiceDirectoryEntry& other);
+
     // Setter and getter for properties
-    Name getName() const { return mName; }
+    const Name& getName() const { return mData->name; }
 
-    void setName(const Name& name) { mName = name; }
+    void setName(const Name& name) { modifiable().name = name; }
 
     /**
      * The signature type
      */
-    Type getType() const { return mType; }
+    const Type& getType() const { return mData->type; }
 
-    void setType(const Type& type) { mType = type; }
+    void setType(const Type& type) { modifiable().type = type; }
 
     /**
      * Get locator
      */
-    ServiceLocator getLocator() const { return mLocator; }
+    const ServiceLocator& getLocator() const { return mData->locator; }
 
-    void setLocator(const ServiceLocator& locator) { mLocator = locator; }
+    void setLocator(const ServiceLocator& locator) { modifiable().locator = locator; }
 
-    Description getDescription() const { return mDescription; }
+    const Description& getDescription() const { return mData->description; }
 
-    void setDescription(const Description& description) { mDescription = description; }
+    void setDescription(const Description& description) { modifiable().description = description; }
 
-    base::Time getTimestamp() const { return mTimestamp; }
+    const base::Time& getTimestamp() const { return mData->timestamp; }
+
+    void setTimestamp(const base::Time& timestamp) { modifiable().timestamp = timestamp; }
 
     /**
      * Update the modification times of this
      * entry
      */
-    void updateTimestamp() { mTimestamp = base::Time::now(); }
+    void updateTimestamp() { modifiable().timestamp = base::Time::now(); }
 
     /**
      * Get the string content of field based on the field identifier
@@ -83,7 +112,12 @@ public:
     /**
      * Comparison operator to allow usage as map key
      */
-    bool operator<(const ServiceDirectoryEntry& other) const { return this->getName() < other.getName(); }
+    bool operator<(const ServiceDirectoryEntry& other) const { return mData->name < other.mData->name; }
+
+    /**
+     * Check whether all fields, including the timestamp, are equal
+     */
+    bool hasSameContent(const ServiceDirectoryEntry& other) const;
 
     /**
      * Convert to string representations
@@ -96,6 +130,10 @@ public:
 typedef std::vector<ServiceDirectoryEntry> ServiceDirectoryList;
 typedef std::map<Name, ServiceDirectoryEntry> ServiceDirectoryMap;
 
+/// Visitor for entries of a service directory
+/// return false to stop the iteration
+typedef std::function<bool (const ServiceDirectoryEntry&)> ServiceDirectoryVisitor;
+
 } // end namespace services
 } // end namespace fipa
 
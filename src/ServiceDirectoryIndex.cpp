@@ -0,0 +1,863 @@
+#include "ServiceDirectoryIndex.hpp"
+#include "RegexCache.hpp"
+#include <algorithm>
+
+namespace fipa {
+namespace services {
+
+ServiceDirectoryIndex::ServiceDirectoryIndex(const ServiceDirectoryIndex& other)
+    : mServices(other.mServices)
+    , mLeases(other.mLeases)
+{
+    rebuildNameIndex();
+    copyIndices(other);
+}
+
+ServiceDirectoryIndex& ServiceDirectoryIndex::operator=(const ServiceDirectoryIndex& other)
+{
+    if(this != &other)
+    {
+        mServices = other.mServices;
+        mLeases = other.mLeases;
+        rebuildNameIndex();
+        copyIndices(other);
+    }
+    return *this;
+}
+
+void ServiceDirectoryIndex::rebuildNameIndex()
+{
+    // The name index refers to the nodes of the own map
+    mNameIndex.clear();
+    mNameIndex.reserve(mServices.size());
+    ServiceDirectoryMap::iterator it = mServices.begin();
+    for(; it != mServices.end(); ++it)
+    {
+        mNameIndex[&it->first] = it;
+    }
+}
+
+void ServiceDirectoryIndex::copyIndices(const ServiceDirectoryIndex& other)
+{
+    // Both maps have the same order, so that the nodes of the other index
+    // are mapped to the own nodes by walking both in parallel
+    NodeMapping nodes;
+    nodes.reserve(mServices.size());
+    ServiceDirectoryMap::const_iterator oit = other.mServices.begin();
+    ServiceDirectoryMap::const_iterator it = mServices.begin();
+    for(; it != mServices.end(); ++it, ++oit)
+    {
+        nodes[&*oit] = &*it;
+    }
+
+    copyIndex(other.mTypeIndex, mTypeIndex, nodes);
+    copyIndex(other.mLocatorIndex, mLocatorIndex, nodes);
+    mLocationIndices.clear();
+    std::map<ServiceLocation::Field, FieldIndex>::const_iterator cit = other.mLocationIndices.begin();
+    for(; cit != other.mLocationIndices.end(); ++cit)
+    {
+        copyIndex(cit->second, mLocationIndices[cit->first], nodes);
+    }
+}
+
+void ServiceDirectoryIndex::copyIndex(const FieldIndex& from, FieldIndex& to, const NodeMapping& nodes)
+{
+    // Values and services are copied in order, so that all insertions at the
+    // end are O(1)
+    to.clear();
+    FieldIndex::const_iterator cit = from.begin();
+    for(; cit != from.end(); ++cit)
+    {
+        Services& services = to.insert(to.end(), std::make_pair(cit->first, Services()))->second;
+        Services::const_iterator sit = cit->second.begin();
+        for(; sit != cit->second.end(); ++sit)
+        {
+            services.insert(services.end(), nodes.find(*sit)->second);
+        }
+    }
+}
+
+bool ServiceDirectoryIndex::insert(const ServiceDirectoryEntry& entry)
+{
+    std::pair<ServiceDirectoryMap::iterator, bool> result = mServices.insert(std::make_pair(entry.getName(), entry));
+    if(!result.second)
+    {
+        return false;
+    }
+    mNameIndex[&result.first->first] = result.first;
+    addToIndices(*result.first);
+    return true;
+}
+
+size_t ServiceDirectoryIndex::insert(const ServiceDirectoryList& entries)
+{
+    mNameIndex.reserve(mServices.size() + entries.size());
+    size_t inserted = 0;
+    ServiceDirectoryMap::iterator hint = mServices.end();
+    ServiceDirectoryList::const_iterator cit = entries.begin();
+    for(; cit != entries.end(); ++cit)
+    {
+        const Name& name = cit->getName();
+        if(mNameIndex.count(&name))
+        {
+            continue;
+        }
+        // Inserting before the hint is O(1) for entries in name order
+        hint = mServices.insert(hint, std::make_pair(name, *cit));
+        mNameIndex[&hint->first] = hint;
+        addToIndices(*hint);
+        ++hint;
+        ++inserted;
+    }
+    return inserted;
+}
+
+bool ServiceDirectoryIndex::erase(const Name& name)
+{
+    NameIndex::iterator it = mNameIndex.find(&name);
+    if(it == mNameIndex.end())
+    {
+        return false;
+    }
+    // The key of the name index refers to the node, so it is erased first
+    ServiceDirectoryMap::iterator service = it->second;
+    removeFromIndices(*service);
+    mLeases.erase(name);
+    mNameIndex.erase(it);
+    mServices.erase(service);
+    return true;
+}
+
+bool ServiceDirectoryIndex::replace(const ServiceDirectoryEntry& entry)
+{
+    NameIndex::iterator it = mNameIndex.find(&entry.getName());
+    if(it == mNameIndex.end())
+    {
+        return false;
+    }
+    removeFromIndices(*it->second);
+    it->second->second = entry;
+    addToIndices(*it->second);
+    return true;
+}
+
+void ServiceDirectoryIndex::setLease(const Name& name, const base::Time& expiry)
+{
+    if(!renewLease(name, expiry))
+    {
+        mLeases[name] = LeaseExpiry(new boost::atomic<int64_t>(expiry.toMicroseconds()));
+    }
+}
+
+bool ServiceDirectoryIndex::renewLease(const Name& name, const base::Time& expiry) const
+{
+    std::unordered_map<Name, LeaseExpiry>::const_iterator cit = mLeases.find(name);
+    if(cit == mLeases.end())
+    {
+        return false;
+    }
+    cit->second->store(expiry.toMicroseconds());
+    return true;
+}
+
+bool ServiceDirectoryIndex::cancelLease(const Name& name)
+{
+    return mLeases.erase(name) > 0;
+}
+
+bool ServiceDirectoryIndex::isExpired(const Name& name, const base::Time& now) const
+{
+    std::unordered_map<Name, LeaseExpiry>::const_iterator cit = mLeases.find(name);
+    return cit != mLeases.end() && cit->second->load() <= now.toMicroseconds();
+}
+
+std::vector<Name> ServiceDirectoryIndex::getExpired(const base::Time& now) const
+{
+    std::vector<Name> expired;
+    std::unordered_map<Name, LeaseExpiry>::const_iterator cit = mLeases.begin();
+    for(; cit != mLeases.end(); ++cit)
+    {
+        if(cit->second->load() <= now.toMicroseconds())
+        {
+            expired.push_back(cit->first);
+        }
+    }
+    return expired;
+}
+
+const ServiceDirectoryEntry* ServiceDirectoryIndex::find(const Name& name) const
+{
+    NameIndex::const_iterator cit = mNameIndex.find(&name);
+    if(cit != mNameIndex.end())
+    {
+        return &cit->second->second;
+    }
+    return NULL;
+}
+
+ServiceDirectoryIndex::Matches ServiceDirectoryIndex::match(const std::string& regex, ServiceDirectoryEntry::Field field, size_t limit) const
+{
+    Matches matches;
+    Services services;
+    switch(field)
+    {
+        case ServiceDirectoryEntry::NAME:
+        {
+            std::string name;
+            if(isLiteral(regex, name))
+            {
+                const ServiceDirectoryEntry* entry = find(name);
+                if(entry)
+                {
+                    matches.push_back(entry);
+                }
+                return matches;
+            }
+
+            std::string residual;
+            if(splitLiteralPrefix(regex, name, residual))
+            {
+                // Only the range of names with the prefix is checked
+                RegexCache::RegexPtr r = compileResidual(residual);
+                ServiceDirectoryMap::const_iterator cit = mServices.lower_bound(name);
+                for(; cit != mServices.end() && cit->first.compare(0, name.size(), name) == 0; ++cit)
+                {
+                    if(matchResidual(cit->first, name.size(), r))
+                    {
+                        matches.push_back(&cit->second);
+                        if(limit != 0 && matches.size() >= limit)
+                        {
+                            break;
+                        }
+                    }
+                }
+                return matches;
+            }
+            break;
+        }
+        case ServiceDirectoryEntry::TYPE:
+            collect(mTypeIndex, regex, services);
+            return resolve(services, limit);
+        case ServiceDirectoryEntry::LOCATOR:
+            collect(mLocatorIndex, regex, services);
+            return resolve(services, limit);
+        default:
+            break;
+    }
+
+    // Fields without an index require a full scan
+    RegexCache::RegexPtr r = RegexCache::getInstance().get(regex);
+    ServiceDirectoryMap::const_iterator cit = mServices.begin();
+    for(; cit != mServices.end(); ++cit)
+    {
+        bool isMatch = false;
+        if(field == ServiceDirectoryEntry::NAME)
+        {
+            isMatch = boost::regex_match(cit->first, *r);
+        } else {
+            isMatch = boost::regex_match(cit->second.getFieldContent(field), *r);
+        }
+
+        if(isMatch)
+        {
+            matches.push_back(&cit->second);
+            if(limit != 0 && matches.size() >= limit)
+            {
+                break;
+            }
+        }
+    }
+    return matches;
+}
+
+ServiceDirectoryIndex::Matches ServiceDirectoryIndex::matchValues(const std::set<std::string>& values, ServiceDirectoryEntry::Field field) const
+{
+    const FieldIndex* index = NULL;
+    switch(field)
+    {
+        case ServiceDirectoryEntry::NAME:
+            return resolve(values);
+        case ServiceDirectoryEntry::TYPE:
+            index = &mTypeIndex;
+            break;
+        case ServiceDirectoryEntry::LOCATOR:
+            index = &mLocatorIndex;
+            break;
+        default:
+            break;
+    }
+
+    if(index)
+    {
+        Services services;
+        std::set<std::string>::const_iterator cit = values.begin();
+        for(; cit != values.end(); ++cit)
+        {
+            FieldIndex::const_iterator iit = index->find(*cit);
+            if(iit != index->end())
+            {
+                services.insert(iit->second.begin(), iit->second.end());
+            }
+        }
+        return resolve(services);
+    }
+
+    // Fields without an index require a single full scan
+    Matches matches;
+    ServiceDirectoryMap::const_iterator cit = mServices.begin();
+    for(; cit != mServices.end(); ++cit)
+    {
+        if(values.count(cit->second.getFieldContent(field)))
+        {
+            matches.push_back(&cit->second);
+        }
+    }
+    return matches;
+}
+
+ServiceDirectoryIndex::Matches ServiceDirectoryIndex::matchLocation(const std::string& regex, ServiceLocation::Field field) const
+{
+    Services services;
+    std::map<ServiceLocation::Field, FieldIndex>::const_iterator cit = mLocationIndices.find(field);
+    if(cit != mLocationIndices.end())
+    {
+        collect(cit->second, regex, services);
+    }
+    return resolve(services);
+}
+
+ServiceDirectoryIndex::Matches ServiceDirectoryIndex::match(const ServiceDirectoryQuery& query, size_t limit, const Name* after) const
+{
+    const ServiceDirectoryQuery::Predicates& predicates = query.getPredicates();
+
+    // Pick the predicate with the fewest candidates, a predicate is only
+    // counted as long as it could beat the best one so far
+    size_t best = predicates.size();
+    size_t bestEstimate = size();
+    for(size_t i = 0; i < predicates.size() && bestEstimate > 0; ++i)
+    {
+        size_t candidates = estimate(predicates[i], bestEstimate);
+        if(candidates < bestEstimate)
+        {
+            best = i;
+            bestEstimate = candidates;
+        }
+    }
+
+    Matches matches;
+    if(best == predicates.size())
+    {
+        ServiceDirectoryMap::const_iterator cit = after ? mServices.upper_bound(*after) : mServices.begin();
+        for(; cit != mServices.end(); ++cit)
+        {
+            if(query.matches(cit->second))
+            {
+                matches.push_back(&cit->second);
+                if(limit != 0 && matches.size() >= limit)
+                {
+                    break;
+                }
+            }
+        }
+        return matches;
+    }
+
+    // Candidates of the driving predicate are visited in name order, so
+    // that a page only touches the candidates up to its last match
+    forEachCandidate(predicates[best], after, [&query, best, limit, &matches](const ServiceDirectoryEntry& entry)
+        {
+            if(query.matches(entry, best))
+            {
+                matches.push_back(&entry);
+                return limit == 0 || matches.size() < limit;
+            }
+            return true;
+        });
+    return matches;
+}
+
+void ServiceDirectoryIndex::forEachCandidate(const ServiceDirectoryQuery::Predicate& predicate, const Name* after, const CandidateVisitor& visitor) const
+{
+    if(predicate.isLocation)
+    {
+        std::map<ServiceLocation::Field, FieldIndex>::const_iterator cit = mLocationIndices.find(predicate.locationField);
+        if(cit != mLocationIndices.end())
+        {
+            forEachCandidate(cit->second, predicate.regex, after, visitor);
+        }
+        return;
+    }
+
+    switch(predicate.field)
+    {
+        case ServiceDirectoryEntry::NAME:
+        {
+            std::string name;
+            if(isLiteral(predicate.regex, name))
+            {
+                const ServiceDirectoryEntry* entry = find(name);
+                if(entry && (!after || *after < name))
+                {
+                    visitor(*entry);
+                }
+                return;
+            }
+
+            std::string residual;
+            if(splitLiteralPrefix(predicate.regex, name, residual))
+            {
+                RegexCache::RegexPtr r = compileResidual(residual);
+                ServiceDirectoryMap::const_iterator cit = mServices.lower_bound(name);
+                if(after && name <= *after)
+                {
+                    cit = mServices.upper_bound(*after);
+                }
+                for(; cit != mServices.end() && cit->first.compare(0, name.size(), name) == 0; ++cit)
+                {
+                    if(matchResidual(cit->first, name.size(), r) && !visitor(cit->second))
+                    {
+                        return;
+                    }
+                }
+                return;
+            }
+            break;
+        }
+        case ServiceDirectoryEntry::TYPE:
+            forEachCandidate(mTypeIndex, predicate.regex, after, visitor);
+            return;
+        case ServiceDirectoryEntry::LOCATOR:
+            forEachCandidate(mLocatorIndex, predicate.regex, after, visitor);
+            return;
+        default:
+            break;
+    }
+
+    // Fields without an index require a scan
+    RegexCache::RegexPtr r = RegexCache::getInstance().get(predicate.regex);
+    ServiceDirectoryMap::const_iterator cit = after ? mServices.upper_bound(*after) : mServices.begin();
+    for(; cit != mServices.end(); ++cit)
+    {
+        const std::string& value = predicate.field == ServiceDirectoryEntry::NAME ? cit->first : cit->second.getFieldContent(predicate.field);
+        if(boost::regex_match(value, *r) && !visitor(cit->second))
+        {
+            return;
+        }
+    }
+}
+
+void ServiceDirectoryIndex::forEachCandidate(const FieldIndex& index, const std::string& regex, const Name* after, const CandidateVisitor& visitor)
+{
+    std::vector<const Services*> values;
+    collectValues(index, regex, values);
+
+    // Remaining services of each value, which are merged by name
+    typedef std::pair<Services::const_iterator, Services::const_iterator> Range;
+    std::vector<Range> ranges;
+    ranges.reserve(values.size());
+    Service probe(after ? *after : Name(), ServiceDirectoryEntry());
+    std::vector<const Services*>::const_iterator vit = values.begin();
+    for(; vit != values.end(); ++vit)
+    {
+        Services::const_iterator begin = after ? (*vit)->upper_bound(&probe) : (*vit)->begin();
+        if(begin != (*vit)->end())
+        {
+            ranges.push_back(Range(begin, (*vit)->end()));
+        }
+    }
+
+    // Min-heap on the name of the next service of each range
+    std::function<bool (const Range&, const Range&)> later = [](const Range& a, const Range& b)
+        {
+            return (*b.first)->first < (*a.first)->first;
+        };
+    std::make_heap(ranges.begin(), ranges.end(), later);
+    const Service* previous = NULL;
+    while(!ranges.empty())
+    {
+        std::pop_heap(ranges.begin(), ranges.end(), later);
+        Range& range = ranges.back();
+        const Service* service = *range.first;
+        if(++range.first == range.second)
+        {
+            ranges.pop_back();
+        } else {
+            std::push_heap(ranges.begin(), ranges.end(), later);
+        }
+
+        // A service is listed for several values if it has several
+        // locations, such duplicates are adjacent
+        if(service != previous)
+        {
+            previous = service;
+            if(!visitor(service->second))
+            {
+                return;
+            }
+        }
+    }
+}
+
+size_t ServiceDirectoryIndex::estimate(const ServiceDirectoryQuery::Predicate& predicate, size_t bound) const
+{
+    if(predicate.isLocation)
+    {
+        std::map<ServiceLocation::Field, FieldIndex>::const_iterator cit = mLocationIndices.find(predicate.locationField);
+        if(cit == mLocationIndices.end())
+        {
+            return 0;
+        }
+        return count(cit->second, predicate.regex, bound, size());
+    }
+
+    switch(predicate.field)
+    {
+        case ServiceDirectoryEntry::NAME:
+        {
+            std::string name;
+            if(isLiteral(predicate.regex, name))
+            {
+                return find(name) ? 1 : 0;
+            }
+
+            std::string residual;
+            if(splitLiteralPrefix(predicate.regex, name, residual))
+            {
+                size_t candidates = 0;
+                ServiceDirectoryMap::const_iterator cit = mServices.lower_bound(name);
+                for(; cit != mServices.end() && candidates < bound && cit->first.compare(0, name.size(), name) == 0; ++cit)
+                {
+                    ++candidates;
+                }
+                return candidates;
+            }
+            break;
+        }
+        case ServiceDirectoryEntry::TYPE:
+            return count(mTypeIndex, predicate.regex, bound, size());
+        case ServiceDirectoryEntry::LOCATOR:
+            return count(mLocatorIndex, predicate.regex, bound, size());
+        default:
+            break;
+    }
+    return size();
+}
+
+void ServiceDirectoryIndex::addToIndices(const Service& service)
+{
+    const ServiceDirectoryEntry& entry = service.second;
+    add(mTypeIndex, entry.getType(), &service);
+
+    const ServiceLocator& locator = entry.getLocator();
+    add(mLocatorIndex, locator.toString(), &service);
+
+    const ServiceLocations& locations = locator.getLocations();
+    ServiceLocations::const_iterator cit = locations.begin();
+    for(; cit != locations.end(); ++cit)
+    {
+        add(mLocationIndices[ServiceLocation::SIGNATURE_TYPE], cit->getSignatureType(), &service);
+        add(mLocationIndices[ServiceLocation::SERVICE_SIGNATURE], cit->getServiceSignature(), &service);
+        add(mLocationIndices[ServiceLocation::SERVICE_ADDRESS], cit->getServiceAddress(), &service);
+    }
+}
+
+void ServiceDirectoryIndex::removeFromIndices(const Service& service)
+{
+    const ServiceDirectoryEntry& entry = service.second;
+    remove(mTypeIndex, entry.getType(), &service);
+
+    const ServiceLocator& locator = entry.getLocator();
+    remove(mLocatorIndex, locator.toString(), &service);
+
+    const ServiceLocations& locations = locator.getLocations();
+    ServiceLocations::const_iterator cit = locations.begin();
+    for(; cit != locations.end(); ++cit)
+    {
+        remove(mLocationIndices[ServiceLocation::SIGNATURE_TYPE], cit->getSignatureType(), &service);
+        remove(mLocationIndices[ServiceLocation::SERVICE_SIGNATURE], cit->getServiceSignature(), &service);
+        remove(mLocationIndices[ServiceLocation::SERVICE_ADDRESS], cit->getServiceAddress(), &service);
+    }
+}
+
+void ServiceDirectoryIndex::add(FieldIndex& index, const std::string& value, const Service* service)
+{
+    // Entries are often added in name order, e.g. when restoring a snapshot,
+    // which makes the hint at the end an O(1) insertion
+    Services& services = index[value];
+    services.insert(services.end(), service);
+}
+
+void ServiceDirectoryIndex::remove(FieldIndex& index, const std::string& value, const Service* service)
+{
+    FieldIndex::iterator it = index.find(value);
+    if(it != index.end())
+    {
+        it->second.erase(service);
+        if(it->second.empty())
+        {
+            index.erase(it);
+        }
+    }
+}
+
+void ServiceDirectoryIndex::collect(const FieldIndex& index, const std::string& regex, Services& services)
+{
+    std::vector<const Services*> values;
+    collectValues(index, regex, values);
+    std::vector<const Services*>::const_iterator cit = values.begin();
+    for(; cit != values.end(); ++cit)
+    {
+        services.insert((*cit)->begin(), (*cit)->end());
+    }
+}
+
+void ServiceDirectoryIndex::collectValues(const FieldIndex& index, const std::string& regex, std::vector<const Services*>& values)
+{
+    std::string literal;
+    if(isLiteral(regex, literal))
+    {
+        FieldIndex::const_iterator cit = index.find(literal);
+        if(cit != index.end())
+        {
+            values.push_back(&cit->second);
+        }
+        return;
+    }
+
+    std::string residual;
+    if(splitLiteralPrefix(regex, literal, residual))
+    {
+        // Values with the same prefix are adjacent in the index
+        RegexCache::RegexPtr r = compileResidual(residual);
+        FieldIndex::const_iterator cit = index.lower_bound(literal);
+        for(; cit != index.end() && cit->first.compare(0, literal.size(), literal) == 0; ++cit)
+        {
+            if(matchResidual(cit->first, literal.size(), r))
+            {
+                values.push_back(&cit->second);
+            }
+        }
+    } else {
+        RegexCache::RegexPtr r = RegexCache::getInstance().get(regex);
+        FieldIndex::const_iterator cit = index.begin();
+        for(; cit != index.end(); ++cit)
+        {
+            if(boost::regex_match(cit->first, *r))
+            {
+                values.push_back(&cit->second);
+            }
+        }
+    }
+}
+
+ServiceDirectoryIndex::Matches ServiceDirectoryIndex::resolve(const Services& services, size_t limit)
+{
+    Matches matches;
+    matches.reserve(limit == 0 ? services.size() : std::min(limit, services.size()));
+    Services::const_iterator cit = services.begin();
+    for(; cit != services.end(); ++cit)
+    {
+        matches.push_back(&(*cit)->second);
+        if(limit != 0 && matches.size() >= limit)
+        {
+            break;
+        }
+    }
+    return matches;
+}
+
+ServiceDirectoryIndex::Matches ServiceDirectoryIndex::resolve(const std::set<Name>& names) const
+{
+    Matches matches;
+    matches.reserve(names.size());
+    std::set<Name>::const_iterator cit = names.begin();
+    for(; cit != names.end(); ++cit)
+    {
+        const ServiceDirectoryEntry* entry = find(*cit);
+        if(entry)
+        {
+            matches.push_back(entry);
+        }
+    }
+    return matches;
+}
+
+size_t ServiceDirectoryIndex::count(const FieldIndex& index, const std::string& regex, size_t bound, size_t unindexed)
+{
+    std::string literal;
+    if(isLiteral(regex, literal))
+    {
+        FieldIndex::const_iterator cit = index.find(literal);
+        return cit == index.end() ? 0 : cit->second.size();
+    }
+
+    std::string residual;
+    if(splitLiteralPrefix(regex, literal, residual))
+    {
+        size_t candidates = 0;
+        FieldIndex::const_iterator cit = index.lower_bound(literal);
+        for(; cit != index.end() && candidates < bound && cit->first.compare(0, literal.size(), literal) == 0; ++cit)
+        {
+            candidates += cit->second.size();
+        }
+        return std::min(candidates, unindexed);
+    }
+    return unindexed;
+}
+
+RegexCache::RegexPtr ServiceDirectoryIndex::compileResidual(const std::string& residual)
+{
+    // An empty residual or an anchor only matches names equal to the prefix
+    if(residual == ".*" || residual == ".*$")
+    {
+        return RegexCache::RegexPtr();
+    }
+    return RegexCache::getInstance().get(residual);
+}
+
+bool ServiceDirectoryIndex::matchResidual(const std::string& value, size_t prefixLength, const RegexCache::RegexPtr& residual)
+{
+    if(!residual)
+    {
+        return true;
+    }
+    // The prefix remains visible to anchors and word boundaries of the residual
+    return boost::regex_match(value.begin() + prefixLength, value.end(), *residual,
+            boost::match_default | boost::match_prev_avail);
+}
+
+bool ServiceDirectoryIndex::isLiteral(const std::string& regex, std::string& literal)
+{
+    static const std::string metaCharacters = "\\.^$|()[]{}*+?";
+
+    size_t start = 0;
+    size_t end = regex.size();
+    if(end > 0 && regex[0] == '^')
+    {
+        ++start;
+    }
+    // A trailing '$' is only an anchor if it is not escaped, i.e. preceded by
+    // an even number of backslashes
+    if(end > start && regex[end - 1] == '$')
+    {
+        size_t backslashes = 0;
+        while(end - 1 - backslashes > start && regex[end - 2 - backslashes] == '\\')
+        {
+            ++backslashes;
+        }
+        if(backslashes % 2 == 0)
+        {
+            --end;
+        }
+    }
+
+    std::string tmp;
+    tmp.reserve(end - start);
+    for(size_t i = start; i < end; ++i)
+    {
+        char c = regex[i];
+        if(c == '\\')
+        {
+            // Only escaped metacharacters are literals, escape sequences such
+            // as \d or \w are character classes
+            if(i + 1 < end && metaCharacters.find(regex[i+1]) != std::string::npos)
+            {
+                tmp += regex[++i];
+                continue;
+            }
+            return false;
+        } else if(metaCharacters.find(c) != std::string::npos)
+        {
+            return false;
+        }
+        tmp += c;
+    }
+    literal = tmp;
+    return true;
+}
+
+bool ServiceDirectoryIndex::isLiteralPrefix(const std::string& regex, std::string& prefix)
+{
+    std::string tmp = regex;
+    if(tmp.size() >= 3 && tmp.compare(tmp.size() - 3, 3, ".*$") == 0)
+    {
+        tmp.erase(tmp.size() - 1);
+    }
+
+    if(tmp.size() < 2 || tmp.compare(tmp.size() - 2, 2, ".*") != 0)
+    {
+        return false;
+    }
+    tmp.erase(tmp.size() - 2);
+    // An anchor in front of '.*' cannot be a prefix
+    if(!tmp.empty() && tmp[tmp.size() - 1] == '$')
+    {
+        return false;
+    }
+    // An escaped '.' would be a repetition of a literal '.', which is
+    // handled by isLiteral rejecting the dangling escape character
+    return isLiteral(tmp, prefix);
+}
+
+bool ServiceDirectoryIndex::splitLiteralPrefix(const std::string& regex, std::string& prefix, std::string& residual)
+{
+    static const std::string metaCharacters = "\\.^$|()[]{}*+?";
+    static const std::string quantifiers = "*+?{";
+
+    // An alternation at any level may match strings without the prefix
+    for(size_t i = 0; i < regex.size(); ++i)
+    {
+        if(regex[i] == '\\')
+        {
+            ++i;
+        } else if(regex[i] == '|')
+        {
+            return false;
+        }
+    }
+
+    size_t start = (!regex.empty() && regex[0] == '^') ? 1 : 0;
+    std::string tmp;
+    // Position of the last literal character in the regular expression
+    size_t last = start;
+    size_t i = start;
+    while(i < regex.size())
+    {
+        char c = regex[i];
+        if(c == '\\')
+        {
+            if(i + 1 < regex.size() && metaCharacters.find(regex[i+1]) != std::string::npos)
+            {
+                last = i;
+                tmp += regex[i+1];
+                i += 2;
+                continue;
+            }
+            break;
+        } else if(metaCharacters.find(c) != std::string::npos)
+        {
+            break;
+        }
+        last = i;
+        tmp += c;
+        ++i;
+    }
+
+    // A quantified character is not part of the prefix
+    if(i < regex.size() && quantifiers.find(regex[i]) != std::string::npos && !tmp.empty())
+    {
+        tmp.erase(tmp.size() - 1);
+        i = last;
+    }
+
+    if(tmp.empty())
+    {
+        return false;
+    }
+    prefix = tmp;
+    residual = regex.substr(i);
+    return true;
+}
+
+} // end namespace services
+} // end namespace fipa
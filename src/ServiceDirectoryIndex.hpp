@@ -0,0 +1,326 @@
+#ifndef FIPA_SERVICES_SERVICE_DIRECTORY_INDEX_HPP
+#define FIPA_SERVICES_SERVICE_DIRECTORY_INDEX_HPP
+
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <boost/atomic.hpp>
+#include <base/Time.hpp>
+#include <fipa_services/ServiceDirectoryEntry.hpp>
+#include <fipa_services/RegexCache.hpp>
+#include <fipa_services/ServiceDirectoryQuery.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class ServiceDirectoryIndex
+ * \brief Storage of service directory entries which is indexed by name, type and locator
+ * \details Entries are stored by name. Inverted indexes map the type, the
+ * stringified locator and the fields of each service location to the nodes
+ * of the entries. Literal and prefix queries on these fields thus only touch
+ * the matching entries, while other regular expressions are only matched
+ * against the distinct values of a field. Since names and field values are
+ * ordered, a regular expression starting with a literal prefix, e.g.
+ * 'robot_3\\..*', is only matched against the range of values with this
+ * prefix, using the residual of the regular expression.
+ * The index also holds the lease expiry of its entries, so that readers can
+ * skip entries with an expired lease which have not been removed yet.
+ * The index itself is not thread-safe, apart from renewing a lease.
+ */
+class ServiceDirectoryIndex
+{
+public:
+    typedef std::shared_ptr<ServiceDirectoryIndex> Ptr;
+    typedef std::shared_ptr<const ServiceDirectoryIndex> ConstPtr;
+
+    /// Entries resulting from a query, ordered by name
+    typedef std::vector<const ServiceDirectoryEntry*> Matches;
+
+    ServiceDirectoryIndex() {}
+
+    ServiceDirectoryIndex(const ServiceDirectoryIndex& other);
+
+    ServiceDirectoryIndex& operator=(const ServiceDirectoryIndex& other);
+
+    /**
+     * Insert an entry
+     * \return false if an entry of the same name already exists
+     */
+    bool insert(const ServiceDirectoryEntry& entry);
+
+    /**
+     * Insert multiple entries, which is most efficient for entries that
+     * are ordered by name
+     * \return Number of inserted entries, entries whose name already exists
+     * are skipped
+     */
+    size_t insert(const ServiceDirectoryList& entries);
+
+    /**
+     * Remove the entry of the given name together with its lease
+     * \return false if the entry does not exist
+     */
+    bool erase(const Name& name);
+
+    /**
+     * Replace an existing entry with the same name, the lease of the entry
+     * is kept
+     * \return false if the entry does not exist
+     */
+    bool replace(const ServiceDirectoryEntry& entry);
+
+    /**
+     * Set the lease expiry of an entry
+     * \param name Name of the entry
+     * \param expiry Time after which the entry is regarded as expired
+     */
+    void setLease(const Name& name, const base::Time& expiry);
+
+    /**
+     * Renew an existing lease
+     * \details The expiry of a lease is shared by all copies of the index,
+     * so that a lease can be renewed without copying the index. Unlike all
+     * other modifications this is safe while the index is being read
+     * \return false if no lease exists for this name
+     */
+    bool renewLease(const Name& name, const base::Time& expiry) const;
+
+    /**
+     * Remove the lease of an entry, the entry remains registered
+     * \return false if no lease exists for this name
+     */
+    bool cancelLease(const Name& name);
+
+    /**
+     * Check whether the lease of an entry has expired
+     * \return false if the lease has not expired or no lease exists
+     */
+    bool isExpired(const Name& name, const base::Time& now) const;
+
+    /**
+     * Get the names of all entries whose lease has expired
+     */
+    std::vector<Name> getExpired(const base::Time& now) const;
+
+    /**
+     * Check whether any entry has a lease
+     */
+    bool hasLeases() const { return !mLeases.empty(); }
+
+    /**
+     * Find an entry by name
+     * \return Pointer to the entry, NULL if the name is not registered
+     */
+    const ServiceDirectoryEntry* find(const Name& name) const;
+
+    /**
+     * Find all entries where the field matches the given regular
+     * expression
+     * \param regex Regular expression
+     * \param field Field the regex is applied to
+     * \param limit Maximum number of matches, 0 for no limit
+     * \return Matching entries
+     */
+    Matches match(const std::string& regex, ServiceDirectoryEntry::Field field, size_t limit = 0) const;
+
+    /**
+     * Find all entries where the content of the field is equal to one of the
+     * given values
+     * \param values Field values
+     * \param field Field the values are compared to
+     * \return Matching entries
+     */
+    Matches matchValues(const std::set<std::string>& values, ServiceDirectoryEntry::Field field) const;
+
+    /**
+     * Find all entries which have at least one location where the given
+     * location field matches the regular expression
+     * \param regex Regular expression
+     * \param field Field of the service location the regex is applied to
+     * \return Matching entries
+     */
+    Matches matchLocation(const std::string& regex, ServiceLocation::Field field) const;
+
+    /**
+     * Find all entries matching all predicates of the query
+     * \details The predicate with the lowest estimate drives the query via
+     * its index, the remaining predicates are checked on the resulting
+     * candidates only. Without any selective predicate all entries are
+     * checked in a single pass.
+     * \param query Query to evaluate
+     * \param limit Maximum number of matches, 0 for no limit
+     * \param after If not NULL, only entries with a name greater than this
+     * name are returned, which allows to resume a previous query
+     * \return Matching entries
+     */
+    Matches match(const ServiceDirectoryQuery& query, size_t limit = 0, const Name* after = NULL) const;
+
+    /**
+     * Estimate the number of candidates the index yields for a predicate
+     * \details Literals are counted exactly, literal prefixes are counted up
+     * to the given bound. All other predicates are estimated to require
+     * checking all entries, i.e. size()
+     * \param predicate Predicate to estimate
+     * \param bound Counting stops when this number has been reached
+     * \return Estimated number of candidates, at most size()
+     */
+    size_t estimate(const ServiceDirectoryQuery::Predicate& predicate, size_t bound) const;
+
+    /**
+     * Get all entries
+     */
+    const ServiceDirectoryMap& getEntries() const { return mServices; }
+
+    /**
+     * Get the number of entries
+     */
+    size_t size() const { return mServices.size(); }
+
+    /**
+     * Check whether a regular expression is a plain literal, i.e. does not
+     * contain any (unescaped) metacharacters apart from a leading '^'
+     * and a trailing '$'
+     * \param regex Regular expression to check
+     * \param literal String the regular expression matches (only set if the
+     * regular expression is literal)
+     * \return true if the regular expression is literal, false otherwise
+     */
+    static bool isLiteral(const std::string& regex, std::string& literal);
+
+    /**
+     * Check whether a regular expression matches all strings with a given
+     * literal prefix, i.e. is of the form 'prefix.*'
+     * \param regex Regular expression to check
+     * \param prefix Prefix the regular expression matches (only set if the
+     * regular expression is a literal prefix)
+     * \return true if the regular expression is a literal prefix, false otherwise
+     */
+    static bool isLiteralPrefix(const std::string& regex, std::string& prefix);
+
+    /**
+     * Split a regular expression into a literal prefix and the residual
+     * regular expression, e.g. 'robot_3\\..*planner' into 'robot_3.' and
+     * '.*planner'. A string matches the regular expression if it starts
+     * with the prefix and the remainder matches the residual.
+     * \param regex Regular expression to split
+     * \param prefix Literal prefix (only set if a prefix exists)
+     * \param residual Residual regular expression (only set if a prefix exists)
+     * \return true if the regular expression has a non-empty literal
+     * prefix, false otherwise, e.g. for alternations
+     */
+    static bool splitLiteralPrefix(const std::string& regex, std::string& prefix, std::string& residual);
+
+private:
+    /// Registered service, i.e. a node of mServices
+    typedef ServiceDirectoryMap::value_type Service;
+
+    struct ServiceOrder
+    {
+        bool operator()(const Service* a, const Service* b) const { return a->first < b->first; }
+    };
+
+    /// Services ordered by name, which refer to the nodes of mServices so
+    /// that names are not duplicated for each indexed value
+    typedef std::set<const Service*, ServiceOrder> Services;
+
+    /// Mapping of field values to the services
+    typedef std::map<std::string, Services> FieldIndex;
+
+    struct NameHash
+    {
+        size_t operator()(const Name* name) const { return std::hash<Name>()(*name); }
+    };
+
+    struct NameEqual
+    {
+        bool operator()(const Name* a, const Name* b) const { return *a == *b; }
+    };
+
+    /// Hash index whose keys refer to the names of the nodes of mServices
+    typedef std::unordered_map<const Name*, ServiceDirectoryMap::iterator, NameHash, NameEqual> NameIndex;
+
+    void addToIndices(const Service& service);
+    void removeFromIndices(const Service& service);
+    void rebuildNameIndex();
+
+    /// Mapping of the nodes of another index to the own nodes
+    typedef std::unordered_map<const Service*, const Service*> NodeMapping;
+
+    /**
+     * Copy the field indexes of another index, referring to the own nodes
+     * Requires mServices to be a copy of the services of the other index
+     */
+    void copyIndices(const ServiceDirectoryIndex& other);
+    static void copyIndex(const FieldIndex& from, FieldIndex& to, const NodeMapping& nodes);
+
+    static void add(FieldIndex& index, const std::string& value, const Service* service);
+    static void remove(FieldIndex& index, const std::string& value, const Service* service);
+
+    /**
+     * Collect the services for all field values matching the regex
+     */
+    static void collect(const FieldIndex& index, const std::string& regex, Services& services);
+
+    /**
+     * Collect the sets of services of all field values matching the regex
+     */
+    static void collectValues(const FieldIndex& index, const std::string& regex, std::vector<const Services*>& values);
+
+    typedef std::function<bool (const ServiceDirectoryEntry&)> CandidateVisitor;
+
+    /**
+     * Call the visitor for the entries matching the predicate in name order,
+     * starting after the given name, until it returns false
+     * \details Seeks the index of the predicate's field, so that only the
+     * visited candidates are touched
+     */
+    void forEachCandidate(const ServiceDirectoryQuery::Predicate& predicate, const Name* after, const CandidateVisitor& visitor) const;
+
+    /**
+     * Call the visitor for the services of all field values matching the
+     * regex in name order, starting after the given name, until it returns
+     * false
+     */
+    static void forEachCandidate(const FieldIndex& index, const std::string& regex, const Name* after, const CandidateVisitor& visitor);
+
+    /**
+     * Count the names for all field values matching the regex up to the given
+     * bound, or return unindexed if the regex does not use the index
+     */
+    static size_t count(const FieldIndex& index, const std::string& regex, size_t bound, size_t unindexed);
+
+    /**
+     * Compile the residual of a regular expression, a residual that matches
+     * everything, i.e. '.*', results in a null pointer
+     */
+    static RegexCache::RegexPtr compileResidual(const std::string& residual);
+
+    /**
+     * Check whether the part of the value following the prefix matches the
+     * residual regular expression, a null residual matches everything
+     */
+    static bool matchResidual(const std::string& value, size_t prefixLength, const RegexCache::RegexPtr& residual);
+
+    static Matches resolve(const Services& services, size_t limit = 0);
+    Matches resolve(const std::set<Name>& names) const;
+
+    /// Registered services
+    ServiceDirectoryMap mServices;
+    /// Hash index over the names of the registered services
+    NameIndex mNameIndex;
+
+    FieldIndex mTypeIndex;
+    FieldIndex mLocatorIndex;
+    /// Indexes per ServiceLocation::Field
+    std::map<ServiceLocation::Field, FieldIndex> mLocationIndices;
+
+    /// Lease expiry in microseconds, shared with copies of the index
+    typedef std::shared_ptr<boost::atomic<int64_t> > LeaseExpiry;
+    std::unordered_map<Name, LeaseExpiry> mLeases;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_SERVICE_DIRECTORY_INDEX_HPP
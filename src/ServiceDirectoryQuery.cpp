@@ -0,0 +1,97 @@
+#include "ServiceDirectoryQuery.hpp"
+#include <sstream>
+
+namespace fipa {
+namespace services {
+
+ServiceDirectoryQuery& ServiceDirectoryQuery::where(ServiceDirectoryEntry::Field field, const std::string& regex)
+{
+    Predicate predicate;
+    predicate.isLocation = false;
+    predicate.field = field;
+    predicate.locationField = ServiceLocation::SERVICE_ADDRESS;
+    predicate.regex = regex;
+    predicate.compiled = RegexCache::getInstance().get(regex);
+    mPredicates.push_back(predicate);
+    return *this;
+}
+
+ServiceDirectoryQuery& ServiceDirectoryQuery::whereLocation(ServiceLocation::Field field, const std::string& regex)
+{
+    Predicate predicate;
+    predicate.isLocation = true;
+    predicate.field = ServiceDirectoryEntry::LOCATOR;
+    predicate.locationField = field;
+    predicate.regex = regex;
+    predicate.compiled = RegexCache::getInstance().get(regex);
+    mPredicates.push_back(predicate);
+    return *this;
+}
+
+bool ServiceDirectoryQuery::matches(const ServiceDirectoryEntry& entry, size_t excluded) const
+{
+    for(size_t i = 0; i < mPredicates.size(); ++i)
+    {
+        if(i != excluded && !matches(entry, mPredicates[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ServiceDirectoryQuery::matches(const ServiceDirectoryEntry& entry, const Predicate& predicate)
+{
+    if(!predicate.isLocation)
+    {
+        // Stored fields are matched in place, without a copy
+        switch(predicate.field)
+        {
+            case ServiceDirectoryEntry::NAME: return boost::regex_match(entry.getName(), *predicate.compiled);
+            case ServiceDirectoryEntry::TYPE: return boost::regex_match(entry.getType(), *predicate.compiled);
+            case ServiceDirectoryEntry::DESCRIPTION: return boost::regex_match(entry.getDescription(), *predicate.compiled);
+            default: return boost::regex_match(entry.getFieldContent(predicate.field), *predicate.compiled);
+        }
+    }
+
+    const ServiceLocations& locations = entry.getLocator().getLocations();
+    ServiceLocations::const_iterator cit = locations.begin();
+    for(; cit != locations.end(); ++cit)
+    {
+        if(boost::regex_match(cit->getFieldContent(predicate.locationField), *predicate.compiled))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string ServiceDirectoryQuery::toString() const
+{
+    std::stringstream ss;
+    Predicates::const_iterator cit = mPredicates.begin();
+    for(; cit != mPredicates.end(); ++cit)
+    {
+        if(cit != mPredicates.begin())
+        {
+            ss << " AND ";
+        }
+
+        if(!cit->isLocation)
+        {
+            ss << ServiceDirectoryEntry::FieldTxt[cit->field];
+        } else {
+            switch(cit->locationField)
+            {
+                case ServiceLocation::SIGNATURE_TYPE: ss << "LOCATION.SIGNATURE_TYPE"; break;
+                case ServiceLocation::SERVICE_SIGNATURE: ss << "LOCATION.SERVICE_SIGNATURE"; break;
+                case ServiceLocation::SERVICE_ADDRESS: ss << "LOCATION.SERVICE_ADDRESS"; break;
+            }
+        }
+        ss << " matching '" << cit->regex << "'";
+    }
+    return ss.str();
+}
+
+} // end namespace services
+} // end namespace fipa
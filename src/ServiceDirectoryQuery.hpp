@@ -0,0 +1,104 @@
+#ifndef FIPA_SERVICES_SERVICE_DIRECTORY_QUERY_HPP
+#define FIPA_SERVICES_SERVICE_DIRECTORY_QUERY_HPP
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <fipa_services/ServiceDirectoryEntry.hpp>
+#include <fipa_services/RegexCache.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class ServiceDirectoryQuery
+ * \brief Conjunction of regular expressions on several fields of a service
+ * directory entry
+ * \details An entry matches the query if it matches all predicates. A
+ * predicate either applies to a field of the entry or to a field of the
+ * service locations, where at least one location has to match.
+ * Service directories use the most selective indexed predicate to find the
+ * candidates and check the remaining predicates in the same pass.
+ * \verbatim
+ #include <fipa_services/ServiceDirectoryQuery.hpp>
+
+ using namespace fipa::services;
+ ServiceDirectoryQuery query;
+ query.where(ServiceDirectoryEntry::TYPE, "planner")
+      .whereLocation(ServiceLocation::SERVICE_ADDRESS, "tcp://.*")
+      .where(ServiceDirectoryEntry::DESCRIPTION, ".*mts-0.*");
+
+ ServiceDirectoryList list = directory.searchByQuery(query, false);
+ \endverbatim
+ */
+class ServiceDirectoryQuery
+{
+public:
+    struct Predicate
+    {
+        /// Whether the predicate applies to the service locations
+        bool isLocation;
+        ServiceDirectoryEntry::Field field;
+        ServiceLocation::Field locationField;
+        std::string regex;
+        RegexCache::RegexPtr compiled;
+    };
+
+    typedef std::vector<Predicate> Predicates;
+
+    /**
+     * Add a predicate on a field of the entry
+     * \param field Field the regular expression is applied to
+     * \param regex Regular expression the field has to match
+     * \return this query
+     * \throws boost::regex_error if the regular expression is invalid
+     */
+    ServiceDirectoryQuery& where(ServiceDirectoryEntry::Field field, const std::string& regex);
+
+    /**
+     * Add a predicate on a field of the service locations, which is
+     * fulfilled if at least one location matches
+     * \param field Field of the service location the regular expression is
+     * applied to
+     * \param regex Regular expression the field has to match
+     * \return this query
+     * \throws boost::regex_error if the regular expression is invalid
+     */
+    ServiceDirectoryQuery& whereLocation(ServiceLocation::Field field, const std::string& regex);
+
+    /**
+     * Get all predicates in the order they have been added
+     */
+    const Predicates& getPredicates() const { return mPredicates; }
+
+    /**
+     * Check whether the query has no predicates, i.e. matches all entries
+     */
+    bool empty() const { return mPredicates.empty(); }
+
+    /**
+     * Check whether an entry fulfills all predicates
+     * \param entry Entry to check
+     * \param excluded Position of a predicate which is not checked, e.g.
+     * since it has been resolved by an index already
+     * \return true if the entry matches, false otherwise
+     */
+    bool matches(const ServiceDirectoryEntry& entry, size_t excluded = std::numeric_limits<size_t>::max()) const;
+
+    /**
+     * Check whether an entry fulfills a single predicate
+     */
+    static bool matches(const ServiceDirectoryEntry& entry, const Predicate& predicate);
+
+    /**
+     * Convert to string representation, e.g. for error messages
+     */
+    std::string toString() const;
+
+private:
+    Predicates mPredicates;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_SERVICE_DIRECTORY_QUERY_HPP
@@ -0,0 +1,264 @@
+#include "ServiceDirectorySnapshot.hpp"
+#include "ErrorHandling.hpp"
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fipa {
+namespace services {
+
+const char* const ServiceDirectorySnapshot::MAGIC = "FIPASDS";
+
+ServiceDirectorySnapshot::ServiceDirectorySnapshot(const std::string& filename)
+    : mMapping(NULL)
+    , mMappingSize(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        throw InvalidSnapshot("could not open '" + filename + "'");
+    }
+
+    struct stat fileStatus;
+    if(fstat(fd, &fileStatus) != 0 || (size_t) fileStatus.st_size < sizeof(Header))
+    {
+        close(fd);
+        throw InvalidSnapshot("'" + filename + "' is too small");
+    }
+
+    mMappingSize = fileStatus.st_size;
+    mMapping = mmap(NULL, mMappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping remains valid after closing the file
+    close(fd);
+    if(mMapping == MAP_FAILED)
+    {
+        mMapping = NULL;
+        throw InvalidSnapshot("could not map '" + filename + "'");
+    }
+
+    const char* data = static_cast<const char*>(mMapping);
+    mHeader = reinterpret_cast<const Header*>(data);
+    size_t expectedSize = sizeof(Header)
+        + (size_t) mHeader->numberOfEntries*sizeof(EntryRecord)
+        + (size_t) mHeader->numberOfLocations*sizeof(LocationRecord)
+        + (size_t) mHeader->blobSize;
+    if(memcmp(mHeader->magic, MAGIC, sizeof(mHeader->magic)) != 0
+            || mHeader->formatVersion != FORMAT_VERSION
+            || expectedSize != mMappingSize)
+    {
+        munmap(mMapping, mMappingSize);
+        mMapping = NULL;
+        throw InvalidSnapshot("'" + filename + "' is not a service directory snapshot of format version 1");
+    }
+
+    mEntries = reinterpret_cast<const EntryRecord*>(data + sizeof(Header));
+    mLocations = reinterpret_cast<const LocationRecord*>(mEntries + mHeader->numberOfEntries);
+    mBlob = reinterpret_cast<const char*>(mLocations + mHeader->numberOfLocations);
+}
+
+ServiceDirectorySnapshot::~ServiceDirectorySnapshot()
+{
+    if(mMapping)
+    {
+        munmap(mMapping, mMappingSize);
+    }
+}
+
+void ServiceDirectorySnapshot::write(const ServiceDirectoryIndex& index, const std::string& filename)
+{
+    const ServiceDirectoryMap& services = index.getEntries();
+    std::vector<EntryRecord> entries;
+    entries.reserve(services.size());
+    std::vector<LocationRecord> locations;
+    std::string blob;
+
+    struct Appender
+    {
+        std::string& blob;
+
+        StringRecord operator()(const std::string& value)
+        {
+            if(blob.size() + value.size() > std::numeric_limits<uint32_t>::max())
+            {
+                throw InvalidSnapshot("content exceeds the maximum size");
+            }
+            StringRecord record;
+            record.offset = blob.size();
+            record.length = value.size();
+            blob.append(value);
+            return record;
+        }
+    } append = { blob };
+
+    ServiceDirectoryMap::const_iterator cit = services.begin();
+    for(; cit != services.end(); ++cit)
+    {
+        const ServiceDirectoryEntry& entry = cit->second;
+        EntryRecord record;
+        record.name = append(entry.getName());
+        record.type = append(entry.getType());
+        record.description = append(entry.getDescription());
+        record.timestamp = entry.getTimestamp().toMicroseconds();
+
+        const ServiceLocations& entryLocations = entry.getLocator().getLocations();
+        record.firstLocation = locations.size();
+        record.numberOfLocations = entryLocations.size();
+        ServiceLocations::const_iterator lit = entryLocations.begin();
+        for(; lit != entryLocations.end(); ++lit)
+        {
+            LocationRecord location;
+            location.serviceAddress = append(lit->getServiceAddress());
+            location.signatureType = append(lit->getSignatureType());
+            location.serviceSignature = append(lit->getServiceSignature());
+            locations.push_back(location);
+        }
+        entries.push_back(record);
+    }
+
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.formatVersion = FORMAT_VERSION;
+    header.numberOfEntries = entries.size();
+    header.numberOfLocations = locations.size();
+    header.blobSize = blob.size();
+
+    std::string tmpFilename = filename + ".tmp";
+    {
+        std::ofstream file(tmpFilename.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        if(!entries.empty())
+        {
+            file.write(reinterpret_cast<const char*>(&entries[0]), entries.size()*sizeof(EntryRecord));
+        }
+        if(!locations.empty())
+        {
+            file.write(reinterpret_cast<const char*>(&locations[0]), locations.size()*sizeof(LocationRecord));
+        }
+        file.write(blob.data(), blob.size());
+        file.close();
+        if(!file)
+        {
+            std::remove(tmpFilename.c_str());
+            throw InvalidSnapshot("could not write '" + tmpFilename + "'");
+        }
+    }
+
+    // The content has to be on disk before the rename, otherwise a crash
+    // might leave an empty or truncated snapshot in place of the old one
+    int fd = open(tmpFilename.c_str(), O_WRONLY);
+    if(fd < 0 || fsync(fd) != 0)
+    {
+        if(fd >= 0)
+        {
+            close(fd);
+        }
+        std::remove(tmpFilename.c_str());
+        throw InvalidSnapshot("could not sync '" + tmpFilename + "'");
+    }
+    close(fd);
+
+    if(std::rename(tmpFilename.c_str(), filename.c_str()) != 0)
+    {
+        std::remove(tmpFilename.c_str());
+        throw InvalidSnapshot("could not replace '" + filename + "'");
+    }
+}
+
+size_t ServiceDirectorySnapshot::size() const
+{
+    return mHeader->numberOfEntries;
+}
+
+std::string ServiceDirectorySnapshot::getString(const StringRecord& record) const
+{
+    if((uint64_t) record.offset + record.length > mHeader->blobSize)
+    {
+        throw InvalidSnapshot("string exceeds the content of the snapshot");
+    }
+    return std::string(mBlob + record.offset, record.length);
+}
+
+int ServiceDirectorySnapshot::compare(const StringRecord& record, const std::string& other) const
+{
+    if((uint64_t) record.offset + record.length > mHeader->blobSize)
+    {
+        throw InvalidSnapshot("string exceeds the content of the snapshot");
+    }
+    int result = memcmp(mBlob + record.offset, other.data(), std::min((size_t) record.length, other.size()));
+    if(result == 0)
+    {
+        if(record.length < other.size())
+        {
+            return -1;
+        } else if(record.length > other.size())
+        {
+            return 1;
+        }
+    }
+    return result;
+}
+
+bool ServiceDirectorySnapshot::find(const Name& name, ServiceDirectoryEntry& entry) const
+{
+    // Entries are ordered by name, as std::string compares
+    size_t low = 0;
+    size_t high = size();
+    while(low < high)
+    {
+        size_t middle = low + (high - low)/2;
+        int result = compare(mEntries[middle].name, name);
+        if(result == 0)
+        {
+            entry = getEntry(middle);
+            return true;
+        } else if(result < 0)
+        {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+ServiceDirectoryEntry ServiceDirectorySnapshot::getEntry(size_t position) const
+{
+    const EntryRecord& record = mEntries[position];
+    if((uint64_t) record.firstLocation + record.numberOfLocations > mHeader->numberOfLocations)
+    {
+        throw InvalidSnapshot("locations exceed the content of the snapshot");
+    }
+
+    ServiceLocator locator;
+    for(uint32_t i = record.firstLocation; i < record.firstLocation + record.numberOfLocations; ++i)
+    {
+        const LocationRecord& location = mLocations[i];
+        locator.addLocation(ServiceLocation(getString(location.serviceAddress),
+                    getString(location.signatureType),
+                    getString(location.serviceSignature)));
+    }
+
+    ServiceDirectoryEntry entry(getString(record.name), getString(record.type), locator, getString(record.description));
+    entry.setTimestamp(base::Time::fromMicroseconds(record.timestamp));
+    return entry;
+}
+
+ServiceDirectoryList ServiceDirectorySnapshot::getEntries() const
+{
+    ServiceDirectoryList entries;
+    entries.reserve(size());
+    for(size_t i = 0; i < size(); ++i)
+    {
+        entries.push_back(getEntry(i));
+    }
+    return entries;
+}
+
+} // end namespace services
+} // end namespace fipa
@@ -0,0 +1,139 @@
+#ifndef FIPA_SERVICES_SERVICE_DIRECTORY_SNAPSHOT_HPP
+#define FIPA_SERVICES_SERVICE_DIRECTORY_SNAPSHOT_HPP
+
+#include <string>
+#include <stdint.h>
+#include <fipa_services/ServiceDirectoryIndex.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class ServiceDirectorySnapshot
+ * \brief Read-only, memory-mapped binary snapshot of service directory entries
+ * \details The snapshot file consists of
+ *  - a fixed size header
+ *  - a table of fixed size entry records ordered by name
+ *  - a table of fixed size location records
+ *  - a blob with the content of all strings
+ *
+ * Records refer to strings by offset and length into the blob, so that
+ * opening a snapshot only maps the file and validates the header. Entries are
+ * looked up by binary search on the mapped entry table and strings are
+ * copied out of the mapping without any parsing.
+ * The format uses the byte order of the host, snapshots are meant to be
+ * restored on the same host, e.g. after a restart.
+ *
+ * \verbatim
+ #include <fipa_services/ServiceDirectorySnapshot.hpp>
+
+ using namespace fipa::services;
+ ServiceDirectorySnapshot::write(*directory.getSnapshot(), "/var/tmp/mts.snapshot");
+
+ ServiceDirectorySnapshot snapshot("/var/tmp/mts.snapshot");
+ ServiceDirectoryList entries = snapshot.getEntries();
+ \endverbatim
+ */
+class ServiceDirectorySnapshot
+{
+public:
+    /**
+     * Map a snapshot file
+     * \param filename Path of the snapshot file
+     * \throws InvalidSnapshot if the file cannot be mapped or is not a valid
+     * snapshot
+     */
+    ServiceDirectorySnapshot(const std::string& filename);
+
+    ~ServiceDirectorySnapshot();
+
+    /**
+     * Write the entries of the index into a snapshot file
+     * \details The snapshot is written and synced to a temporary file first,
+     * which then replaces the given file, so that an existing snapshot is
+     * never left partially written, not even by a crash
+     * \param index Entries to write
+     * \param filename Path of the snapshot file
+     * \throws InvalidSnapshot if the file cannot be written
+     */
+    static void write(const ServiceDirectoryIndex& index, const std::string& filename);
+
+    /**
+     * Get the number of entries
+     */
+    size_t size() const;
+
+    /**
+     * Find an entry by name
+     * \param name Name of the entry
+     * \param entry Resulting entry
+     * \return true if the entry has been found, false otherwise
+     */
+    bool find(const Name& name, ServiceDirectoryEntry& entry) const;
+
+    /**
+     * Get the entry at the given position
+     * \param position Position of the entry, entries are ordered by name
+     */
+    ServiceDirectoryEntry getEntry(size_t position) const;
+
+    /**
+     * Get all entries ordered by name
+     */
+    ServiceDirectoryList getEntries() const;
+
+private:
+    ServiceDirectorySnapshot(const ServiceDirectorySnapshot& other);
+    ServiceDirectorySnapshot& operator=(const ServiceDirectorySnapshot& other);
+
+    struct StringRecord
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct EntryRecord
+    {
+        StringRecord name;
+        StringRecord type;
+        StringRecord description;
+        uint32_t firstLocation;
+        uint32_t numberOfLocations;
+        int64_t timestamp;
+    };
+
+    struct LocationRecord
+    {
+        StringRecord serviceAddress;
+        StringRecord signatureType;
+        StringRecord serviceSignature;
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t formatVersion;
+        uint32_t numberOfEntries;
+        uint32_t numberOfLocations;
+        uint32_t blobSize;
+    };
+
+    static const char* const MAGIC;
+    static const uint32_t FORMAT_VERSION = 1;
+
+    std::string getString(const StringRecord& record) const;
+
+    int compare(const StringRecord& record, const std::string& other) const;
+
+    void* mMapping;
+    size_t mMappingSize;
+
+    const Header* mHeader;
+    const EntryRecord* mEntries;
+    const LocationRecord* mLocations;
+    const char* mBlob;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_SERVICE_DIRECTORY_SNAPSHOT_HPP
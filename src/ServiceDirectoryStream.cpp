@@ -0,0 +1,36 @@
+#include "ServiceDirectoryStream.hpp"
+
+namespace fipa {
+namespace services {
+
+ServiceDirectoryStream::ServiceDirectoryStream(const ServiceDirectory& directory, const ServiceDirectoryQuery& query, size_t pageSize)
+    : mDirectory(directory)
+    , mQuery(query)
+    , mPageSize(pageSize)
+    , mPosition(0)
+    , mNumberOfPages(0)
+{
+    if(pageSize == 0)
+    {
+        throw ArgumentError("page size of 0");
+    }
+}
+
+bool ServiceDirectoryStream::next(ServiceDirectoryEntry& entry)
+{
+    while(mPosition >= mPage.entries.size())
+    {
+        if(mNumberOfPages > 0 && mPage.isLast())
+        {
+            return false;
+        }
+        mPage = mDirectory.searchPage(mQuery, mPageSize, mPage.resumeToken);
+        mPosition = 0;
+        ++mNumberOfPages;
+    }
+    entry = mPage.entries[mPosition++];
+    return true;
+}
+
+} // end namespace services
+} // end namespace fipa
@@ -0,0 +1,64 @@
+#ifndef FIPA_SERVICES_SERVICE_DIRECTORY_STREAM_HPP
+#define FIPA_SERVICES_SERVICE_DIRECTORY_STREAM_HPP
+
+#include <fipa_services/ServiceDirectory.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class ServiceDirectoryStream
+ * \brief Streaming iteration over the services matching a query
+ * \details The stream retrieves the matching services page by page via
+ * ServiceDirectory::searchPage, so that at most one page of entries is held
+ * in memory. Concurrent modifications of the directory do not invalidate
+ * the stream, see ServiceDirectoryPage.
+ * \verbatim
+ #include <fipa_services/ServiceDirectoryStream.hpp>
+
+ using namespace fipa::services;
+ ServiceDirectoryStream stream(directory);
+ ServiceDirectoryEntry entry;
+ while(stream.next(entry))
+ {
+     std::cout << entry.toString() << std::endl;
+ }
+ \endverbatim
+ */
+class ServiceDirectoryStream
+{
+public:
+    /**
+     * Constructor
+     * \param directory Directory to iterate, which has to outlive the stream
+     * \param query Query the services have to match, by default all services
+     * \param pageSize Maximum number of entries retrieved at once
+     * \throws ArgumentError if the page size is 0
+     */
+    ServiceDirectoryStream(const ServiceDirectory& directory, const ServiceDirectoryQuery& query = ServiceDirectoryQuery(), size_t pageSize = 256);
+
+    /**
+     * Get the next matching service
+     * \param entry Resulting entry
+     * \return false if all matching services have been returned
+     */
+    bool next(ServiceDirectoryEntry& entry);
+
+    /**
+     * Get the number of pages that have been retrieved so far
+     */
+    size_t getNumberOfPages() const { return mNumberOfPages; }
+
+private:
+    const ServiceDirectory& mDirectory;
+    ServiceDirectoryQuery mQuery;
+    size_t mPageSize;
+
+    ServiceDirectoryPage mPage;
+    size_t mPosition;
+    size_t mNumberOfPages;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_SERVICE_DIRECTORY_STREAM_HPP
@@ -0,0 +1,295 @@
+#include "ServiceDirectoryWireFormat.hpp"
+#include "ErrorHandling.hpp"
+#include <cstring>
+
+namespace fipa {
+namespace services {
+
+namespace {
+    const size_t MAGIC_SIZE = 4;
+    const size_t TIMESTAMP_SIZE = 8;
+
+    size_t getEncodedSize(const ServiceDirectoryEntry& entry)
+    {
+        typedef ServiceDirectoryWireFormat Format;
+        const ServiceLocations& locations = entry.getLocator().getLocations();
+        size_t size = TIMESTAMP_SIZE
+            + Format::getStringSize(entry.getName())
+            + Format::getStringSize(entry.getType())
+            + Format::getStringSize(entry.getDescription())
+            + Format::getVarintSize(locations.size());
+        ServiceLocations::const_iterator cit = locations.begin();
+        for(; cit != locations.end(); ++cit)
+        {
+            size += Format::getStringSize(cit->getServiceAddress())
+                + Format::getStringSize(cit->getSignatureType())
+                + Format::getStringSize(cit->getServiceSignature());
+        }
+        return size;
+    }
+}
+
+ServiceLocation ServiceLocationView::toLocation() const
+{
+    ServiceLocation location;
+    location.mServiceAddress.assign(serviceAddress.data, serviceAddress.size);
+    location.mSignatureType = InternedString(signatureType.data, signatureType.size);
+    location.mServiceSignature = InternedString(serviceSignature.data, serviceSignature.size);
+    return location;
+}
+
+ServiceDirectoryEntryView::ServiceDirectoryEntryView()
+    : mNumberOfLocations(0)
+    , mLocations(NULL)
+    , mLocationsEnd(NULL)
+    , mNextLocation(NULL)
+{
+}
+
+const char* ServiceDirectoryEntryView::readLocation(const char* position, const char* end, ServiceLocationView& location)
+{
+    position = ServiceDirectoryWireFormat::readString(position, end, location.serviceAddress);
+    position = ServiceDirectoryWireFormat::readString(position, end, location.signatureType);
+    return ServiceDirectoryWireFormat::readString(position, end, location.serviceSignature);
+}
+
+bool ServiceDirectoryEntryView::nextLocation(ServiceLocationView& location)
+{
+    if(mNextLocation == mLocationsEnd)
+    {
+        return false;
+    }
+    mNextLocation = readLocation(mNextLocation, mLocationsEnd, location);
+    return true;
+}
+
+ServiceDirectoryEntry ServiceDirectoryEntryView::toEntry() const
+{
+    ServiceDirectoryEntry entry;
+    ServiceDirectoryEntry::Data& data = entry.modifiable();
+    data.name.assign(name.data, name.size);
+    data.type = InternedString(type.data, type.size);
+    data.description = InternedString(description.data, description.size);
+    data.timestamp = timestamp;
+
+    ServiceLocations locations;
+    locations.reserve(mNumberOfLocations);
+    ServiceLocationView location;
+    for(const char* position = mLocations; position != mLocationsEnd; )
+    {
+        position = readLocation(position, mLocationsEnd, location);
+        locations.push_back(location.toLocation());
+    }
+    data.locator = ServiceLocator(std::move(locations));
+    return entry;
+}
+
+const char* const ServiceDirectoryWireFormat::MAGIC = "FSDW";
+
+size_t ServiceDirectoryWireFormat::getVarintSize(uint64_t value)
+{
+    size_t size = 1;
+    while(value >= 0x80)
+    {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+void ServiceDirectoryWireFormat::appendVarint(std::string& buffer, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+}
+
+const char* ServiceDirectoryWireFormat::readVarint(const char* position, const char* end, uint64_t& value)
+{
+    value = 0;
+    for(unsigned shift = 0; position != end && shift < 64; shift += 7)
+    {
+        uint8_t byte = static_cast<uint8_t>(*position++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+        {
+            return position;
+        }
+    }
+    throw InvalidEncoding("truncated or overlong integer");
+}
+
+size_t ServiceDirectoryWireFormat::getStringSize(const std::string& value)
+{
+    return getVarintSize(value.size()) + value.size();
+}
+
+void ServiceDirectoryWireFormat::appendString(std::string& buffer, const std::string& value)
+{
+    appendVarint(buffer, value.size());
+    buffer.append(value);
+}
+
+const char* ServiceDirectoryWireFormat::readString(const char* position, const char* end, StringRange& value)
+{
+    uint64_t size;
+    position = readVarint(position, end, size);
+    if(size > static_cast<uint64_t>(end - position))
+    {
+        throw InvalidEncoding("string exceeds the data");
+    }
+    value = StringRange(position, size);
+    return position + size;
+}
+
+
+std::string ServiceDirectoryWireFormat::encode(const ServiceDirectoryList& entries)
+{
+    std::string buffer;
+    encode(entries, buffer);
+    return buffer;
+}
+
+void ServiceDirectoryWireFormat::encode(const ServiceDirectoryList& entries, std::string& buffer)
+{
+    std::vector<size_t> sizes;
+    sizes.reserve(entries.size());
+    size_t size = MAGIC_SIZE + 1 + getVarintSize(entries.size());
+    ServiceDirectoryList::const_iterator cit = entries.begin();
+    for(; cit != entries.end(); ++cit)
+    {
+        sizes.push_back(getEncodedSize(*cit));
+        size += getVarintSize(sizes.back()) + sizes.back();
+    }
+    buffer.reserve(buffer.size() + size);
+
+    buffer.append(MAGIC, MAGIC_SIZE);
+    buffer.push_back(static_cast<char>(VERSION));
+    appendVarint(buffer, entries.size());
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+        const ServiceDirectoryEntry& entry = entries[i];
+        appendVarint(buffer, sizes[i]);
+
+        uint64_t timestamp = static_cast<uint64_t>(entry.getTimestamp().toMicroseconds());
+        for(size_t byte = 0; byte < TIMESTAMP_SIZE; ++byte)
+        {
+            buffer.push_back(static_cast<char>(timestamp >> (8*byte)));
+        }
+        appendString(buffer, entry.getName());
+        appendString(buffer, entry.getType());
+        appendString(buffer, entry.getDescription());
+
+        const ServiceLocations& locations = entry.getLocator().getLocations();
+        appendVarint(buffer, locations.size());
+        ServiceLocations::const_iterator lit = locations.begin();
+        for(; lit != locations.end(); ++lit)
+        {
+            appendString(buffer, lit->getServiceAddress());
+            appendString(buffer, lit->getSignatureType());
+            appendString(buffer, lit->getServiceSignature());
+        }
+    }
+}
+
+ServiceDirectoryList ServiceDirectoryWireFormat::decode(const std::string& data)
+{
+    ServiceDirectoryWireReader reader(data);
+    ServiceDirectoryList entries;
+    entries.reserve(reader.getNumberOfEntries());
+    ServiceDirectoryEntryView view;
+    while(reader.next(view))
+    {
+        entries.push_back(view.toEntry());
+    }
+    return entries;
+}
+
+ServiceDirectoryWireReader::ServiceDirectoryWireReader(const char* data, size_t size)
+{
+    readHeader(data, size);
+}
+
+ServiceDirectoryWireReader::ServiceDirectoryWireReader(const std::string& data)
+{
+    readHeader(data.data(), data.size());
+}
+
+void ServiceDirectoryWireReader::readHeader(const char* data, size_t size)
+{
+    mEnd = data + size;
+    mNumberOfDecodedEntries = 0;
+    if(size < MAGIC_SIZE + 1 || memcmp(data, ServiceDirectoryWireFormat::MAGIC, MAGIC_SIZE) != 0)
+    {
+        throw InvalidEncoding("missing header");
+    }
+
+    uint8_t version = static_cast<uint8_t>(data[MAGIC_SIZE]);
+    if(version != ServiceDirectoryWireFormat::VERSION)
+    {
+        throw InvalidEncoding("unsupported version " + std::to_string(version));
+    }
+
+    uint64_t numberOfEntries;
+    mPosition = ServiceDirectoryWireFormat::readVarint(data + MAGIC_SIZE + 1, mEnd, numberOfEntries);
+    // Each entry takes at least one byte
+    if(numberOfEntries > static_cast<uint64_t>(mEnd - mPosition))
+    {
+        throw InvalidEncoding("number of entries exceeds the data");
+    }
+    mNumberOfEntries = numberOfEntries;
+}
+
+bool ServiceDirectoryWireReader::next(ServiceDirectoryEntryView& view)
+{
+    if(mNumberOfDecodedEntries == mNumberOfEntries)
+    {
+        if(mPosition != mEnd)
+        {
+            throw InvalidEncoding("data after the last entry");
+        }
+        return false;
+    }
+
+    uint64_t size;
+    const char* position = ServiceDirectoryWireFormat::readVarint(mPosition, mEnd, size);
+    if(size > static_cast<uint64_t>(mEnd - position) || size < TIMESTAMP_SIZE)
+    {
+        throw InvalidEncoding("entry exceeds the data");
+    }
+    const char* end = position + size;
+
+    uint64_t timestamp = 0;
+    for(size_t byte = 0; byte < TIMESTAMP_SIZE; ++byte)
+    {
+        timestamp |= static_cast<uint64_t>(static_cast<uint8_t>(*position++)) << (8*byte);
+    }
+    view.timestamp = base::Time::fromMicroseconds(static_cast<int64_t>(timestamp));
+    position = ServiceDirectoryWireFormat::readString(position, end, view.name);
+    position = ServiceDirectoryWireFormat::readString(position, end, view.type);
+    position = ServiceDirectoryWireFormat::readString(position, end, view.description);
+
+    uint64_t numberOfLocations;
+    position = ServiceDirectoryWireFormat::readVarint(position, end, numberOfLocations);
+    view.mNumberOfLocations = numberOfLocations;
+    view.mLocations = position;
+    // Validate the locations, so that they can be read without further checks
+    ServiceLocationView location;
+    for(uint64_t i = 0; i < numberOfLocations; ++i)
+    {
+        position = ServiceDirectoryEntryView::readLocation(position, end, location);
+    }
+    view.mLocationsEnd = position;
+    view.mNextLocation = view.mLocations;
+
+    // Skip fields that have been added by compatible revisions
+    mPosition = end;
+    ++mNumberOfDecodedEntries;
+    return true;
+}
+
+} // end namespace services
+} // end namespace fipa
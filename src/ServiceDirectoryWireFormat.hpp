@@ -0,0 +1,228 @@
+#ifndef FIPA_SERVICES_SERVICE_DIRECTORY_WIRE_FORMAT_HPP
+#define FIPA_SERVICES_SERVICE_DIRECTORY_WIRE_FORMAT_HPP
+
+#include <string>
+#include <stdint.h>
+#include <fipa_services/ServiceDirectoryEntry.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class StringRange
+ * \brief Read-only reference to a string inside an encoded buffer
+ */
+struct StringRange
+{
+    const char* data;
+    size_t size;
+
+    StringRange() : data(NULL), size(0) {}
+
+    StringRange(const char* data, size_t size) : data(data), size(size) {}
+
+    /**
+     * Copy the referenced content into a string
+     */
+    std::string str() const { return std::string(data, size); }
+
+    bool empty() const { return size == 0; }
+
+    bool operator==(const std::string& other) const { return other.size() == size && other.compare(0, size, data, size) == 0; }
+
+    bool operator!=(const std::string& other) const { return !(*this == other); }
+};
+
+/**
+ * \class ServiceLocationView
+ * \brief Service location decoded in place, see ServiceDirectoryWireReader
+ */
+struct ServiceLocationView
+{
+    StringRange serviceAddress;
+    StringRange signatureType;
+    StringRange serviceSignature;
+
+    /**
+     * Create a service location from the referenced content
+     */
+    ServiceLocation toLocation() const;
+};
+
+/**
+ * \class ServiceDirectoryEntryView
+ * \brief Service directory entry decoded in place, see
+ * ServiceDirectoryWireReader
+ * \details A view refers to the encoded buffer and is only valid as long as
+ * the buffer is
+ */
+class ServiceDirectoryEntryView
+{
+public:
+    StringRange name;
+    StringRange type;
+    StringRange description;
+    base::Time timestamp;
+
+    ServiceDirectoryEntryView();
+
+    /**
+     * Get the number of locations of the locator
+     */
+    size_t getNumberOfLocations() const { return mNumberOfLocations; }
+
+    /**
+     * Get the locations of the locator one after another
+     * \param location Resulting location
+     * \return false if all locations have been retrieved, true otherwise
+     */
+    bool nextLocation(ServiceLocationView& location);
+
+    /**
+     * Create a service directory entry from the referenced content
+     */
+    ServiceDirectoryEntry toEntry() const;
+
+private:
+    friend class ServiceDirectoryWireReader;
+
+    static const char* readLocation(const char* position, const char* end, ServiceLocationView& location);
+
+    size_t mNumberOfLocations;
+    const char* mLocations;
+    const char* mLocationsEnd;
+    const char* mNextLocation;
+};
+
+/**
+ * \class ServiceDirectoryWireFormat
+ * \brief Compact binary encoding of service directory entries for the
+ * exchange between hosts
+ * \details The encoding is independent of the host byte order:
+ * \verbatim
+ encoding  := "FSDW" version:u8 numberOfEntries:varint entry*
+ entry     := length:varint timestamp:i64 name type description
+              numberOfLocations:varint location*
+ location  := serviceAddress signatureType serviceSignature
+ string    := length:varint byte*
+ \endverbatim
+ * Integers are little endian, varints are unsigned LEB128 and timestamps are
+ * microseconds. The version is only increased for incompatible changes,
+ * which readers reject. Compatible additions are appended to an entry and
+ * skipped by readers which do not know them, since each entry is prefixed
+ * with its length.
+ *
+ * \verbatim
+ #include <fipa_services/ServiceDirectoryWireFormat.hpp>
+
+ using namespace fipa::services;
+ std::string data = ServiceDirectoryWireFormat::encode(directory.getAll());
+
+ ServiceDirectoryWireReader reader(data);
+ ServiceDirectoryEntryView view;
+ while(reader.next(view))
+ {
+     if(view.type == "planner")
+     {
+         entries.push_back(view.toEntry());
+     }
+ }
+ \endverbatim
+ */
+class ServiceDirectoryWireFormat
+{
+public:
+    static const char* const MAGIC;
+    static const uint8_t VERSION = 1;
+
+    /**
+     * Encode entries
+     * \return encoded entries
+     */
+    static std::string encode(const ServiceDirectoryList& entries);
+
+    /**
+     * Encode entries and append them to a buffer
+     * \param entries Entries to encode
+     * \param buffer Buffer to append the encoding to
+     */
+    static void encode(const ServiceDirectoryList& entries, std::string& buffer);
+
+    /**
+     * Decode all entries
+     * \throws InvalidEncoding if the data is not a valid encoding
+     */
+    static ServiceDirectoryList decode(const std::string& data);
+
+    /**
+     * \name Primitives of the encoding, which allow other encodings, e.g.
+     * of replication messages, to embed the same integers and strings
+     * \{
+     */
+    static size_t getVarintSize(uint64_t value);
+
+    static void appendVarint(std::string& buffer, uint64_t value);
+
+    /**
+     * Read a varint
+     * \return Position after the varint
+     * \throws InvalidEncoding if the varint exceeds the data
+     */
+    static const char* readVarint(const char* position, const char* end, uint64_t& value);
+
+    static size_t getStringSize(const std::string& value);
+
+    static void appendString(std::string& buffer, const std::string& value);
+
+    /**
+     * Read a string
+     * \return Position after the string
+     * \throws InvalidEncoding if the string exceeds the data
+     */
+    static const char* readString(const char* position, const char* end, StringRange& value);
+    /** \} */
+};
+
+/**
+ * \class ServiceDirectoryWireReader
+ * \brief Decoder of the ServiceDirectoryWireFormat which decodes entries
+ * into views, without copying any content
+ */
+class ServiceDirectoryWireReader
+{
+public:
+    /**
+     * Create reader for encoded data, which has to outlive the reader and all
+     * views
+     * \throws InvalidEncoding if the header is invalid or of an unsupported
+     * version
+     */
+    ServiceDirectoryWireReader(const char* data, size_t size);
+
+    ServiceDirectoryWireReader(const std::string& data);
+
+    /**
+     * Get the number of encoded entries
+     */
+    size_t getNumberOfEntries() const { return mNumberOfEntries; }
+
+    /**
+     * Decode the next entry
+     * \param view Resulting view
+     * \return false if all entries have been decoded, true otherwise
+     * \throws InvalidEncoding if the entry is invalid
+     */
+    bool next(ServiceDirectoryEntryView& view);
+
+private:
+    void readHeader(const char* data, size_t size);
+
+    const char* mPosition;
+    const char* mEnd;
+    size_t mNumberOfEntries;
+    size_t mNumberOfDecodedEntries;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_SERVICE_DIRECTORY_WIRE_FORMAT_HPP
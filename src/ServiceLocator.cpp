@@ -1,15 +1,47 @@
 #include "ServiceLocator.hpp"
 #include "ErrorHandling.hpp"
 #include <boost/algorithm/string.hpp>
-#include <boost/regex.hpp>
-
-#include <fipa_services/transports/Transport.hpp>
+#include "RegexCache.hpp"
+#include <algorithm>
 
 namespace fipa {
 namespace services {
 
-std::string ServiceLocation::getFieldContent(ServiceLocation::Field field) const
+ServiceLocation::ServiceLocation(const ServiceLocation& other)
+    : mServiceAddress(other.mServiceAddress)
+    , mSignatureType(other.mSignatureType)
+    , mServiceSignature(other.mServiceSignature)
+    , mEndpoint(std::atomic_load(&other.mEndpoint))
+{}
+
+ServiceLocation& ServiceLocation::operator=(const ServiceLocation& other)
+{
+    mServiceAddress = other.mServiceAddress;
+    mSignatureType = other.mSignatureType;
+    mServiceSignature = other.mServiceSignature;
+    mEndpoint = std::atomic_load(&other.mEndpoint);
+    return *this;
+}
+
+ServiceLocation::ServiceLocation(ServiceLocation&& other) noexcept
+    : mServiceAddress(std::move(other.mServiceAddress))
+    , mSignatureType(std::move(other.mSignatureType))
+    , mServiceSignature(std::move(other.mServiceSignature))
+    , mEndpoint(std::move(other.mEndpoint))
+{}
+
+ServiceLocation& ServiceLocation::operator=(ServiceLocation&& other) noexcept
+{
+    mServiceAddress = std::move(other.mServiceAddress);
+    mSignatureType = std::move(other.mSignatureType);
+    mServiceSignature = std::move(other.mServiceSignature);
+    mEndpoint = std::move(other.mEndpoint);
+    return *this;
+}
+
+const std::string& ServiceLocation::getFieldContent(ServiceLocation::Field field) const
 {
+    static const std::string empty;
     switch(field)
     {
         case SIGNATURE_TYPE: return getSignatureType();
@@ -18,36 +50,78 @@ std::string ServiceLocation::getFieldContent(ServiceLocation::Field field) const
         default: assert(-1);
     }
 
-    return "";
+    return empty;
 }
 
 std::string ServiceLocation::toString() const
 {
-    std::string representation = mServiceAddress + " "  + mSignatureType + " " + mServiceSignature;
-    boost::trim(representation);
+    std::string representation;
+    representation.reserve(getStringLength());
+    appendTo(representation);
     return representation;
 }
 
+void ServiceLocation::appendTo(std::string& representation) const
+{
+    size_t start = representation.size();
+    representation.append(mServiceAddress);
+    representation.push_back(' ');
+    representation.append(mSignatureType.str());
+    representation.push_back(' ');
+    representation.append(mServiceSignature.str());
+
+    // Trim the appended representation in place
+    size_t end = representation.size();
+    while(end > start && isspace(static_cast<unsigned char>(representation[end - 1])))
+    {
+        --end;
+    }
+    representation.resize(end);
+
+    size_t first = start;
+    while(first < end && isspace(static_cast<unsigned char>(representation[first])))
+    {
+        ++first;
+    }
+    representation.erase(start, first - start);
+}
+
 ServiceLocation ServiceLocation::fromString(const std::string& locationString)
 {
     ServiceLocation location;
-    std::vector<std::string> fieldTokens;
-    boost::split(fieldTokens, locationString, boost::is_any_of(" "));
+    location.updateFromString(locationString.data(), locationString.data() + locationString.size());
+    return location;
+}
 
-    switch(fieldTokens.size())
+void ServiceLocation::updateFromString(const char* begin, const char* end)
+{
+    // Fields are separated by single spaces
+    const char* separators[2];
+    size_t numberOfSeparators = 0;
+    for(const char* c = begin; c != end; ++c)
+    {
+        if(*c == ' ')
+        {
+            if(numberOfSeparators == 2)
+            {
+                throw std::invalid_argument("ServiceLocation::fromString could not parse ServiceLocation from '" + std::string(begin, end) + "'");
+            }
+            separators[numberOfSeparators++] = c;
+        }
+    }
+
+    switch(numberOfSeparators)
     {
-        case 3:
-            location.mServiceSignature = fieldTokens[2];
         case 2:
-            location.mSignatureType = fieldTokens[1];
+            mServiceSignature = InternedString(separators[1] + 1, end - separators[1] - 1);
+            end = separators[1];
         case 1:
-            location.mServiceAddress = fieldTokens[0];
+            mSignatureType = InternedString(separators[0] + 1, end - separators[0] - 1);
+            end = separators[0];
+        case 0:
+            mServiceAddress.assign(begin, end);
             break;
-        default:
-            throw std::invalid_argument("ServiceLocation::fromString could not parse ServiceLocation from '" + locationString + "'");
     }
-
-    return location;
 }
 
 bool ServiceLocation::operator==(const fipa::services::ServiceLocation& other) const
@@ -55,21 +129,78 @@ bool ServiceLocation::operator==(const fipa::services::ServiceLocation& other) c
     return mServiceAddress == other.mServiceAddress && mServiceSignature == other.mServiceSignature && mSignatureType == other.mSignatureType;
 }
 
-std::string ServiceLocation::getProtocol() const
+const ServiceLocation::Endpoint& ServiceLocation::getEndpoint() const
+{
+    std::shared_ptr<const Endpoint> endpoint = std::atomic_load(&mEndpoint);
+    if(endpoint)
+    {
+        return *endpoint;
+    }
+
+    std::shared_ptr<Endpoint> parsed(new Endpoint());
+    parsed->transportType = transports::TransportType::UNKNOWN;
+    parsed->valid = false;
+    try {
+        parsed->address = transports::Address::fromString(mServiceAddress);
+        parsed->valid = true;
+        parsed->transportType = transports::TransportType::getTypeFromTxt(parsed->address.protocol);
+    } catch(const std::invalid_argument&)
+    {
+        // Malformatted address or unsupported protocol
+    }
+
+    // Concurrent readers might parse as well, but only the first result is
+    // kept, so that references to it remain valid
+    std::shared_ptr<const Endpoint> expected;
+    if(std::atomic_compare_exchange_strong(&mEndpoint, &expected, std::shared_ptr<const Endpoint>(parsed)))
+    {
+        return *parsed;
+    }
+    return *expected;
+}
+
+const transports::Address& ServiceLocation::getAddress() const
 {
-    return transports::Address::fromString(mServiceAddress).protocol;
+    const Endpoint& endpoint = getEndpoint();
+    if(!endpoint.valid)
+    {
+        throw std::invalid_argument("address '" + mServiceAddress + "' malformatted");
+    }
+    return endpoint.address;
 }
 
+ServiceLocator::ServiceLocator(const ServiceLocations& locations)
+    : mLocations(locations)
+{}
+
+ServiceLocator::ServiceLocator(ServiceLocations&& locations)
+    : mLocations(std::move(locations))
+{}
+
 void ServiceLocator::updateFromString(const std::string& locations)
 {
-    std::vector<std::string> locationTokens;
-    boost::split(locationTokens, locations, boost::is_any_of(";"));
+    const char* begin = locations.data();
+    const char* end = begin + locations.size();
+    mLocations.reserve(mLocations.size() + std::count(begin, end, ';') + 1);
 
-    std::vector<std::string>::const_iterator cit = locationTokens.begin();
-    for(; cit != locationTokens.end(); ++cit)
+    // Locations are separated by ';' and built in place
+    for(;;)
     {
-        ServiceLocation location = ServiceLocation::fromString(*cit);
-        mLocations.push_back(location);
+        const char* separator = std::find(begin, end, ';');
+        mLocations.push_back(ServiceLocation());
+        try {
+            mLocations.back().updateFromString(begin, separator);
+        } catch(...)
+        {
+            mLocations.pop_back();
+            throw;
+        }
+
+        if(separator == end)
+        {
+            break;
+        }
+        begin = separator + 1;
     }
 }
 
@@ -82,11 +213,18 @@ ServiceLocator ServiceLocator::fromString(const std::string& locations)
 
 std::string ServiceLocator::toString() const
 {
-    std::string description;
+    size_t length = 0;
     ServiceLocations::const_iterator cit = mLocations.begin();
     for(; cit != mLocations.end(); ++cit)
     {
-        description += cit->toString();
+        length += cit->getStringLength() + 1;
+    }
+
+    std::string description;
+    description.reserve(length);
+    for(cit = mLocations.begin(); cit != mLocations.end(); ++cit)
+    {
+        cit->appendTo(description);
         description += ";";
     }
     boost::trim(description);
@@ -99,13 +237,13 @@ ServiceLocations ServiceLocator::search(const std::string& regex, ServiceLocatio
     ServiceLocations serviceLocations;
     ServiceLocations::const_iterator it = mLocations.begin();
 
-    boost::regex r(regex);
+    RegexCache::RegexPtr r = RegexCache::getInstance().get(regex);
     boost::smatch what;
     for(; it != mLocations.end(); ++it)
     {
-        ServiceLocation entry = *it;
+        const ServiceLocation& entry = *it;
 
-        if(boost::regex_match( entry.getFieldContent(field), what,r))
+        if(boost::regex_match( entry.getFieldContent(field), what,*r))
         {
             serviceLocations.push_back(entry);
         }
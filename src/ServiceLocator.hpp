@@ -3,6 +3,10 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <fipa_services/InternedString.hpp>
+#include <fipa_services/transports/Address.hpp>
+#include <fipa_services/transports/TransportType.hpp>
 
 namespace fipa {
 namespace services {
@@ -16,11 +20,44 @@ class ServiceLocation
     /// The service address
     std::string mServiceAddress;
     /// The signature type is describes the 'type' of a
-    /// service signature [optional element]
-    std::string mSignatureType;
+    /// service signature [optional element], interned since it repeats
+    /// across services
+    InternedString mSignatureType;
     /// According to FIPA a fully qualifified name that describes the binding
     /// signature of this service, e.g. org.omg.agent.idl-binding
-    std::string mServiceSignature;
+    InternedString mServiceSignature;
+
+    /// Service address as parsed for routing
+    struct Endpoint
+    {
+        transports::Address address;
+        transports::TransportType::Type transportType;
+        bool valid;
+    };
+    /// Parsed on first use, and shared with all copies of this location
+    mutable std::shared_ptr<const Endpoint> mEndpoint;
+
+    const Endpoint& getEndpoint() const;
+
+    friend class ServiceLocator;
+    friend struct ServiceLocationView;
+
+    /**
+     * Set the fields from the ' ' separated fields in the given range
+     * \throws std::invalid_argument if the range has more than three fields
+     */
+    void updateFromString(const char* begin, const char* end);
+
+    /**
+     * Append the string representation
+     * \see toString
+     */
+    void appendTo(std::string& representation) const;
+
+    /**
+     * Get the length of the string representation, excluding trimming
+     */
+    size_t getStringLength() const { return mServiceAddress.size() + mSignatureType.str().size() + mServiceSignature.str().size() + 2; }
 
 public:
     enum Field { SIGNATURE_TYPE = 0x01, SERVICE_SIGNATURE = 0x02, SERVICE_ADDRESS = 0x04 };
@@ -36,30 +73,38 @@ public:
         , mServiceSignature(serviceSignature)
     {}
 
+    ServiceLocation(const ServiceLocation& other);
+
+    ServiceLocation& operator=(const ServiceLocation& other);
+
+    ServiceLocation(ServiceLocation&& other) noexcept;
+
+    ServiceLocation& operator=(ServiceLocation&& other) noexcept;
+
     /**
      * Get the content of a specific field
      * \param field Field for which the value should be retrieved
      * \return content of field
      */
-    std::string getFieldContent(ServiceLocation::Field field) const;
+    const std::string& getFieldContent(ServiceLocation::Field field) const;
 
     /**
      * Get the signature type of this service location
      * \return signature type
      */
-    std::string getSignatureType() const { return mSignatureType; }
+    const std::string& getSignatureType() const { return mSignatureType; }
 
     /**
      * Get the service signature
      * \return service signature
      */
-    std::string getServiceSignature() const { return mServiceSignature; }
+    const std::string& getServiceSignature() const { return mServiceSignature; }
 
     /**
      * Get the service address
      * \return service address
      */
-    std::string getServiceAddress() const { return mServiceAddress; }
+    const std::string& getServiceAddress() const { return mServiceAddress; }
 
     /**
      * Convert to ServiceLocation to string
@@ -82,8 +127,26 @@ public:
     /**
      * Helper function to retrieve the underlying transport 
      * protocol that is part of the service address
+     * \throws std::invalid_argument if the service address is malformatted
      */
-    std::string getProtocol() const;
+    const std::string& getProtocol() const { return getAddress().protocol; }
+
+    /**
+     * Get the service address in parsed form
+     * \details The service address is parsed only once, so that this
+     * can be used on the routing path
+     * \return parsed service address
+     * \throws std::invalid_argument if the service address is malformatted
+     */
+    const transports::Address& getAddress() const;
+
+    /**
+     * Get the type of the transport that corresponds to the protocol of the
+     * service address
+     * \return transport type, or UNKNOWN if the service address is
+     * malformatted or its protocol is not supported
+     */
+    transports::TransportType::Type getTransportType() const { return getEndpoint().transportType; }
 };
 
 typedef std::vector<ServiceLocation> ServiceLocations;
@@ -103,7 +166,9 @@ public:
 
     ServiceLocator(const ServiceLocations& locations);
 
-    ServiceLocations getLocations() const { return mLocations; }
+    ServiceLocator(ServiceLocations&& locations);
+
+    const ServiceLocations& getLocations() const { return mLocations; }
 
     /**
      * Add a service location
@@ -122,7 +187,7 @@ public:
      * Get the first location, i.e. the one with highest priority
      * \return ServiceLocation of highest priority
      */
-    ServiceLocation getFirstLocation() const { return mLocations.front(); }
+    const ServiceLocation& getFirstLocation() const { return mLocations.front(); }
 
     /**
      * Search for a service location, e.g. given a certain signature type
@@ -0,0 +1,532 @@
+#include "ShardedServiceDirectory.hpp"
+#include <algorithm>
+#include <future>
+#include <base-logging/Logging.hpp>
+
+namespace fipa {
+namespace services {
+
+namespace {
+    // A batch is owned by the thread running ShardedServiceDirectory::batch
+    template<typename T>
+    void keepBatch(T*) {}
+}
+
+ShardedServiceDirectory::ShardedServiceDirectory(size_t numberOfShards, ConcurrencyMode mode, int numberOfWorkers)
+    : ServiceDirectory(mode)
+    , mBatch(keepBatch<Batch>)
+{
+    numberOfShards = std::max(numberOfShards, (size_t) 1);
+    for(size_t i = 0; i < numberOfShards; ++i)
+    {
+        ServiceDirectory::Ptr shard(new ServiceDirectory(mode));
+        // Changes of all shards are republished with the version of this
+        // directory
+        shard->subscribe([this](const ServiceDirectoryChange& change)
+            {
+                Batch* batch = mBatch.get();
+                if(batch)
+                {
+                    boost::unique_lock<boost::mutex> lock(batch->mutex);
+                    batch->changes.push_back(change);
+                } else {
+                    mChangeFeed.publish(change.type, change.entry, change.previous);
+                }
+            });
+        mShards.push_back(shard);
+    }
+
+    if(numberOfWorkers < 0)
+    {
+        numberOfWorkers = std::max((int) boost::thread::hardware_concurrency() - 1, 0);
+    }
+    // The calling thread queries shards as well
+    numberOfWorkers = std::min(numberOfWorkers, (int) numberOfShards - 1);
+
+    mWork.reset(new boost::asio::io_service::work(mIOService));
+    for(int i = 0; i < numberOfWorkers; ++i)
+    {
+        mWorkers.create_thread([this]() { mIOService.run(); });
+    }
+}
+
+ShardedServiceDirectory::~ShardedServiceDirectory()
+{
+    mWork.reset();
+    mWorkers.join_all();
+}
+
+size_t ShardedServiceDirectory::getShardIndex(const Name& name) const
+{
+    return std::hash<Name>()(name) % mShards.size();
+}
+
+void ShardedServiceDirectory::forEachShard(const std::function<void (size_t)>& job) const
+{
+    // Shards are distributed round robin over the calling thread and the
+    // worker threads
+    size_t participants = mWorkers.size() + 1;
+    // Changes of the jobs belong to the batch of the calling thread
+    Batch* batch = mBatch.get();
+    std::vector< std::future<void> > futures;
+    for(size_t p = 1; p < participants; ++p)
+    {
+        std::shared_ptr< std::packaged_task<void ()> > task(new std::packaged_task<void ()>([this, &job, p, participants, batch]()
+            {
+                mBatch.reset(batch);
+                try {
+                    for(size_t i = p; i < mShards.size(); i += participants)
+                    {
+                        job(i);
+                    }
+                } catch(...)
+                {
+                    mBatch.reset();
+                    throw;
+                }
+                mBatch.reset();
+            }));
+        futures.push_back(task->get_future());
+        mIOService.post([task]() { (*task)(); });
+    }
+
+    std::exception_ptr error;
+    try {
+        for(size_t i = 0; i < mShards.size(); i += participants)
+        {
+            job(i);
+        }
+    } catch(...)
+    {
+        error = std::current_exception();
+    }
+
+    // Wait for all jobs, since they refer to the job function
+    std::vector< std::future<void> >::iterator it = futures.begin();
+    for(; it != futures.end(); ++it)
+    {
+        try {
+            it->get();
+        } catch(...)
+        {
+            if(!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if(error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void ShardedServiceDirectory::batch(const std::function<void ()>& modification)
+{
+    Batch batch;
+    mBatch.reset(&batch);
+    try {
+        modification();
+    } catch(...)
+    {
+        // Shards which have been modified already have to be published
+        mBatch.reset();
+        mChangeFeed.publish(batch.changes);
+        throw;
+    }
+    mBatch.reset();
+    mChangeFeed.publish(batch.changes);
+}
+
+ServiceDirectoryList ShardedServiceDirectory::merge(const std::vector<ServiceDirectoryList>& results)
+{
+    size_t size = 0;
+    std::vector<ServiceDirectoryList>::const_iterator rit = results.begin();
+    for(; rit != results.end(); ++rit)
+    {
+        size += rit->size();
+    }
+
+    ServiceDirectoryList resultList;
+    resultList.reserve(size);
+    for(rit = results.begin(); rit != results.end(); ++rit)
+    {
+        resultList.insert(resultList.end(), rit->begin(), rit->end());
+    }
+    std::sort(resultList.begin(), resultList.end());
+    return resultList;
+}
+
+void ShardedServiceDirectory::registerService(const ServiceDirectoryEntry& entry)
+{
+    boost::shared_lock<boost::shared_mutex> lock(mWriteMutex);
+    mShards[getShardIndex(entry.getName())]->registerService(entry);
+}
+
+void ShardedServiceDirectory::registerService(const ServiceDirectoryEntry& entry, const base::Time& leaseDuration)
+{
+    boost::shared_lock<boost::shared_mutex> lock(mWriteMutex);
+    mShards[getShardIndex(entry.getName())]->registerService(entry, leaseDuration);
+}
+
+void ShardedServiceDirectory::registerServices(const ServiceDirectoryList& entries)
+{
+    boost::unique_lock<boost::shared_mutex> lock(mWriteMutex);
+    std::vector<ServiceDirectoryList> parts(mShards.size());
+    std::set<Name> names;
+    ServiceDirectoryList::const_iterator cit = entries.begin();
+    for(; cit != entries.end(); ++cit)
+    {
+        size_t shard = getShardIndex(cit->getName());
+        if(!names.insert(cit->getName()).second || !mShards[shard]->lookupByName(cit->getName()).empty())
+        {
+            throw DuplicateEntry(cit->toString());
+        }
+        parts[shard].push_back(*cit);
+    }
+
+    batch([this, &parts]()
+        {
+            for(size_t i = 0; i < parts.size(); ++i)
+            {
+                if(!parts[i].empty())
+                {
+                    mShards[i]->registerServices(parts[i]);
+                }
+            }
+        });
+}
+
+void ShardedServiceDirectory::deregisterServices(const std::vector<Name>& names)
+{
+    boost::unique_lock<boost::shared_mutex> lock(mWriteMutex);
+    std::vector< std::vector<Name> > parts(mShards.size());
+    std::vector<Name>::const_iterator cit = names.begin();
+    for(; cit != names.end(); ++cit)
+    {
+        size_t shard = getShardIndex(*cit);
+        if(mShards[shard]->lookupByName(*cit).empty())
+        {
+            throw NotFound("ServiceDirectoryEntry named '" + *cit + "'");
+        }
+        parts[shard].push_back(*cit);
+    }
+
+    batch([this, &parts]()
+        {
+            for(size_t i = 0; i < parts.size(); ++i)
+            {
+                if(!parts[i].empty())
+                {
+                    mShards[i]->deregisterServices(parts[i]);
+                }
+            }
+        });
+}
+
+void ShardedServiceDirectory::renewLease(const Name& name, const base::Time& leaseDuration)
+{
+    mShards[getShardIndex(name)]->renewLease(name, leaseDuration);
+}
+
+size_t ShardedServiceDirectory::expireLeases(const base::Time& now)
+{
+    boost::shared_lock<boost::shared_mutex> lock(mWriteMutex);
+    size_t expired = 0;
+    std::vector<ServiceDirectory::Ptr>::const_iterator it = mShards.begin();
+    for(; it != mShards.end(); ++it)
+    {
+        expired += (*it)->expireLeases(now);
+    }
+    return expired;
+}
+
+void ShardedServiceDirectory::deregisterService(const std::string& regex, ServiceDirectoryEntry::Field field)
+{
+    boost::shared_lock<boost::shared_mutex> lock(mWriteMutex);
+    std::string name;
+    if(field == ServiceDirectoryEntry::NAME && ServiceDirectoryIndex::isLiteral(regex, name))
+    {
+        mShards[getShardIndex(name)]->deregisterService(regex, field);
+        return;
+    }
+
+    // Remove the first match in name order across all shards, as the
+    // unsharded directory does
+    for(;;)
+    {
+        std::vector<ServiceDirectoryList> results(mShards.size());
+        forEachShard([this, &results, &regex, field](size_t i)
+            {
+                mShards[i]->forEachMatch(regex, field, [&results, i](const ServiceDirectoryEntry& entry)
+                    {
+                        results[i].push_back(entry);
+                        return false;
+                    });
+            });
+
+        const Name* first = NULL;
+        std::vector<ServiceDirectoryList>::const_iterator rit = results.begin();
+        for(; rit != results.end(); ++rit)
+        {
+            if(!rit->empty() && (!first || rit->front().getName() < *first))
+            {
+                first = &rit->front().getName();
+            }
+        }
+        if(!first)
+        {
+            throw NotFound("ServiceDirectoryEntry matching '" + regex + "'");
+        }
+
+        try {
+            mShards[getShardIndex(*first)]->deregisterServices(std::vector<Name>(1, *first));
+            return;
+        } catch(const NotFound&)
+        {
+            // removed concurrently, look for the next match
+        }
+    }
+}
+
+ServiceDirectoryList ShardedServiceDirectory::search(const std::string& regex, ServiceDirectoryEntry::Field field, bool doThrow) const
+{
+    ServiceDirectoryList resultList;
+    std::string name;
+    if(field == ServiceDirectoryEntry::NAME && ServiceDirectoryIndex::isLiteral(regex, name))
+    {
+        resultList = mShards[getShardIndex(name)]->search(regex, field, false);
+    } else {
+        std::vector<ServiceDirectoryList> results(mShards.size());
+        forEachShard([this, &results, &regex, field](size_t i)
+            {
+                results[i] = mShards[i]->search(regex, field, false);
+            });
+        resultList = merge(results);
+    }
+
+    if(resultList.empty() && doThrow)
+    {
+        throw NotFound("ServiceDirectoryEntry matching '" + regex + "'");
+    }
+    return resultList;
+}
+
+void ShardedServiceDirectory::forEachMatch(const std::string& regex, ServiceDirectoryEntry::Field field, const ServiceDirectoryVisitor& visitor) const
+{
+    // The visitor is not required to be thread-safe, so shards are visited
+    // one after another
+    bool stopped = false;
+    std::vector<ServiceDirectory::Ptr>::const_iterator it = mShards.begin();
+    for(; it != mShards.end() && !stopped; ++it)
+    {
+        (*it)->forEachMatch(regex, field, [&visitor, &stopped](const ServiceDirectoryEntry& entry)
+            {
+                stopped = !visitor(entry);
+                return !stopped;
+            });
+    }
+}
+
+ServiceDirectoryList ShardedServiceDirectory::lookupByName(const Name& name) const
+{
+    return mShards[getShardIndex(name)]->lookupByName(name);
+}
+
+ServiceDirectoryList ShardedServiceDirectory::searchByLocation(const std::string& regex, ServiceLocation::Field field, bool doThrow) const
+{
+    std::vector<ServiceDirectoryList> results(mShards.size());
+    forEachShard([this, &results, &regex, field](size_t i)
+        {
+            results[i] = mShards[i]->searchByLocation(regex, field, false);
+        });
+
+    ServiceDirectoryList resultList = merge(results);
+    if(resultList.empty() && doThrow)
+    {
+        throw NotFound("ServiceDirectoryEntry with location matching '" + regex + "'");
+    }
+    return resultList;
+}
+
+ServiceDirectoryList ShardedServiceDirectory::searchByQuery(const ServiceDirectoryQuery& query, bool doThrow) const
+{
+    std::string name;
+    const ServiceDirectoryQuery::Predicates& predicates = query.getPredicates();
+    ServiceDirectoryQuery::Predicates::const_iterator cit = predicates.begin();
+    for(; cit != predicates.end(); ++cit)
+    {
+        if(!cit->isLocation && cit->field == ServiceDirectoryEntry::NAME && ServiceDirectoryIndex::isLiteral(cit->regex, name))
+        {
+            break;
+        }
+    }
+
+    ServiceDirectoryList resultList;
+    if(cit != predicates.end())
+    {
+        resultList = mShards[getShardIndex(name)]->searchByQuery(query, false);
+    } else {
+        std::vector<ServiceDirectoryList> results(mShards.size());
+        forEachShard([this, &results, &query](size_t i)
+            {
+                results[i] = mShards[i]->searchByQuery(query, false);
+            });
+        resultList = merge(results);
+    }
+
+    if(resultList.empty() && doThrow)
+    {
+        throw NotFound("ServiceDirectoryEntry with " + query.toString());
+    }
+    return resultList;
+}
+
+ServiceDirectoryPage ShardedServiceDirectory::searchPage(const ServiceDirectoryQuery& query, size_t limit, const std::string& resumeToken) const
+{
+    std::vector<ServiceDirectoryPage> pages(mShards.size());
+    forEachShard([this, &pages, &query, limit, &resumeToken](size_t i)
+        {
+            pages[i] = mShards[i]->searchPage(query, limit, resumeToken);
+        });
+
+    bool hasMore = false;
+    std::vector<ServiceDirectoryList> results(mShards.size());
+    for(size_t i = 0; i < pages.size(); ++i)
+    {
+        hasMore = hasMore || !pages[i].isLast();
+        results[i].swap(pages[i].entries);
+    }
+
+    ServiceDirectoryPage page;
+    page.entries = merge(results);
+    if(page.entries.size() > limit)
+    {
+        page.entries.resize(limit);
+        hasMore = true;
+    }
+    if(hasMore)
+    {
+        page.resumeToken = ServiceDirectoryPage::createResumeToken(page.entries.back().getName());
+    }
+    return page;
+}
+
+void ShardedServiceDirectory::modify(const ServiceDirectoryEntry& entry)
+{
+    boost::shared_lock<boost::shared_mutex> lock(mWriteMutex);
+    mShards[getShardIndex(entry.getName())]->modify(entry);
+}
+
+ServiceDirectoryList ShardedServiceDirectory::getAll() const
+{
+    std::vector<ServiceDirectoryList> results(mShards.size());
+    forEachShard([this, &results](size_t i)
+        {
+            results[i] = mShards[i]->getAll();
+        });
+    return merge(results);
+}
+
+ServiceDirectoryIndex::ConstPtr ShardedServiceDirectory::getSnapshot() const
+{
+    ServiceDirectoryIndex::Ptr snapshot(new ServiceDirectoryIndex());
+    std::vector<ServiceDirectory::Ptr>::const_iterator it = mShards.begin();
+    for(; it != mShards.end(); ++it)
+    {
+        ServiceDirectoryIndex::ConstPtr shard = (*it)->getSnapshot();
+        const ServiceDirectoryMap& entries = shard->getEntries();
+        ServiceDirectoryMap::const_iterator cit = entries.begin();
+        for(; cit != entries.end(); ++cit)
+        {
+            snapshot->insert(cit->second);
+        }
+    }
+    return snapshot;
+}
+
+base::Time ShardedServiceDirectory::getTimestamp() const
+{
+    base::Time timestamp = ServiceDirectory::getTimestamp();
+    std::vector<ServiceDirectory::Ptr>::const_iterator it = mShards.begin();
+    for(; it != mShards.end(); ++it)
+    {
+        timestamp = std::max(timestamp, (*it)->getTimestamp());
+    }
+    return timestamp;
+}
+
+void ShardedServiceDirectory::mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field field)
+{
+    mergeSelectively(updateList, field, getUniqueFieldValues(updateList, field));
+}
+
+void ShardedServiceDirectory::mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field field, const std::set<std::string>& fieldValues)
+{
+    // No other modification may interfere between validation and merge
+    boost::unique_lock<boost::shared_mutex> lock(mWriteMutex);
+    // Validate the update list before any shard is modified
+    std::vector<ServiceDirectoryList> updates(mShards.size());
+    std::set<Name> additions;
+    ServiceDirectoryList::const_iterator uit = updateList.begin();
+    for(; uit != updateList.end(); ++uit)
+    {
+        Name name = uit->getName();
+        size_t shard = getShardIndex(name);
+        bool duplicate = !additions.insert(name).second;
+        if(!duplicate)
+        {
+            ServiceDirectoryList existing = mShards[shard]->lookupByName(name);
+            duplicate = !existing.empty() && !fieldValues.count(existing.front().getFieldContent(field));
+        }
+
+        if(duplicate)
+        {
+            LOG_WARN_S << "Duplicate entry: " << uit->toString();
+            throw DuplicateEntry(uit->toString());
+        }
+        updates[shard].push_back(*uit);
+    }
+
+    // Entries with the given field values need to be removed from all
+    // shards, even if a shard does not receive any update
+    batch([this, &updates, &fieldValues, field]()
+        {
+            forEachShard([this, &updates, &fieldValues, field](size_t i)
+                {
+                    mShards[i]->mergeSelectively(updates[i], field, fieldValues);
+                });
+        });
+}
+
+size_t ShardedServiceDirectory::restore(const ServiceDirectoryList& entries, const base::Time& leaseDuration)
+{
+    std::vector<ServiceDirectoryList> parts(mShards.size());
+    ServiceDirectoryList::const_iterator cit = entries.begin();
+    for(; cit != entries.end(); ++cit)
+    {
+        parts[getShardIndex(cit->getName())].push_back(*cit);
+    }
+
+    std::vector<size_t> restored(mShards.size(), 0);
+    boost::unique_lock<boost::shared_mutex> lock(mWriteMutex);
+    batch([this, &parts, &restored, &leaseDuration]()
+        {
+            forEachShard([this, &parts, &restored, &leaseDuration](size_t i)
+                {
+                    restored[i] = mShards[i]->restore(parts[i], leaseDuration);
+                });
+        });
+
+    size_t numberOfRestored = 0;
+    std::vector<size_t>::const_iterator rit = restored.begin();
+    for(; rit != restored.end(); ++rit)
+    {
+        numberOfRestored += *rit;
+    }
+    return numberOfRestored;
+}
+
+} // end namespace services
+} // end namespace fipa
@@ -0,0 +1,299 @@
+#ifndef FIPA_SERVICES_SHARDED_SERVICE_DIRECTORY_HPP
+#define FIPA_SERVICES_SHARDED_SERVICE_DIRECTORY_HPP
+
+#include <memory>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/thread/tss.hpp>
+#include <fipa_services/ServiceDirectory.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class ShardedServiceDirectory
+ * \brief Service directory which partitions the entries into shards by the hash of their name
+ * \details Each shard is a ServiceDirectory with its own lock and index, so
+ * that registrations of services with different names rarely contend.
+ * Operations on a single name, e.g. registerService, lookupByName or
+ * the search for a literal name, only access the shard the name belongs to.
+ * All other queries fan out to all shards -- in parallel if worker threads
+ * are available -- and the results are merged in name order.
+ *
+ * Modifications which involve multiple shards, e.g. mergeSelectively or
+ * registerServices, are serialized with all other modifications, so that
+ * they are validated and applied without interference. They are however
+ * not atomic for readers, which might see some shards modified and others
+ * not yet.
+ *
+ * Changes of the shards are published with a version of the sharded
+ * directory, so that subscribers see a single change feed. The changes of a
+ * modification of multiple shards share a single version and are published
+ * by the modifying thread.
+ *
+ * \verbatim
+ #include <fipa_services/ShardedServiceDirectory.hpp>
+
+ using namespace fipa::services;
+ ServiceDirectory::Ptr serviceDirectory(new ShardedServiceDirectory(16));
+ message_transport::MessageTransport messageTransport(fipa::acl::AgentID("mts"), serviceDirectory);
+ \endverbatim
+ */
+class ShardedServiceDirectory : public ServiceDirectory
+{
+public:
+    /**
+     * Constructor
+     * \param numberOfShards Number of shards, at least one shard is used
+     * \param mode Synchronization of readers and writers within each shard
+     * \param numberOfWorkers Number of threads which query shards in parallel
+     * to the calling thread, a negative number uses one thread less than
+     * the hardware concurrency. If set to 0 all shards are queried by the
+     * calling thread
+     */
+    ShardedServiceDirectory(size_t numberOfShards = 16, ConcurrencyMode mode = LOCKING, int numberOfWorkers = -1);
+
+    virtual ~ShardedServiceDirectory();
+
+    /**
+     * Get the number of shards
+     */
+    size_t getNumberOfShards() const { return mShards.size(); }
+
+    /**
+     * Get the number of worker threads
+     */
+    size_t getNumberOfWorkers() const { return mWorkers.size(); }
+
+    /**
+     * Get the shard a service of the given name is stored in
+     * \param name Name of the service
+     * \return index of the shard
+     */
+    size_t getShardIndex(const Name& name) const;
+
+    /**
+     * Register service in the shard of its name
+     * \param entry description object to add
+     * \throws DuplicateEntry
+     */
+    void registerService(const ServiceDirectoryEntry& entry);
+
+    /**
+     * Register service with a lease in the shard of its name
+     * \param entry description object to add
+     * \param leaseDuration Duration after which the service is removed unless
+     * the lease is renewed
+     * \throws DuplicateEntry
+     */
+    void registerService(const ServiceDirectoryEntry& entry, const base::Time& leaseDuration);
+
+    /**
+     * Register several services, with a single modification per shard
+     * \details The services are checked in all shards before any is
+     * registered, concurrent registrations of the same names may however
+     * cause a DuplicateEntry after some shards have been modified. The
+     * changes of all shards are published with a single version
+     * \param entries Entries of distinct names
+     * \throws DuplicateEntry
+     */
+    void registerServices(const ServiceDirectoryList& entries);
+
+    /**
+     * Renew the lease of a service in the shard of its name
+     * \throws NotFound if the service does not exist or has not been
+     * registered with a lease
+     */
+    void renewLease(const Name& name, const base::Time& leaseDuration);
+
+    /**
+     * Remove all services with an expired lease from all shards
+     * \param now Current time
+     * \return Number of removed services
+     */
+    size_t expireLeases(const base::Time& now = base::Time::now());
+
+    /**
+     * Deregister several services by name, with a single modification per
+     * shard, see registerServices
+     * \throws NotFound
+     */
+    void deregisterServices(const std::vector<Name>& names);
+
+    /**
+     * Remove a service
+     * \details Literal names are removed from their shard only, otherwise
+     * the first match in name order across all shards is removed
+     * \param regex regular expression
+     * \param field field to apply the regular expression on, default is name of the entry
+     * \throws NotFound
+     */
+    void deregisterService(const std::string& regex, ServiceDirectoryEntry::Field field = ServiceDirectoryEntry::NAME);
+
+    /**
+     * Search in all shards for services where the field matches the given
+     * regular expression
+     * \param regex Regular expression to match
+     * \param field Field name to apply the regex to
+     * \param doThrow Flag to control the throw behaviour, i.e. to throw an exception when no result has been found
+     * \throw NotFound
+     * \return Result list ordered by name
+     */
+    ServiceDirectoryList search(const std::string& regex, ServiceDirectoryEntry::Field field = ServiceDirectoryEntry::NAME, bool doThrow = true) const;
+
+    /**
+     * Call the visitor for each matching service, shard by shard
+     * \param regex Regular expression to match
+     * \param field Field name to apply the regex to
+     * \param visitor Function called for each matching entry, return false to
+     * stop the iteration
+     */
+    void forEachMatch(const std::string& regex, ServiceDirectoryEntry::Field field, const ServiceDirectoryVisitor& visitor) const;
+
+    /**
+     * Lookup a service by its exact name in the shard of the name
+     * \param name Name of the service
+     * \return Result list, which is either empty or contains the single
+     * matching entry
+     */
+    ServiceDirectoryList lookupByName(const Name& name) const;
+
+    /**
+     * Search in all shards for services with at least one service location
+     * matching the given regular expression
+     * \param regex Regular expression to match
+     * \param field Field of the service location to apply the regex to
+     * \param doThrow Flag to control the throw behaviour, i.e. to throw an exception when no result has been found
+     * \throw NotFound
+     * \return Result list ordered by name
+     */
+    ServiceDirectoryList searchByLocation(const std::string& regex, ServiceLocation::Field field = ServiceLocation::SERVICE_ADDRESS, bool doThrow = true) const;
+
+    /**
+     * Search for services matching all predicates of a query
+     * \details A query with a literal name only accesses the shard of the
+     * name, otherwise all shards are queried
+     * \param query Query combining predicates on several fields
+     * \param doThrow Flag to control the throw behaviour, i.e. to throw an exception when no result has been found
+     * \throw NotFound
+     * \return Result list ordered by name
+     */
+    ServiceDirectoryList searchByQuery(const ServiceDirectoryQuery& query, bool doThrow = true) const;
+
+    /**
+     * Get a page of the services matching all predicates of a query
+     * \details Each shard contributes its first entries after the resume
+     * token, which are merged by name
+     * \param query Query combining predicates on several fields
+     * \param limit Maximum number of entries of the page
+     * \param resumeToken Token of the previous page, empty for the first page
+     * \return Page of entries ordered by name
+     * \throws ArgumentError if the limit is 0 or the token is invalid
+     */
+    ServiceDirectoryPage searchPage(const ServiceDirectoryQuery& query, size_t limit, const std::string& resumeToken = "") const;
+
+    /**
+     * Modify an existing entry in the shard of its name
+     * \param entry Entry that updates the existing one
+     * \throws NotFound if entry does not exist
+     */
+    void modify(const ServiceDirectoryEntry& entry);
+
+    /**
+     * Retrieve all registered services of all shards
+     * \return List of all registered services ordered by name
+     */
+    ServiceDirectoryList getAll() const;
+
+    /**
+     * Get a snapshot of the registered services of all shards
+     * \details The snapshot is always a copy, which is only consistent per shard
+     */
+    ServiceDirectoryIndex::ConstPtr getSnapshot() const;
+
+    /**
+     * Get timestamp
+     * \return Latest modification time of all shards
+     */
+    base::Time getTimestamp() const;
+
+    /**
+     * Merge the update list into all shards
+     * \details The update list is validated for all shards before any shard
+     * is modified, each shard is then updated in a single transaction
+     * \param updateList list of services selected to update the existing one
+     * \param selectiveMerge Field by which entries are identified for removal
+     * \throws DuplicateEntry if the update list contains an entry twice or an
+     * entry of the update list exists but is not identified for removal
+     */
+    void mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field selectiveMerge);
+
+    /**
+     * Merge the update list into all shards and remove the entries where
+     * the field has one of the given values from all shards
+     * \details The update list is validated for all shards before any shard
+     * is modified, each shard is then updated in a single transaction
+     * \param updateList list of services selected to update the existing one
+     * \param selectiveMerge Field by which entries are identified for removal
+     * \param fieldValues Values of the field which identify the entries for removal
+     * \throws DuplicateEntry if the update list contains an entry twice or an
+     * entry of the update list exists but is not identified for removal
+     */
+    void mergeSelectively(const ServiceDirectoryList& updateList, ServiceDirectoryEntry::Field selectiveMerge, const std::set<std::string>& fieldValues);
+
+    /**
+     * Register the given services which are not registered yet in the
+     * shards of their names, with a single modification per shard
+     * \details Also used by restoreSnapshot
+     * \param entries Services to restore
+     * \param leaseDuration If not null, the restored services are registered
+     * with a lease of this duration
+     * \return Number of restored services
+     */
+    size_t restore(const ServiceDirectoryList& entries, const base::Time& leaseDuration = base::Time());
+
+private:
+    /**
+     * Call the job for each shard index, distributed over the
+     * calling thread and the worker threads
+     * \details Returns when the job has been completed for all shards, an
+     * exception thrown by a job is rethrown
+     */
+    void forEachShard(const std::function<void (size_t)>& job) const;
+
+    /**
+     * Run a modification of several shards, whose changes are published
+     * with a single version once the modification is completed
+     * \details The changes are collected from the calling thread as well as
+     * from the worker threads of forEachShard
+     * Requires mWriteMutex to be held exclusively
+     */
+    void batch(const std::function<void ()>& modification);
+
+    /**
+     * Concatenate the results of the shards and order them by name
+     */
+    static ServiceDirectoryList merge(const std::vector<ServiceDirectoryList>& results);
+
+    std::vector<ServiceDirectory::Ptr> mShards;
+    /// Changes of the shards collected within batch
+    struct Batch
+    {
+        boost::mutex mutex;
+        ServiceDirectoryChangeList changes;
+    };
+    /// Batch a thread contributes to, set for the calling thread of batch
+    /// and for worker threads running its jobs
+    mutable boost::thread_specific_ptr<Batch> mBatch;
+    /// Held shared by modifications of a single shard and exclusively by
+    /// modifications of multiple shards
+    boost::shared_mutex mWriteMutex;
+
+    mutable boost::asio::io_service mIOService;
+    std::unique_ptr<boost::asio::io_service::work> mWork;
+    boost::thread_group mWorkers;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_SHARDED_SERVICE_DIRECTORY_HPP
@@ -0,0 +1,149 @@
+#include "TimerWheel.hpp"
+#include <algorithm>
+
+namespace fipa {
+namespace services {
+
+TimerWheel::TimerWheel(const base::Time& resolution, const base::Time& start)
+    : mResolution(resolution)
+    , mStart(start)
+    , mCurrentTick(0)
+{
+    std::fill(mLevelSizes, mLevelSizes + LEVELS, 0);
+    if(mResolution.toMicroseconds() <= 0)
+    {
+        mResolution = base::Time::fromMicroseconds(1);
+    }
+}
+
+uint64_t TimerWheel::toTick(const base::Time& time) const
+{
+    int64_t elapsed = (time - mStart).toMicroseconds();
+    if(elapsed <= 0)
+    {
+        return 0;
+    }
+    int64_t resolution = mResolution.toMicroseconds();
+    return (elapsed + resolution - 1) / resolution;
+}
+
+void TimerWheel::schedule(const std::string& key, const base::Time& expiry)
+{
+    cancel(key);
+
+    Timer timer;
+    timer.key = key;
+    // Timers which are already due expire with the next tick
+    timer.tick = std::max(toTick(expiry), mCurrentTick + 1);
+    insert(timer);
+}
+
+bool TimerWheel::cancel(const std::string& key)
+{
+    std::unordered_map<std::string, Location>::iterator it = mTimers.find(key);
+    if(it == mTimers.end())
+    {
+        return false;
+    }
+    mSlots[it->second.level][it->second.slot].erase(it->second.timer);
+    --mLevelSizes[it->second.level];
+    mTimers.erase(it);
+    return true;
+}
+
+void TimerWheel::insert(const Timer& timer)
+{
+    uint64_t delta = timer.tick - mCurrentTick;
+    // Timers beyond the range of the wheel are placed into the farthest
+    // slot and cascaded again later
+    uint64_t tick = timer.tick;
+    size_t level = 0;
+    for(; level < LEVELS - 1; ++level)
+    {
+        if(delta < (uint64_t) 1 << (SLOT_BITS*(level + 1)))
+        {
+            break;
+        }
+    }
+    if(level == LEVELS - 1 && delta >= (uint64_t) 1 << (SLOT_BITS*LEVELS))
+    {
+        tick = mCurrentTick + ((uint64_t) 1 << (SLOT_BITS*LEVELS)) - 1;
+    }
+
+    size_t slot = (tick >> (SLOT_BITS*level)) & SLOT_MASK;
+    Slot& s = mSlots[level][slot];
+    Location location;
+    location.level = level;
+    location.slot = slot;
+    location.timer = s.insert(s.end(), timer);
+    mTimers[timer.key] = location;
+    ++mLevelSizes[level];
+}
+
+void TimerWheel::cascade(size_t level, size_t slot)
+{
+    Slot timers;
+    timers.swap(mSlots[level][slot]);
+    mLevelSizes[level] -= timers.size();
+    Slot::const_iterator cit = timers.begin();
+    for(; cit != timers.end(); ++cit)
+    {
+        insert(*cit);
+    }
+}
+
+std::vector<std::string> TimerWheel::advance(const base::Time& now)
+{
+    std::vector<std::string> expired;
+    // Only completely elapsed ticks are processed
+    int64_t elapsed = (now - mStart).toMicroseconds();
+    uint64_t targetTick = elapsed > 0 ? elapsed / mResolution.toMicroseconds() : 0;
+
+    while(mCurrentTick < targetTick)
+    {
+        // If the lower levels are empty, nothing happens until the next
+        // cascade of the lowest non-empty level
+        size_t lowest = 0;
+        while(lowest < LEVELS && mLevelSizes[lowest] == 0)
+        {
+            ++lowest;
+        }
+        if(lowest == LEVELS)
+        {
+            mCurrentTick = targetTick;
+            break;
+        } else if(lowest > 0)
+        {
+            uint64_t span = (uint64_t) 1 << (SLOT_BITS*lowest);
+            uint64_t nextCascade = (mCurrentTick/span + 1)*span;
+            if(nextCascade > targetTick)
+            {
+                mCurrentTick = targetTick;
+                break;
+            }
+            mCurrentTick = nextCascade - 1;
+        }
+
+        ++mCurrentTick;
+        size_t slot = mCurrentTick & SLOT_MASK;
+        for(size_t level = 1; slot == 0 && level < LEVELS; ++level)
+        {
+            slot = (mCurrentTick >> (SLOT_BITS*level)) & SLOT_MASK;
+            cascade(level, slot);
+        }
+
+        Slot& due = mSlots[0][mCurrentTick & SLOT_MASK];
+        Slot::const_iterator cit = due.begin();
+        for(; cit != due.end(); ++cit)
+        {
+            expired.push_back(cit->key);
+            mTimers.erase(cit->key);
+        }
+        mLevelSizes[0] -= due.size();
+        due.clear();
+    }
+    return expired;
+}
+
+} // end namespace services
+} // end namespace fipa
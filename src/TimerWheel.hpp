@@ -0,0 +1,122 @@
+#ifndef FIPA_SERVICES_TIMER_WHEEL_HPP
+#define FIPA_SERVICES_TIMER_WHEEL_HPP
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <base/Time.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class TimerWheel
+ * \brief Hierarchical timer wheel which tracks the expiry of named timers
+ * \details Time is divided into ticks of a fixed resolution. The wheel
+ * consists of LEVELS levels with SLOTS slots each, where a slot of level l
+ * spans SLOTS^l ticks. A timer is stored in the level matching its distance
+ * to the current tick and is moved to lower levels (cascaded) when time
+ * approaches its expiry. Scheduling and cancelling a timer is O(1), and
+ * advancing the wheel only touches the expired timers and the timers being
+ * cascaded -- there is no scan over all timers.
+ *
+ * Timers expire at the first tick at or after their expiry time, i.e. up to
+ * one resolution late but never early.
+ * The wheel is not thread-safe.
+ */
+class TimerWheel
+{
+public:
+    /**
+     * Constructor
+     * \param resolution Duration of a single tick
+     * \param start Time of tick 0
+     */
+    TimerWheel(const base::Time& resolution = base::Time::fromMilliseconds(10), const base::Time& start = base::Time::now());
+
+    /**
+     * Schedule a timer, replaces an existing timer of the same key
+     * \param key Key of the timer
+     * \param expiry Time at which the timer expires
+     */
+    void schedule(const std::string& key, const base::Time& expiry);
+
+    /**
+     * Cancel a timer
+     * \return false if no timer of this key exists
+     */
+    bool cancel(const std::string& key);
+
+    /**
+     * Check whether a timer exists for the given key
+     */
+    bool contains(const std::string& key) const { return mTimers.count(key); }
+
+    /**
+     * Advance the wheel to the given time
+     * \param now Current time
+     * \return Keys of all timers that expired
+     */
+    std::vector<std::string> advance(const base::Time& now);
+
+    /**
+     * Get the duration of a single tick
+     */
+    const base::Time& getResolution() const { return mResolution; }
+
+    /**
+     * Get the number of scheduled timers
+     */
+    size_t size() const { return mTimers.size(); }
+
+private:
+    static const size_t LEVELS = 4;
+    static const size_t SLOT_BITS = 8;
+    static const size_t SLOTS = 1 << SLOT_BITS;
+    static const uint64_t SLOT_MASK = SLOTS - 1;
+
+    struct Timer
+    {
+        std::string key;
+        uint64_t tick;
+    };
+
+    typedef std::list<Timer> Slot;
+
+    struct Location
+    {
+        size_t level;
+        size_t slot;
+        Slot::iterator timer;
+    };
+
+    /**
+     * Convert a time to a tick, rounding up
+     */
+    uint64_t toTick(const base::Time& time) const;
+
+    /**
+     * Add a timer to the slot matching its distance to the current tick
+     */
+    void insert(const Timer& timer);
+
+    /**
+     * Move all timers of a slot to lower levels
+     */
+    void cascade(size_t level, size_t slot);
+
+    base::Time mResolution;
+    base::Time mStart;
+    uint64_t mCurrentTick;
+
+    Slot mSlots[LEVELS][SLOTS];
+    // Number of timers per level, to skip ticks without any timer
+    size_t mLevelSizes[LEVELS];
+    std::unordered_map<std::string, Location> mTimers;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_TIMER_WHEEL_HPP
@@ -0,0 +1,172 @@
+#include "UnknownReceiverCache.hpp"
+#include "ServiceDirectoryIndex.hpp"
+
+namespace fipa {
+namespace services {
+
+UnknownReceiverCache::UnknownReceiverCache(const base::Time& lifetime, size_t capacity)
+    : mLifetime(lifetime)
+    , mCapacity(capacity)
+    , mNumberOfPatterns(0)
+    , mGeneration(0)
+    , mHits(0)
+    , mInsertions(0)
+    , mInvalidations(0)
+{
+}
+
+void UnknownReceiverCache::setLifetime(const base::Time& lifetime)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mLifetime = lifetime;
+}
+
+base::Time UnknownReceiverCache::getLifetime() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mLifetime;
+}
+
+bool UnknownReceiverCache::contains(const std::string& receiver, const base::Time& now)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    Receivers::iterator it = mReceivers.find(receiver);
+    if(it == mReceivers.end())
+    {
+        return false;
+    }
+    if(it->second.expiry <= now)
+    {
+        mNumberOfPatterns -= it->second.pattern;
+        mReceivers.erase(it);
+        return false;
+    }
+    ++mHits;
+    return true;
+}
+
+uint64_t UnknownReceiverCache::getGeneration() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mGeneration;
+}
+
+bool UnknownReceiverCache::insert(const std::string& receiver, uint64_t generation, const base::Time& now)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    if(generation != mGeneration || mLifetime.isNull())
+    {
+        return false;
+    }
+
+    Receivers::iterator it = mReceivers.find(receiver);
+    if(it == mReceivers.end())
+    {
+        if(mReceivers.size() >= mCapacity)
+        {
+            removeExpired(now);
+            // Receivers beyond the capacity are resolved every time
+            if(mReceivers.size() >= mCapacity)
+            {
+                return false;
+            }
+        }
+
+        Entry entry;
+        std::string literal;
+        // Escaped literals are treated as patterns, since they differ from
+        // the names they resolve to
+        entry.pattern = !ServiceDirectoryIndex::isLiteral(receiver, literal) || literal != receiver;
+        mNumberOfPatterns += entry.pattern;
+        it = mReceivers.insert(std::make_pair(receiver, entry)).first;
+    }
+    it->second.expiry = now + mLifetime;
+    ++mInsertions;
+    return true;
+}
+
+void UnknownReceiverCache::invalidate(const std::string& name)
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    ++mGeneration;
+
+    Receivers::iterator it = mReceivers.find(name);
+    if(it != mReceivers.end())
+    {
+        mNumberOfPatterns -= it->second.pattern;
+        mReceivers.erase(it);
+        ++mInvalidations;
+    }
+
+    // Any pattern might match the name
+    for(it = mReceivers.begin(); mNumberOfPatterns != 0 && it != mReceivers.end(); )
+    {
+        if(it->second.pattern)
+        {
+            it = mReceivers.erase(it);
+            --mNumberOfPatterns;
+            ++mInvalidations;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void UnknownReceiverCache::clear()
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    ++mGeneration;
+    mInvalidations += mReceivers.size();
+    mReceivers.clear();
+    mNumberOfPatterns = 0;
+}
+
+uint64_t UnknownReceiverCache::getHits() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mHits;
+}
+
+uint64_t UnknownReceiverCache::getInsertions() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mInsertions;
+}
+
+uint64_t UnknownReceiverCache::getInvalidations() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mInvalidations;
+}
+
+void UnknownReceiverCache::resetStatistics()
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    mHits = 0;
+    mInsertions = 0;
+    mInvalidations = 0;
+}
+
+size_t UnknownReceiverCache::size() const
+{
+    boost::unique_lock<boost::mutex> lock(mMutex);
+    return mReceivers.size();
+}
+
+void UnknownReceiverCache::removeExpired(const base::Time& now)
+{
+    Receivers::iterator it = mReceivers.begin();
+    while(it != mReceivers.end())
+    {
+        if(it->second.expiry <= now)
+        {
+            mNumberOfPatterns -= it->second.pattern;
+            it = mReceivers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // end namespace services
+} // end namespace fipa
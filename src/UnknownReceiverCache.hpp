@@ -0,0 +1,148 @@
+#ifndef FIPA_SERVICES_UNKNOWN_RECEIVER_CACHE_HPP
+#define FIPA_SERVICES_UNKNOWN_RECEIVER_CACHE_HPP
+
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+#include <boost/thread.hpp>
+#include <base/Time.hpp>
+
+namespace fipa {
+namespace services {
+
+/**
+ * \class UnknownReceiverCache
+ * \brief Bounded, thread-safe negative cache of receivers which could
+ * neither be resolved in the service directory nor delivered locally
+ * \details A receiver is cached for a short lifetime, so that letters to it
+ * fail without repeating the resolution. Since a receiver becomes
+ * resolvable when a matching service is added, additions have to be
+ * reported via invalidate: this drops the receiver of the same name and all
+ * receivers which are regular expressions. To avoid caching a receiver
+ * whose service has been added while it was resolved, the generation is
+ * read before resolving and passed to insert.
+ * \verbatim
+ #include <fipa_services/UnknownReceiverCache.hpp>
+
+ using namespace fipa::services;
+ UnknownReceiverCache cache;
+ if(!cache.contains(receiver))
+ {
+     uint64_t generation = cache.getGeneration();
+     if(!resolve(receiver))
+     {
+         cache.insert(receiver, generation);
+     }
+ }
+ \endverbatim
+ */
+class UnknownReceiverCache
+{
+public:
+    /**
+     * Constructor
+     * \param lifetime Time a receiver is cached, zero disables the cache
+     * \param capacity Maximum number of cached receivers
+     */
+    UnknownReceiverCache(const base::Time& lifetime = base::Time::fromSeconds(1), size_t capacity = 1024);
+
+    /**
+     * Set the time a receiver is cached, zero disables the cache
+     */
+    void setLifetime(const base::Time& lifetime);
+
+    /**
+     * Get the time a receiver is cached
+     */
+    base::Time getLifetime() const;
+
+    /**
+     * Check whether a receiver is known to be unresolvable, which counts as
+     * hit
+     * \param receiver Name or regular expression of the receiver
+     * \param now Current time
+     */
+    bool contains(const std::string& receiver, const base::Time& now = base::Time::now());
+
+    /**
+     * Get the current generation, which changes with each invalidation
+     */
+    uint64_t getGeneration() const;
+
+    /**
+     * Cache an unresolvable receiver, unless the cache has been invalidated
+     * since the given generation
+     * \param receiver Name or regular expression of the receiver
+     * \param generation Generation before the receiver has been resolved
+     * \param now Current time
+     * \return true if the receiver has been cached, false otherwise
+     */
+    bool insert(const std::string& receiver, uint64_t generation, const base::Time& now = base::Time::now());
+
+    /**
+     * Drop the receivers which may resolve to a service that has been added
+     * \param name Name of the added service
+     */
+    void invalidate(const std::string& name);
+
+    /**
+     * Drop all cached receivers, e.g. when local delivery has changed
+     */
+    void clear();
+
+    /**
+     * Number of contains calls for a cached receiver
+     */
+    uint64_t getHits() const;
+
+    /**
+     * Number of receivers that have been cached
+     */
+    uint64_t getInsertions() const;
+
+    /**
+     * Number of cached receivers that have been dropped by invalidate or
+     * clear
+     */
+    uint64_t getInvalidations() const;
+
+    /**
+     * Reset the counters
+     */
+    void resetStatistics();
+
+    /**
+     * Number of currently cached receivers, including expired ones
+     */
+    size_t size() const;
+
+private:
+    struct Entry
+    {
+        base::Time expiry;
+        /// Receiver is a regular expression, which may match any name
+        bool pattern;
+    };
+    typedef std::unordered_map<std::string, Entry> Receivers;
+
+    /**
+     * Drop the expired receivers
+     * Requires mMutex to be held
+     */
+    void removeExpired(const base::Time& now);
+
+    mutable boost::mutex mMutex;
+    base::Time mLifetime;
+    size_t mCapacity;
+    Receivers mReceivers;
+    size_t mNumberOfPatterns;
+    uint64_t mGeneration;
+
+    uint64_t mHits;
+    uint64_t mInsertions;
+    uint64_t mInvalidations;
+};
+
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_UNKNOWN_RECEIVER_CACHE_HPP
@@ -1,7 +1,7 @@
 #include "Address.hpp"
 
-#include <boost/regex.hpp>
-#include <boost/lexical_cast.hpp>
+#include <stdexcept>
+#include <cstring>
 
 namespace fipa {
 namespace services {
@@ -16,22 +16,60 @@ Address::Address(const std::string& ip, uint16_t port, const std::string& protoc
 
 std::string Address::toString() const
 {
-    return protocol + "://" + ip + ":" + boost::lexical_cast<std::string>(port);
+    // Format the port backwards into a local buffer
+    char digits[5];
+    char* end = digits + sizeof(digits);
+    char* begin = end;
+    uint16_t value = port;
+    do {
+        *--begin = '0' + value % 10;
+        value /= 10;
+    } while(value != 0);
+
+    std::string address;
+    address.reserve(protocol.size() + 3 + ip.size() + 1 + (end - begin));
+    address.append(protocol);
+    address.append("://", 3);
+    address.append(ip);
+    address.push_back(':');
+    address.append(begin, end);
+    return address;
 }
 
 Address Address::fromString(const std::string& addressString)
 {
-    boost::regex r("([^:]*)://([^:]*):([0-9]{1,5})");
-    boost::smatch what;
-    if(boost::regex_match(addressString, what, r))
+    // Accepts <protocol>://<ip>:<port>, where neither protocol nor ip contain
+    // a ':' and port has at most 5 digits
+    const char* begin = addressString.data();
+    const char* end = begin + addressString.size();
+
+    const char* protocolEnd = static_cast<const char*>(memchr(begin, ':', end - begin));
+    if(protocolEnd && end - protocolEnd > 3 && protocolEnd[1] == '/' && protocolEnd[2] == '/')
     {
-        std::string protocol(what[1].first, what[1].second);
-        std::string address(what[2].first, what[2].second);
-        uint16_t port = atoi( std::string(what[3].first, what[3].second).c_str() );
-        return Address(address, port, protocol);
-    } else {
-        throw std::invalid_argument("address '" + addressString + "' malformatted");
+        const char* ipBegin = protocolEnd + 3;
+        const char* ipEnd = static_cast<const char*>(memchr(ipBegin, ':', end - ipBegin));
+        if(ipEnd)
+        {
+            const char* portBegin = ipEnd + 1;
+            size_t portLength = end - portBegin;
+            uint32_t port = 0;
+            const char* c = portBegin;
+            for(; c != end && *c >= '0' && *c <= '9'; ++c)
+            {
+                port = port*10 + (*c - '0');
+            }
+
+            if(c == end && portLength > 0 && portLength <= 5 && port <= 0xFFFF)
+            {
+                Address address;
+                address.protocol.assign(begin, protocolEnd);
+                address.ip.assign(ipBegin, ipEnd);
+                address.port = static_cast<uint16_t>(port);
+                return address;
+            }
+        }
     }
+    throw std::invalid_argument("address '" + addressString + "' malformatted");
 }
 
 bool Address::operator==(const Address& other) const
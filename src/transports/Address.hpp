@@ -30,8 +30,9 @@ struct Address
     std::string toString() const;
 
     /**
-     * Create address from string
-     * \return std::invalid_argument if address is malformatted
+     * Create address from string of the form <protocol>://<ip>:<port>
+     * \throws std::invalid_argument if address is malformatted, or the port is
+     * out of range
      */
     static Address fromString(const std::string& address);
 
@@ -16,12 +16,6 @@ namespace fipa {
 namespace services {
 namespace transports {
 
-std::map<Transport::Type, std::string> Transport::TypeTxt = {
-    {Transport::UNKNOWN, "UNKNOWN"},
-    {Transport::UDT, "UDT"},
-    {Transport::TCP, "TCP"},
-    {Transport::ALL, "ALL"}};
-
 std::string Transport::getLocalIPv4Address(const std::string& interfaceName)
 {
     struct ifaddrs* interfaces;
@@ -84,22 +78,6 @@ Transport::Transport(const Configuration& config)
     , mConfiguration(config)
 {}
 
-Transport::Type Transport::getTypeFromTxt(const std::string& type)
-{
-    std::string tmp = type;
-    boost::to_upper(tmp);
-    std::map<Type, std::string>::const_iterator cit = TypeTxt.begin();
-    for(; cit != TypeTxt.end(); ++cit)
-    {
-        if(cit->second == tmp)
-        {
-            return cit->first;
-        }
-    }
-    throw std::invalid_argument("Transport::getTypeFromString: unknown type '" + type + "'");
-
-}
-
 void Transport::registerObserver(TransportObserver observer)
 {
     mObservers.push_back(observer);
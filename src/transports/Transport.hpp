@@ -9,6 +9,7 @@
 #include <fipa_services/transports/udt/OutgoingConnection.hpp>
 
 #include "Configuration.hpp"
+#include "TransportType.hpp"
 
 namespace fipa {
 namespace services {
@@ -21,14 +22,8 @@ typedef std::function<void (const std::string&)> TransportObserver;
  * \class Transport
  * \brief Connection management base class
  */
-class Transport
+class Transport : public TransportType
 {
-public:
-    /// Builtin transport types that can be activated
-    enum Type { UNKNOWN = 0x00, UDT = 0x01, TCP = 0x02, ALL = 0xFF };
-
-    static std::map<Type, std::string> TypeTxt;
-
 private:
     Type mType; 
     std::vector<TransportObserver> mObservers;
@@ -51,11 +46,6 @@ public:
      */
     static Transport::Ptr create(Type type);
 
-    /**
-     * Retrieve the type for a given string
-     */
-    static Type getTypeFromTxt(const std::string& typeTxt);
-
     /**
      * Register a callback function that is called via 
      * notify when new data arrives
@@ -0,0 +1,34 @@
+#include "TransportType.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <stdexcept>
+
+namespace fipa {
+namespace services {
+namespace transports {
+
+std::map<TransportType::Type, std::string> TransportType::TypeTxt = {
+    {TransportType::UNKNOWN, "UNKNOWN"},
+    {TransportType::UDT, "UDT"},
+    {TransportType::TCP, "TCP"},
+    {TransportType::ALL, "ALL"}};
+
+TransportType::Type TransportType::getTypeFromTxt(const std::string& type)
+{
+    std::string tmp = type;
+    boost::to_upper(tmp);
+    std::map<Type, std::string>::const_iterator cit = TypeTxt.begin();
+    for(; cit != TypeTxt.end(); ++cit)
+    {
+        if(cit->second == tmp)
+        {
+            return cit->first;
+        }
+    }
+    throw std::invalid_argument("Transport::getTypeFromString: unknown type '" + type + "'");
+
+}
+
+} // end namespace transports
+} // end namespace services
+} // end namespace fipa
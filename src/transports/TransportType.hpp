@@ -0,0 +1,34 @@
+#ifndef FIPA_SERVICES_TRANSPORTS_TRANSPORT_TYPE_HPP
+#define FIPA_SERVICES_TRANSPORTS_TRANSPORT_TYPE_HPP
+
+#include <map>
+#include <string>
+
+namespace fipa {
+namespace services {
+namespace transports {
+
+/**
+ * \class TransportType
+ * \brief Builtin transport types that can be activated
+ * \details Kept apart from Transport, so that service locations can refer to
+ * the type of their transport without depending on the transport
+ * implementations
+ */
+struct TransportType
+{
+    enum Type { UNKNOWN = 0x00, UDT = 0x01, TCP = 0x02, ALL = 0xFF };
+
+    static std::map<Type, std::string> TypeTxt;
+
+    /**
+     * Retrieve the type for a given string
+     * \throws std::invalid_argument if the type is unknown
+     */
+    static Type getTypeFromTxt(const std::string& typeTxt);
+};
+
+} // end namespace transports
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_TRANSPORTS_TRANSPORT_TYPE_HPP
@@ -0,0 +1,107 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/regex.hpp>
+#include <iostream>
+#include <sstream>
+#include <base/Time.hpp>
+#include <fipa_services/ServiceLocator.hpp>
+
+using namespace fipa::services;
+using namespace fipa::services::transports;
+
+BOOST_AUTO_TEST_SUITE(address_benchmark)
+
+BOOST_AUTO_TEST_CASE(address_parsing)
+{
+    const size_t iterations = 1000000;
+    std::vector<std::string> addresses;
+    for(size_t i = 0; i < 100; ++i)
+    {
+        std::stringstream ss;
+        ss << (i % 2 ? "udt" : "tcp") << "://192.168.0." << i << ":" << 2000 + i;
+        addresses.push_back(ss.str());
+    }
+
+    std::cout << "Address parsing: " << iterations << " addresses" << std::endl;
+
+    // Reference: parsing with a regular expression
+    static const boost::regex r("([^:]*)://([^:]*):([0-9]{1,5})");
+    size_t ports = 0;
+    base::Time start = base::Time::now();
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        boost::smatch what;
+        const std::string& address = addresses[i % addresses.size()];
+        if(boost::regex_match(address, what, r))
+        {
+            Address parsed(std::string(what[2].first, what[2].second), atoi(std::string(what[3].first, what[3].second).c_str()), std::string(what[1].first, what[1].second));
+            ports += parsed.port;
+        }
+    }
+    base::Time regexTime = base::Time::now() - start;
+
+    size_t parsedPorts = 0;
+    start = base::Time::now();
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        parsedPorts += Address::fromString(addresses[i % addresses.size()]).port;
+    }
+    base::Time parseTime = base::Time::now() - start;
+    BOOST_REQUIRE(ports == parsedPorts);
+
+    size_t length = 0;
+    Address address = Address::fromString(addresses[0]);
+    start = base::Time::now();
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        address.port = i;
+        length += address.toString().size();
+    }
+    base::Time formatTime = base::Time::now() - start;
+    BOOST_REQUIRE(length > 0);
+
+    std::cout << "    regex: " << regexTime.toMilliseconds() << " ms"
+        << ", fromString: " << parseTime.toMilliseconds() << " ms"
+        << ", toString: " << formatTime.toMilliseconds() << " ms" << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(locator_parsing)
+{
+    const size_t iterations = 100000;
+    std::string location = "udt://192.168.0.1:12391 fipa::services::transports::MessageTransport mts-0";
+    std::string locator = location + ";tcp://192.168.0.1:12392 fipa::services::transports::MessageTransport mts-0";
+
+    std::cout << "Service location parsing: " << iterations << " strings" << std::endl;
+
+    size_t ports = 0;
+    base::Time start = base::Time::now();
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        ports += ServiceLocation::fromString(location).getAddress().port;
+    }
+    base::Time locationTime = base::Time::now() - start;
+
+    size_t locations = 0;
+    start = base::Time::now();
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        locations += ServiceLocator::fromString(locator).getLocations().size();
+    }
+    base::Time locatorTime = base::Time::now() - start;
+    BOOST_REQUIRE(ports == iterations*12391 && locations == 2*iterations);
+
+    ServiceLocator parsed = ServiceLocator::fromString(locator);
+    size_t length = 0;
+    start = base::Time::now();
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        length += parsed.toString().size();
+    }
+    base::Time formatTime = base::Time::now() - start;
+    BOOST_REQUIRE(length == iterations*(locator.size() + 1));
+
+    std::cout << "    ServiceLocation::fromString (incl. address): " << locationTime.toMilliseconds() << " ms"
+        << ", ServiceLocator::fromString (2 locations): " << locatorTime.toMilliseconds() << " ms"
+        << ", ServiceLocator::toString: " << formatTime.toMilliseconds() << " ms" << std::endl;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
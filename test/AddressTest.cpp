@@ -0,0 +1,29 @@
+#include <boost/test/unit_test.hpp>
+#include <fipa_services/transports/Address.hpp>
+
+using namespace fipa::services::transports;
+
+BOOST_AUTO_TEST_SUITE(address)
+
+BOOST_AUTO_TEST_CASE(parsing)
+{
+    Address address = Address::fromString("udt://192.168.0.1:2000");
+    BOOST_REQUIRE(address.protocol == "udt");
+    BOOST_REQUIRE(address.ip == "192.168.0.1");
+    BOOST_REQUIRE(address.port == 2000);
+    BOOST_REQUIRE(address.toString() == "udt://192.168.0.1:2000");
+
+    address = Address::fromString("tcp://localhost:65535");
+    BOOST_REQUIRE(address.port == 65535);
+    BOOST_REQUIRE(Address("10.0.0.1", 0, "tcp").toString() == "tcp://10.0.0.1:0");
+
+    const char* malformatted[] = { "", "udt", "udt://", "udt://192.168.0.1", "udt://192.168.0.1:",
+        "udt:/192.168.0.1:2000", "udt://192.168.0.1:2000x", "udt://192.168.0.1:-1",
+        "udt://192.168.0.1:123456", "udt://192.168.0.1:65536", "udt://::1:2000" };
+    for(size_t i = 0; i < sizeof(malformatted)/sizeof(const char*); ++i)
+    {
+        BOOST_REQUIRE_THROW(Address::fromString(malformatted[i]), std::invalid_argument);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
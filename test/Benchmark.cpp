@@ -0,0 +1,5 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE benchmarks
+#define BOOST_AUTO_TEST_MAIN
+#include <boost/test/unit_test.hpp>
@@ -0,0 +1,188 @@
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <sstream>
+#include <fipa_services/DistributedServiceDirectory.hpp>
+#include <fipa_services/InProcessDiscoveryBackend.hpp>
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(distributed_service_directory_benchmark)
+
+namespace {
+    ServiceDirectoryEntry createNodeEntry(size_t node, size_t id)
+    {
+        std::stringstream ss;
+        ss << "robot_" << node << "_" << id << ".arm.planner";
+
+        ServiceLocator locator;
+        locator.addLocation(ServiceLocation("udt://192.168.0.1:12391", "fipa::services::transports::MessageTransport"));
+        return ServiceDirectoryEntry(ss.str(), "fipa::services::transports::MessageTransport", locator, "Message client of mts-0");
+    }
+
+    typedef std::vector< std::shared_ptr<DistributedServiceDirectory> > Nodes;
+
+    Nodes createNodes(const InProcessDiscoveryNetwork::Ptr& network, size_t size)
+    {
+        Nodes nodes;
+        for(size_t n = 0; n < size; ++n)
+        {
+            nodes.push_back(std::shared_ptr<DistributedServiceDirectory>(new DistributedServiceDirectory(std::vector<std::string>(1, DEFAULT_SERVICE_SCOPE),
+                DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)))));
+        }
+        return nodes;
+    }
+
+    bool converged(const Nodes& nodes, size_t services)
+    {
+        Nodes::const_iterator cit = nodes.begin();
+        for(; cit != nodes.end(); ++cit)
+        {
+            if((*cit)->getAll().size() != services)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(register_throughput)
+{
+    const size_t numberOfNodes = 4;
+    const size_t services = 1000;
+    const char* methodTxt[] = { "registerService", "registerServices" };
+
+    std::cout << "DistributedServiceDirectory registration of " << services << " services on each of " << numberOfNodes
+        << " nodes, until visible on all nodes" << std::endl;
+    for(size_t m = 0; m < 2; ++m)
+    {
+        InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork(base::Time::fromMilliseconds(1)));
+        Nodes nodes = createNodes(network, numberOfNodes);
+        std::vector<ServiceDirectoryList> entries(numberOfNodes);
+        for(size_t n = 0; n < numberOfNodes; ++n)
+        {
+            for(size_t id = 0; id < services; ++id)
+            {
+                entries[n].push_back(createNodeEntry(n, id));
+            }
+        }
+
+        base::Time start = base::Time::now();
+        for(size_t n = 0; n < numberOfNodes; ++n)
+        {
+            if(m == 0)
+            {
+                ServiceDirectoryList::const_iterator cit = entries[n].begin();
+                for(; cit != entries[n].end(); ++cit)
+                {
+                    nodes[n]->registerService(*cit);
+                }
+            } else {
+                nodes[n]->registerServices(entries[n]);
+            }
+        }
+        base::Time registrationTime = base::Time::now() - start;
+        network->flush();
+        base::Time totalTime = base::Time::now() - start;
+        BOOST_REQUIRE(converged(nodes, numberOfNodes*services));
+
+        std::cout << "    " << methodTxt[m] << " registration: " << registrationTime.toMilliseconds() << " ms, visible after: "
+            << totalTime.toMilliseconds() << " ms (" << static_cast<uint64_t>(numberOfNodes*services / totalTime.toSeconds()) << " services/s)" << std::endl;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(search_throughput)
+{
+    const size_t numberOfNodes = 4;
+    const size_t services = 2500;
+    const size_t lookups = 10000;
+    const size_t searches = 100;
+
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork(base::Time::fromMilliseconds(1)));
+    Nodes nodes = createNodes(network, numberOfNodes);
+    for(size_t n = 0; n < numberOfNodes; ++n)
+    {
+        ServiceDirectoryList entries;
+        for(size_t id = 0; id < services; ++id)
+        {
+            entries.push_back(createNodeEntry(n, id));
+        }
+        nodes[n]->registerServices(entries);
+    }
+    network->flush();
+    BOOST_REQUIRE(converged(nodes, numberOfNodes*services));
+    const DistributedServiceDirectory& directory = *nodes.front();
+
+    std::cout << "DistributedServiceDirectory searches in a cache of " << numberOfNodes*services << " services" << std::endl;
+
+    std::vector<Name> names;
+    for(size_t i = 0; i < lookups; ++i)
+    {
+        names.push_back(createNodeEntry(i % numberOfNodes, i % services).getName());
+    }
+    base::Time start = base::Time::now();
+    for(size_t i = 0; i < lookups; ++i)
+    {
+        BOOST_REQUIRE(directory.lookupByName(names[i]).size() == 1);
+    }
+    base::Time lookupTime = base::Time::now() - start;
+
+    start = base::Time::now();
+    for(size_t i = 0; i < searches; ++i)
+    {
+        BOOST_REQUIRE(directory.search(names[i], ServiceDirectoryEntry::NAME, true).size() == 1);
+    }
+    base::Time exactTime = base::Time::now() - start;
+
+    start = base::Time::now();
+    for(size_t i = 0; i < searches; ++i)
+    {
+        BOOST_REQUIRE(directory.search("robot_1_.*", ServiceDirectoryEntry::NAME, false).size() == services);
+    }
+    base::Time regexTime = base::Time::now() - start;
+
+    std::cout << "    lookupByName: " << static_cast<uint64_t>(lookups / lookupTime.toSeconds()) << " lookups/s" << std::endl;
+    std::cout << "    exact name search: " << static_cast<uint64_t>(searches / exactTime.toSeconds()) << " searches/s" << std::endl;
+    std::cout << "    regex name search: " << static_cast<uint64_t>(searches / regexTime.toSeconds()) << " searches/s" << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(convergence_under_loss)
+{
+    const size_t numberOfNodes = 8;
+    const size_t services = 100;
+    const base::Time delay = base::Time::fromMilliseconds(5);
+    double losses[] = { 0.0, 0.05, 0.2 };
+
+    std::cout << "DistributedServiceDirectory convergence of " << numberOfNodes << " nodes with " << services
+        << " services each, reannouncing every " << delay.toMilliseconds() << " ms" << std::endl;
+    for(size_t l = 0; l < sizeof(losses)/sizeof(double); ++l)
+    {
+        InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork(delay, losses[l], 1));
+        Nodes nodes = createNodes(network, numberOfNodes);
+        for(size_t n = 0; n < numberOfNodes; ++n)
+        {
+            ServiceDirectoryList entries;
+            for(size_t id = 0; id < services; ++id)
+            {
+                entries.push_back(createNodeEntry(n, id));
+            }
+            nodes[n]->registerServices(entries);
+        }
+
+        size_t rounds = 0;
+        network->flush();
+        while(!converged(nodes, numberOfNodes*services))
+        {
+            BOOST_REQUIRE(rounds < 100);
+            network->reannounce();
+            network->flush();
+            ++rounds;
+        }
+
+        std::cout << "    loss " << losses[l] << ": " << rounds << " reannouncements, converged after " << network->getTime().toMilliseconds()
+            << " ms simulated, " << network->getNumberOfLostEvents() << " of " << network->getNumberOfLostEvents() + network->getNumberOfDeliveredEvents()
+            << " events lost" << std::endl;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
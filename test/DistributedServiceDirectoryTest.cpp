@@ -1,7 +1,9 @@
 #include <boost/test/unit_test.hpp>
 #include <iostream>
 #include <sstream>
+#include <fipa_services/AvahiServicePublisher.hpp>
 #include <fipa_services/DistributedServiceDirectory.hpp>
+#include <fipa_services/InProcessDiscoveryBackend.hpp>
 BOOST_AUTO_TEST_SUITE(distributed_service_directory_suite)
 
 std::string getProtocolPath()
@@ -15,7 +17,7 @@ std::string getProtocolPath()
     return configurationPath;
 }
 
-BOOST_AUTO_TEST_CASE(distributed_service_directory_test)
+BOOST_AUTO_TEST_CASE(convert)
 {
     using namespace fipa::services;
     using namespace servicediscovery;
@@ -53,6 +55,24 @@ BOOST_AUTO_TEST_CASE(distributed_service_directory_test)
         BOOST_REQUIRE_MESSAGE(expected == received, "Distributed: conversion description -- got '" << received << "' expected '" << expected << "'");
     }
 
+    ServiceDirectoryEntry converted = DistributedServiceDirectory::convert(serviceDescription);
+    BOOST_REQUIRE(converted.getName() == name);
+    BOOST_REQUIRE(converted.getType() == type);
+    BOOST_REQUIRE(converted.getLocator().toString() == locator.toString());
+    BOOST_REQUIRE(converted.getDescription() == description);
+}
+
+// Integration tests which require a running avahi daemon, they are disabled
+// by default and run with --run_test=@avahi
+BOOST_AUTO_TEST_CASE(distributed_service_directory_test, *boost::unit_test::label("avahi") *boost::unit_test::disabled())
+{
+    using namespace fipa::services;
+
+    Name name("test-name");
+    Type type = "_test._tcp";
+    ServiceLocator locator = ServiceLocator::fromString("url://test/url;http://bla.org");
+    Description description = "test description of this service";
+
     DistributedServiceDirectory distributedServiceDirectory;
     BOOST_REQUIRE_THROW( distributedServiceDirectory.search(name, ServiceDirectoryEntry::NAME, true), NotFound );
     // Register 5 Services
@@ -91,5 +111,333 @@ BOOST_AUTO_TEST_CASE(distributed_service_directory_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(shared_publisher, *boost::unit_test::label("avahi") *boost::unit_test::disabled())
+{
+    using namespace fipa::services;
+
+    // Modifications within the commit delay are committed together
+    AvahiServicePublisher publisher(base::Time::fromMilliseconds(100));
+    ServiceLocator locator = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+    std::vector<servicediscovery::avahi::ServiceDescription> descriptions;
+    for(int i = 0; i < 50; ++i)
+    {
+        std::stringstream ss;
+        ss << "shared_" << i;
+        descriptions.push_back(DistributedServiceDirectory::convert(ServiceDirectoryEntry(ss.str(), "_test._tcp", locator, "")));
+    }
+    publisher.publish(DEFAULT_SERVICE_SCOPE, descriptions);
+    publisher.publish(DEFAULT_SERVICE_SCOPE, descriptions.front());
+    BOOST_REQUIRE(publisher.getNumberOfServices() == 50);
+
+    DistributedServiceDirectory directory;
+    sleep(5);
+    BOOST_REQUIRE(directory.search("shared_.*", ServiceDirectoryEntry::NAME, false).size() == 50);
+
+    std::vector<std::string> names;
+    names.push_back("shared_0");
+    names.push_back("unknown");
+    BOOST_REQUIRE(publisher.unpublish(DEFAULT_SERVICE_SCOPE, names) == 1);
+    BOOST_REQUIRE(!publisher.unpublish("_unknown._udp", "shared_1"));
+    BOOST_REQUIRE(publisher.getNumberOfServices() == 49);
+    sleep(5);
+    BOOST_REQUIRE(directory.search("shared_.*", ServiceDirectoryEntry::NAME, false).size() == 49);
+}
+
+BOOST_AUTO_TEST_CASE(publisher_collision, *boost::unit_test::label("avahi") *boost::unit_test::disabled())
+{
+    using namespace fipa::services;
+
+    // The services of the second publisher, which do not collide, remain
+    // published
+    AvahiServicePublisher first;
+    AvahiServicePublisher second;
+    ServiceLocator locator = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+    first.publish(DEFAULT_SERVICE_SCOPE, DistributedServiceDirectory::convert(ServiceDirectoryEntry("collision_0", "_test._tcp", locator, "first")));
+    sleep(2);
+
+    std::vector<servicediscovery::avahi::ServiceDescription> descriptions;
+    for(int i = 0; i < 5; ++i)
+    {
+        std::stringstream ss;
+        ss << "collision_" << i;
+        descriptions.push_back(DistributedServiceDirectory::convert(ServiceDirectoryEntry(ss.str(), "_test._tcp", locator, "second")));
+    }
+    second.publish(DEFAULT_SERVICE_SCOPE, descriptions);
+
+    DistributedServiceDirectory directory;
+    sleep(5);
+    BOOST_REQUIRE(directory.search("collision_.*", ServiceDirectoryEntry::NAME, false).size() == 5);
+    BOOST_REQUIRE(directory.lookupByName("collision_0").front().getDescription() == "first");
+}
+
+BOOST_AUTO_TEST_CASE(local_cache)
+{
+    using namespace fipa::services;
+
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork());
+    // Publishes the services of another node
+    std::shared_ptr<InProcessDiscoveryBackend> remote(new InProcessDiscoveryBackend(network));
+    ServiceLocator locator = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+    remote->publish(DEFAULT_SERVICE_SCOPE, ServiceDirectoryList(1, ServiceDirectoryEntry("visible", "planner", locator, "")));
+
+    DistributedServiceDirectory directory(std::vector<std::string>(1, DEFAULT_SERVICE_SCOPE), DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    network->flush();
+    BOOST_REQUIRE(directory.search("visible", ServiceDirectoryEntry::NAME, true).size() == 1);
+
+    ServiceDirectoryChangeList changes;
+    uint64_t version = directory.getVersion();
+
+    // Services are searched in the cache, which follows the events
+    remote->publish(DEFAULT_SERVICE_SCOPE, ServiceDirectoryList(1, ServiceDirectoryEntry("agent.0", "planner", locator, "")));
+    network->flush();
+    BOOST_REQUIRE(directory.search("planner", ServiceDirectoryEntry::TYPE, true).size() == 2);
+    BOOST_REQUIRE(directory.lookupByName("agent.0").size() == 1);
+    BOOST_REQUIRE(directory.searchByLocation("tcp://.*").size() == 2);
+
+    remote->publish(DEFAULT_SERVICE_SCOPE, ServiceDirectoryList(1, ServiceDirectoryEntry("agent.0", "planner", locator, "updated")));
+    network->flush();
+    BOOST_REQUIRE(directory.lookupByName("agent.0").front().getDescription() == "updated");
+    BOOST_REQUIRE(directory.getAll().size() == 2);
+
+    remote->unpublish(DEFAULT_SERVICE_SCOPE, std::vector<Name>(1, "agent.0"));
+    network->flush();
+    BOOST_REQUIRE(directory.lookupByName("agent.0").empty());
+    BOOST_REQUIRE_THROW(directory.search("agent.*", ServiceDirectoryEntry::NAME, true), NotFound);
+
+    BOOST_REQUIRE(directory.getChanges(version, changes));
+    BOOST_REQUIRE(changes.size() == 3);
+    BOOST_REQUIRE(changes[0].type == ServiceDirectoryChange::ADDED);
+    BOOST_REQUIRE(changes[1].type == ServiceDirectoryChange::MODIFIED);
+    BOOST_REQUIRE(changes[2].type == ServiceDirectoryChange::REMOVED);
+}
+
+BOOST_AUTO_TEST_CASE(async_registration)
+{
+    using namespace fipa::services;
+
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork());
+    DistributedServiceDirectory directory(std::vector<std::string>(1, DEFAULT_SERVICE_SCOPE), DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    ServiceLocator locator = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+
+    std::vector<std::future<void> > futures;
+    for(int i = 0; i < 100; ++i)
+    {
+        std::stringstream ss;
+        ss << "async_" << i;
+        futures.push_back(directory.registerServiceAsync(ServiceDirectoryEntry(ss.str(), "_test._tcp", locator, "")));
+    }
+    // Coalesced with the pending registration
+    futures.push_back(directory.registerServiceAsync(ServiceDirectoryEntry("transient", "_test._tcp", locator, "")));
+    futures.push_back(directory.deregisterServiceAsync("transient"));
+
+    for(size_t i = 0; i < futures.size(); ++i)
+    {
+        BOOST_REQUIRE_NO_THROW(futures[i].get());
+    }
+    BOOST_REQUIRE(directory.getRegisteredServices().size() == 100);
+    network->flush();
+    BOOST_REQUIRE(directory.search("async_.*", ServiceDirectoryEntry::NAME, false).size() == 100);
+
+    std::future<void> unknown = directory.deregisterServiceAsync("unknown");
+    BOOST_REQUIRE_THROW(unknown.get(), NotFound);
+
+    futures.clear();
+    for(int i = 0; i < 100; ++i)
+    {
+        std::stringstream ss;
+        ss << "async_" << i;
+        futures.push_back(directory.deregisterServiceAsync(ss.str()));
+    }
+    for(size_t i = 0; i < futures.size(); ++i)
+    {
+        BOOST_REQUIRE_NO_THROW(futures[i].get());
+    }
+    BOOST_REQUIRE(directory.getRegisteredServices().empty());
+}
+
+BOOST_AUTO_TEST_CASE(bulk_registration)
+{
+    using namespace fipa::services;
+
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork());
+    DistributedServiceDirectory directory(std::vector<std::string>(1, DEFAULT_SERVICE_SCOPE), DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    ServiceLocator locator = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+
+    ServiceDirectoryList entries;
+    std::vector<Name> names;
+    for(int i = 0; i < 10; ++i)
+    {
+        std::stringstream ss;
+        ss << "bulk_" << i;
+        entries.push_back(ServiceDirectoryEntry(ss.str(), "_test._tcp", locator, ""));
+        names.push_back(ss.str());
+    }
+    directory.registerServices(entries);
+    BOOST_REQUIRE(directory.getRegisteredServices().size() == 10);
+    network->flush();
+    BOOST_REQUIRE(directory.search("bulk_.*", ServiceDirectoryEntry::NAME, false).size() == 10);
+
+    names.push_back("unknown");
+    BOOST_REQUIRE_THROW(directory.deregisterServices(names), NotFound);
+    BOOST_REQUIRE(directory.getRegisteredServices().size() == 10);
+    names.pop_back();
+    directory.deregisterServices(names);
+    BOOST_REQUIRE(directory.getRegisteredServices().empty());
+    network->flush();
+    BOOST_REQUIRE(directory.getAll().empty());
+}
+
+BOOST_AUTO_TEST_CASE(leases)
+{
+    using namespace fipa::services;
+
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork());
+    DistributedServiceDirectory directory(std::vector<std::string>(1, DEFAULT_SERVICE_SCOPE), DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    ServiceLocator locator = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+    base::Time lease = base::Time::fromSeconds(10);
+    directory.registerService(ServiceDirectoryEntry("agent_0", "planner", locator, ""), lease);
+    directory.registerService(ServiceDirectoryEntry("agent_1", "planner", locator, ""), lease);
+    directory.registerService(ServiceDirectoryEntry("agent_2", "planner", locator, ""));
+    BOOST_REQUIRE_THROW(directory.renewLease("agent_2", lease), NotFound);
+    network->flush();
+    BOOST_REQUIRE(directory.getAll().size() == 3);
+
+    base::Time now = base::Time::now();
+    BOOST_REQUIRE_NO_THROW(directory.renewLease("agent_1", base::Time::fromSeconds(20)));
+    BOOST_REQUIRE(directory.expireLeases(now + base::Time::fromSeconds(11)) == 1);
+    BOOST_REQUIRE(directory.getRegisteredServices().size() == 2);
+    network->flush();
+    BOOST_REQUIRE(directory.lookupByName("agent_0").empty());
+    BOOST_REQUIRE(directory.getAll().size() == 2);
+
+    // A deregistered service does not keep its lease
+    directory.deregisterService("agent_1", ServiceDirectoryEntry::NAME);
+    BOOST_REQUIRE(directory.expireLeases(now + base::Time::fromSeconds(30)) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(modification)
+{
+    using namespace fipa::services;
+
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork());
+    std::vector<std::string> scopes(1, DEFAULT_SERVICE_SCOPE);
+    DistributedServiceDirectory a(scopes, DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    DistributedServiceDirectory b(scopes, DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    ServiceLocator locator = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+    a.registerService(ServiceDirectoryEntry("agent_0", "planner", locator, "initial"), base::Time::fromSeconds(10));
+    network->flush();
+
+    // Modifications are published to all nodes
+    a.modify(ServiceDirectoryEntry("agent_0", "planner", locator, "modified"));
+    network->flush();
+    BOOST_REQUIRE(b.lookupByName("agent_0").front().getDescription() == "modified");
+    BOOST_REQUIRE(a.getRegisteredServices().front().getDescription() == "modified");
+    BOOST_REQUIRE_NO_THROW(a.renewLease("agent_0", base::Time::fromSeconds(10)));
+
+    // Only services of this instance can be modified
+    BOOST_REQUIRE_THROW(b.modify(ServiceDirectoryEntry("agent_0", "planner", locator, "")), NotFound);
+    BOOST_REQUIRE_THROW(b.restore(a.getAll()), NotSupported);
+    BOOST_REQUIRE(b.lookupByName("agent_0").front().getDescription() == "modified");
+}
+
+BOOST_AUTO_TEST_CASE(selective_merge)
+{
+    using namespace fipa::services;
+
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork());
+    std::vector<std::string> scopes(1, DEFAULT_SERVICE_SCOPE);
+    DistributedServiceDirectory a(scopes, DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    DistributedServiceDirectory b(scopes, DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    ServiceLocator locator0 = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+    ServiceLocator locator1 = ServiceLocator::fromString("tcp://192.168.0.2:2000");
+    a.registerService(ServiceDirectoryEntry("agent_0", "planner", locator0, ""));
+    a.registerService(ServiceDirectoryEntry("agent_1", "planner", locator0, ""));
+    a.registerService(ServiceDirectoryEntry("agent_2", "planner", locator1, ""));
+    b.registerService(ServiceDirectoryEntry("agent_3", "planner", locator0, ""));
+    network->flush();
+
+    ServiceDirectoryList updates;
+    updates.push_back(ServiceDirectoryEntry("agent_1", "planner", locator0, "merged"));
+    updates.push_back(ServiceDirectoryEntry("agent_4", "planner", locator0, "merged"));
+    a.mergeSelectively(updates, ServiceDirectoryEntry::LOCATOR);
+    network->flush();
+
+    // Services of other nodes are not withdrawn
+    BOOST_REQUIRE(a.getRegisteredServices().size() == 3);
+    BOOST_REQUIRE(b.lookupByName("agent_0").empty());
+    BOOST_REQUIRE(b.lookupByName("agent_1").front().getDescription() == "merged");
+    BOOST_REQUIRE(b.lookupByName("agent_2").size() == 1);
+    BOOST_REQUIRE(b.lookupByName("agent_3").size() == 1);
+    BOOST_REQUIRE(b.lookupByName("agent_4").size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(selective_merge_keeps_domain)
+{
+    using namespace fipa::services;
+
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork());
+    std::string otherScope = "_other_service_directory._udp";
+    std::vector<std::string> scopes;
+    scopes.push_back(DEFAULT_SERVICE_SCOPE);
+    scopes.push_back(otherScope);
+    DistributedServiceDirectory a(scopes, DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    DistributedServiceDirectory defaultScope(std::vector<std::string>(1, DEFAULT_SERVICE_SCOPE), DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    DistributedServiceDirectory other(std::vector<std::string>(1, otherScope), DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    ServiceLocator locator = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+    a.registerService(ServiceDirectoryEntry("agent_0", "planner", locator, ""), otherScope);
+    network->flush();
+    BOOST_REQUIRE(other.lookupByName("agent_0").size() == 1);
+
+    ServiceDirectoryList updates;
+    updates.push_back(ServiceDirectoryEntry("agent_0", "planner", locator, "merged"));
+    updates.push_back(ServiceDirectoryEntry("agent_1", "planner", locator, "merged"));
+    a.mergeSelectively(updates, ServiceDirectoryEntry::LOCATOR);
+    network->flush();
+
+    // The registered service stays in its domain, the new one is published
+    // in the default domain
+    BOOST_REQUIRE(other.lookupByName("agent_0").front().getDescription() == "merged");
+    BOOST_REQUIRE(defaultScope.lookupByName("agent_0").empty());
+    BOOST_REQUIRE(defaultScope.lookupByName("agent_1").size() == 1);
+    BOOST_REQUIRE(other.lookupByName("agent_1").empty());
+    BOOST_REQUIRE(a.getAll().size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(simulated_network)
+{
+    using namespace fipa::services;
+
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork(base::Time::fromMilliseconds(10), 0.3, 42));
+    std::vector<std::string> scopes(1, DEFAULT_SERVICE_SCOPE);
+    DistributedServiceDirectory a(scopes, DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    DistributedServiceDirectory b(scopes, DiscoveryBackend::Ptr(new InProcessDiscoveryBackend(network)));
+    ServiceLocator locator = ServiceLocator::fromString("tcp://192.168.0.1:2000");
+
+    ServiceDirectoryList entries;
+    for(int i = 0; i < 100; ++i)
+    {
+        std::stringstream ss;
+        ss << "node_a.agent_" << i;
+        entries.push_back(ServiceDirectoryEntry(ss.str(), "_test._tcp", locator, ""));
+    }
+    a.registerServices(entries);
+
+    // Nothing is visible before the propagation delay
+    network->advance(base::Time::fromMilliseconds(5));
+    BOOST_REQUIRE(a.getAll().empty() && b.getAll().empty());
+    network->advance(base::Time::fromMilliseconds(5));
+    BOOST_REQUIRE(a.getAll().size() == 100);
+    BOOST_REQUIRE(network->getNumberOfLostEvents() > 0);
+    BOOST_REQUIRE(b.getAll().size() == 100 - network->getNumberOfLostEvents());
+
+    // Lost events are recovered by announcing the services again
+    for(int round = 0; round < 20 && b.getAll().size() < 100; ++round)
+    {
+        network->reannounce();
+        network->flush();
+    }
+    BOOST_REQUIRE(b.getAll().size() == 100);
+    BOOST_REQUIRE(b.lookupByName("node_a.agent_42").size() == 1);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <fipa_services/InProcessDiscoveryBackend.hpp>
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(in_process_discovery_backend)
+
+namespace {
+    /// Observer that keeps the visible services
+    struct Visible
+    {
+        std::map<Name, ServiceDirectoryEntry> services;
+
+        void operator()(ServiceDirectoryChange::Type type, const ServiceDirectoryEntry& entry)
+        {
+            if(type == ServiceDirectoryChange::REMOVED)
+            {
+                services.erase(entry.getName());
+            } else {
+                services[entry.getName()] = entry;
+            }
+        }
+    };
+
+    ServiceDirectoryList createEntries(const std::string& prefix, size_t size)
+    {
+        ServiceDirectoryList entries;
+        for(size_t i = 0; i < size; ++i)
+        {
+            std::stringstream ss;
+            ss << prefix << i;
+            entries.push_back(ServiceDirectoryEntry(ss.str(), "planner", ServiceLocator(), ""));
+        }
+        return entries;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(propagation)
+{
+    InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork(base::Time::fromMilliseconds(10)));
+    std::vector<std::string> scopes(1, "_test._tcp");
+    Visible visibleA, visibleB, visibleOther;
+
+    std::shared_ptr<InProcessDiscoveryBackend> a(new InProcessDiscoveryBackend(network));
+    std::shared_ptr<InProcessDiscoveryBackend> b(new InProcessDiscoveryBackend(network));
+    std::shared_ptr<InProcessDiscoveryBackend> other(new InProcessDiscoveryBackend(network));
+    a->listen(scopes, std::ref(visibleA));
+    b->listen(scopes, std::ref(visibleB));
+    other->listen(std::vector<std::string>(1, "_other._tcp"), std::ref(visibleOther));
+
+    a->publish("_test._tcp", createEntries("a_", 3));
+    BOOST_REQUIRE(network->getNumberOfPendingEvents() == 6);
+    network->advance(base::Time::fromMilliseconds(9));
+    BOOST_REQUIRE(visibleA.services.empty() && visibleB.services.empty());
+    network->advance(base::Time::fromMilliseconds(1));
+    BOOST_REQUIRE(network->getTime() == base::Time::fromMilliseconds(10));
+    BOOST_REQUIRE(visibleA.services.size() == 3);
+    BOOST_REQUIRE(visibleB.services.size() == 3);
+    BOOST_REQUIRE(visibleOther.services.empty());
+
+    // Only the publisher withdraws its services
+    b->unpublish("_test._tcp", std::vector<Name>(1, "a_0"));
+    a->unpublish("_test._tcp", std::vector<Name>(1, "a_1"));
+    network->flush();
+    BOOST_REQUIRE(visibleB.services.size() == 2);
+    BOOST_REQUIRE(!visibleB.services.count("a_1"));
+
+    // Visible services are reported when listening starts
+    Visible visibleC;
+    std::shared_ptr<InProcessDiscoveryBackend> c(new InProcessDiscoveryBackend(network));
+    c->listen(scopes, std::ref(visibleC));
+    network->flush();
+    BOOST_REQUIRE(visibleC.services.size() == 2);
+
+    // Services are withdrawn when the publisher stops
+    a->stop();
+    network->flush();
+    BOOST_REQUIRE(visibleB.services.empty() && visibleC.services.empty());
+    BOOST_REQUIRE(visibleA.services.size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(loss)
+{
+    std::vector<std::string> scopes(1, "_test._tcp");
+    uint64_t lost[2];
+    for(size_t run = 0; run < 2; ++run)
+    {
+        InProcessDiscoveryNetwork::Ptr network(new InProcessDiscoveryNetwork(base::Time::fromMilliseconds(1), 0.2, 7));
+        Visible visibleA, visibleB;
+        std::shared_ptr<InProcessDiscoveryBackend> a(new InProcessDiscoveryBackend(network));
+        std::shared_ptr<InProcessDiscoveryBackend> b(new InProcessDiscoveryBackend(network));
+        a->listen(scopes, std::ref(visibleA));
+        b->listen(scopes, std::ref(visibleB));
+
+        a->publish("_test._tcp", createEntries("a_", 1000));
+        network->flush();
+        // The publisher sees its own services reliably
+        BOOST_REQUIRE(visibleA.services.size() == 1000);
+        lost[run] = network->getNumberOfLostEvents();
+        BOOST_REQUIRE(lost[run] > 100 && lost[run] < 300);
+        BOOST_REQUIRE(visibleB.services.size() == 1000 - lost[run]);
+        BOOST_REQUIRE(network->getNumberOfDeliveredEvents() == 2000 - lost[run]);
+
+        for(int round = 0; round < 20 && visibleB.services.size() < 1000; ++round)
+        {
+            network->reannounce();
+            network->flush();
+        }
+        BOOST_REQUIRE(visibleB.services.size() == 1000);
+    }
+    // Losses are reproducible
+    BOOST_REQUIRE(lost[0] == lost[1]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
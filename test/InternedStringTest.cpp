@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <fipa_services/InternedString.hpp>
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(interned_string)
+
+BOOST_AUTO_TEST_CASE(sharing)
+{
+    InternedString empty;
+    BOOST_REQUIRE(empty.str().empty());
+    BOOST_REQUIRE(empty == InternedString(""));
+
+    std::string content = "fipa::services::transports::MessageTransport";
+    InternedString a(content);
+    InternedString b(content);
+    BOOST_REQUIRE(a == b);
+    BOOST_REQUIRE(a != empty);
+    // Equal strings share their content
+    BOOST_REQUIRE(&a.str() == &b.str());
+    const std::string& reference = a;
+    BOOST_REQUIRE(reference == content);
+}
+
+BOOST_AUTO_TEST_CASE(purging)
+{
+    StringPool pool;
+    {
+        InternedString kept = pool.intern("kept");
+        for(int i = 0; i < 100; ++i)
+        {
+            std::stringstream ss;
+            ss << "dropped_" << i;
+            pool.intern(ss.str());
+        }
+        BOOST_REQUIRE(pool.size() == 101);
+        BOOST_REQUIRE(pool.purge() == 100);
+        BOOST_REQUIRE(pool.size() == 1);
+        BOOST_REQUIRE(&pool.intern("kept").str() == &kept.str());
+    }
+    BOOST_REQUIRE(pool.purge() == 1);
+    BOOST_REQUIRE(pool.size() == 0);
+
+    // Unreferenced content is purged automatically when the pool grows
+    for(int i = 0; i < 10000; ++i)
+    {
+        std::stringstream ss;
+        ss << "dropped_" << i;
+        pool.intern(ss.str());
+    }
+    BOOST_REQUIRE(pool.size() < 2048);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_interning)
+{
+    StringPool pool;
+    std::vector<InternedString> results[4];
+    boost::thread_group threads;
+    for(int t = 0; t < 4; ++t)
+    {
+        std::vector<InternedString>& result = results[t];
+        threads.create_thread([&pool, &result]()
+            {
+                for(int i = 0; i < 1000; ++i)
+                {
+                    std::stringstream ss;
+                    ss << "type_" << i;
+                    result.push_back(pool.intern(ss.str()));
+                }
+            });
+    }
+    threads.join_all();
+
+    // All threads share the same content
+    BOOST_REQUIRE(pool.size() == 1000);
+    for(int i = 0; i < 1000; ++i)
+    {
+        BOOST_REQUIRE(&results[1][i].str() == &results[0][i].str());
+        BOOST_REQUIRE(&results[3][i].str() == &results[2][i].str());
+        BOOST_REQUIRE(&results[2][i].str() == &results[0][i].str());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
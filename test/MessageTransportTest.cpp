@@ -1,5 +1,6 @@
 #include <boost/test/unit_test.hpp>
 #include <iostream>
+#include <set>
 #include <fipa_services/MessageTransport.hpp>
 
 using namespace std::placeholders;
@@ -48,6 +49,74 @@ BOOST_AUTO_TEST_CASE(internal_communication)
     messageTransport1.handle(env);
 }
 
+BOOST_AUTO_TEST_CASE(unknown_receiver)
+{
+    using namespace fipa::acl;
+    using namespace fipa::services::message_transport;
+    using namespace fipa::services;
+
+    ServiceDirectory::Ptr serviceDirectory(new ServiceDirectory());
+    MessageTransport messageTransport(AgentID("mts-0"), serviceDirectory);
+
+    TestDelivery delivery;
+    messageTransport.registerMessageTransport("default-corba-transport", std::bind(&TestDelivery::deliverOrForwardLetterFail,delivery,_1,_2));
+
+    ACLMessage msg;
+    msg.setSender(AgentID("sender"));
+    msg.addReceiver(AgentID("unknown-receiver"));
+    msg.setContent("Test content");
+
+    UnknownReceiverCache& cache = messageTransport.getUnknownReceiverCache();
+    for(int i = 0; i < 10; ++i)
+    {
+        ACLEnvelope env(msg, representation::BITEFFICIENT);
+        messageTransport.handle(env);
+    }
+    // Only the first letter resolves the receiver
+    BOOST_REQUIRE(cache.getInsertions() >= 1);
+    BOOST_REQUIRE(cache.getHits() >= 9);
+
+    serviceDirectory->registerService(ServiceDirectoryEntry("unknown-receiver", messageTransport.getServiceSignature(), ServiceLocator(), ""));
+    BOOST_REQUIRE(cache.getInvalidations() >= 1);
+    BOOST_REQUIRE(!cache.contains("unknown-receiver"));
+}
+
+BOOST_AUTO_TEST_CASE(receiver_patterns)
+{
+    using namespace fipa::acl;
+    using namespace fipa::services::message_transport;
+    using namespace fipa::services;
+
+    ServiceDirectory::Ptr serviceDirectory(new ServiceDirectory());
+    MessageTransport messageTransport(AgentID("mts-0"), serviceDirectory);
+    messageTransport.activateTransport(transports::Transport::UDT);
+    messageTransport.registerClient("a.b", "Message client of mts-0");
+    messageTransport.registerClient("aXb", "Message client of mts-0");
+
+    std::set<std::string> delivered;
+    messageTransport.registerMessageTransport("default-corba-transport", [&delivered](const std::string& receiverName, const Letter& letter)
+        {
+            delivered.insert(receiverName);
+            return true;
+        });
+
+    // Unescaped metacharacters form a pattern, while escaped or anchored
+    // names only match themselves
+    std::string receivers[] = { "a.b", "a\\.b", "aXb", "^aXb$" };
+    size_t expected[] = { 2, 1, 1, 1 };
+    for(size_t i = 0; i < 4; ++i)
+    {
+        delivered.clear();
+        ACLMessage msg;
+        msg.setSender(AgentID("sender"));
+        msg.addReceiver(AgentID(receivers[i]));
+        msg.setContent("Test content");
+        ACLEnvelope env(msg, representation::BITEFFICIENT);
+        messageTransport.handle(env);
+        BOOST_REQUIRE_MESSAGE(delivered.size() == expected[i], "receiver '" << receivers[i] << "' delivered to " << delivered.size());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(inter_service_communication)
 {
     using namespace fipa::acl;
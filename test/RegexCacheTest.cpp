@@ -0,0 +1,48 @@
+#include <boost/test/unit_test.hpp>
+#include <fipa_services/RegexCache.hpp>
+
+BOOST_AUTO_TEST_SUITE(regex_cache)
+
+BOOST_AUTO_TEST_CASE(hits_and_misses)
+{
+    using namespace fipa::services;
+
+    RegexCache cache(2);
+    RegexCache::RegexPtr r0 = cache.get("robot_.*");
+    BOOST_REQUIRE(cache.getMisses() == 1 && cache.getHits() == 0);
+    BOOST_REQUIRE(boost::regex_match(std::string("robot_0"), *r0));
+
+    RegexCache::RegexPtr r1 = cache.get("robot_.*");
+    BOOST_REQUIRE(cache.getMisses() == 1 && cache.getHits() == 1);
+    BOOST_REQUIRE_MESSAGE(r0 == r1, "Cached regex is reused");
+
+    BOOST_REQUIRE_THROW(cache.get("robot_("), boost::regex_error);
+    BOOST_REQUIRE(cache.size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(lru_eviction)
+{
+    using namespace fipa::services;
+
+    RegexCache cache(2);
+    cache.get("a.*");
+    cache.get("b.*");
+    // Use a.* to make b.* the least recently used one
+    cache.get("a.*");
+    cache.get("c.*");
+    BOOST_REQUIRE(cache.size() == 2);
+
+    cache.resetStatistics();
+    cache.get("a.*");
+    cache.get("c.*");
+    BOOST_REQUIRE(cache.getHits() == 2);
+    cache.get("b.*");
+    BOOST_REQUIRE(cache.getMisses() == 1);
+
+    cache.setCapacity(1);
+    BOOST_REQUIRE(cache.size() == 1);
+    cache.clear();
+    BOOST_REQUIRE(cache.size() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
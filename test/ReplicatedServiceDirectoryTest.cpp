@@ -0,0 +1,147 @@
+#include <boost/test/unit_test.hpp>
+#include <unistd.h>
+#include <fipa_services/ReplicatedServiceDirectory.hpp>
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(replicated_service_directory)
+
+namespace {
+    std::vector<ReplicatedServiceDirectory::Ptr> createNodes()
+    {
+        std::vector<ReplicatedServiceDirectory::Ptr> nodes;
+        const char* ids[] = { "node-a", "node-b", "node-c" };
+        for(size_t i = 0; i < 3; ++i)
+        {
+            ReplicatedServiceDirectory::Ptr node(new ReplicatedServiceDirectory(ids[i], transports::TransportType::TCP, "lo"));
+            node->setAntiEntropyPeriod(base::Time::fromSeconds(3600));
+            nodes.push_back(node);
+        }
+        // Chain of peers, the remaining peers are learnt from the messages
+        nodes[0]->addPeer(nodes[1]->getNodeId(), nodes[1]->getAddress());
+        nodes[1]->addPeer(nodes[2]->getNodeId(), nodes[2]->getAddress());
+        return nodes;
+    }
+
+    void triggerAll(const std::vector<ReplicatedServiceDirectory::Ptr>& nodes, size_t rounds = 20)
+    {
+        for(size_t r = 0; r < rounds; ++r)
+        {
+            for(size_t i = 0; i < nodes.size(); ++i)
+            {
+                nodes[i]->trigger();
+            }
+            usleep(10000);
+        }
+    }
+
+    std::string getContent(const ReplicatedServiceDirectory& directory)
+    {
+        std::string content;
+        ServiceDirectoryList entries = directory.getAll();
+        ServiceDirectoryList::const_iterator cit = entries.begin();
+        for(; cit != entries.end(); ++cit)
+        {
+            content += cit->toString() + "\n";
+        }
+        return content;
+    }
+
+    bool converged(const std::vector<ReplicatedServiceDirectory::Ptr>& nodes)
+    {
+        for(size_t i = 1; i < nodes.size(); ++i)
+        {
+            if(getContent(*nodes[i]) != getContent(*nodes[0]) || nodes[i]->getVersionVector() != nodes[0]->getVersionVector())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(propagation)
+{
+    std::vector<ReplicatedServiceDirectory::Ptr> nodes = createNodes();
+    ServiceLocator locator = ServiceLocator::fromString("tcp://127.0.0.1:4000");
+
+    nodes[0]->registerService(ServiceDirectoryEntry("agent_a", "planner", locator, ""));
+    nodes[2]->registerService(ServiceDirectoryEntry("agent_c", "mapper", locator, ""));
+    triggerAll(nodes);
+
+    BOOST_REQUIRE(converged(nodes));
+    for(size_t i = 0; i < nodes.size(); ++i)
+    {
+        BOOST_REQUIRE(nodes[i]->getAll().size() == 2);
+        BOOST_REQUIRE(nodes[i]->lookupByName("agent_a").front().getType() == "planner");
+    }
+    // Peers are learnt from the messages, so that node-b knows both others
+    BOOST_REQUIRE(nodes[1]->getPeers().size() == 2);
+    BOOST_REQUIRE(nodes[2]->getPeers().size() == 1);
+
+    nodes[1]->modify(ServiceDirectoryEntry("agent_a", "planner", locator, "modified"));
+    nodes[0]->deregisterService(ServiceDirectoryEntry("agent_c", "", locator, ""));
+    triggerAll(nodes);
+
+    BOOST_REQUIRE(converged(nodes));
+    for(size_t i = 0; i < nodes.size(); ++i)
+    {
+        BOOST_REQUIRE(nodes[i]->getAll().size() == 1);
+        BOOST_REQUIRE(nodes[i]->lookupByName("agent_a").front().getDescription() == "modified");
+        BOOST_REQUIRE(nodes[i]->lookupByName("agent_c").empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_modifications)
+{
+    std::vector<ReplicatedServiceDirectory::Ptr> nodes = createNodes();
+    ServiceLocator locator = ServiceLocator::fromString("tcp://127.0.0.1:4000");
+
+    // Conflicting registrations before any replication
+    for(size_t i = 0; i < nodes.size(); ++i)
+    {
+        nodes[i]->registerService(ServiceDirectoryEntry("agent", nodes[i]->getNodeId(), locator, ""));
+    }
+    triggerAll(nodes);
+
+    BOOST_REQUIRE(converged(nodes));
+    // Equal sequence numbers, so the highest node id wins
+    BOOST_REQUIRE(nodes[0]->lookupByName("agent").front().getType() == "node-c");
+
+    // Removal and modification of the same service
+    nodes[0]->deregisterService(ServiceDirectoryEntry("agent", "", locator, ""));
+    nodes[1]->modify(ServiceDirectoryEntry("agent", "modified", locator, ""));
+    triggerAll(nodes);
+    BOOST_REQUIRE(converged(nodes));
+}
+
+BOOST_AUTO_TEST_CASE(anti_entropy)
+{
+    std::vector<ReplicatedServiceDirectory::Ptr> nodes = createNodes();
+    ServiceLocator locator = ServiceLocator::fromString("tcp://127.0.0.1:4000");
+    nodes[0]->registerService(ServiceDirectoryEntry("agent_0", "planner", locator, ""));
+    triggerAll(nodes);
+    BOOST_REQUIRE(converged(nodes));
+
+    // Disconnect node-c and modify the directory meanwhile
+    ReplicatedServiceDirectory::Ptr offline = nodes.back();
+    nodes.pop_back();
+    nodes[1]->removePeer(offline->getNodeId());
+    BOOST_REQUIRE_THROW(nodes[1]->removePeer(offline->getNodeId()), NotFound);
+    nodes[0]->deregisterService(ServiceDirectoryEntry("agent_0", "", locator, ""));
+    nodes[1]->registerService(ServiceDirectoryEntry("agent_1", "planner", locator, ""));
+    triggerAll(nodes);
+    BOOST_REQUIRE(offline->lookupByName("agent_0").size() == 1);
+    BOOST_REQUIRE(offline->lookupByName("agent_1").empty());
+
+    // Reconnect, the next anti-entropy round catches up
+    nodes.push_back(offline);
+    offline->synchronize();
+    triggerAll(nodes);
+    BOOST_REQUIRE(converged(nodes));
+    BOOST_REQUIRE(offline->lookupByName("agent_0").empty());
+    BOOST_REQUIRE(offline->lookupByName("agent_1").size() == 1);
+    BOOST_REQUIRE(ReplicatedServiceDirectory::dominates(offline->getVersionVector(), nodes[0]->getVersionVector()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,563 @@
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include <iostream>
+#include <sstream>
+#include <boost/atomic.hpp>
+#include <fipa_services/ServiceDirectory.hpp>
+#include <fipa_services/ServiceDirectoryStream.hpp>
+#include <fipa_services/ServiceDirectoryWireFormat.hpp>
+#include "TestEntries.hpp"
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(service_directory_benchmark)
+
+namespace {
+    ServiceDirectoryEntry createEntry(size_t id)
+    {
+        return test::createEntry("robot_%.arm.planner", id);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lookup_by_name)
+{
+    const size_t lookups = 100000;
+    size_t sizes[] = { 10, 100, 1000, 10000 };
+
+    std::cout << "ServiceDirectory lookup by name: " << lookups << " lookups per directory size" << std::endl;
+    for(size_t s = 0; s < sizeof(sizes)/sizeof(size_t); ++s)
+    {
+        ServiceDirectory sd;
+        for(size_t i = 0; i < sizes[s]; ++i)
+        {
+            sd.registerService(createEntry(i));
+        }
+
+        std::vector<Name> names;
+        for(size_t i = 0; i < lookups; ++i)
+        {
+            names.push_back(createEntry(i % sizes[s]).getName());
+        }
+
+        size_t found = 0;
+        base::Time start = base::Time::now();
+        for(size_t i = 0; i < lookups; ++i)
+        {
+            found += sd.lookupByName(names[i]).size();
+        }
+        base::Time lookupTime = base::Time::now() - start;
+        BOOST_REQUIRE(found == lookups);
+
+        // The regex search on a subset of lookups, since it is too slow for
+        // large directories otherwise
+        const size_t searches = 100;
+        start = base::Time::now();
+        for(size_t i = 0; i < searches; ++i)
+        {
+            found += sd.search(names[i] + "$", ServiceDirectoryEntry::NAME, false).size();
+        }
+        base::Time searchTime = base::Time::now() - start;
+
+        std::cout << "    entries: " << sizes[s]
+            << " lookupByName: " << lookupTime.toMicroseconds()*1000.0/lookups << " ns/lookup"
+            << " regex search: " << searchTime.toMicroseconds()*1000.0/searches << " ns/search"
+            << std::endl;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_reads)
+{
+    const size_t entries = 1000;
+    const base::Time duration = base::Time::fromMilliseconds(300);
+    size_t readerThreads[] = { 1, 2, 4, 8, 16, 32 };
+    ServiceDirectory::ConcurrencyMode modes[] = { ServiceDirectory::LOCKING, ServiceDirectory::COPY_ON_WRITE };
+    const char* modeTxt[] = { "LOCKING", "COPY_ON_WRITE" };
+
+    std::cout << "ServiceDirectory concurrent lookupByName with " << entries << " entries and a writer churning registrations" << std::endl;
+    for(size_t m = 0; m < 2; ++m)
+    {
+        for(size_t r = 0; r < sizeof(readerThreads)/sizeof(size_t); ++r)
+        {
+            ServiceDirectory sd(modes[m]);
+            std::vector<Name> names;
+            for(size_t i = 0; i < entries; ++i)
+            {
+                ServiceDirectoryEntry entry = createEntry(i);
+                sd.registerService(entry);
+                names.push_back(entry.getName());
+            }
+
+            boost::atomic<bool> stop(false);
+            boost::atomic<uint64_t> lookups(0);
+            uint64_t writes = 0;
+
+            boost::thread_group readers;
+            for(size_t t = 0; t < readerThreads[r]; ++t)
+            {
+                readers.create_thread([&sd, &names, &stop, &lookups, t]()
+                    {
+                        uint64_t count = 0;
+                        size_t i = t;
+                        while(!stop)
+                        {
+                            sd.lookupByName(names[i % names.size()]);
+                            i += 7;
+                            ++count;
+                        }
+                        lookups += count;
+                    });
+            }
+
+            base::Time start = base::Time::now();
+            while(base::Time::now() - start < duration)
+            {
+                ServiceDirectoryEntry entry = createEntry(entries + writes % 100);
+                sd.registerService(entry);
+                sd.deregisterService(entry.getName(), ServiceDirectoryEntry::NAME);
+                ++writes;
+            }
+            stop = true;
+            readers.join_all();
+
+            std::cout << "    " << modeTxt[m] << " readers: " << readerThreads[r]
+                << " lookups/s: " << lookups / duration.toSeconds()
+                << " writes/s: " << writes / duration.toSeconds()
+                << std::endl;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(merge_selectively)
+{
+    const size_t entries = 10000;
+    const size_t mtsCount = 10;
+    ServiceDirectory::ConcurrencyMode modes[] = { ServiceDirectory::LOCKING, ServiceDirectory::COPY_ON_WRITE };
+    const char* modeTxt[] = { "LOCKING", "COPY_ON_WRITE" };
+
+    std::cout << "ServiceDirectory mergeSelectively of " << entries << " entries into a directory of " << entries << " entries" << std::endl;
+    for(size_t m = 0; m < 2; ++m)
+    {
+        // Entries are distributed over several message transport services
+        // each identified by its locator
+        ServiceDirectoryList updateList;
+        for(size_t i = 0; i < entries; ++i)
+        {
+            ServiceDirectoryEntry entry = createEntry(i);
+            std::stringstream ss;
+            ss << "udt://192.168.0." << i % mtsCount << ":12391";
+            entry.setLocator(ServiceLocator::fromString(ss.str()));
+            updateList.push_back(entry);
+        }
+
+        ServiceDirectory sd(modes[m]);
+        sd.mergeSelectively(updateList, ServiceDirectoryEntry::LOCATOR);
+
+        base::Time start = base::Time::now();
+        sd.mergeSelectively(updateList, ServiceDirectoryEntry::LOCATOR);
+        base::Time mergeTime = base::Time::now() - start;
+        BOOST_REQUIRE(sd.getAll().size() == entries);
+
+        std::cout << "    " << modeTxt[m] << " merge: " << mergeTime.toMilliseconds() << " ms" << std::endl;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bulk_registration)
+{
+    ServiceDirectory::ConcurrencyMode modes[] = { ServiceDirectory::LOCKING, ServiceDirectory::COPY_ON_WRITE };
+    const char* modeTxt[] = { "LOCKING", "COPY_ON_WRITE" };
+    size_t sizes[] = { 10, 100, 1000 };
+    // Best of several rounds, since a single registration of a small batch
+    // is dominated by noise
+    const size_t rounds = 5;
+
+    std::cout << "ServiceDirectory registration of a batch: registerService per entry vs. registerServices, best of "
+        << rounds << " rounds" << std::endl;
+    for(size_t m = 0; m < 2; ++m)
+    {
+        for(size_t s = 0; s < 3; ++s)
+        {
+            ServiceDirectoryList entries;
+            std::vector<Name> names;
+            for(size_t i = 0; i < sizes[s]; ++i)
+            {
+                entries.push_back(createEntry(i));
+                names.push_back(entries.back().getName());
+            }
+
+            base::Time singleTime, bulkTime, bulkRemovalTime;
+            for(size_t r = 0; r < rounds; ++r)
+            {
+                ServiceDirectory single(modes[m]);
+                base::Time start = base::Time::now();
+                ServiceDirectoryList::const_iterator cit = entries.begin();
+                for(; cit != entries.end(); ++cit)
+                {
+                    single.registerService(*cit);
+                }
+                base::Time time = base::Time::now() - start;
+                singleTime = (r == 0 || time < singleTime) ? time : singleTime;
+
+                ServiceDirectory bulk(modes[m]);
+                start = base::Time::now();
+                bulk.registerServices(entries);
+                time = base::Time::now() - start;
+                bulkTime = (r == 0 || time < bulkTime) ? time : bulkTime;
+                BOOST_REQUIRE(bulk.getAll().size() == sizes[s]);
+
+                start = base::Time::now();
+                bulk.deregisterServices(names);
+                time = base::Time::now() - start;
+                bulkRemovalTime = (r == 0 || time < bulkRemovalTime) ? time : bulkRemovalTime;
+                BOOST_REQUIRE(bulk.getAll().empty());
+            }
+
+            std::cout << "    " << modeTxt[m] << " " << sizes[s] << " entries, single: " << singleTime.toMicroseconds() << " us, bulk: " << bulkTime.toMicroseconds() << " us"
+                << ", bulk removal: " << bulkRemovalTime.toMicroseconds() << " us" << std::endl;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lease_expiry)
+{
+    const size_t entries = 100000;
+    const base::Time checkPeriod = base::Time::fromMilliseconds(100);
+
+    std::cout << "ServiceDirectory lease expiry: " << entries << " leases of 1 - 60 s checked every "
+        << checkPeriod.toMilliseconds() << " ms" << std::endl;
+
+    ServiceDirectory sd;
+    base::Time start = base::Time::now();
+    for(size_t i = 0; i < entries; ++i)
+    {
+        sd.registerService(createEntry(i), base::Time::fromMilliseconds(1000 + (i*7919) % 59000));
+    }
+    base::Time registrationTime = base::Time::now() - start;
+
+    // Checks where no lease expired
+    const size_t idleChecks = 10000;
+    base::Time idleStart = base::Time::now();
+    for(size_t c = 0; c < idleChecks; ++c)
+    {
+        sd.expireLeases(start);
+    }
+    base::Time idleTime = base::Time::now() - idleStart;
+
+    size_t expired = 0;
+    base::Time expiryTime;
+    base::Time maxCheckTime;
+    // Leases start at registration, which takes a while
+    size_t checks = (registrationTime.toMicroseconds() + 61000000)/checkPeriod.toMicroseconds();
+    for(size_t c = 1; c <= checks; ++c)
+    {
+        base::Time checkStart = base::Time::now();
+        expired += sd.expireLeases(start + base::Time::fromMicroseconds(checkPeriod.toMicroseconds()*c));
+        base::Time checkTime = base::Time::now() - checkStart;
+        expiryTime = expiryTime + checkTime;
+        maxCheckTime = std::max(maxCheckTime, checkTime);
+    }
+    BOOST_REQUIRE(expired == entries);
+    BOOST_REQUIRE(sd.getAll().empty());
+
+    std::cout << "    registration: " << registrationTime.toMicroseconds()*1000.0/entries << " ns/entry"
+        << " expiry: " << expiryTime.toMicroseconds()*1000.0/entries << " ns/expired entry"
+        << " max. check: " << maxCheckTime.toMicroseconds() << " us"
+        << " check without expiry: " << idleTime.toMicroseconds()*1000.0/idleChecks << " ns"
+        << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(prefix_search)
+{
+    const size_t entries = 100000;
+    const size_t searches = 20;
+    const char* regexes[] = { "robot_42\\..*", "robot_4.*\\.planner", "robot_4\\d\\d\\.arm\\.planner" };
+
+    ServiceDirectory sd;
+    for(size_t i = 0; i < entries; ++i)
+    {
+        sd.registerService(createEntry(i));
+    }
+
+    std::cout << "ServiceDirectory name search with " << entries << " entries" << std::endl;
+    for(size_t r = 0; r < sizeof(regexes)/sizeof(char*); ++r)
+    {
+        std::string regex(regexes[r]);
+        // A leading group hides the prefix and enforces matching all names
+        std::string fullScan = "(" + regex.substr(0,1) + ")" + regex.substr(1);
+
+        size_t found = 0;
+        base::Time start = base::Time::now();
+        for(size_t i = 0; i < searches; ++i)
+        {
+            found += sd.search(regex, ServiceDirectoryEntry::NAME, false).size();
+        }
+        base::Time prefixTime = base::Time::now() - start;
+
+        size_t foundByScan = 0;
+        start = base::Time::now();
+        for(size_t i = 0; i < searches; ++i)
+        {
+            foundByScan += sd.search(fullScan, ServiceDirectoryEntry::NAME, false).size();
+        }
+        base::Time scanTime = base::Time::now() - start;
+        BOOST_REQUIRE(found == foundByScan);
+
+        std::cout << "    regex: " << regex << " matches: " << found/searches
+            << " prefix range: " << prefixTime.toMicroseconds()/searches << " us/search"
+            << " full scan: " << scanTime.toMicroseconds()/searches << " us/search"
+            << std::endl;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(compound_query)
+{
+    const size_t entries = 100000;
+    const size_t searches = 20;
+
+    ServiceDirectory sd;
+    for(size_t i = 0; i < entries; ++i)
+    {
+        sd.registerService(createEntry(i));
+    }
+
+    ServiceDirectoryQuery query;
+    query.where(ServiceDirectoryEntry::TYPE, "fipa::services::transports::MessageTransport")
+        .whereLocation(ServiceLocation::SERVICE_ADDRESS, "udt://.*")
+        .where(ServiceDirectoryEntry::NAME, "robot_42.*")
+        .where(ServiceDirectoryEntry::DESCRIPTION, ".*mts-0");
+
+    size_t found = 0;
+    base::Time start = base::Time::now();
+    for(size_t i = 0; i < searches; ++i)
+    {
+        found += sd.searchByQuery(query, false).size();
+    }
+    base::Time queryTime = base::Time::now() - start;
+
+    // Searching a single field and filtering the copied results
+    size_t foundByFilter = 0;
+    start = base::Time::now();
+    for(size_t i = 0; i < searches; ++i)
+    {
+        ServiceDirectoryList list = sd.search("fipa::services::transports::MessageTransport", ServiceDirectoryEntry::TYPE, false);
+        ServiceDirectoryList::const_iterator cit = list.begin();
+        for(; cit != list.end(); ++cit)
+        {
+            if(query.matches(*cit))
+            {
+                ++foundByFilter;
+            }
+        }
+    }
+    base::Time filterTime = base::Time::now() - start;
+    BOOST_REQUIRE(found == foundByFilter);
+
+    std::cout << "ServiceDirectory compound query with " << entries << " entries, matches: " << found/searches
+        << " searchByQuery: " << queryTime.toMicroseconds()/searches << " us/search"
+        << " search and filter: " << filterTime.toMicroseconds()/searches << " us/search"
+        << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(paginated_walk)
+{
+    const size_t entries = 100000;
+    size_t pageSizes[] = { 100, 1000, 10000 };
+
+    ServiceDirectory sd;
+    for(size_t i = 0; i < entries; ++i)
+    {
+        sd.registerService(createEntry(i));
+    }
+
+    base::Time start = base::Time::now();
+    size_t walked = sd.getAll().size();
+    base::Time allTime = base::Time::now() - start;
+    BOOST_REQUIRE(walked == entries);
+
+    std::cout << "ServiceDirectory walk over " << entries << " entries: getAll: " << allTime.toMilliseconds() << " ms"
+        << " (" << entries << " entries held)" << std::endl;
+    for(size_t p = 0; p < sizeof(pageSizes)/sizeof(size_t); ++p)
+    {
+        walked = 0;
+        start = base::Time::now();
+        ServiceDirectoryStream stream(sd, ServiceDirectoryQuery(), pageSizes[p]);
+        ServiceDirectoryEntry entry;
+        while(stream.next(entry))
+        {
+            ++walked;
+        }
+        base::Time streamTime = base::Time::now() - start;
+        BOOST_REQUIRE(walked == entries);
+
+        std::cout << "    stream with page size " << pageSizes[p] << ": " << streamTime.toMilliseconds() << " ms"
+            << " (" << pageSizes[p] << " entries held)" << std::endl;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(memory_per_entry)
+{
+    // mallinfo2 is only provided by glibc 2.33 and later
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const size_t entries = 100000;
+
+    // Entries differ in name and address only, as for the clients of a
+    // message transport
+    size_t start = mallinfo2().uordblks;
+    {
+        ServiceDirectoryList list;
+        list.reserve(entries);
+        for(size_t i = 0; i < entries; ++i)
+        {
+            list.push_back(createEntry(i));
+        }
+        size_t listSize = mallinfo2().uordblks - start;
+
+        ServiceDirectory sd;
+        sd.restore(list);
+        list.clear();
+        list.shrink_to_fit();
+        size_t directorySize = mallinfo2().uordblks - start;
+
+        std::cout << "ServiceDirectory memory with " << entries << " entries: "
+            << "entry: " << listSize/entries << " bytes/entry"
+            << " directory: " << directorySize/entries << " bytes/entry"
+            << std::endl;
+    }
+#else
+    std::cout << "ServiceDirectory memory per entry is not measured, since mallinfo2 is not available" << std::endl;
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_restore)
+{
+    const size_t entries = 100000;
+    const std::string filename = "/tmp/fipa_services_benchmark.snapshot";
+
+    ServiceDirectory sd;
+    for(size_t i = 0; i < entries; ++i)
+    {
+        sd.registerService(createEntry(i));
+    }
+
+    base::Time start = base::Time::now();
+    sd.saveSnapshot(filename);
+    base::Time saveTime = base::Time::now() - start;
+
+    start = base::Time::now();
+    ServiceDirectory restored;
+    size_t numberOfRestored = restored.restoreSnapshot(filename);
+    base::Time restoreTime = base::Time::now() - start;
+    BOOST_REQUIRE(numberOfRestored == entries);
+
+    std::remove(filename.c_str());
+
+    std::cout << "ServiceDirectory snapshot of " << entries << " entries: save: " << saveTime.toMilliseconds() << " ms"
+        << " restore: " << restoreTime.toMilliseconds() << " ms"
+        << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(location_dispatch)
+{
+    using namespace fipa::services::transports;
+
+    const size_t sends = 100000;
+    ServiceDirectory sd;
+    sd.registerService(createEntry(0));
+    Name name = createEntry(0).getName();
+
+    std::cout << "ServiceLocation transport dispatch: " << sends << " sends" << std::endl;
+
+    // Parsing the service address on every send
+    size_t udt = 0;
+    base::Time start = base::Time::now();
+    for(size_t i = 0; i < sends; ++i)
+    {
+        ServiceDirectoryList list = sd.lookupByName(name);
+        const ServiceLocation& location = list[0].getLocator().getFirstLocation();
+        Address address = Address::fromString(location.getServiceAddress());
+        udt += TransportType::getTypeFromTxt(address.protocol) == TransportType::UDT;
+    }
+    base::Time parseTime = base::Time::now() - start;
+
+    // Using the address that is cached with the entry
+    start = base::Time::now();
+    for(size_t i = 0; i < sends; ++i)
+    {
+        ServiceDirectoryList list = sd.lookupByName(name);
+        const ServiceLocation& location = list[0].getLocator().getFirstLocation();
+        udt += location.getTransportType() == TransportType::UDT && location.getAddress().port == 12391;
+    }
+    base::Time cachedTime = base::Time::now() - start;
+    BOOST_REQUIRE(udt == 2*sends);
+
+    std::cout << "    parsed per send: " << parseTime.toMilliseconds() << " ms"
+        << ", cached: " << cachedTime.toMilliseconds() << " ms" << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(wire_format)
+{
+    const size_t size = 10000;
+    ServiceDirectoryList entries;
+    for(size_t i = 0; i < size; ++i)
+    {
+        entries.push_back(createEntry(i));
+    }
+
+    std::cout << "ServiceDirectoryEntry encoding: " << size << " entries" << std::endl;
+
+    // Textual encoding of each field, as used for service discovery
+    size_t textSize = 0;
+    base::Time start = base::Time::now();
+    std::vector< std::vector<std::string> > texts(size);
+    for(size_t i = 0; i < size; ++i)
+    {
+        for(int f = 0; f < ServiceDirectoryEntry::END_MARKER; ++f)
+        {
+            texts[i].push_back(entries[i].getFieldContent((ServiceDirectoryEntry::Field) f));
+            textSize += texts[i].back().size();
+        }
+    }
+    base::Time textEncodeTime = base::Time::now() - start;
+
+    start = base::Time::now();
+    ServiceDirectoryList textDecoded;
+    for(size_t i = 0; i < size; ++i)
+    {
+        ServiceDirectoryEntry entry;
+        for(int f = 0; f < ServiceDirectoryEntry::END_MARKER; ++f)
+        {
+            entry.setFieldContent((ServiceDirectoryEntry::Field) f, texts[i][f]);
+        }
+        textDecoded.push_back(entry);
+    }
+    base::Time textDecodeTime = base::Time::now() - start;
+
+    start = base::Time::now();
+    std::string data = ServiceDirectoryWireFormat::encode(entries);
+    base::Time encodeTime = base::Time::now() - start;
+
+    start = base::Time::now();
+    ServiceDirectoryList decoded = ServiceDirectoryWireFormat::decode(data);
+    base::Time decodeTime = base::Time::now() - start;
+    BOOST_REQUIRE(decoded.size() == size && textDecoded.size() == size);
+
+    // Selecting entries from the views, without decoding into entries
+    start = base::Time::now();
+    size_t matches = 0;
+    ServiceDirectoryWireReader reader(data);
+    ServiceDirectoryEntryView view;
+    while(reader.next(view))
+    {
+        matches += view.name == "robot_42.arm.planner";
+    }
+    base::Time scanTime = base::Time::now() - start;
+    BOOST_REQUIRE(matches == 1);
+
+    std::cout << "    text: " << textSize << " bytes, encode: " << textEncodeTime.toMilliseconds() << " ms, decode: " << textDecodeTime.toMilliseconds() << " ms" << std::endl;
+    std::cout << "    binary: " << data.size() << " bytes, encode: " << encodeTime.toMilliseconds() << " ms, decode: " << decodeTime.toMilliseconds() << " ms"
+        << ", view scan: " << scanTime.toMicroseconds() << " us" << std::endl;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
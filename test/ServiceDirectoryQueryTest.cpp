@@ -0,0 +1,143 @@
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <fipa_services/ServiceDirectory.hpp>
+#include <fipa_services/ShardedServiceDirectory.hpp>
+#include "TestEntries.hpp"
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(service_directory_query)
+
+namespace {
+    /// Entries differ in type, protocol and message transport
+    ServiceDirectoryEntry createAgent(int id)
+    {
+        std::stringstream description;
+        description << "Message client of mts-" << id % 5;
+        return test::createEntry("agent_%", id, id % 3 == 0 ? "planner" : "arm-controller",
+                id % 2 == 0 ? "udt://192.168.0.%:2000" : "tcp://192.168.0.%:2000", description.str());
+    }
+
+    ServiceDirectoryList filter(const ServiceDirectoryList& list, const ServiceDirectoryQuery& query)
+    {
+        ServiceDirectoryList resultList;
+        ServiceDirectoryList::const_iterator cit = list.begin();
+        for(; cit != list.end(); ++cit)
+        {
+            if(query.matches(*cit))
+            {
+                resultList.push_back(*cit);
+            }
+        }
+        return resultList;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(matching)
+{
+    ServiceDirectoryQuery query;
+    BOOST_REQUIRE(query.empty());
+    BOOST_REQUIRE(query.matches(createAgent(0)));
+
+    query.where(ServiceDirectoryEntry::TYPE, "planner")
+        .whereLocation(ServiceLocation::SERVICE_ADDRESS, "tcp://.*");
+    BOOST_REQUIRE(query.getPredicates().size() == 2);
+    BOOST_REQUIRE(!query.matches(createAgent(0)));
+    BOOST_REQUIRE(!query.matches(createAgent(1)));
+    BOOST_REQUIRE(query.matches(createAgent(3)));
+    // Excluding the failing predicate
+    BOOST_REQUIRE(query.matches(createAgent(0), 1));
+    BOOST_REQUIRE(query.toString() == "TYPE matching 'planner' AND LOCATION.SERVICE_ADDRESS matching 'tcp://.*'");
+
+    BOOST_REQUIRE_THROW(ServiceDirectoryQuery().where(ServiceDirectoryEntry::NAME, "agent_("), boost::regex_error);
+}
+
+BOOST_AUTO_TEST_CASE(planning)
+{
+    ServiceDirectoryIndex index;
+    for(int i = 0; i < 100; ++i)
+    {
+        index.insert(createAgent(i));
+    }
+
+    ServiceDirectoryQuery query;
+    query.where(ServiceDirectoryEntry::DESCRIPTION, ".*mts-1")
+        .where(ServiceDirectoryEntry::TYPE, "planner")
+        .where(ServiceDirectoryEntry::NAME, "agent_4.*")
+        .whereLocation(ServiceLocation::SERVICE_ADDRESS, "tcp://.*")
+        .where(ServiceDirectoryEntry::NAME, "agent_42");
+
+    const ServiceDirectoryQuery::Predicates& predicates = query.getPredicates();
+    // Unindexed fields require checking all entries
+    BOOST_REQUIRE(index.estimate(predicates[0], 100) == 100);
+    BOOST_REQUIRE(index.estimate(predicates[1], 100) == 34);
+    BOOST_REQUIRE(index.estimate(predicates[2], 100) == 11);
+    // Counting stops at the bound
+    BOOST_REQUIRE(index.estimate(predicates[2], 5) == 5);
+    BOOST_REQUIRE(index.estimate(predicates[3], 100) == 50);
+    BOOST_REQUIRE(index.estimate(predicates[4], 100) == 1);
+
+    // Only agent_42 fulfills the name predicates, but not the remaining ones
+    BOOST_REQUIRE(index.match(query).empty());
+
+    ServiceDirectoryQuery unselective;
+    unselective.where(ServiceDirectoryEntry::DESCRIPTION, ".*mts-1")
+        .where(ServiceDirectoryEntry::NAME, ".*_1.*");
+    ServiceDirectoryIndex::Matches matches = index.match(unselective);
+    BOOST_REQUIRE(matches.size() == 3);
+    BOOST_REQUIRE(matches[0]->getName() == "agent_1");
+    BOOST_REQUIRE(matches[1]->getName() == "agent_11");
+    BOOST_REQUIRE(matches[2]->getName() == "agent_16");
+    BOOST_REQUIRE(index.match(unselective, 2).size() == 2);
+
+    BOOST_REQUIRE(index.match(ServiceDirectoryQuery()).size() == 100);
+}
+
+BOOST_AUTO_TEST_CASE(search_by_query)
+{
+    ServiceDirectory sd;
+    ShardedServiceDirectory sharded(4);
+    for(int i = 0; i < 100; ++i)
+    {
+        sd.registerService(createAgent(i));
+        sharded.registerService(createAgent(i));
+    }
+
+    std::vector<ServiceDirectoryQuery> queries(5);
+    queries[0].where(ServiceDirectoryEntry::TYPE, "planner")
+        .whereLocation(ServiceLocation::SERVICE_ADDRESS, "tcp://.*")
+        .where(ServiceDirectoryEntry::DESCRIPTION, ".*mts-3");
+    queries[1].where(ServiceDirectoryEntry::NAME, "agent_1.*")
+        .where(ServiceDirectoryEntry::TYPE, "arm-.*");
+    queries[2].where(ServiceDirectoryEntry::NAME, "agent_33")
+        .where(ServiceDirectoryEntry::TYPE, "planner");
+    queries[3].where(ServiceDirectoryEntry::LOCATOR, "udt://.*")
+        .where(ServiceDirectoryEntry::DESCRIPTION, ".*mts-(2|4)");
+    queries[4].whereLocation(ServiceLocation::SIGNATURE_TYPE, "fipa::services::transports::MessageTransport");
+
+    ServiceDirectoryList all = sd.getAll();
+    for(size_t q = 0; q < queries.size(); ++q)
+    {
+        ServiceDirectoryList expected = filter(all, queries[q]);
+        BOOST_REQUIRE_MESSAGE(!expected.empty(), "Query: " << queries[q].toString());
+
+        ServiceDirectoryList results = sd.searchByQuery(queries[q]);
+        ServiceDirectoryList shardedResults = sharded.searchByQuery(queries[q]);
+        BOOST_REQUIRE_MESSAGE(results.size() == expected.size(), "Query: " << queries[q].toString());
+        BOOST_REQUIRE_MESSAGE(shardedResults.size() == expected.size(), "Query: " << queries[q].toString());
+        for(size_t i = 0; i < expected.size(); ++i)
+        {
+            BOOST_REQUIRE(results[i].getName() == expected[i].getName());
+            BOOST_REQUIRE(shardedResults[i].getName() == expected[i].getName());
+        }
+    }
+
+    ServiceDirectoryQuery none;
+    none.where(ServiceDirectoryEntry::NAME, "agent_41")
+        .where(ServiceDirectoryEntry::TYPE, "planner");
+    BOOST_REQUIRE_THROW(sd.searchByQuery(none), NotFound);
+    BOOST_REQUIRE_THROW(sharded.searchByQuery(none), NotFound);
+    BOOST_REQUIRE(sd.searchByQuery(none, false).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
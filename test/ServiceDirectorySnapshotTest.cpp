@@ -0,0 +1,92 @@
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <fipa_services/ServiceDirectory.hpp>
+#include <fipa_services/ServiceDirectorySnapshot.hpp>
+#include <fipa_services/ShardedServiceDirectory.hpp>
+
+BOOST_AUTO_TEST_SUITE(service_directory_snapshot)
+
+/**
+ * Unique path of a snapshot file, which is removed after the test
+ */
+struct SnapshotFile
+{
+    std::string filename;
+
+    SnapshotFile()
+        : filename((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("fipa_services_snapshot_%%%%-%%%%-%%%%.bin")).string())
+    {}
+
+    ~SnapshotFile()
+    {
+        std::remove(filename.c_str());
+        std::remove((filename + ".tmp").c_str());
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(save_and_restore, SnapshotFile)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory sd;
+    for(int i = 0; i < 100; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        ServiceLocator locator;
+        locator.addLocation(ServiceLocation("udt://192.168.0.1:2000", "fipa::services::message_transport::MessageTransport", "mts-0"));
+        if(i % 2)
+        {
+            locator.addLocation(ServiceLocation("tcp://192.168.0.1:3000"));
+        }
+        sd.registerService(ServiceDirectoryEntry(ss.str(), "planner", locator, "description"));
+    }
+    sd.saveSnapshot(filename);
+
+    ServiceDirectorySnapshot snapshot(filename);
+    BOOST_REQUIRE(snapshot.size() == 100);
+    ServiceDirectoryEntry entry;
+    BOOST_REQUIRE(snapshot.find("agent_41", entry));
+    BOOST_REQUIRE(entry.getLocator().toString() == sd.lookupByName("agent_41").front().getLocator().toString());
+    BOOST_REQUIRE(entry.getTimestamp() == sd.lookupByName("agent_41").front().getTimestamp());
+    BOOST_REQUIRE(!snapshot.find("agent_100", entry));
+    BOOST_REQUIRE(!snapshot.find("", entry));
+
+    // Services registered before the restore are kept
+    ServiceDirectory restored;
+    restored.registerService(ServiceDirectoryEntry("agent_0", "other", ServiceLocator(), ""));
+    BOOST_REQUIRE(restored.restoreSnapshot(filename, base::Time::fromSeconds(10)) == 99);
+    BOOST_REQUIRE(restored.getAll().size() == 100);
+    BOOST_REQUIRE(restored.lookupByName("agent_0").front().getType() == "other");
+    BOOST_REQUIRE(restored.lookupByName("agent_1").front().getLocator().getLocations().size() == 2);
+    BOOST_REQUIRE(restored.search("planner", ServiceDirectoryEntry::TYPE).size() == 99);
+    BOOST_REQUIRE(restored.expireLeases(base::Time::now() + base::Time::fromSeconds(11)) == 99);
+
+    ShardedServiceDirectory sharded(4);
+    BOOST_REQUIRE(sharded.restoreSnapshot(filename) == 100);
+    BOOST_REQUIRE(sharded.getAll().size() == 100);
+}
+
+BOOST_FIXTURE_TEST_CASE(invalid_snapshot, SnapshotFile)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory sd;
+    BOOST_REQUIRE_THROW(sd.restoreSnapshot(filename), InvalidSnapshot);
+
+    {
+        std::ofstream file(filename.c_str());
+        file << "no service directory snapshot";
+    }
+    BOOST_REQUIRE_THROW(sd.restoreSnapshot(filename), InvalidSnapshot);
+    std::remove(filename.c_str());
+
+    // Empty directory
+    sd.saveSnapshot(filename);
+    BOOST_REQUIRE(sd.restoreSnapshot(filename) == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
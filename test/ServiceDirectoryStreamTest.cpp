@@ -0,0 +1,157 @@
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <fipa_services/ServiceDirectoryStream.hpp>
+#include <fipa_services/ShardedServiceDirectory.hpp>
+#include "TestEntries.hpp"
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(service_directory_stream)
+
+BOOST_AUTO_TEST_CASE(pagination)
+{
+    ServiceDirectory sd;
+    ShardedServiceDirectory sharded(4);
+    for(int i = 0; i < 100; ++i)
+    {
+        sd.registerService(test::createEntry("agent_%", i, i % 2 ? "odd" : "even"));
+        sharded.registerService(test::createEntry("agent_%", i, i % 2 ? "odd" : "even"));
+    }
+
+    std::vector<ServiceDirectory*> directories;
+    directories.push_back(&sd);
+    directories.push_back(&sharded);
+    for(size_t d = 0; d < directories.size(); ++d)
+    {
+        ServiceDirectoryList all = directories[d]->getAll();
+        ServiceDirectoryList walked;
+        std::string token;
+        size_t pages = 0;
+        do {
+            ServiceDirectoryPage page = directories[d]->searchPage(ServiceDirectoryQuery(), 30, token);
+            BOOST_REQUIRE(page.entries.size() <= 30);
+            walked.insert(walked.end(), page.entries.begin(), page.entries.end());
+            token = page.resumeToken;
+            ++pages;
+        } while(!token.empty());
+
+        BOOST_REQUIRE(pages == 4);
+        BOOST_REQUIRE(walked.size() == all.size());
+        for(size_t i = 0; i < all.size(); ++i)
+        {
+            BOOST_REQUIRE(walked[i].getName() == all[i].getName());
+        }
+
+        // A page that ends exactly with the last match is the last page
+        ServiceDirectoryQuery odd;
+        odd.where(ServiceDirectoryEntry::TYPE, "odd");
+        ServiceDirectoryPage page = directories[d]->searchPage(odd, 50);
+        BOOST_REQUIRE(page.entries.size() == 50 && page.isLast());
+        page = directories[d]->searchPage(odd, 49);
+        BOOST_REQUIRE(page.entries.size() == 49 && !page.isLast());
+        page = directories[d]->searchPage(odd, 49, page.resumeToken);
+        BOOST_REQUIRE(page.entries.size() == 1 && page.isLast());
+
+        BOOST_REQUIRE_THROW(directories[d]->searchPage(odd, 0), ArgumentError);
+        BOOST_REQUIRE_THROW(directories[d]->searchPage(odd, 10, "agent_1"), ArgumentError);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(indexed_pagination)
+{
+    ServiceDirectory sd;
+    for(int i = 0; i < 100; ++i)
+    {
+        std::stringstream name, type;
+        name << "agent_" << i;
+        type << "type_" << i % 5;
+        ServiceLocator locator = ServiceLocator::fromString(i % 4 ? "udt://192.168.0.3:2000" : "udt://192.168.0.1:2000;udt://192.168.0.2:2000");
+        sd.registerService(ServiceDirectoryEntry(name.str(), type.str(), locator, ""));
+    }
+
+    // Candidates of several field values are merged in name order, entries
+    // with several matching locations are returned once
+    ServiceDirectoryQuery queries[2];
+    queries[0].where(ServiceDirectoryEntry::TYPE, "type_[13]");
+    queries[1].whereLocation(ServiceLocation::SERVICE_ADDRESS, "udt://192\\.168\\.0\\.[12]:2000");
+    size_t expected[] = { 40, 25 };
+    for(size_t q = 0; q < 2; ++q)
+    {
+        ServiceDirectoryList walked;
+        std::string token;
+        do {
+            ServiceDirectoryPage page = sd.searchPage(queries[q], 7, token);
+            BOOST_REQUIRE(page.entries.size() <= 7);
+            walked.insert(walked.end(), page.entries.begin(), page.entries.end());
+            token = page.resumeToken;
+        } while(!token.empty());
+
+        BOOST_REQUIRE(walked.size() == expected[q]);
+        for(size_t i = 1; i < walked.size(); ++i)
+        {
+            BOOST_REQUIRE(walked[i - 1].getName() < walked[i].getName());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_modification)
+{
+    ServiceDirectory sd(ServiceDirectory::COPY_ON_WRITE);
+    for(int i = 0; i < 100; i += 2)
+    {
+        sd.registerService(test::createEntry("agent_%", i, "even"));
+    }
+
+    ServiceDirectoryPage page = sd.searchPage(ServiceDirectoryQuery(), 10);
+    BOOST_REQUIRE(page.entries.back().getName() == "agent_24");
+
+    // Entries before the resume token are not returned, removed entries
+    // after it are skipped and added entries after it are returned
+    sd.registerService(test::createEntry("agent_%", 1, "odd"));
+    sd.registerService(test::createEntry("agent_%", 27, "odd"));
+    sd.deregisterService("agent_26", ServiceDirectoryEntry::NAME);
+    sd.deregisterService("agent_28", ServiceDirectoryEntry::NAME);
+
+    page = sd.searchPage(ServiceDirectoryQuery(), 10, page.resumeToken);
+    BOOST_REQUIRE(page.entries[0].getName() == "agent_27");
+    BOOST_REQUIRE(page.entries[1].getName() == "agent_30");
+}
+
+BOOST_AUTO_TEST_CASE(streaming)
+{
+    ServiceDirectory sd;
+    for(int i = 0; i < 1000; ++i)
+    {
+        sd.registerService(test::createEntry("agent_%", i, i % 2 ? "odd" : "even"));
+    }
+
+    ServiceDirectoryQuery even;
+    even.where(ServiceDirectoryEntry::TYPE, "even");
+    ServiceDirectoryStream stream(sd, even, 64);
+    ServiceDirectoryEntry entry;
+    size_t count = 0;
+    Name previous;
+    while(stream.next(entry))
+    {
+        BOOST_REQUIRE(entry.getType() == "even");
+        BOOST_REQUIRE(previous < entry.getName());
+        previous = entry.getName();
+        ++count;
+
+        // Modifications during the walk do not affect the remaining entries
+        if(count == 100)
+        {
+            sd.deregisterService("agent_1", ServiceDirectoryEntry::NAME);
+        }
+    }
+    BOOST_REQUIRE(count == 500);
+    BOOST_REQUIRE(stream.getNumberOfPages() == 8);
+    BOOST_REQUIRE(!stream.next(entry));
+
+    ServiceDirectory empty;
+    ServiceDirectoryStream emptyStream(empty);
+    BOOST_REQUIRE(!emptyStream.next(entry));
+    BOOST_REQUIRE_THROW(ServiceDirectoryStream(sd, even, 0), ArgumentError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,5 +1,8 @@
 #include <boost/test/unit_test.hpp>
 #include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <boost/atomic.hpp>
 #include <fipa_services/ServiceDirectory.hpp>
 BOOST_AUTO_TEST_SUITE(service_directory)
 
@@ -72,5 +75,681 @@ BOOST_AUTO_TEST_CASE(regex_matching)
     BOOST_REQUIRE(list.size() == 2);
 }
 
+BOOST_AUTO_TEST_CASE(lookup_by_name)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory sd;
+    for(int i = 0; i < 10; ++i)
+    {
+        std::stringstream ss;
+        ss << "robot_" << i << ".arm";
+        ServiceDirectoryEntry entry(ss.str(), "arm-type", ServiceLocator(), "");
+        BOOST_REQUIRE_NO_THROW(sd.registerService(entry));
+    }
+
+    BOOST_REQUIRE(sd.lookupByName("robot_3.arm").size() == 1);
+    BOOST_REQUIRE(sd.lookupByName("robot_3.arm")[0].getName() == "robot_3.arm");
+    BOOST_REQUIRE(sd.lookupByName("robot_3Xarm").empty());
+    BOOST_REQUIRE(sd.lookupByName("robot_3").empty());
+
+    // Literal and non literal regular expressions have to yield the same result
+    BOOST_REQUIRE(sd.search("robot_3\\.arm$", ServiceDirectoryEntry::NAME, false).size() == 1);
+    BOOST_REQUIRE(sd.search("robot_3.arm$", ServiceDirectoryEntry::NAME, false).size() == 1);
+    BOOST_REQUIRE(sd.search("robot_.\\.arm", ServiceDirectoryEntry::NAME, false).size() == 10);
+
+    BOOST_REQUIRE_NO_THROW(sd.deregisterService("^robot_3\\.arm$", ServiceDirectoryEntry::NAME));
+    BOOST_REQUIRE(sd.lookupByName("robot_3.arm").empty());
+    BOOST_REQUIRE_THROW(sd.deregisterService("robot_3\\.arm", ServiceDirectoryEntry::NAME), NotFound);
+    BOOST_REQUIRE(sd.getAll().size() == 9);
+}
+
+BOOST_AUTO_TEST_CASE(literal_detection)
+{
+    using namespace fipa::services;
+
+    std::string literal;
+    BOOST_REQUIRE(ServiceDirectoryIndex::isLiteral("test-name", literal) && literal == "test-name");
+    BOOST_REQUIRE(ServiceDirectoryIndex::isLiteral("^test-name$", literal) && literal == "test-name");
+    BOOST_REQUIRE(ServiceDirectoryIndex::isLiteral("robot\\.arm", literal) && literal == "robot.arm");
+    BOOST_REQUIRE(ServiceDirectoryIndex::isLiteral("price\\$", literal) && literal == "price$");
+    BOOST_REQUIRE(!ServiceDirectoryIndex::isLiteral("robot.arm", literal));
+    BOOST_REQUIRE(!ServiceDirectoryIndex::isLiteral(".*", literal));
+    BOOST_REQUIRE(!ServiceDirectoryIndex::isLiteral("robot_\\d", literal));
+    BOOST_REQUIRE(!ServiceDirectoryIndex::isLiteral("a|b", literal));
+}
+
+BOOST_AUTO_TEST_CASE(type_and_locator_index)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory sd;
+    for(int i = 0; i < 10; ++i)
+    {
+        std::stringstream name;
+        name << "agent_" << i;
+        std::stringstream address;
+        address << (i % 2 == 0 ? "udt" : "tcp") << "://192.168.0." << i << ":2000";
+
+        ServiceLocator locator;
+        locator.addLocation(ServiceLocation(address.str(), "fipa::services::transports::MessageTransport"));
+        ServiceDirectoryEntry entry(name.str(), i < 5 ? "planner" : "arm-controller", locator, "");
+        BOOST_REQUIRE_NO_THROW(sd.registerService(entry));
+    }
+
+    BOOST_REQUIRE(sd.search("planner", ServiceDirectoryEntry::TYPE, false).size() == 5);
+    BOOST_REQUIRE(sd.search("arm-.*", ServiceDirectoryEntry::TYPE, false).size() == 5);
+    BOOST_REQUIRE(sd.search(".*-controller", ServiceDirectoryEntry::TYPE, false).size() == 5);
+    BOOST_REQUIRE(sd.search("udt://.*", ServiceDirectoryEntry::LOCATOR, false).size() == 5);
+    BOOST_REQUIRE(sd.searchByLocation("tcp://.*", ServiceLocation::SERVICE_ADDRESS, false).size() == 5);
+    BOOST_REQUIRE(sd.searchByLocation("fipa::services::transports::MessageTransport", ServiceLocation::SIGNATURE_TYPE, false).size() == 10);
+    BOOST_REQUIRE_THROW(sd.searchByLocation("unknown", ServiceLocation::SIGNATURE_TYPE), NotFound);
+
+    // Results are ordered by name
+    ServiceDirectoryList list = sd.search("planner", ServiceDirectoryEntry::TYPE);
+    BOOST_REQUIRE(list.front().getName() == "agent_0" && list.back().getName() == "agent_4");
+
+    // Index has to follow modifications
+    ServiceDirectoryEntry entry = sd.lookupByName("agent_0").front();
+    entry.setType("arm-controller");
+    BOOST_REQUIRE_NO_THROW(sd.modify(entry));
+    BOOST_REQUIRE(sd.search("planner", ServiceDirectoryEntry::TYPE, false).size() == 4);
+    BOOST_REQUIRE(sd.search("arm-controller", ServiceDirectoryEntry::TYPE, false).size() == 6);
+
+    BOOST_REQUIRE_NO_THROW(sd.deregisterService("arm-controller", ServiceDirectoryEntry::TYPE));
+    BOOST_REQUIRE(sd.lookupByName("agent_0").empty());
+    BOOST_REQUIRE(sd.search("udt://.*", ServiceDirectoryEntry::LOCATOR, false).size() == 4);
+
+    ServiceDirectoryList update;
+    update.push_back(entry);
+    sd.mergeSelectively(update, ServiceDirectoryEntry::TYPE);
+    BOOST_REQUIRE(sd.search("arm-controller", ServiceDirectoryEntry::TYPE, false).size() == 1);
+    BOOST_REQUIRE(sd.search("planner", ServiceDirectoryEntry::TYPE, false).size() == 4);
+}
+
+BOOST_AUTO_TEST_CASE(literal_prefix_detection)
+{
+    using namespace fipa::services;
+
+    std::string prefix;
+    BOOST_REQUIRE(ServiceDirectoryIndex::isLiteralPrefix("robot_3\\..*", prefix) && prefix == "robot_3.");
+    BOOST_REQUIRE(ServiceDirectoryIndex::isLiteralPrefix("^udt://.*$", prefix) && prefix == "udt://");
+    BOOST_REQUIRE(ServiceDirectoryIndex::isLiteralPrefix(".*", prefix) && prefix == "");
+    BOOST_REQUIRE(!ServiceDirectoryIndex::isLiteralPrefix("robot", prefix));
+    BOOST_REQUIRE(!ServiceDirectoryIndex::isLiteralPrefix("robot\\.*", prefix));
+    BOOST_REQUIRE(!ServiceDirectoryIndex::isLiteralPrefix("robot.\\..*", prefix));
+    BOOST_REQUIRE(!ServiceDirectoryIndex::isLiteralPrefix("robot$.*", prefix));
+}
+
+BOOST_AUTO_TEST_CASE(prefix_split)
+{
+    using namespace fipa::services;
+
+    std::string prefix;
+    std::string residual;
+    BOOST_REQUIRE(ServiceDirectoryIndex::splitLiteralPrefix("robot_3\\..*", prefix, residual) && prefix == "robot_3." && residual == ".*");
+    BOOST_REQUIRE(ServiceDirectoryIndex::splitLiteralPrefix("^robot_4.*\\.planner", prefix, residual) && prefix == "robot_4" && residual == ".*\\.planner");
+    BOOST_REQUIRE(ServiceDirectoryIndex::splitLiteralPrefix("robot_3*", prefix, residual) && prefix == "robot_" && residual == "3*");
+    BOOST_REQUIRE(ServiceDirectoryIndex::splitLiteralPrefix("robot\\.+", prefix, residual) && prefix == "robot" && residual == "\\.+");
+    BOOST_REQUIRE(ServiceDirectoryIndex::splitLiteralPrefix("robot_\\d+", prefix, residual) && prefix == "robot_" && residual == "\\d+");
+    BOOST_REQUIRE(ServiceDirectoryIndex::splitLiteralPrefix("robot", prefix, residual) && prefix == "robot" && residual == "");
+    BOOST_REQUIRE(ServiceDirectoryIndex::splitLiteralPrefix("robot\\\\$", prefix, residual) && prefix == "robot\\" && residual == "$");
+    BOOST_REQUIRE(!ServiceDirectoryIndex::splitLiteralPrefix("r*obot", prefix, residual));
+    BOOST_REQUIRE(!ServiceDirectoryIndex::splitLiteralPrefix(".*robot", prefix, residual));
+    BOOST_REQUIRE(!ServiceDirectoryIndex::splitLiteralPrefix("robot_1|agent_1", prefix, residual));
+    BOOST_REQUIRE(!ServiceDirectoryIndex::splitLiteralPrefix("robot_(1|2)", prefix, residual));
+
+    // Range matching has to yield the same results as matching all names
+    ServiceDirectory sd;
+    for(int i = 0; i < 200; ++i)
+    {
+        std::stringstream name;
+        name << "robot_" << i << (i % 2 == 0 ? ".arm.planner" : ".base.controller");
+        ServiceLocator locator;
+        locator.addLocation(ServiceLocation("udt://192.168.0.1:2000", "fipa::services::transports::MessageTransport"));
+        BOOST_REQUIRE_NO_THROW(sd.registerService(ServiceDirectoryEntry(name.str(), "planner", locator, "")));
+    }
+
+    const char* regexes[] = { "robot_3\\..*", "robot_4.*\\.planner", "robot_1\\d\\..*", "robot_1[0-9]+\\.base\\..*",
+        "robot_12*\\..*", "robot_\\d\\.arm\\.planner$", "robot_199\\.base\\.controller", "robot_.*\\b\\w+$" };
+    for(size_t i = 0; i < sizeof(regexes)/sizeof(char*); ++i)
+    {
+        // A leading group hides the prefix and enforces matching all names
+        std::string regex(regexes[i]);
+        std::string fullScan = "(" + regex.substr(0,1) + ")" + regex.substr(1);
+        BOOST_REQUIRE(!ServiceDirectoryIndex::splitLiteralPrefix(fullScan, prefix, residual));
+
+        ServiceDirectoryList ranged = sd.search(regex, ServiceDirectoryEntry::NAME, false);
+        ServiceDirectoryList scanned = sd.search(fullScan, ServiceDirectoryEntry::NAME, false);
+        BOOST_REQUIRE_MESSAGE(!ranged.empty() && ranged.size() == scanned.size(), "Regex: " << regex);
+        for(size_t e = 0; e < ranged.size(); ++e)
+        {
+            BOOST_REQUIRE(ranged[e].getName() == scanned[e].getName());
+        }
+    }
+    BOOST_REQUIRE(sd.search("robot_4.*\\.planner", ServiceDirectoryEntry::NAME, false).size() == 6);
+    BOOST_REQUIRE(sd.search("robot_\\d\\.arm\\.planner", ServiceDirectoryEntry::NAME, false).size() == 5);
+
+    // The '$' following an escaped backslash is an anchor
+    std::string literal;
+    BOOST_REQUIRE(ServiceDirectoryIndex::isLiteral("robot_1\\\\$", literal) && literal == "robot_1\\");
+    BOOST_REQUIRE(ServiceDirectoryIndex::isLiteral("robot_1\\$", literal) && literal == "robot_1$");
+    sd.registerService(ServiceDirectoryEntry("robot_1\\", "planner", ServiceLocator(), ""));
+    sd.registerService(ServiceDirectoryEntry("robot_1\\.arm", "planner", ServiceLocator(), ""));
+    BOOST_REQUIRE(sd.search("robot_1\\\\$", ServiceDirectoryEntry::NAME, false).size() == 1);
+    BOOST_REQUIRE(sd.search("(r)obot_1\\\\$", ServiceDirectoryEntry::NAME, false).size() == 1);
+    BOOST_REQUIRE(sd.search("robot_1\\\\.*$", ServiceDirectoryEntry::NAME, false).size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(copy_on_write)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory sd(ServiceDirectory::COPY_ON_WRITE);
+    BOOST_REQUIRE(sd.getConcurrencyMode() == ServiceDirectory::COPY_ON_WRITE);
+    BOOST_REQUIRE_NO_THROW(sd.registerService(ServiceDirectoryEntry("agent_0", "planner", ServiceLocator(), "")));
+    BOOST_REQUIRE_THROW(sd.registerService(ServiceDirectoryEntry("agent_0", "planner", ServiceLocator(), "")), DuplicateEntry);
+
+    // A snapshot is not affected by later modifications
+    ServiceDirectoryIndex::ConstPtr snapshot = sd.getSnapshot();
+    BOOST_REQUIRE_NO_THROW(sd.registerService(ServiceDirectoryEntry("agent_1", "planner", ServiceLocator(), "")));
+    BOOST_REQUIRE_NO_THROW(sd.deregisterService("agent_0", ServiceDirectoryEntry::NAME));
+    BOOST_REQUIRE(snapshot->size() == 1 && snapshot->find("agent_0"));
+    BOOST_REQUIRE(sd.getAll().size() == 1 && !sd.lookupByName("agent_1").empty());
+
+    // Readers run concurrently to a writer
+    boost::atomic<bool> failed(false);
+    boost::thread_group readers;
+    for(int t = 0; t < 4; ++t)
+    {
+        readers.create_thread([&sd, &failed]()
+            {
+                for(int i = 0; i < 2000; ++i)
+                {
+                    // agent_1 is never touched by the writer
+                    if(sd.lookupByName("agent_1").empty() || sd.search("planner", ServiceDirectoryEntry::TYPE, false).empty())
+                    {
+                        failed = true;
+                    }
+                }
+            });
+    }
+    for(int i = 0; i < 200; ++i)
+    {
+        std::stringstream ss;
+        ss << "churn_" << i;
+        sd.registerService(ServiceDirectoryEntry(ss.str(), "planner", ServiceLocator(), ""));
+        sd.deregisterService(ss.str(), ServiceDirectoryEntry::NAME);
+    }
+    readers.join_all();
+    BOOST_REQUIRE_MESSAGE(!failed, "Readers always see a consistent directory");
+    BOOST_REQUIRE(sd.getAll().size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(index_copy)
+{
+    using namespace fipa::services;
+
+    ServiceDirectoryIndex index;
+    for(int i = 0; i < 10; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        index.insert(ServiceDirectoryEntry(ss.str(), "planner", ServiceLocator::fromString("udt://192.168.0.1:2000"), ""));
+    }
+
+    ServiceDirectoryIndex copy(index);
+    ServiceDirectoryIndex assigned;
+    assigned = copy;
+    BOOST_REQUIRE(index.erase("agent_0"));
+    BOOST_REQUIRE(index.replace(ServiceDirectoryEntry("agent_1", "arm-controller", ServiceLocator(), "")));
+    BOOST_REQUIRE(index.match("planner", ServiceDirectoryEntry::TYPE).size() == 8);
+
+    // Copies are independent and their indexes refer to their own entries
+    ServiceDirectoryIndex* copies[] = { &copy, &assigned };
+    for(size_t c = 0; c < 2; ++c)
+    {
+        ServiceDirectoryIndex::Matches matches = copies[c]->match("planner", ServiceDirectoryEntry::TYPE);
+        BOOST_REQUIRE(matches.size() == 10);
+        for(size_t i = 0; i < matches.size(); ++i)
+        {
+            BOOST_REQUIRE(matches[i] == copies[c]->find(matches[i]->getName()));
+        }
+        BOOST_REQUIRE(copies[c]->matchLocation("udt://.*", ServiceLocation::SERVICE_ADDRESS).size() == 10);
+        BOOST_REQUIRE(copies[c]->erase("agent_0"));
+        BOOST_REQUIRE(copies[c]->match("planner", ServiceDirectoryEntry::TYPE).size() == 9);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shared_entries)
+{
+    using namespace fipa::services;
+
+    ServiceDirectoryEntry entry("agent_0", "planner", ServiceLocator(), "description");
+    ServiceDirectoryEntry copy = entry;
+    copy.setType("arm-controller");
+    BOOST_REQUIRE_MESSAGE(entry.getType() == "planner", "Modification of a copy does not affect the original");
+    BOOST_REQUIRE(copy.getType() == "arm-controller" && copy.getDescription() == "description");
+
+    // Entries are copy-only, so a moved-from entry keeps its content
+    ServiceDirectoryEntry moved = std::move(copy);
+    BOOST_REQUIRE(copy.getName() == "agent_0" && moved.getType() == "arm-controller");
+
+    ServiceDirectory::ConcurrencyMode modes[] = { ServiceDirectory::LOCKING, ServiceDirectory::COPY_ON_WRITE };
+    for(size_t m = 0; m < 2; ++m)
+    {
+        ServiceDirectory sd(modes[m]);
+        for(int i = 0; i < 10; ++i)
+        {
+            std::stringstream ss;
+            ss << "agent_" << i;
+            sd.registerService(ServiceDirectoryEntry(ss.str(), i % 2 ? "planner" : "arm-controller", ServiceLocator(), ""));
+        }
+
+        std::vector<std::string> names;
+        sd.forEachMatch("planner", ServiceDirectoryEntry::TYPE, [&names](const ServiceDirectoryEntry& entry)
+            {
+                names.push_back(entry.getName());
+                return true;
+            });
+        BOOST_REQUIRE(names.size() == 5 && names[0] == "agent_1");
+
+        // Stop iteration early
+        size_t visited = 0;
+        sd.forEachMatch(".*", ServiceDirectoryEntry::NAME, [&visited](const ServiceDirectoryEntry& entry)
+            {
+                return ++visited < 3;
+            });
+        BOOST_REQUIRE(visited == 3);
+
+        // Re-entrant visitor, which reads and modifies the directory while
+        // a lease becomes due, so that the writer removes the expired entry
+        sd.registerService(ServiceDirectoryEntry("leased", "planner", ServiceLocator(), ""), base::Time::fromMilliseconds(20));
+        visited = 0;
+        sd.forEachMatch(".*", ServiceDirectoryEntry::NAME, [&visited, &sd](const ServiceDirectoryEntry& entry)
+            {
+                if(visited == 0)
+                {
+                    usleep(50000);
+                }
+                BOOST_REQUIRE(sd.lookupByName(entry.getName()).size() == 1);
+                sd.deregisterService(entry);
+                return ++visited < 3;
+            });
+        BOOST_REQUIRE(visited == 3);
+        BOOST_REQUIRE(sd.getAll().size() == 7);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(merge_selectively)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory sd;
+    for(int i = 0; i < 6; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        ServiceLocator locator = ServiceLocator::fromString(i < 3 ? "udt://192.168.0.1:2000" : "udt://192.168.0.2:2000");
+        sd.registerService(ServiceDirectoryEntry(ss.str(), "planner", locator, ""));
+    }
+
+    // All entries of mts at 192.168.0.1 are replaced
+    ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+    ServiceDirectoryList updateList;
+    updateList.push_back(ServiceDirectoryEntry("agent_0", "arm-controller", locator, ""));
+    updateList.push_back(ServiceDirectoryEntry("agent_6", "planner", locator, ""));
+    BOOST_REQUIRE_NO_THROW(sd.mergeSelectively(updateList, ServiceDirectoryEntry::LOCATOR));
+
+    BOOST_REQUIRE(sd.search("udt://192\\.168\\.0\\.1:2000;", ServiceDirectoryEntry::LOCATOR, false).size() == 2);
+    BOOST_REQUIRE(sd.lookupByName("agent_0").front().getType() == "arm-controller");
+    BOOST_REQUIRE(sd.lookupByName("agent_1").empty());
+    BOOST_REQUIRE(sd.getAll().size() == 5);
+
+    // An update that conflicts with an existing entry is not applied at all
+    updateList.push_back(ServiceDirectoryEntry("agent_3", "planner", locator, ""));
+    BOOST_REQUIRE_THROW(sd.mergeSelectively(updateList, ServiceDirectoryEntry::LOCATOR), DuplicateEntry);
+    BOOST_REQUIRE(sd.getAll().size() == 5);
+    BOOST_REQUIRE(sd.lookupByName("agent_3").front().getLocator().toString() == "udt://192.168.0.2:2000;");
+}
+
+BOOST_AUTO_TEST_CASE(change_feed)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory::ConcurrencyMode modes[] = { ServiceDirectory::LOCKING, ServiceDirectory::COPY_ON_WRITE };
+    for(size_t m = 0; m < 2; ++m)
+    {
+        ServiceDirectory sd(modes[m]);
+        BOOST_REQUIRE(sd.getVersion() == 0);
+
+        ServiceDirectoryChangeList received;
+        ServiceDirectoryChangeFeed::SubscriptionId id = sd.subscribe([&received](const ServiceDirectoryChange& change)
+            {
+                received.push_back(change);
+            }, "planner", ServiceDirectoryEntry::TYPE);
+
+        ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+        sd.registerService(ServiceDirectoryEntry("agent_0", "planner", locator, ""));
+        sd.registerService(ServiceDirectoryEntry("agent_1", "arm-controller", locator, ""));
+        sd.modify(ServiceDirectoryEntry("agent_1", "planner", locator, ""));
+        sd.deregisterService("agent_0", ServiceDirectoryEntry::NAME);
+        BOOST_REQUIRE(sd.getVersion() == 4);
+
+        BOOST_REQUIRE(received.size() == 3);
+        BOOST_REQUIRE(received[0].type == ServiceDirectoryChange::ADDED && received[0].version == 1);
+        BOOST_REQUIRE(received[1].type == ServiceDirectoryChange::MODIFIED && received[1].version == 3);
+        BOOST_REQUIRE(received[1].previous.getType() == "arm-controller");
+        BOOST_REQUIRE(received[2].type == ServiceDirectoryChange::REMOVED && received[2].entry.getName() == "agent_0");
+
+        sd.unsubscribe(id);
+        BOOST_REQUIRE_THROW(sd.unsubscribe(id), NotFound);
+
+        // Pull all changes after version 1
+        ServiceDirectoryChangeList changes;
+        BOOST_REQUIRE(sd.getChanges(1, changes));
+        BOOST_REQUIRE(changes.size() == 3);
+        BOOST_REQUIRE(changes[0].type == ServiceDirectoryChange::ADDED && changes[0].entry.getName() == "agent_1");
+
+        changes.clear();
+        BOOST_REQUIRE(sd.getChanges(0, changes, "agent_0"));
+        BOOST_REQUIRE(changes.size() == 2);
+
+        // Replacing entries by merge
+        ServiceDirectoryList updateList;
+        updateList.push_back(ServiceDirectoryEntry("agent_1", "planner", locator, "updated"));
+        updateList.push_back(ServiceDirectoryEntry("agent_2", "planner", locator, ""));
+        sd.mergeSelectively(updateList, ServiceDirectoryEntry::LOCATOR);
+        changes.clear();
+        BOOST_REQUIRE(sd.getChanges(4, changes));
+        BOOST_REQUIRE(changes.size() == 2);
+        BOOST_REQUIRE(changes[0].type == ServiceDirectoryChange::MODIFIED && changes[0].entry.getDescription() == "updated");
+        BOOST_REQUIRE(changes[1].type == ServiceDirectoryChange::ADDED && changes[1].entry.getName() == "agent_2");
+
+        // Merging unchanged entries is not a change
+        uint64_t version = sd.getVersion();
+        sd.mergeSelectively(sd.getAll(), ServiceDirectoryEntry::LOCATOR);
+        BOOST_REQUIRE(sd.getVersion() == version);
+    }
+
+    // Consumers that fall behind need to resynchronize
+    ServiceDirectoryChangeFeed feed(2);
+    for(int i = 0; i < 5; ++i)
+    {
+        feed.publish(ServiceDirectoryChange::ADDED, ServiceDirectoryEntry());
+    }
+    ServiceDirectoryChangeList changes;
+    BOOST_REQUIRE(!feed.getChanges(2, changes));
+    BOOST_REQUIRE(feed.getChanges(3, changes));
+    BOOST_REQUIRE(changes.size() == 2 && changes.back().version == 5);
+
+    // The capacity counts changes, batches are dropped as a whole and the
+    // latest batch is retained even if it exceeds the capacity
+    ServiceDirectory sd;
+    sd.setHistoryCapacity(10);
+    BOOST_REQUIRE(sd.getHistoryCapacity() == 10);
+    ServiceDirectoryList entries;
+    for(int i = 0; i < 8; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        entries.push_back(ServiceDirectoryEntry(ss.str(), "planner", ServiceLocator(), ""));
+    }
+    sd.registerServices(entries);
+    sd.registerService(ServiceDirectoryEntry("agent_8", "planner", ServiceLocator(), ""));
+    sd.registerService(ServiceDirectoryEntry("agent_9", "planner", ServiceLocator(), ""));
+    changes.clear();
+    BOOST_REQUIRE(sd.getChanges(0, changes) && changes.size() == 10);
+    sd.registerService(ServiceDirectoryEntry("agent_10", "planner", ServiceLocator(), ""));
+    changes.clear();
+    BOOST_REQUIRE(!sd.getChanges(0, changes));
+    BOOST_REQUIRE(sd.getChanges(1, changes) && changes.size() == 3);
+
+    entries.clear();
+    for(int i = 0; i < 20; ++i)
+    {
+        std::stringstream ss;
+        ss << "robot_" << i;
+        entries.push_back(ServiceDirectoryEntry(ss.str(), "planner", ServiceLocator(), ""));
+    }
+    sd.registerServices(entries);
+    changes.clear();
+    BOOST_REQUIRE(!sd.getChanges(3, changes));
+    BOOST_REQUIRE(sd.getChanges(4, changes) && changes.size() == 20);
+}
+
+BOOST_AUTO_TEST_CASE(unsubscribe_during_notification)
+{
+    using namespace fipa::services;
+
+    ServiceDirectoryChangeFeed feed;
+    boost::atomic<bool> called(false);
+    boost::atomic<bool> returned(false);
+    ServiceDirectoryChangeFeed::SubscriptionId id = feed.subscribe([&called, &returned](const ServiceDirectoryChange& change)
+        {
+            called = true;
+            usleep(100000);
+            returned = true;
+        });
+
+    boost::thread publisher([&feed]() { feed.publish(ServiceDirectoryChange::ADDED, ServiceDirectoryEntry()); });
+    while(!called)
+    {
+        usleep(1000);
+    }
+    // The callback must not be used after unsubscribe returns
+    feed.unsubscribe(id);
+    BOOST_REQUIRE(returned);
+    publisher.join();
+
+    // Callbacks may unsubscribe themselves
+    ServiceDirectoryChangeFeed::SubscriptionId self = 0;
+    size_t calls = 0;
+    self = feed.subscribe([&feed, &self, &calls](const ServiceDirectoryChange& change)
+        {
+            ++calls;
+            feed.unsubscribe(self);
+        });
+    feed.publish(ServiceDirectoryChange::ADDED, ServiceDirectoryEntry());
+    feed.publish(ServiceDirectoryChange::ADDED, ServiceDirectoryEntry());
+    BOOST_REQUIRE(calls == 1);
+}
+
+BOOST_AUTO_TEST_CASE(leases)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory sd;
+    ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+    base::Time lease = base::Time::fromSeconds(10);
+    sd.registerService(ServiceDirectoryEntry("agent_0", "planner", locator, ""), lease);
+    sd.registerService(ServiceDirectoryEntry("agent_1", "planner", locator, ""), lease);
+    sd.registerService(ServiceDirectoryEntry("agent_2", "planner", locator, ""));
+    BOOST_REQUIRE_THROW(sd.renewLease("agent_2", lease), NotFound);
+
+    base::Time now = base::Time::now();
+    BOOST_REQUIRE(sd.expireLeases(now + base::Time::fromSeconds(5)) == 0);
+    BOOST_REQUIRE_NO_THROW(sd.renewLease("agent_1", base::Time::fromSeconds(20)));
+
+    ServiceDirectoryChangeList changes;
+    uint64_t version = sd.getVersion();
+    BOOST_REQUIRE(sd.expireLeases(now + base::Time::fromSeconds(11)) == 1);
+    BOOST_REQUIRE(sd.lookupByName("agent_0").empty());
+    BOOST_REQUIRE(sd.getChanges(version, changes));
+    BOOST_REQUIRE(changes.size() == 1 && changes[0].type == ServiceDirectoryChange::REMOVED);
+
+    // A deregistered service does not keep its lease
+    sd.deregisterService("agent_1", ServiceDirectoryEntry::NAME);
+    sd.registerService(ServiceDirectoryEntry("agent_1", "planner", locator, ""));
+    BOOST_REQUIRE(sd.expireLeases(now + base::Time::fromSeconds(30)) == 0);
+    BOOST_REQUIRE(sd.getAll().size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(expired_leases_on_lookup)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory::ConcurrencyMode modes[] = { ServiceDirectory::LOCKING, ServiceDirectory::COPY_ON_WRITE };
+    for(size_t m = 0; m < 2; ++m)
+    {
+        ServiceDirectory sd(modes[m]);
+        ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+        sd.registerService(ServiceDirectoryEntry("crashed", "planner", locator, ""), base::Time::fromMilliseconds(50));
+        sd.registerService(ServiceDirectoryEntry("alive", "planner", locator, ""));
+        sd.registerService(ServiceDirectoryEntry("renewed", "planner", locator, ""), base::Time::fromMilliseconds(50));
+        sd.renewLease("renewed", base::Time::fromSeconds(10));
+        BOOST_REQUIRE(sd.lookupByName("crashed").size() == 1);
+        uint64_t version = sd.getVersion();
+
+        // Lookups leave out expired services without removing them, while
+        // the renewed lease is still valid
+        usleep(100000);
+        BOOST_REQUIRE(sd.lookupByName("crashed").empty());
+        BOOST_REQUIRE(sd.lookupByName("renewed").size() == 1);
+        BOOST_REQUIRE(sd.search("crashed", ServiceDirectoryEntry::NAME, false).empty());
+        BOOST_REQUIRE(sd.searchByQuery(ServiceDirectoryQuery().where(ServiceDirectoryEntry::TYPE, "planner")).size() == 2);
+        BOOST_REQUIRE(sd.getAll().size() == 2);
+        BOOST_REQUIRE(sd.getSnapshot()->size() == 2);
+        BOOST_REQUIRE(sd.getVersion() == version);
+
+        // Pages are filled with the services following expired ones
+        ServiceDirectoryQuery planners = ServiceDirectoryQuery().where(ServiceDirectoryEntry::TYPE, "planner");
+        ServiceDirectoryPage page = sd.searchPage(planners, 1);
+        BOOST_REQUIRE(page.entries.size() == 1 && page.entries[0].getName() == "alive");
+        page = sd.searchPage(planners, 1, page.resumeToken);
+        BOOST_REQUIRE(page.entries.size() == 1 && page.entries[0].getName() == "renewed");
+        BOOST_REQUIRE(page.isLast());
+
+        BOOST_REQUIRE(sd.expireLeases() == 1);
+        BOOST_REQUIRE(sd.getVersion() == version + 1);
+        BOOST_REQUIRE(sd.getAll().size() == 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parsed_locations)
+{
+    using namespace fipa::services;
+    using namespace fipa::services::transports;
+
+    ServiceLocation location("udt://192.168.0.1:2000", "fipa::services::message_transport::MessageTransport");
+    BOOST_REQUIRE(location.getTransportType() == TransportType::UDT);
+    BOOST_REQUIRE(location.getAddress() == Address("192.168.0.1", 2000));
+    BOOST_REQUIRE(location.getProtocol() == "udt");
+    BOOST_REQUIRE(ServiceLocation("tcp://192.168.0.1:3000").getTransportType() == TransportType::TCP);
+
+    // Copies share the parsed address
+    ServiceLocation copy = location;
+    BOOST_REQUIRE(&copy.getAddress() == &location.getAddress());
+
+    ServiceLocation unsupported("xyz://192.168.0.1:2000");
+    BOOST_REQUIRE(unsupported.getTransportType() == TransportType::UNKNOWN);
+    BOOST_REQUIRE(unsupported.getProtocol() == "xyz");
+
+    ServiceLocation malformatted("192.168.0.1");
+    BOOST_REQUIRE(malformatted.getTransportType() == TransportType::UNKNOWN);
+    BOOST_REQUIRE_THROW(malformatted.getAddress(), std::invalid_argument);
+
+    // Entries returned by the directory share the parsed addresses of the
+    // registered entry
+    ServiceDirectory sd;
+    sd.registerService(ServiceDirectoryEntry("agent_0", "planner", ServiceLocator::fromString("udt://192.168.0.1:2000"), ""));
+    const Address* address = &sd.lookupByName("agent_0")[0].getLocator().getFirstLocation().getAddress();
+    BOOST_REQUIRE(address == &sd.lookupByName("agent_0")[0].getLocator().getFirstLocation().getAddress());
+}
+
+BOOST_AUTO_TEST_CASE(locator_strings)
+{
+    using namespace fipa::services;
+
+    std::string description = "udt://192.168.0.1:2000 fipa::services::message_transport::MessageTransport mts-0;tcp://192.168.0.1:3000 fipa::services::message_transport::MessageTransport;tcp://192.168.0.1:4000";
+    ServiceLocator locator = ServiceLocator::fromString(description);
+    const ServiceLocations& locations = locator.getLocations();
+    BOOST_REQUIRE(locations.size() == 3);
+    BOOST_REQUIRE(locations[0].getServiceSignature() == "mts-0");
+    BOOST_REQUIRE(locations[1].getSignatureType() == "fipa::services::message_transport::MessageTransport");
+    BOOST_REQUIRE(locations[1].getServiceSignature().empty());
+    BOOST_REQUIRE(locations[2].getServiceAddress() == "tcp://192.168.0.1:4000");
+    BOOST_REQUIRE(locations[2].getSignatureType().empty());
+    BOOST_REQUIRE(locator.toString() == description + ";");
+    BOOST_REQUIRE(ServiceLocation(" udt://192.168.0.1:2000").toString() == "udt://192.168.0.1:2000");
+    BOOST_REQUIRE(ServiceLocation("udt://192.168.0.1:2000", "", "mts-0").toString() == "udt://192.168.0.1:2000  mts-0");
+
+    // Fields are separated by single spaces
+    ServiceLocation location = ServiceLocation::fromString("udt://192.168.0.1:2000  mts-0");
+    BOOST_REQUIRE(location.getSignatureType().empty() && location.getServiceSignature() == "mts-0");
+    BOOST_REQUIRE_THROW(ServiceLocation::fromString("udt://192.168.0.1:2000 a b c"), std::invalid_argument);
+
+    // Locations before a malformatted one are kept
+    ServiceLocator partial;
+    BOOST_REQUIRE_THROW(partial.updateFromString("tcp://192.168.0.1:3000;udt://192.168.0.1:2000 a b c"), std::invalid_argument);
+    BOOST_REQUIRE(partial.getLocations().size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(bulk_registration)
+{
+    using namespace fipa::services;
+
+    ServiceDirectory::ConcurrencyMode modes[] = { ServiceDirectory::LOCKING, ServiceDirectory::COPY_ON_WRITE };
+    for(size_t m = 0; m < 2; ++m)
+    {
+        ServiceDirectory sd(modes[m]);
+        ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+        sd.registerService(ServiceDirectoryEntry("existing", "type", locator, ""));
+        uint64_t version = sd.getVersion();
+
+        ServiceDirectoryList entries;
+        for(int i = 0; i < 10; ++i)
+        {
+            std::stringstream ss;
+            ss << "agent_" << i;
+            entries.push_back(ServiceDirectoryEntry(ss.str(), "type", locator, ""));
+        }
+
+        // Nothing is registered if a single entry is a duplicate
+        ServiceDirectoryList duplicates = entries;
+        duplicates.push_back(ServiceDirectoryEntry("existing", "type", locator, ""));
+        BOOST_REQUIRE_THROW(sd.registerServices(duplicates), DuplicateEntry);
+        duplicates.back() = entries.front();
+        BOOST_REQUIRE_THROW(sd.registerServices(duplicates), DuplicateEntry);
+        BOOST_REQUIRE(sd.getAll().size() == 1);
+
+        // A single version for all changes
+        sd.registerServices(entries);
+        BOOST_REQUIRE(sd.getAll().size() == 11);
+        BOOST_REQUIRE(sd.getVersion() == version + 1);
+        ServiceDirectoryChangeList changes;
+        BOOST_REQUIRE(sd.getChanges(version, changes));
+        BOOST_REQUIRE(changes.size() == 10);
+        BOOST_REQUIRE(changes.front().version == version + 1 && changes.back().version == version + 1);
+
+        std::vector<Name> names;
+        names.push_back("agent_0");
+        names.push_back("agent_1");
+        names.push_back("unknown");
+        BOOST_REQUIRE_THROW(sd.deregisterServices(names), NotFound);
+        BOOST_REQUIRE(sd.getAll().size() == 11);
+
+        names.pop_back();
+        sd.deregisterServices(names);
+        BOOST_REQUIRE(sd.getAll().size() == 9);
+        BOOST_REQUIRE(sd.lookupByName("agent_0").empty());
+        BOOST_REQUIRE(sd.getVersion() == version + 2);
+    }
+
+    // A batch counts once against the history capacity
+    ServiceDirectoryChangeFeed feed(2);
+    ServiceDirectoryChange change;
+    change.type = ServiceDirectoryChange::ADDED;
+    feed.publish(ServiceDirectoryChange::ADDED, ServiceDirectoryEntry());
+    feed.publish(ServiceDirectoryChangeList(2000, change));
+    ServiceDirectoryChangeList changes;
+    BOOST_REQUIRE(feed.getChanges(0, changes));
+    BOOST_REQUIRE(changes.size() == 2001);
+    feed.publish(ServiceDirectoryChange::ADDED, ServiceDirectoryEntry());
+    changes.clear();
+    BOOST_REQUIRE(!feed.getChanges(0, changes));
+    BOOST_REQUIRE(feed.getChanges(1, changes));
+    BOOST_REQUIRE(changes.size() == 2001 && changes.back().version == 3);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,111 @@
+#include <boost/test/unit_test.hpp>
+#include <fipa_services/ServiceDirectoryWireFormat.hpp>
+#include <fipa_services/ErrorHandling.hpp>
+#include "TestEntries.hpp"
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(service_directory_wire_format)
+
+namespace {
+    ServiceDirectoryList createEntries(size_t size)
+    {
+        ServiceDirectoryList entries;
+        for(size_t i = 0; i < size; ++i)
+        {
+            // Long descriptions need multi-byte lengths
+            ServiceDirectoryEntry entry = test::createEntry("agent_%", i, "planner", "udt://192.168.0.1:2000", std::string(i*50, 'd'), "mts-0");
+            if(i % 2)
+            {
+                ServiceLocator locator = entry.getLocator();
+                locator.addLocation(ServiceLocation("tcp://192.168.0.1:3000"));
+                entry.setLocator(locator);
+            }
+            entries.push_back(entry);
+        }
+        return entries;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+    ServiceDirectoryList entries = createEntries(10);
+    std::string data = ServiceDirectoryWireFormat::encode(entries);
+    ServiceDirectoryList decoded = ServiceDirectoryWireFormat::decode(data);
+    BOOST_REQUIRE(decoded.size() == entries.size());
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+        BOOST_REQUIRE(decoded[i].getName() == entries[i].getName());
+        BOOST_REQUIRE(decoded[i].getType() == entries[i].getType());
+        BOOST_REQUIRE(decoded[i].getDescription() == entries[i].getDescription());
+        BOOST_REQUIRE(decoded[i].getTimestamp() == entries[i].getTimestamp());
+        BOOST_REQUIRE(decoded[i].getLocator().getLocations() == entries[i].getLocator().getLocations());
+    }
+
+    BOOST_REQUIRE(ServiceDirectoryWireFormat::decode(ServiceDirectoryWireFormat::encode(ServiceDirectoryList())).empty());
+}
+
+BOOST_AUTO_TEST_CASE(views)
+{
+    ServiceDirectoryList entries = createEntries(2);
+    std::string data = ServiceDirectoryWireFormat::encode(entries);
+
+    ServiceDirectoryWireReader reader(data);
+    BOOST_REQUIRE(reader.getNumberOfEntries() == 2);
+    ServiceDirectoryEntryView view;
+    BOOST_REQUIRE(reader.next(view));
+    BOOST_REQUIRE(view.name == "agent_0" && view.type == "planner" && view.description.empty());
+    // Views refer to the encoded data
+    BOOST_REQUIRE(view.name.data > data.data() && view.name.data < data.data() + data.size());
+
+    BOOST_REQUIRE(reader.next(view));
+    BOOST_REQUIRE(view.getNumberOfLocations() == 2);
+    ServiceLocationView location;
+    BOOST_REQUIRE(view.nextLocation(location));
+    BOOST_REQUIRE(location.serviceAddress == "udt://192.168.0.1:2000" && location.serviceSignature == "mts-0");
+    BOOST_REQUIRE(view.nextLocation(location));
+    BOOST_REQUIRE(location.serviceAddress == "tcp://192.168.0.1:3000" && location.signatureType.empty());
+    BOOST_REQUIRE(!view.nextLocation(location));
+    BOOST_REQUIRE(view.toEntry().getLocator().getLocations().size() == 2);
+    BOOST_REQUIRE(!reader.next(view));
+}
+
+BOOST_AUTO_TEST_CASE(versioning)
+{
+    ServiceDirectoryList entries = createEntries(1);
+    std::string data = ServiceDirectoryWireFormat::encode(entries);
+
+    // Fields appended by a compatible revision are skipped, the length of
+    // the small entry is a single byte after the header
+    std::string extended = data;
+    const size_t lengthPosition = 6;
+    BOOST_REQUIRE(static_cast<uint8_t>(extended[lengthPosition]) < 0x7C);
+    extended[lengthPosition] += 4;
+    extended.append("\x01\x02\x03\x04", 4);
+    ServiceDirectoryList decoded = ServiceDirectoryWireFormat::decode(extended);
+    BOOST_REQUIRE(decoded.size() == 1 && decoded[0].getName() == "agent_0");
+
+    std::string incompatible = data;
+    incompatible[4] = ServiceDirectoryWireFormat::VERSION + 1;
+    BOOST_REQUIRE_THROW(ServiceDirectoryWireReader reader(incompatible), InvalidEncoding);
+    BOOST_REQUIRE_THROW(ServiceDirectoryWireReader reader(data.substr(0, 3)), InvalidEncoding);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_data)
+{
+    std::string data = ServiceDirectoryWireFormat::encode(createEntries(3));
+
+    // Every truncation is detected
+    for(size_t size = 0; size < data.size(); ++size)
+    {
+        BOOST_REQUIRE_THROW(ServiceDirectoryWireFormat::decode(data.substr(0, size)), InvalidEncoding);
+    }
+    BOOST_REQUIRE_THROW(ServiceDirectoryWireFormat::decode(data + "x"), InvalidEncoding);
+
+    // Lengths exceeding the entry
+    std::string corrupted = data;
+    corrupted[6 + 1 + 8] = 0x7F;
+    BOOST_REQUIRE_THROW(ServiceDirectoryWireFormat::decode(corrupted), InvalidEncoding);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+#include <boost/test/unit_test.hpp>
+#include <iostream>
+#include <sstream>
+#include <fipa_services/ShardedServiceDirectory.hpp>
+#include "TestEntries.hpp"
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(sharded_service_directory_benchmark)
+
+BOOST_AUTO_TEST_CASE(concurrent_register_and_search)
+{
+    const size_t registrations = 2000;
+    const size_t searches = 20;
+    size_t threads[] = { 1, 2, 4, 8 };
+
+    std::cout << "ServiceDirectory vs. ShardedServiceDirectory: " << registrations << " registrations and lookups plus "
+        << searches << " regex searches per thread" << std::endl;
+    for(size_t t = 0; t < sizeof(threads)/sizeof(size_t); ++t)
+    {
+        std::vector<ServiceDirectory::Ptr> directories;
+        directories.push_back(ServiceDirectory::Ptr(new ServiceDirectory()));
+        directories.push_back(ServiceDirectory::Ptr(new ShardedServiceDirectory(16)));
+        const char* directoryTxt[] = { "ServiceDirectory", "ShardedServiceDirectory" };
+
+        for(size_t d = 0; d < directories.size(); ++d)
+        {
+            ServiceDirectory::Ptr sd = directories[d];
+            std::vector< std::vector<ServiceDirectoryEntry> > entries(threads[t]);
+            for(size_t i = 0; i < threads[t]; ++i)
+            {
+                std::stringstream name;
+                name << "robot_" << i << "_%.arm.planner";
+                for(size_t id = 0; id < registrations; ++id)
+                {
+                    entries[i].push_back(test::createEntry(name.str(), id));
+                }
+            }
+
+            base::Time start = base::Time::now();
+            boost::thread_group workers;
+            for(size_t i = 0; i < threads[t]; ++i)
+            {
+                workers.create_thread([sd, &entries, i, searches]()
+                    {
+                        const std::vector<ServiceDirectoryEntry>& threadEntries = entries[i];
+                        std::vector<ServiceDirectoryEntry>::const_iterator cit = threadEntries.begin();
+                        for(; cit != threadEntries.end(); ++cit)
+                        {
+                            sd->registerService(*cit);
+                            sd->lookupByName(cit->getName());
+                        }
+                        for(size_t s = 0; s < searches; ++s)
+                        {
+                            sd->search(".*_1\\.arm\\.planner", ServiceDirectoryEntry::NAME, false);
+                        }
+                    });
+            }
+            workers.join_all();
+            base::Time duration = base::Time::now() - start;
+            BOOST_REQUIRE(sd->getAll().size() == threads[t]*registrations);
+
+            std::cout << "    " << directoryTxt[d] << " threads: " << threads[t]
+                << " time: " << duration.toMilliseconds() << " ms"
+                << " registrations/s: " << threads[t]*registrations / duration.toSeconds()
+                << std::endl;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
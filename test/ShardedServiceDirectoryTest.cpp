@@ -0,0 +1,242 @@
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <fipa_services/ShardedServiceDirectory.hpp>
+
+BOOST_AUTO_TEST_SUITE(sharded_service_directory)
+
+BOOST_AUTO_TEST_CASE(register_and_search)
+{
+    using namespace fipa::services;
+
+    int workers[] = { 0, 3 };
+    for(size_t w = 0; w < 2; ++w)
+    {
+        ShardedServiceDirectory sd(8, ServiceDirectory::LOCKING, workers[w]);
+        BOOST_REQUIRE(sd.getNumberOfShards() == 8);
+        BOOST_REQUIRE(sd.getNumberOfWorkers() == (size_t) workers[w]);
+
+        ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+        for(int i = 0; i < 100; ++i)
+        {
+            std::stringstream ss;
+            ss << "agent_" << i;
+            sd.registerService(ServiceDirectoryEntry(ss.str(), i % 2 ? "odd" : "even", locator, ""));
+        }
+        BOOST_REQUIRE_THROW(sd.registerService(ServiceDirectoryEntry("agent_0", "even", locator, "")), DuplicateEntry);
+
+        ServiceDirectoryList all = sd.getAll();
+        BOOST_REQUIRE(all.size() == 100);
+        BOOST_REQUIRE(all.front().getName() == "agent_0");
+        BOOST_REQUIRE(all.back().getName() == "agent_99");
+
+        BOOST_REQUIRE(sd.lookupByName("agent_42").size() == 1);
+        BOOST_REQUIRE(sd.search("agent_42", ServiceDirectoryEntry::NAME).size() == 1);
+        BOOST_REQUIRE(sd.search("agent_4.*", ServiceDirectoryEntry::NAME).size() == 11);
+        BOOST_REQUIRE(sd.search("odd", ServiceDirectoryEntry::TYPE).size() == 50);
+        BOOST_REQUIRE(sd.searchByLocation("udt://.*").size() == 100);
+        BOOST_REQUIRE_THROW(sd.search("unknown", ServiceDirectoryEntry::NAME), NotFound);
+        BOOST_REQUIRE(sd.getSnapshot()->size() == 100);
+
+        size_t visited = 0;
+        sd.forEachMatch("even", ServiceDirectoryEntry::TYPE, [&visited](const ServiceDirectoryEntry& entry)
+            {
+                return ++visited < 10;
+            });
+        BOOST_REQUIRE(visited == 10);
+
+        BOOST_REQUIRE_NO_THROW(sd.modify(ServiceDirectoryEntry("agent_1", "even", locator, "")));
+        BOOST_REQUIRE(sd.search("even", ServiceDirectoryEntry::TYPE).size() == 51);
+
+        BOOST_REQUIRE_NO_THROW(sd.deregisterService("agent_1", ServiceDirectoryEntry::NAME));
+        BOOST_REQUIRE_NO_THROW(sd.deregisterService("odd", ServiceDirectoryEntry::TYPE));
+        BOOST_REQUIRE_THROW(sd.deregisterService("agent_1", ServiceDirectoryEntry::NAME), NotFound);
+        BOOST_REQUIRE(sd.getAll().size() == 98);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(merge_selectively)
+{
+    using namespace fipa::services;
+
+    ShardedServiceDirectory sd(4);
+    ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+    ServiceLocator otherLocator = ServiceLocator::fromString("udt://192.168.0.2:2000");
+    for(int i = 0; i < 20; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        sd.registerService(ServiceDirectoryEntry(ss.str(), "planner", i < 10 ? locator : otherLocator, ""));
+    }
+
+    // The only update has to remove all entries with the same locator from
+    // all shards
+    ServiceDirectoryList updateList;
+    updateList.push_back(ServiceDirectoryEntry("agent_0", "planner", locator, ""));
+    BOOST_REQUIRE_NO_THROW(sd.mergeSelectively(updateList, ServiceDirectoryEntry::LOCATOR));
+    BOOST_REQUIRE(sd.getAll().size() == 11);
+
+    updateList.push_back(ServiceDirectoryEntry("agent_10", "planner", locator, ""));
+    BOOST_REQUIRE_THROW(sd.mergeSelectively(updateList, ServiceDirectoryEntry::LOCATOR), DuplicateEntry);
+    BOOST_REQUIRE(sd.getAll().size() == 11);
+}
+
+BOOST_AUTO_TEST_CASE(change_feed)
+{
+    using namespace fipa::services;
+
+    ShardedServiceDirectory sd(4);
+    size_t received = 0;
+    sd.subscribe([&received](const ServiceDirectoryChange& change) { ++received; });
+
+    ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+    for(int i = 0; i < 10; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        sd.registerService(ServiceDirectoryEntry(ss.str(), "planner", locator, ""));
+    }
+    BOOST_REQUIRE(received == 10);
+    BOOST_REQUIRE(sd.getVersion() == 10);
+
+    ServiceDirectoryChangeList changes;
+    BOOST_REQUIRE(sd.getChanges(5, changes));
+    BOOST_REQUIRE(changes.size() == 5);
+    BOOST_REQUIRE(changes.front().version == 6);
+}
+
+BOOST_AUTO_TEST_CASE(deregister_first_match)
+{
+    using namespace fipa::services;
+
+    // Sharded and unsharded directories remove the same entry
+    ServiceDirectory sd;
+    ShardedServiceDirectory sharded(4);
+    ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+    for(int i = 0; i < 20; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        sd.registerService(ServiceDirectoryEntry(ss.str(), i % 3 ? "planner" : "arm", locator, ""));
+        sharded.registerService(ServiceDirectoryEntry(ss.str(), i % 3 ? "planner" : "arm", locator, ""));
+    }
+
+    for(int i = 0; i < 7; ++i)
+    {
+        sd.deregisterService("agent_1.*", ServiceDirectoryEntry::NAME);
+        sharded.deregisterService("agent_1.*", ServiceDirectoryEntry::NAME);
+        sd.deregisterService("arm", ServiceDirectoryEntry::TYPE);
+        sharded.deregisterService("arm", ServiceDirectoryEntry::TYPE);
+
+        ServiceDirectoryList expected = sd.getAll();
+        ServiceDirectoryList received = sharded.getAll();
+        BOOST_REQUIRE(expected.size() == received.size());
+        for(size_t e = 0; e < expected.size(); ++e)
+        {
+            BOOST_REQUIRE(expected[e].getName() == received[e].getName());
+        }
+    }
+    BOOST_REQUIRE_THROW(sharded.deregisterService("arm", ServiceDirectoryEntry::TYPE), NotFound);
+}
+
+BOOST_AUTO_TEST_CASE(bulk_registration)
+{
+    using namespace fipa::services;
+
+    ShardedServiceDirectory sd(8);
+    ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+    ServiceDirectoryList entries;
+    std::vector<Name> names;
+    for(int i = 0; i < 100; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        entries.push_back(ServiceDirectoryEntry(ss.str(), "type", locator, ""));
+        names.push_back(ss.str());
+    }
+    size_t received = 0;
+    sd.subscribe([&received](const ServiceDirectoryChange& change) { ++received; });
+    sd.registerServices(entries);
+    BOOST_REQUIRE(sd.getAll().size() == 100);
+    // The changes of all shards share a version
+    BOOST_REQUIRE(received == 100);
+    BOOST_REQUIRE(sd.getVersion() == 1);
+    BOOST_REQUIRE_THROW(sd.registerServices(ServiceDirectoryList(1, entries.back())), DuplicateEntry);
+
+    names.push_back("unknown");
+    BOOST_REQUIRE_THROW(sd.deregisterServices(names), NotFound);
+    BOOST_REQUIRE(sd.getAll().size() == 100);
+    names.pop_back();
+    sd.deregisterServices(names);
+    BOOST_REQUIRE(sd.getAll().empty());
+    BOOST_REQUIRE(sd.getVersion() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(restore)
+{
+    using namespace fipa::services;
+
+    ShardedServiceDirectory sd(8);
+    ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+    sd.registerService(ServiceDirectoryEntry("agent_0", "planner", locator, ""));
+
+    ServiceDirectoryList entries;
+    for(int i = 0; i < 20; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        entries.push_back(ServiceDirectoryEntry(ss.str(), "planner", locator, ""));
+    }
+    // Called through the base class, the entries have to end up in the shards
+    ServiceDirectory& directory = sd;
+    BOOST_REQUIRE(directory.restore(entries) == 19);
+    BOOST_REQUIRE(sd.getAll().size() == 20);
+    BOOST_REQUIRE(sd.lookupByName("agent_13").size() == 1);
+    BOOST_REQUIRE(sd.search("agent_1.*", ServiceDirectoryEntry::NAME).size() == 11);
+
+    std::set<std::string> fieldValues;
+    fieldValues.insert(locator.toString());
+    directory.mergeSelectively(ServiceDirectoryList(1, entries.front()), ServiceDirectoryEntry::LOCATOR, fieldValues);
+    BOOST_REQUIRE(sd.getAll().size() == 1);
+    BOOST_REQUIRE(sd.lookupByName("agent_0").size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(batch_versions)
+{
+    using namespace fipa::services;
+
+    // Shards are modified by the worker threads, the changes are published
+    // by the calling thread with a single version
+    ShardedServiceDirectory sd(8, ServiceDirectory::LOCKING, 3);
+    boost::thread::id caller = boost::this_thread::get_id();
+    size_t received = 0;
+    bool callerOnly = true;
+    sd.subscribe([&received, &callerOnly, caller](const ServiceDirectoryChange& change)
+        {
+            ++received;
+            callerOnly = callerOnly && boost::this_thread::get_id() == caller;
+        });
+
+    ServiceLocator locator = ServiceLocator::fromString("udt://192.168.0.1:2000");
+    ServiceDirectoryList entries;
+    for(int i = 0; i < 100; ++i)
+    {
+        std::stringstream ss;
+        ss << "agent_" << i;
+        entries.push_back(ServiceDirectoryEntry(ss.str(), "planner", locator, ""));
+    }
+    BOOST_REQUIRE(sd.restore(entries) == 100);
+    BOOST_REQUIRE(sd.getVersion() == 1);
+
+    ServiceLocator otherLocator = ServiceLocator::fromString("udt://192.168.0.2:2000");
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+        entries[i].setLocator(otherLocator);
+    }
+    sd.mergeSelectively(entries, ServiceDirectoryEntry::NAME);
+    BOOST_REQUIRE(sd.getVersion() == 2);
+    BOOST_REQUIRE(sd.search("udt://192.168.0.2:2000", ServiceDirectoryEntry::LOCATOR).size() == 100);
+    BOOST_REQUIRE(received == 200);
+    BOOST_REQUIRE(callerOnly);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,55 @@
+#ifndef FIPA_SERVICES_TEST_TEST_ENTRIES_HPP
+#define FIPA_SERVICES_TEST_TEST_ENTRIES_HPP
+
+#include <sstream>
+#include <string>
+#include <fipa_services/ServiceDirectoryEntry.hpp>
+
+namespace fipa {
+namespace services {
+namespace test {
+
+/**
+ * Create a numbered entry of a message client for tests and benchmarks
+ * \details The entry has a single location at a message transport. Each '%'
+ * in the name and the address is replaced by the id, e.g. 'agent_%'
+ * \param name Name of the entry
+ * \param id Number of the entry
+ * \param type Type of the entry
+ * \param address Service address of the message transport
+ * \param description Description of the entry
+ * \param serviceSignature Service signature of the location
+ * \return Entry
+ */
+inline ServiceDirectoryEntry createEntry(const std::string& name, size_t id,
+        const std::string& type = "fipa::services::transports::MessageTransport",
+        const std::string& address = "udt://192.168.0.1:12391",
+        const std::string& description = "Message client of mts-0",
+        const std::string& serviceSignature = "")
+{
+    std::stringstream ss;
+    ss << id;
+    std::string number = ss.str();
+
+    std::string entryName = name;
+    std::string entryAddress = address;
+    std::string* fields[] = { &entryName, &entryAddress };
+    for(size_t f = 0; f < 2; ++f)
+    {
+        size_t pos = 0;
+        while((pos = fields[f]->find('%', pos)) != std::string::npos)
+        {
+            fields[f]->replace(pos, 1, number);
+            pos += number.size();
+        }
+    }
+
+    ServiceLocator locator;
+    locator.addLocation(ServiceLocation(entryAddress, "fipa::services::transports::MessageTransport", serviceSignature));
+    return ServiceDirectoryEntry(entryName, type, locator, description);
+}
+
+} // end namespace test
+} // end namespace services
+} // end namespace fipa
+#endif // FIPA_SERVICES_TEST_TEST_ENTRIES_HPP
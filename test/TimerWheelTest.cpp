@@ -0,0 +1,74 @@
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <sstream>
+#include <fipa_services/TimerWheel.hpp>
+
+BOOST_AUTO_TEST_SUITE(timer_wheel)
+
+BOOST_AUTO_TEST_CASE(expiry)
+{
+    using namespace fipa::services;
+
+    base::Time start = base::Time::now();
+    TimerWheel wheel(base::Time::fromMilliseconds(10), start);
+
+    wheel.schedule("a", start + base::Time::fromMilliseconds(25));
+    wheel.schedule("b", start + base::Time::fromMilliseconds(100));
+    wheel.schedule("c", start + base::Time::fromMilliseconds(100));
+    BOOST_REQUIRE(wheel.size() == 3);
+
+    // Timers never expire early
+    BOOST_REQUIRE(wheel.advance(start + base::Time::fromMilliseconds(24)).empty());
+    std::vector<std::string> expired = wheel.advance(start + base::Time::fromMilliseconds(30));
+    BOOST_REQUIRE(expired.size() == 1 && expired[0] == "a");
+    BOOST_REQUIRE(!wheel.contains("a"));
+
+    // Rescheduling and cancelling
+    wheel.schedule("b", start + base::Time::fromMilliseconds(200));
+    BOOST_REQUIRE(wheel.cancel("c"));
+    BOOST_REQUIRE(!wheel.cancel("c"));
+    BOOST_REQUIRE(wheel.advance(start + base::Time::fromMilliseconds(150)).empty());
+    expired = wheel.advance(start + base::Time::fromMilliseconds(200));
+    BOOST_REQUIRE(expired.size() == 1 && expired[0] == "b");
+    BOOST_REQUIRE(wheel.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(cascading)
+{
+    using namespace fipa::services;
+
+    base::Time start = base::Time::now();
+    base::Time resolution = base::Time::fromMilliseconds(1);
+    TimerWheel wheel(resolution, start);
+
+    // Expiry times across all levels, including beyond the range of the
+    // wheel
+    std::vector<int64_t> ticks;
+    ticks.push_back(1);
+    ticks.push_back(255);
+    ticks.push_back(256);
+    ticks.push_back(257);
+    ticks.push_back(65535);
+    ticks.push_back(65536);
+    ticks.push_back(70000);
+    ticks.push_back(16777216 + 3);
+    ticks.push_back(5000000000LL);
+    for(size_t i = 0; i < ticks.size(); ++i)
+    {
+        std::stringstream ss;
+        ss << ticks[i];
+        wheel.schedule(ss.str(), start + base::Time::fromMilliseconds(ticks[i]));
+    }
+
+    for(size_t i = 0; i < ticks.size(); ++i)
+    {
+        std::stringstream ss;
+        ss << ticks[i];
+        BOOST_REQUIRE_MESSAGE(wheel.advance(start + base::Time::fromMilliseconds(ticks[i] - 1)).empty(), "Timer " << ticks[i] << " expired early");
+        std::vector<std::string> expired = wheel.advance(start + base::Time::fromMilliseconds(ticks[i]));
+        BOOST_REQUIRE_MESSAGE(expired.size() == 1 && expired[0] == ss.str(), "Timer " << ticks[i] << " expired");
+    }
+    BOOST_REQUIRE(wheel.size() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,88 @@
+#include <boost/test/unit_test.hpp>
+#include <fipa_services/UnknownReceiverCache.hpp>
+#include <fipa_services/ServiceDirectory.hpp>
+
+using namespace fipa::services;
+
+BOOST_AUTO_TEST_SUITE(unknown_receiver_cache)
+
+BOOST_AUTO_TEST_CASE(expiry)
+{
+    UnknownReceiverCache cache(base::Time::fromMilliseconds(100));
+    base::Time now = base::Time::fromSeconds(1000);
+
+    BOOST_REQUIRE(!cache.contains("agent-0", now));
+    BOOST_REQUIRE(cache.insert("agent-0", cache.getGeneration(), now));
+    BOOST_REQUIRE(cache.contains("agent-0", now));
+    BOOST_REQUIRE(cache.contains("agent-0", now + base::Time::fromMilliseconds(99)));
+    BOOST_REQUIRE(!cache.contains("agent-0", now + base::Time::fromMilliseconds(100)));
+    BOOST_REQUIRE(cache.size() == 0);
+
+    BOOST_REQUIRE(cache.getHits() == 2);
+    BOOST_REQUIRE(cache.getInsertions() == 1);
+    cache.resetStatistics();
+    BOOST_REQUIRE(cache.getHits() == 0);
+
+    // A zero lifetime disables the cache
+    cache.setLifetime(base::Time());
+    BOOST_REQUIRE(!cache.insert("agent-0", cache.getGeneration(), now));
+    BOOST_REQUIRE(!cache.contains("agent-0", now));
+}
+
+BOOST_AUTO_TEST_CASE(invalidation)
+{
+    UnknownReceiverCache cache;
+    cache.insert("agent-0", cache.getGeneration());
+    cache.insert("agent-1", cache.getGeneration());
+    cache.insert("robot_.*", cache.getGeneration());
+
+    // Patterns may match any added service
+    cache.invalidate("agent-0");
+    BOOST_REQUIRE(!cache.contains("agent-0"));
+    BOOST_REQUIRE(!cache.contains("robot_.*"));
+    BOOST_REQUIRE(cache.contains("agent-1"));
+    BOOST_REQUIRE(cache.getInvalidations() == 2);
+
+    // Resolution started before the invalidation
+    uint64_t generation = cache.getGeneration();
+    cache.invalidate("agent-2");
+    BOOST_REQUIRE(!cache.insert("agent-2", generation));
+    BOOST_REQUIRE(!cache.contains("agent-2"));
+
+    cache.clear();
+    BOOST_REQUIRE(cache.size() == 0);
+    BOOST_REQUIRE(cache.getInvalidations() == 3);
+}
+
+BOOST_AUTO_TEST_CASE(capacity)
+{
+    UnknownReceiverCache cache(base::Time::fromMilliseconds(100), 2);
+    base::Time now = base::Time::fromSeconds(1000);
+    BOOST_REQUIRE(cache.insert("agent-0", 0, now));
+    BOOST_REQUIRE(cache.insert("agent-1", 0, now));
+    BOOST_REQUIRE(!cache.insert("agent-2", 0, now));
+    // Expired receivers make room
+    BOOST_REQUIRE(cache.insert("agent-2", 0, now + base::Time::fromMilliseconds(100)));
+    BOOST_REQUIRE(cache.size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(directory_changes)
+{
+    ServiceDirectory directory;
+    UnknownReceiverCache cache;
+    directory.subscribe([&cache](const ServiceDirectoryChange& change)
+        {
+            if(change.type == ServiceDirectoryChange::ADDED)
+            {
+                cache.invalidate(change.entry.getName());
+            }
+        });
+
+    cache.insert("agent-0", cache.getGeneration());
+    directory.registerService(ServiceDirectoryEntry("agent-1", "planner", ServiceLocator(), ""));
+    BOOST_REQUIRE(cache.contains("agent-0"));
+    directory.registerService(ServiceDirectoryEntry("agent-0", "planner", ServiceLocator(), ""));
+    BOOST_REQUIRE(!cache.contains("agent-0"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()